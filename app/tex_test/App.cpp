@@ -6,11 +6,18 @@
 #include "TGAImage.h"
 #include "WavefrontObj.h"
 #include "Mesh.h"
+#include "VertexLayout.h"
 
 #include "GL/glew.h"
 #include "GL/freeglut.h"
 
-App::App() {
+#include <filesystem>
+#include <iostream>
+
+App::App()
+	: tex(0), triangle_count(0), index_type(GL_UNSIGNED_SHORT), material_location(-1),
+	texture_bound(false), mesh_bound(false), preview_bound(false)
+{
 
 }
 
@@ -20,8 +27,64 @@ void App::init()
 	init_array();
 	init_tex();
 #endif
-	init_tex();
+	loader.reset(new AssetLoader());
+
 	init_program();
+	init_tex();
+	init_mesh();
+}
+
+bool App::update(double budget_seconds)
+{
+	bool busy = loader->update(budget_seconds);
+
+	if (!texture_bound && texture->ready()) {
+		tex = texture->id;
+		glBindTexture(GL_TEXTURE_2D, tex);
+		texture_bound = true;
+	}
+
+	if (!mesh_bound && mesh->ready()) {
+		bind_mesh();
+		mesh_bound = true;
+
+		// The cooked mesh replaces the preview for good.
+		if (preview) {
+			AssetLoader::release(preview);
+			preview.reset();
+		}
+	}
+
+	if (!mesh_bound && !preview_bound && preview && preview->vertex_buffer != 0) {
+		bind_preview();
+		preview_bound = true;
+	}
+
+	// Uploads bind their own buffers, so take the index buffer back.
+	if (mesh_bound)
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.index);
+
+	return busy;
+}
+
+void App::shutdown()
+{
+	// Loads still in flight are dropped with the loader, so nothing is
+	// uploaded into the objects released below.
+	loader.reset();
+
+	if (texture)
+		AssetLoader::release(texture);
+	if (mesh)
+		AssetLoader::release(mesh);
+	if (preview)
+		AssetLoader::release(preview);
+
+	texture.reset();
+	mesh.reset();
+	preview.reset();
+	texture_bound = mesh_bound = preview_bound = false;
+	tex = 0;
 }
 
 size_t App::get_triangle_count() const
@@ -29,6 +92,98 @@ size_t App::get_triangle_count() const
 	return triangle_count;
 }
 
+GLenum App::get_index_type() const
+{
+	return index_type;
+}
+
+size_t App::get_index_size() const
+{
+	return index_type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+size_t App::get_streamed_vertex_count() const
+{
+	if (mesh_bound || !preview_bound)
+		return 0;
+
+	return preview->drawable_triangles * 3;
+}
+
+const MeshLod::Level &App::select_lod(float pixels_per_unit) const
+{
+	return lod.level(lod.select(pixels_per_unit));
+}
+
+size_t App::get_draw_ranges(float pixels_per_unit, std::vector<MeshletCull::DrawRange> &draws,
+	std::vector<Batch> &batches) const
+{
+	draws.clear();
+	batches.clear();
+
+	// The mesh is drawn straight in clip space, so the frustum is the unit
+	// cube. There is no camera position to test the normal cones against,
+	// and faces are not culled, so only the frustum test applies.
+	static const float identity[16] = {
+		1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f
+	};
+	static const Frustum frustum = Frustum::from_matrix(identity);
+
+	uint32_t level = (uint32_t)lod.select(pixels_per_unit);
+	size_t culled = 0;
+
+	// Culled separately per submesh, so ranges never merge across a
+	// material change.
+	std::vector<MeshletCull::DrawRange> visible;
+
+	for (const Mesh::Submesh &sub : submeshes) {
+		if (sub.level != level)
+			continue;
+
+		// A submesh wholly outside needs none of its meshlets tested.
+		if (!sub.bounds.empty() && !frustum.intersects_aabb(sub.bounds.min, sub.bounds.max)) {
+			culled += sub.meshlet_count;
+			continue;
+		}
+
+		Batch batch = { sub.material, draws.size(), 0 };
+
+		if (sub.meshlet_count == 0) {
+			draws.push_back({ sub.first_index, sub.index_count });
+		}
+		else {
+			visible.clear();
+			size_t count = MeshletCull::cull(meshlets.data() + sub.first_meshlet, sub.meshlet_count,
+				frustum, nullptr, visible);
+			culled += sub.meshlet_count - count;
+			draws.insert(draws.end(), visible.begin(), visible.end());
+		}
+
+		batch.draw_count = draws.size() - batch.first_draw;
+		if (batch.draw_count)
+			batches.push_back(batch);
+	}
+
+	return culled;
+}
+
+void App::use_material(uint32_t material) const
+{
+	if (material_location < 0)
+		return;
+
+	if (material < materials.size()) {
+		const Mesh::Material &m = materials[material];
+		glUniform4f(material_location, m.diffuse[0], m.diffuse[1], m.diffuse[2], m.opacity);
+	}
+	else {
+		glUniform4f(material_location, 1.0f, 1.0f, 1.0f, 1.0f);
+	}
+}
+
 std::vector<vec4f> App::conv_tga_to_gltexture(const TGAImage & image) const
 {
 	std::vector<vec4f> data;
@@ -99,31 +254,7 @@ void App::init_array()
 
 void App::init_tex()
 {
-	glGenTextures(1, &tex);
-	glBindTexture(GL_TEXTURE_2D, tex);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-	TGAImage image("res/metal1.tga");
-	const TGAImage::rgba *data = image.getPixelData().data();
-
-	glTexImage2D(GL_TEXTURE_2D,
-		0,
-		GL_RGBA,
-		image.width(),
-		image.height(),
-		0,
-		GL_BGRA, // B and R channels are flipped in .tga formats
-		GL_UNSIGNED_BYTE,
-		(void *)data
-	);
-
-	// Must load texture before generating mipmaps.
-	glGenerateMipmap(GL_TEXTURE_2D);
+	texture = loader->load_texture("res/metal1.tga");
 }
 
 void App::init_program()
@@ -132,11 +263,30 @@ void App::init_program()
 		"#version 110\n"
 		"attribute vec3 vertex;\n"
 		"attribute vec2 uv;\n"
+		"attribute vec3 normal;\n"
 		"varying vec2 frag_uv;\n"
+		"varying vec3 frag_normal;\n"
+		""
+		// Undo the vertex quantisation, see VertexLayout::Dequantize.
+		"uniform vec3 vertex_offset;\n"
+		"uniform vec3 vertex_scale;\n"
+		"uniform vec2 uv_offset;\n"
+		"uniform vec2 uv_scale;\n"
+		"uniform int normal_octahedral;\n"
+		""
+		"vec3 decode_normal(vec3 n) {\n"
+		" if (normal_octahedral == 0)\n"
+		"  return n;\n"
+		" vec3 v = vec3(n.xy, 1.0 - abs(n.x) - abs(n.y));\n"
+		" if (v.z < 0.0)\n"
+		"  v.xy = (1.0 - abs(v.yx)) * sign(v.xy);\n"
+		" return normalize(v);\n"
+		"}\n"
 		""
 		"void main() {\n"
-		" gl_Position = vec4(vertex, 1.0);\n"
-		" frag_uv = uv;\n"
+		" gl_Position = vec4(vertex_offset + vertex * vertex_scale, 1.0);\n"
+		" frag_uv = uv_offset + uv * uv_scale;\n"
+		" frag_normal = decode_normal(normal);\n"
 		"}\n"
 		;
 
@@ -147,9 +297,10 @@ void App::init_program()
 		"varying vec2 frag_uv;\n"
 		""
 		"uniform sampler2D tex;\n"
+		"uniform vec4 material_diffuse;\n"
 		""
 		"void main() {\n"
-		" gl_FragColor = texture2D(tex, frag_uv);\n"
+		" gl_FragColor = texture2D(tex, frag_uv) * material_diffuse;\n"
 		"}\n"
 		;
 
@@ -163,80 +314,55 @@ void App::init_program()
 	p->print_debug_info();
 	p->use();
 
-	GLint vertex_id = glGetAttribLocation(p->id(), "vertex");
-	GLint uv_id = glGetAttribLocation(p->id(), "uv");
+	material_location = glGetUniformLocation(p->id(), "material_diffuse");
+}
 
-	WavefrontObj mesh("res/coollogo.obj");
-	Mesh temp(mesh);
-	Mesh::Unpacked unpacked = temp.unpack_to_triangles();
+void App::init_mesh()
+{
+	static const char *mesh_file = "res/coollogo.obj";
+	static const char *cache_file = "res/coollogo.obj.meshcache";
 
-#if 0
-	static const vec3f vertex[6] = {
-		vec3f(0.5f, 0.5f, 0.0f),
-		vec3f(0.5f, -0.5f, 0.0f),
-		vec3f(-0.5f, -0.5f, 0.0f),
-
-		vec3f(0.5f, 0.5f, 0.0f),
-		vec3f(-0.5f, 0.5f, 0.0f),
-		vec3f(-0.5f, -0.5f, 0.0f),
-	};
+	// On a cache hit the vertex data is uploaded straight out of the mapping.
+	mesh = loader->load_mesh(mesh_file, cache_file);
 
-	static const vec2f uv[6] = {
-		vec2f(1.0f, 1.0f),
-		vec2f(1.0f, 0.0f),
-		vec2f(0.0f, 0.0f),
+	// Without a cache the mesh is cooked first, which takes several times
+	// as long as parsing it; stream its raw triangles in meanwhile.
+	std::error_code ec;
+	if (!std::filesystem::exists(cache_file, ec))
+		preview = loader->load_mesh_progressive(mesh_file);
+}
 
-		vec2f(1.0f, 1.0f),
-		vec2f(0.0f, 1.0f),
-		vec2f(0.0f, 0.0f),
-	};
+void App::bind_mesh()
+{
+	buffer.vertex = mesh->vertex_buffer;
+	buffer.index = mesh->index_buffer;
 
-	static const vec3f normal[6] = {
-		vec3f(0.0f, 0.0f, 1.0f),
-		vec3f(0.0f, 0.0f, 1.0f),
-		vec3f(0.0f, 0.0f, 1.0f),
+	index_type = mesh->index_type;
+	lod = mesh->lod;
+	meshlets = mesh->meshlets;
+	submeshes = mesh->submeshes;
+	materials = mesh->materials;
 
-		vec3f(0.0f, 0.0f, 1.0f),
-		vec3f(0.0f, 0.0f, 1.0f),
-		vec3f(0.0f, 0.0f, 1.0f)
-	};
-#elseif 0
-	const vec3f *vertex = unpacked.vertex.data();
-	const vec2f *uv = unpacked.uv.data();
-	const vec3f *normal = unpacked.normal.data();
-#endif
+	if (lod.empty())
+		lod.add({ 0, (uint32_t)mesh->index_count, 0.0f });
 
-	triangle_count = temp.vertex_tri.size() * 3;
-#if 0
-	glGenBuffers(1, &buffer.vertex);
-	glBindBuffer(GL_ARRAY_BUFFER, buffer.vertex);
-	glBufferData(GL_ARRAY_BUFFER, 6 * sizeof(vec3f), (void *)vertex, GL_STATIC_DRAW);
-#endif
+	triangle_count = lod.level(0).index_count;
 
-	glGenBuffers(1, &buffer.vertex);
+	// Every attribute lives in the one interleaved buffer.
 	glBindBuffer(GL_ARRAY_BUFFER, buffer.vertex);
-	glBufferData(GL_ARRAY_BUFFER, unpacked.vertex.size() * sizeof(vec3f), (void *)unpacked.vertex.data(), GL_STATIC_DRAW);
-
-	glEnableVertexAttribArray(vertex_id);
-	glVertexAttribPointer(vertex_id, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
+	mesh->layout.bind(*p);
+	mesh->dequantize.set_uniforms(*p);
 
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.index);
 	assert(glGetError() == GL_NONE);
-#if 1
-	glGenBuffers(1, &buffer.uv);
-	glBindBuffer(GL_ARRAY_BUFFER, buffer.uv);
-	glBufferData(GL_ARRAY_BUFFER, unpacked.uv.size() * sizeof(vec3f), (void *)unpacked.uv.data(), GL_STATIC_DRAW);
+}
 
-	glVertexAttribPointer(uv_id, 2, GL_FLOAT, GL_TRUE, 0, 0);
-	glEnableVertexAttribArray(uv_id);
-#endif
+void App::bind_preview()
+{
+	// Plain floats, so the shader's dequantisation is the identity.
+	glBindBuffer(GL_ARRAY_BUFFER, preview->vertex_buffer);
+	preview->layout.bind(*p);
+	VertexLayout::Dequantize().set_uniforms(*p);
 	assert(glGetError() == GL_NONE);
-
-#if 0
-	glGenBuffers(1, &buffer.normal);
-	glBindBuffer(GL_ARRAY_BUFFER, buffer.normal);
-	glBufferData(GL_ARRAY_BUFFER, 6 * sizeof(vec3f), normal, GL_STATIC_DRAW);
-#endif
-
-	return;
 }
+
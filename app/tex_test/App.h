@@ -8,12 +8,20 @@
 
 #include "Shader.h"
 #include "Program.h"
+#include "MeshLod.h"
+#include "Meshlet.h"
+#include "Mesh.h"
+#include "AssetLoader.h"
+
+#include <memory>
+#include <vector>
 
 class App {
 	struct gl_buffer {
 		GLuint vertex;
 		GLuint normal;
 		GLuint uv;
+		GLuint index;
 	} buffer;
 
 	GLuint tex;
@@ -21,12 +29,67 @@ class App {
 	Shader *vs, *fs;
 	Program *p;
 
+	// Number of indices to draw, and their type (GL_UNSIGNED_SHORT/INT).
 	size_t triangle_count;
+	GLenum index_type;
+
+	MeshLod lod;
+	std::vector<Meshlet> meshlets;
+	std::vector<Mesh::Submesh> submeshes;
+	std::vector<Mesh::Material> materials;
+
+	GLint material_location;
+
+	std::unique_ptr<AssetLoader> loader;
+	std::shared_ptr<const AssetLoader::TextureAsset> texture;
+	std::shared_ptr<const AssetLoader::MeshAsset> mesh;
+	std::shared_ptr<const AssetLoader::StreamedMeshAsset> preview;
+	bool texture_bound, mesh_bound, preview_bound;
 
 public:
+	// Consecutive draws of get_draw_ranges() that share a material.
+	struct Batch {
+		uint32_t material;
+		size_t first_draw;
+		size_t draw_count;
+	};
+
 	App();
+
+	// Compiles the shaders and starts loading the assets in the
+	// background; nothing is drawn until the mesh is in.
 	void init();
+
+	// Call once per frame: uploads finished loads for at most
+	// budget_seconds and starts using them. Returns true while loads are
+	// still outstanding.
+	bool update(double budget_seconds);
+
+	// Stops loading and deletes the GL objects of the assets. Call while
+	// the GL context is still current.
+	void shutdown();
+
 	size_t get_triangle_count() const;
+	GLenum get_index_type() const;
+	size_t get_index_size() const;
+
+	// Vertices of the streamed preview to draw with glDrawArrays(), or 0
+	// once the cooked mesh is in (or there is no preview).
+	size_t get_streamed_vertex_count() const;
+
+	// Level of detail to draw when one mesh unit covers pixels_per_unit
+	// pixels on screen.
+	const MeshLod::Level &select_lod(float pixels_per_unit) const;
+
+	// Index ranges to draw this frame: the submeshes of the selected level
+	// of detail, and for the finest level only the meshlets that survive
+	// culling. Draws come grouped into one batch per material. Returns the
+	// number of meshlets culled.
+	size_t get_draw_ranges(float pixels_per_unit, std::vector<MeshletCull::DrawRange> &draws,
+		std::vector<Batch> &batches) const;
+
+	// Sets the material uniforms for the draws of a batch.
+	void use_material(uint32_t material) const;
 
 private:
 	std::vector<vec4f> conv_tga_to_gltexture(const TGAImage &image) const;
@@ -34,4 +97,7 @@ private:
 	void init_array();
 	void init_tex();
 	void init_program();
+	void init_mesh();
+	void bind_mesh();
+	void bind_preview();
 };
@@ -0,0 +1,522 @@
+#include "AssetLoader.h"
+
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "MeshStream.h"
+#include "TGAImage.h"
+#include "TGAImageView.h"
+#include "WavefrontMtl.h"
+#include "WavefrontObj.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace {
+
+typedef std::chrono::steady_clock upload_clock;
+
+// CPU side of a mesh, kept until its buffers are uploaded. On a cache hit
+// vertices and indices point into the cache mapping, otherwise into the
+// freshly cooked interleaved and indexed data.
+struct MeshData {
+	MeshCache cache;
+	Mesh::Indexed indexed;
+	Mesh::Interleaved interleaved;
+
+	const void *vertices;
+	const void *indices;
+	size_t vertex_bytes;
+	size_t index_bytes;
+};
+
+bool read_cache(AssetLoader::MeshAsset &asset, MeshData &data)
+{
+	MeshCache &cache = data.cache;
+
+	data.vertices = cache.get_interleaved(asset.layout, asset.dequantize, asset.vertex_count);
+
+	data.indices = cache.get<uint16_t>(MeshCache::INDEX16, asset.index_count);
+	asset.index_type = GL_UNSIGNED_SHORT;
+	if (!data.indices) {
+		data.indices = cache.get<uint32_t>(MeshCache::INDEX32, asset.index_count);
+		asset.index_type = GL_UNSIGNED_INT;
+	}
+
+	if (!data.vertices || !data.indices)
+		return false;
+
+	size_t level_count;
+	const MeshLod::Level *levels = cache.get<MeshLod::Level>(MeshCache::LOD_LEVELS, level_count);
+	asset.lod = MeshLod(levels, levels ? level_count : 0);
+
+	size_t meshlet_count;
+	const Meshlet *m = cache.get<Meshlet>(MeshCache::MESHLETS, meshlet_count);
+	asset.meshlets.assign(m, m ? m + meshlet_count : m);
+
+	size_t submesh_count;
+	const Mesh::Submesh *s = cache.get<Mesh::Submesh>(MeshCache::SUBMESHES, submesh_count);
+	asset.submeshes.assign(s, s ? s + submesh_count : s);
+
+	size_t material_count;
+	const Mesh::Material *mat = cache.get<Mesh::Material>(MeshCache::MATERIALS, material_count);
+	asset.materials.assign(mat, mat ? mat + material_count : mat);
+
+	size_t bounds_count;
+	const Mesh::Bounds *bounds = cache.get<Mesh::Bounds>(MeshCache::MESH_BOUNDS, bounds_count);
+	if (bounds && bounds_count == 1)
+		asset.bounds = *bounds;
+
+	return true;
+}
+
+bool cook_mesh(AssetLoader::MeshAsset &asset, MeshData &data, const std::string &cache_path)
+{
+	const std::string &mesh_file = asset.path;
+
+	WavefrontObj obj(mesh_file, WavefrontObj::PARSE_MAPPED);
+	Mesh mesh(obj);
+	if (mesh.vertex_tri.empty()) {
+		std::cerr << "Mesh \"" << mesh_file << "\" has no triangles\n";
+		return false;
+	}
+
+	WavefrontMtl mtl;
+	mtl.load_libraries(obj.material_libraries(), mesh_file);
+	mesh.set_materials(mtl);
+
+	std::vector<std::string> libraries;
+	for (const std::string &library : obj.material_libraries())
+		libraries.push_back(WavefrontMtl::library_path(library, mesh_file));
+
+	// Files without (complete) normals get smooth ones, keeping edges
+	// sharper than 60 degrees hard.
+	if (mesh.normal.empty() || mesh.normal_tri.size() != mesh.vertex_tri.size())
+		mesh.generate_normals(60.0f);
+
+	Mesh::Indexed &indexed = data.indexed;
+	indexed = mesh.unpack_to_indexed();
+	indexed.optimize(MeshOptimize::DEFAULT_CACHE_SIZE);
+	indexed.build_lods({ 0.5f, 0.25f, 0.125f });
+	indexed.build_meshlets();
+
+	// 16-bit positions and uvs, 16-bit octahedral normals.
+	Mesh::QuantizeOptions options(Mesh::QuantizeOptions::POSITION_UNORM16,
+		Mesh::QuantizeOptions::NORMAL_OCT16, Mesh::QuantizeOptions::UV_UNORM16);
+	Mesh::Interleaved &interleaved = data.interleaved;
+	interleaved = indexed.quantize(options);
+
+	MeshCache::write(mesh_file, libraries, cache_path, mesh, indexed, interleaved);
+
+	asset.layout = interleaved.layout;
+	asset.dequantize = interleaved.dequantize;
+	asset.vertex_count = interleaved.vertex_count;
+	asset.index_type = indexed.index_type;
+	asset.index_count = indexed.index_count();
+	asset.lod = indexed.lods;
+	asset.meshlets = indexed.meshlets;
+	asset.submeshes = indexed.submeshes;
+	asset.materials = mesh.materials;
+	asset.bounds = indexed.bounds;
+
+	data.vertices = interleaved.data.data();
+	data.indices = indexed.index_data();
+	return true;
+}
+
+}
+
+AssetLoader::Asset::Asset(const std::string &p)
+	: path(p), state(PENDING)
+{
+}
+
+bool AssetLoader::Asset::ready() const
+{
+	return state == READY;
+}
+
+bool AssetLoader::Asset::failed() const
+{
+	return state == FAILED;
+}
+
+AssetLoader::TextureAsset::TextureAsset(const std::string &p)
+	: Asset(p), id(0), width(0), height(0)
+{
+}
+
+AssetLoader::MeshAsset::MeshAsset(const std::string &p)
+	: Asset(p), vertex_buffer(0), index_buffer(0), vertex_count(0),
+	index_type(GL_UNSIGNED_SHORT), index_count(0)
+{
+}
+
+AssetLoader::StreamedMeshAsset::StreamedMeshAsset(const std::string &p)
+	: Asset(p), vertex_buffer(0), layout(MeshStream::layout()), triangle_capacity(0),
+	drawable_triangles(0), released(false)
+{
+}
+
+AssetLoader::AssetLoader(unsigned thread_count)
+	: stopping(false), outstanding(0)
+{
+	if (thread_count == 0)
+		thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+	workers.reserve(thread_count);
+	for (unsigned i = 0; i < thread_count; ++i)
+		workers.emplace_back([this]() { run_worker(); });
+}
+
+AssetLoader::~AssetLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(job_mutex);
+		stopping = true;
+	}
+	job_ready.notify_all();
+
+	for (auto &w : workers)
+		w.join();
+}
+
+std::shared_ptr<const AssetLoader::TextureAsset> AssetLoader::load_texture(const std::string &path)
+{
+	auto asset = std::make_shared<TextureAsset>(path);
+	++outstanding;
+
+	queue_job(asset, [this, asset]() {
+		// Uncompressed 32-bit files are uploaded straight from a mapping
+		// of the file; anything else is decoded first. owner keeps
+		// whichever holds the pixels alive until the upload is done.
+		std::shared_ptr<const void> owner;
+		const TGAImage::rgba *image_pixels = nullptr;
+
+		auto view = std::make_shared<TGAImageView>(asset->path);
+		if (view->isOpen() && view->width() > 0 && view->height() > 0) {
+			// Fault the pages in here rather than on the render thread.
+			view->prefetch();
+			asset->width = view->width();
+			asset->height = view->height();
+			image_pixels = view->getPixelData();
+			owner = view;
+		}
+		else {
+			auto image = std::make_shared<TGAImage>(asset->path);
+			if (image->width() == 0 || image->height() == 0) {
+				std::cerr << "Failed to load texture \"" << asset->path << "\"\n";
+				complete(*asset, FAILED);
+				return;
+			}
+
+			asset->width = image->width();
+			asset->height = image->height();
+			image_pixels = image->getPixelData().data();
+			owner = image;
+		}
+		asset->state = DECODED;
+
+		// Allocate the texture, then fill it a band of rows at a time.
+		const size_t row_bytes = asset->width * sizeof(TGAImage::rgba);
+		const int rows_per_step = (int)std::max<size_t>(1, UPLOAD_SLICE / row_bytes);
+		int rows_done = -1;
+
+		queue_upload([this, asset, owner, image_pixels, rows_per_step, rows_done]() mutable {
+			TextureAsset &tex = *asset;
+
+			if (rows_done < 0) {
+				glGenTextures(1, &tex.id);
+				glBindTexture(GL_TEXTURE_2D, tex.id);
+
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tex.width, tex.height, 0,
+					GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+				rows_done = 0;
+				return false;
+			}
+
+			int rows = std::min(rows_per_step, tex.height - rows_done);
+			const TGAImage::rgba *pixels = image_pixels + (size_t)rows_done * tex.width;
+
+			glBindTexture(GL_TEXTURE_2D, tex.id);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, rows_done, tex.width, rows,
+				GL_BGRA, // B and R channels are flipped in .tga formats
+				GL_UNSIGNED_BYTE, pixels);
+			rows_done += rows;
+
+			if (rows_done < tex.height)
+				return false;
+
+			// Must load texture before generating mipmaps.
+			glGenerateMipmap(GL_TEXTURE_2D);
+			owner.reset();
+			complete(tex, READY);
+			return true;
+		});
+	});
+
+	return asset;
+}
+
+std::shared_ptr<const AssetLoader::MeshAsset> AssetLoader::load_mesh(const std::string &path,
+	const std::string &cache_path)
+{
+	auto asset = std::make_shared<MeshAsset>(path);
+	++outstanding;
+
+	queue_job(asset, [this, asset, cache_path]() {
+		auto data = std::make_shared<MeshData>();
+
+		bool loaded = data->cache.load(asset->path, cache_path) && read_cache(*asset, *data);
+		if (!loaded && !cook_mesh(*asset, *data, cache_path)) {
+			complete(*asset, FAILED);
+			return;
+		}
+
+		if (asset->submeshes.empty()) {
+			asset->submeshes.push_back({ Mesh::NO_MATERIAL, 0, 0, (uint32_t)asset->index_count,
+				0, (uint32_t)asset->meshlets.size(), asset->bounds });
+		}
+
+		data->vertex_bytes = asset->vertex_count * asset->layout.stride();
+		data->index_bytes = asset->index_count
+			* (asset->index_type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t));
+		asset->state = DECODED;
+
+		// Allocate both buffers, then fill them a slice at a time.
+		bool created = false;
+		size_t vertex_done = 0, index_done = 0;
+
+		queue_upload([this, asset, data, created, vertex_done, index_done]() mutable {
+			MeshAsset &mesh = *asset;
+
+			if (!created) {
+				glGenBuffers(1, &mesh.vertex_buffer);
+				glBindBuffer(GL_ARRAY_BUFFER, mesh.vertex_buffer);
+				glBufferData(GL_ARRAY_BUFFER, data->vertex_bytes, nullptr, GL_STATIC_DRAW);
+
+				glGenBuffers(1, &mesh.index_buffer);
+				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.index_buffer);
+				glBufferData(GL_ELEMENT_ARRAY_BUFFER, data->index_bytes, nullptr, GL_STATIC_DRAW);
+				created = true;
+				return false;
+			}
+
+			if (vertex_done < data->vertex_bytes) {
+				size_t size = std::min(UPLOAD_SLICE, data->vertex_bytes - vertex_done);
+				glBindBuffer(GL_ARRAY_BUFFER, mesh.vertex_buffer);
+				glBufferSubData(GL_ARRAY_BUFFER, vertex_done, size,
+					(const uint8_t *)data->vertices + vertex_done);
+				vertex_done += size;
+			}
+			else if (index_done < data->index_bytes) {
+				size_t size = std::min(UPLOAD_SLICE, data->index_bytes - index_done);
+				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.index_buffer);
+				glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, index_done, size,
+					(const uint8_t *)data->indices + index_done);
+				index_done += size;
+			}
+
+			if (vertex_done < data->vertex_bytes || index_done < data->index_bytes)
+				return false;
+
+			data.reset();
+			complete(mesh, READY);
+			return true;
+		});
+	});
+
+	return asset;
+}
+
+std::shared_ptr<const AssetLoader::StreamedMeshAsset> AssetLoader::load_mesh_progressive(
+	const std::string &path)
+{
+	auto asset = std::make_shared<StreamedMeshAsset>(path);
+	++outstanding;
+
+	queue_job(asset, [this, asset]() {
+		MappedFile file(asset->path);
+		if (!file.is_open()) {
+			std::cerr << "Failed to open mesh \"" << asset->path << "\"\n";
+			complete(*asset, FAILED);
+			return;
+		}
+		file.advise_sequential();
+
+		// Counting lines is a small fraction of parsing them, and lets the
+		// buffer be allocated once before the first batch arrives.
+		asset->triangle_capacity = MeshStream::count_faces(file.begin(), file.end());
+		const size_t stride = asset->layout.stride();
+
+		queue_upload([asset, stride]() {
+			StreamedMeshAsset &mesh = *asset;
+			if (mesh.released)
+				return true;
+
+			glGenBuffers(1, &mesh.vertex_buffer);
+			glBindBuffer(GL_ARRAY_BUFFER, mesh.vertex_buffer);
+			glBufferData(GL_ARRAY_BUFFER, mesh.triangle_capacity * 3 * stride, nullptr, GL_STATIC_DRAW);
+			return true;
+		});
+
+		// Uploads run in order, so every batch lands after the buffer
+		// exists and drawable_triangles only ever grows.
+		MeshStream stream(STREAM_BATCH, asset->triangle_capacity,
+			[this, asset, stride](size_t first, std::vector<float> &&vertices) {
+				auto batch = std::make_shared<std::vector<float>>(std::move(vertices));
+
+				queue_upload([asset, stride, first, batch]() {
+					StreamedMeshAsset &mesh = *asset;
+					if (mesh.released)
+						return true;
+
+					glBindBuffer(GL_ARRAY_BUFFER, mesh.vertex_buffer);
+					glBufferSubData(GL_ARRAY_BUFFER, first * 3 * stride,
+						batch->size() * sizeof(float), batch->data());
+					mesh.drawable_triangles = first
+						+ batch->size() / (3 * MeshStream::FLOATS_PER_VERTEX);
+					return true;
+				});
+			});
+
+		WavefrontObj::visit(file.begin(), file.end(), stream);
+		stream.finish();
+		asset->state = DECODED;
+
+		queue_upload([this, asset]() {
+			complete(*asset, READY);
+			return true;
+		});
+	});
+
+	return asset;
+}
+
+bool AssetLoader::update(double budget_seconds)
+{
+	upload_clock::time_point start = upload_clock::now();
+
+	do {
+		Upload upload;
+		{
+			std::lock_guard<std::mutex> lock(upload_mutex);
+			if (uploads.empty())
+				break;
+
+			upload = std::move(uploads.front());
+			uploads.pop_front();
+		}
+
+		// An unfinished upload goes back to the front, so it completes
+		// before the next one starts.
+		if (!upload()) {
+			std::lock_guard<std::mutex> lock(upload_mutex);
+			uploads.push_front(std::move(upload));
+		}
+	} while (std::chrono::duration<double>(upload_clock::now() - start).count() < budget_seconds);
+
+	return busy();
+}
+
+void AssetLoader::finish()
+{
+	while (update(1e30)) {
+		std::unique_lock<std::mutex> lock(upload_mutex);
+		upload_ready.wait(lock, [this]() { return !uploads.empty() || outstanding == 0; });
+	}
+}
+
+bool AssetLoader::busy() const
+{
+	return outstanding != 0;
+}
+
+// The loader hands its assets out as const only so that callers leave
+// them alone; it made them, so it may change them here.
+
+void AssetLoader::release(const std::shared_ptr<const TextureAsset> &asset)
+{
+	TextureAsset &tex = const_cast<TextureAsset &>(*asset);
+	if (tex.id != 0)
+		glDeleteTextures(1, &tex.id);
+	tex.id = 0;
+}
+
+void AssetLoader::release(const std::shared_ptr<const MeshAsset> &asset)
+{
+	MeshAsset &mesh = const_cast<MeshAsset &>(*asset);
+	GLuint buffers[2] = { mesh.vertex_buffer, mesh.index_buffer };
+	glDeleteBuffers(2, buffers);
+	mesh.vertex_buffer = 0;
+	mesh.index_buffer = 0;
+}
+
+void AssetLoader::release(const std::shared_ptr<const StreamedMeshAsset> &asset)
+{
+	StreamedMeshAsset &mesh = const_cast<StreamedMeshAsset &>(*asset);
+	if (mesh.vertex_buffer != 0)
+		glDeleteBuffers(1, &mesh.vertex_buffer);
+	mesh.vertex_buffer = 0;
+	mesh.drawable_triangles = 0;
+	mesh.released = true;
+}
+
+void AssetLoader::run_worker()
+{
+	for (;;) {
+		Job job;
+		bool dropped;
+		{
+			std::unique_lock<std::mutex> lock(job_mutex);
+			job_ready.wait(lock, [this]() { return stopping || !jobs.empty(); });
+
+			if (jobs.empty())
+				return;
+
+			job = std::move(jobs.front());
+			jobs.pop_front();
+			dropped = stopping;
+		}
+
+		// Once stopping, whatever is still queued fails rather than runs,
+		// so no asset is left PENDING.
+		if (dropped)
+			complete(*job.asset, FAILED);
+		else
+			job.run();
+	}
+}
+
+void AssetLoader::queue_job(std::shared_ptr<Asset> asset, std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(job_mutex);
+		jobs.push_back({ std::move(asset), std::move(job) });
+	}
+	job_ready.notify_one();
+}
+
+void AssetLoader::queue_upload(Upload upload)
+{
+	{
+		std::lock_guard<std::mutex> lock(upload_mutex);
+		uploads.push_back(std::move(upload));
+	}
+	upload_ready.notify_all();
+}
+
+void AssetLoader::complete(Asset &asset, State state)
+{
+	// Under the lock, so finish() cannot miss the last completion.
+	std::lock_guard<std::mutex> lock(upload_mutex);
+	asset.state = state;
+	--outstanding;
+	upload_ready.notify_all();
+}
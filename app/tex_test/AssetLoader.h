@@ -0,0 +1,173 @@
+#pragma once
+
+#include "GL/glew.h"
+
+#include "Mesh.h"
+#include "MeshLod.h"
+#include "Meshlet.h"
+#include "VertexLayout.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+Loads textures (.tga) and meshes (.obj, through their MeshCache) without
+stalling the render thread.
+
+Files are read and decoded on a pool of worker threads. Each request hands
+back a handle straight away; its state moves from PENDING to DECODED once
+the CPU side is done, and to READY once the GL objects exist. Those are
+created by update() on the render thread, which stops once its time budget
+is used up. Buffers go up in UPLOAD_SLICE pieces, so one large asset is
+spread over several frames instead of stalling one. Uncompressed 32-bit
+textures are uploaded straight from a TGAImageView of the file, without
+a decoded copy. Requests no worker has started when the loader is
+destroyed end up FAILED.
+*/
+
+class AssetLoader {
+public:
+	enum State {
+		PENDING,
+		DECODED,
+		READY,
+		FAILED
+	};
+
+	struct Asset {
+		std::string path;
+		std::atomic<State> state;
+
+		explicit Asset(const std::string &path);
+
+		bool ready() const;
+		bool failed() const;
+	};
+
+	// GL_TEXTURE_2D with mipmaps, repeating, nearest filtered.
+	struct TextureAsset : Asset {
+		GLuint id;
+		int width, height;
+
+		explicit TextureAsset(const std::string &path);
+	};
+
+	// Interleaved vertex buffer and index buffer, with everything needed
+	// to draw them. Set once the asset is READY.
+	struct MeshAsset : Asset {
+		GLuint vertex_buffer;
+		GLuint index_buffer;
+
+		VertexLayout layout;
+		VertexLayout::Dequantize dequantize;
+		size_t vertex_count;
+
+		GLenum index_type;
+		size_t index_count;
+
+		MeshLod lod;
+		std::vector<Meshlet> meshlets;
+		std::vector<Mesh::Submesh> submeshes;
+		std::vector<Mesh::Material> materials;
+		Mesh::Bounds bounds;
+
+		explicit MeshAsset(const std::string &path);
+	};
+
+	// The triangles of a .obj file as they are parsed, unindexed, in the
+	// layout of MeshStream. vertex_buffer is sized for the whole file up
+	// front; drawable_triangles counts how many of them have been uploaded
+	// so far, so glDrawArrays() can draw [0, 3 * drawable_triangles) every
+	// frame while the rest streams in. Both are only touched on the render
+	// thread, as is released, which drops the batches still to come.
+	struct StreamedMeshAsset : Asset {
+		GLuint vertex_buffer;
+		VertexLayout layout;
+		size_t triangle_capacity;
+		size_t drawable_triangles;
+		bool released;
+
+		explicit StreamedMeshAsset(const std::string &path);
+	};
+
+	static constexpr size_t UPLOAD_SLICE = 1024 * 1024;
+
+	// Triangles per streamed batch; 32-byte vertices make a batch about
+	// UPLOAD_SLICE.
+	static constexpr size_t STREAM_BATCH = 8192;
+
+	// thread_count 0 means one worker per hardware thread.
+	explicit AssetLoader(unsigned thread_count = 0);
+	~AssetLoader();
+
+	AssetLoader(const AssetLoader &) = delete;
+	AssetLoader &operator=(const AssetLoader &) = delete;
+
+	std::shared_ptr<const TextureAsset> load_texture(const std::string &path);
+
+	// Uses cache_path if it is current, otherwise cooks the .obj and
+	// writes cache_path for next time.
+	std::shared_ptr<const MeshAsset> load_mesh(const std::string &path, const std::string &cache_path);
+
+	// Parses path with the streaming parser and uploads its triangles
+	// STREAM_BATCH at a time as they come, without cooking them, so that
+	// something is on screen long before a large file has been read.
+	std::shared_ptr<const StreamedMeshAsset> load_mesh_progressive(const std::string &path);
+
+	// Render thread only. Runs GL uploads until budget_seconds have passed,
+	// always at least one step so that loading cannot stall. Returns true
+	// while requests are still outstanding.
+	bool update(double budget_seconds);
+
+	// Render thread only. Blocks until every request so far is READY or
+	// FAILED.
+	void finish();
+
+	bool busy() const;
+
+	// Render thread only. Delete the GL objects of an asset that is no
+	// longer drawn and set their names to 0. Textures and cooked meshes
+	// must not be halfway through an upload: release them once they are
+	// READY or FAILED, or after their loader is gone. A streamed mesh may
+	// be released while it is still coming in.
+	static void release(const std::shared_ptr<const TextureAsset> &asset);
+	static void release(const std::shared_ptr<const MeshAsset> &asset);
+	static void release(const std::shared_ptr<const StreamedMeshAsset> &asset);
+
+private:
+	// One step of a GL upload; returns true once the upload is complete.
+	typedef std::function<bool()> Upload;
+
+	// Decoding work for one asset, which fails if the loader is destroyed
+	// before a worker gets to it.
+	struct Job {
+		std::shared_ptr<Asset> asset;
+		std::function<void()> run;
+	};
+
+	void run_worker();
+	void queue_job(std::shared_ptr<Asset> asset, std::function<void()> job);
+	void queue_upload(Upload upload);
+	void complete(Asset &asset, State state);
+
+	std::vector<std::thread> workers;
+
+	std::mutex job_mutex;
+	std::condition_variable job_ready;
+	std::deque<Job> jobs;
+	bool stopping;
+
+	std::mutex upload_mutex;
+	std::condition_variable upload_ready;
+	std::deque<Upload> uploads;
+
+	std::atomic<size_t> outstanding;
+};
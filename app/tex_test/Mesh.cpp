@@ -1,37 +1,477 @@
 #include "Mesh.h"
+#include "MeshNormals.h"
+#include "MeshSimplify.h"
+#include "Parallel.h"
+#include "VertexQuantize.h"
 
-Mesh::Mesh(WavefrontObj & obj)
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <type_traits>
+
+namespace {
+
+struct corner_key {
+	size_t v, uv, n;
+
+	bool operator==(const corner_key &other) const {
+		return v == other.v && uv == other.uv && n == other.n;
+	}
+};
+
+/*
+Open-addressing map from corner_key to vertex id. The slots only hold ids;
+the keys themselves live in one array indexed by id, so the table stays at
+four bytes per slot however large the indices get.
+*/
+class CornerMap {
+	static constexpr uint32_t EMPTY = std::numeric_limits<uint32_t>::max();
+
+	std::vector<uint32_t> slots;
+	std::vector<corner_key> keys;
+	size_t mask;
+
+	static size_t hash(const corner_key &k) {
+		uint64_t h = (uint64_t)k.v * 0x9E3779B97F4A7C15ULL;
+		h ^= (uint64_t)k.uv * 0xC2B2AE3D27D4EB4FULL;
+		h ^= (uint64_t)k.n * 0x165667B19E3779F9ULL;
+		return (size_t)(h ^ (h >> 29));
+	}
+
+	void grow() {
+		std::vector<uint32_t> bigger(slots.size() * 2, EMPTY);
+		bigger.swap(slots);
+		mask = slots.size() - 1;
+
+		for (uint32_t id = 0; id < keys.size(); ++id) {
+			size_t i = hash(keys[id]) & mask;
+			while (slots[i] != EMPTY)
+				i = (i + 1) & mask;
+			slots[i] = id;
+		}
+	}
+
+public:
+	explicit CornerMap(size_t expected) {
+		size_t capacity = 16;
+		while (capacity < expected * 2)
+			capacity *= 2;
+
+		slots.assign(capacity, EMPTY);
+		keys.reserve(expected);
+		mask = capacity - 1;
+	}
+
+	// Returns the id for k, adding it if it is new. inserted tells which.
+	uint32_t insert(const corner_key &k, bool &inserted) {
+		size_t i = hash(k) & mask;
+
+		while (slots[i] != EMPTY) {
+			if (keys[slots[i]] == k) {
+				inserted = false;
+				return slots[i];
+			}
+			i = (i + 1) & mask;
+		}
+
+		uint32_t id = (uint32_t)keys.size();
+		slots[i] = id;
+		keys.push_back(k);
+		inserted = true;
+
+		// Keep the load factor under one half.
+		if (keys.size() * 2 > slots.size())
+			grow();
+
+		return id;
+	}
+};
+
+/*
+Renumbers one submesh's indices to the vertices it uses, in order of first
+use, so the per-submesh passes cost the size of the submesh rather than of
+the whole mesh. global maps a local vertex back to the mesh.
+*/
+struct SubmeshVertices {
+	std::vector<uint32_t> local_of;
+	std::vector<uint32_t> global;
+	std::vector<uint32_t> indices;
+
+	explicit SubmeshVertices(size_t vertex_count)
+		: local_of(vertex_count, std::numeric_limits<uint32_t>::max())
+	{
+	}
+
+	void gather(const uint32_t *src, size_t count)
+	{
+		// Only the entries the last submesh set need clearing.
+		for (uint32_t v : global)
+			local_of[v] = std::numeric_limits<uint32_t>::max();
+		global.clear();
+
+		indices.resize(count);
+		for (size_t i = 0; i < count; ++i) {
+			uint32_t &local = local_of[src[i]];
+			if (local == std::numeric_limits<uint32_t>::max()) {
+				local = (uint32_t)global.size();
+				global.push_back(src[i]);
+			}
+			indices[i] = local;
+		}
+	}
+
+	// Copies stride elements per used vertex out of a per-vertex array.
+	template <class T>
+	std::vector<T> pick(const T *data, size_t stride = 1) const
+	{
+		std::vector<T> out(global.size() * stride);
+		for (size_t v = 0; v < global.size(); ++v)
+			std::copy(data + global[v] * stride, data + (global[v] + 1) * stride, out.begin() + v * stride);
+		return out;
+	}
+};
+
+template <class T>
+const float *stream_data(const std::vector<T> &stream)
 {
-	const WavefrontObj::MeshData &data = obj.data();
+	return stream.empty() ? nullptr : &stream[0].x;
+}
+
+/*
+Copies parallel attribute arrays into one interleaved buffer. The streams
+are given in VertexLayout::Attribute order; missing ones are null.
+*/
+Mesh::Interleaved interleave_streams(const VertexLayout &layout, size_t count,
+	const float *const streams[VertexLayout::ATTRIBUTE_COUNT])
+{
+	static const uint32_t stream_size[VertexLayout::ATTRIBUTE_COUNT] = { 3, 3, 2, 4 };
+
+	Mesh::Interleaved out;
+	out.layout = layout;
+	out.vertex_count = count;
+	out.data.assign(count * layout.stride(), 0);
 
-	vertex.reserve(data.vert.size());
-	for (const auto &v : data.vert) {
-		vertex.push_back(vec3f(v.x, v.y, v.z));
+	for (int a = 0; a < VertexLayout::ATTRIBUTE_COUNT; ++a) {
+		const VertexLayout::Element &e = layout.element((VertexLayout::Attribute)a);
+		if (e.size == 0)
+			continue;
+
+		if (e.type != GL_FLOAT) {
+			std::cerr << "Mesh::interleave(): attribute \"" << VertexLayout::attribute_name((VertexLayout::Attribute)a)
+				<< "\" is not GL_FLOAT\n";
+			continue;
+		}
+
+		const float *src = streams[a];
+		if (!src) {
+			std::cerr << "Mesh::interleave(): mesh has no \""
+				<< VertexLayout::attribute_name((VertexLayout::Attribute)a) << "\" data\n";
+			continue;
+		}
+
+		size_t bytes = std::min(e.size, stream_size[a]) * sizeof(float);
+		uint8_t *dst = out.data.data() + e.offset;
+
+		for (size_t v = 0; v < count; ++v) {
+			std::memcpy(dst, src, bytes);
+			dst += layout.stride();
+			src += stream_size[a];
+		}
 	}
 
-	vertex.reserve(data.uv.size());
-	for (const auto &v : data.uv) {
-		uv.push_back(vec2f(v.x, v.y));
+	return out;
+}
+
+void compute_meshlet_bounds(Meshlet &m, const uint32_t *indices, const vec3f *position,
+	const uint32_t *vertices, size_t vertex_count)
+{
+	float lo[3] = { INFINITY, INFINITY, INFINITY };
+	float hi[3] = { -INFINITY, -INFINITY, -INFINITY };
+
+	for (size_t i = 0; i < vertex_count; ++i) {
+		const vec3f &p = position[vertices[i]];
+		lo[0] = std::min(lo[0], p.x); hi[0] = std::max(hi[0], p.x);
+		lo[1] = std::min(lo[1], p.y); hi[1] = std::max(hi[1], p.y);
+		lo[2] = std::min(lo[2], p.z); hi[2] = std::max(hi[2], p.z);
+	}
+
+	float radius2 = 0.0f;
+	for (int k = 0; k < 3; ++k) {
+		m.aabb_min[k] = lo[k];
+		m.aabb_max[k] = hi[k];
+		m.center[k] = (lo[k] + hi[k]) * 0.5f;
+	}
+	for (size_t i = 0; i < vertex_count; ++i) {
+		const vec3f &p = position[vertices[i]];
+		float dx = p.x - m.center[0], dy = p.y - m.center[1], dz = p.z - m.center[2];
+		radius2 = std::max(radius2, dx * dx + dy * dy + dz * dz);
+	}
+	m.radius = std::sqrt(radius2);
+
+	// Normal cone: the axis is the average facing; the cutoff follows from
+	// the triangle that deviates most from it.
+	std::vector<vec3f> normals;
+	normals.reserve(m.index_count / 3);
+	float axis[3] = { 0.0f, 0.0f, 0.0f };
+
+	for (uint32_t i = 0; i < m.index_count; i += 3) {
+		const vec3f &a = position[indices[i]];
+		const vec3f &b = position[indices[i + 1]];
+		const vec3f &c = position[indices[i + 2]];
+
+		float e1[3] = { b.x - a.x, b.y - a.y, b.z - a.z };
+		float e2[3] = { c.x - a.x, c.y - a.y, c.z - a.z };
+		float n[3] = {
+			e1[1] * e2[2] - e1[2] * e2[1],
+			e1[2] * e2[0] - e1[0] * e2[2],
+			e1[0] * e2[1] - e1[1] * e2[0]
+		};
+		float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length == 0.0f)
+			continue;
+
+		vec3f unit(n[0] / length, n[1] / length, n[2] / length);
+		normals.push_back(unit);
+		axis[0] += unit.x;
+		axis[1] += unit.y;
+		axis[2] += unit.z;
 	}
 
-	vertex.reserve(data.norm.size());
-	for (const auto &v : data.norm) {
-		normal.push_back(vec3f(v.x, v.y, v.z));
+	for (int k = 0; k < 3; ++k) {
+		m.cone_apex[k] = m.center[k];
+		m.cone_axis[k] = 0.0f;
+	}
+	m.cone_cutoff = 1.0f;
+
+	float axis_length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+	if (axis_length == 0.0f)
+		return;
+
+	for (int k = 0; k < 3; ++k)
+		m.cone_axis[k] = axis[k] / axis_length;
+
+	float min_dot = 1.0f;
+	for (const vec3f &n : normals)
+		min_dot = std::min(min_dot, n.x * m.cone_axis[0] + n.y * m.cone_axis[1] + n.z * m.cone_axis[2]);
+
+	// Past about 84 degrees the cone would hardly ever cull anything.
+	if (min_dot <= 0.1f)
+		return;
+
+	// Move the apex back along the axis until it is behind every
+	// triangle's plane.
+	float max_t = 0.0f;
+	size_t t = 0;
+	for (uint32_t i = 0; i < m.index_count; i += 3) {
+		const vec3f &a = position[indices[i]];
+		const vec3f &b = position[indices[i + 1]];
+		const vec3f &c = position[indices[i + 2]];
+
+		float e1[3] = { b.x - a.x, b.y - a.y, b.z - a.z };
+		float e2[3] = { c.x - a.x, c.y - a.y, c.z - a.z };
+		float cross_x = e1[1] * e2[2] - e1[2] * e2[1];
+		float cross_y = e1[2] * e2[0] - e1[0] * e2[2];
+		float cross_z = e1[0] * e2[1] - e1[1] * e2[0];
+		if (cross_x == 0.0f && cross_y == 0.0f && cross_z == 0.0f)
+			continue;
+
+		const vec3f &n = normals[t++];
+		float dc = (m.center[0] - a.x) * n.x + (m.center[1] - a.y) * n.y + (m.center[2] - a.z) * n.z;
+		float dn = m.cone_axis[0] * n.x + m.cone_axis[1] * n.y + m.cone_axis[2] * n.z;
+		max_t = std::max(max_t, dc / dn);
+	}
+
+	for (int k = 0; k < 3; ++k)
+		m.cone_apex[k] = m.center[k] - m.cone_axis[k] * max_t;
+
+	m.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+}
+
+}
+
+Mesh::Interleaved::Interleaved()
+	: vertex_count(0)
+{
+}
+
+Mesh::QuantizeOptions::QuantizeOptions()
+	: position(POSITION_FLOAT), normal(NORMAL_FLOAT), uv(UV_FLOAT)
+{
+}
+
+Mesh::QuantizeOptions::QuantizeOptions(Position p, Normal n, Uv u)
+	: position(p), normal(n), uv(u)
+{
+}
+
+VertexLayout Mesh::Unpacked::default_layout() const
+{
+	VertexLayout layout;
+	layout.add(VertexLayout::POSITION, 3);
+	if (!normal.empty())
+		layout.add(VertexLayout::NORMAL, 3);
+	if (!uv.empty())
+		layout.add(VertexLayout::UV, 2);
+
+	return layout;
+}
+
+Mesh::Interleaved Mesh::Unpacked::interleave(const VertexLayout &layout) const
+{
+	const float *streams[VertexLayout::ATTRIBUTE_COUNT] = {
+		stream_data(vertex),
+		normal.size() == vertex.size() ? stream_data(normal) : nullptr,
+		uv.size() == vertex.size() ? stream_data(uv) : nullptr,
+		nullptr
+	};
+
+	return interleave_streams(layout, vertex.size(), streams);
+}
+
+Mesh::Mesh(WavefrontObj & obj, unsigned thread_count)
+{
+	const WavefrontObj::MeshData &data = obj.data();
+
+	vertex.resize(data.vert.size());
+	uv.resize(data.uv.size());
+	normal.resize(data.norm.size());
+
+	parallel_for(data.vert.size(), thread_count, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+			vertex[i] = vec3f(data.vert[i].x, data.vert[i].y, data.vert[i].z);
+	});
+
+	// Only vertices filled in through data() by hand need a pass of their
+	// own.
+	bounds = obj.bounds();
+	if (bounds.empty()) {
+		for (const vec3f &v : vertex)
+			bounds.add(v.x, v.y, v.z);
 	}
 
-	for (const auto &f : data.f) {
-		if (f.p1.have.v) {
-			vertex_tri.push_back(index_tri(f.p1.vertex, f.p2.vertex, f.p3.vertex));
+	parallel_for(data.uv.size(), thread_count, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+			uv[i] = vec2f(data.uv[i].x, data.uv[i].y);
+	});
+
+	parallel_for(data.norm.size(), thread_count, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i)
+			normal[i] = vec3f(data.norm[i].x, data.norm[i].y, data.norm[i].z);
+	});
+
+	// Not every face has every stream, so count what each range of faces
+	// contributes first; the prefix sums then give every range a fixed
+	// place to write its part of each stream. A face has a stream if its
+	// first corner has an index in it.
+	const WavefrontObj::FaceIndices &faces = data.f;
+	const uint32_t *face_v = faces.vertex.data();
+	const uint32_t *face_uv = faces.has(WavefrontObj::FaceIndices::UV) ? faces.uv.data() : nullptr;
+	const uint32_t *face_n = faces.has(WavefrontObj::FaceIndices::NORMAL) ? faces.normal.data() : nullptr;
+
+	size_t face_count = faces.size();
+	size_t range_count = parallel_range_count(face_count, thread_count);
+	std::vector<size_t> v_start(range_count + 1, 0);
+	std::vector<size_t> uv_start(range_count + 1, 0);
+	std::vector<size_t> n_start(range_count + 1, 0);
+
+	parallel_ranges(face_count, range_count, [&](size_t r, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			v_start[r + 1] += face_v[i * 3] != 0;
+			uv_start[r + 1] += face_uv && face_uv[i * 3] != 0;
+			n_start[r + 1] += face_n && face_n[i * 3] != 0;
 		}
-		if (f.p1.have.uv) {
-			uv_tri.push_back(index_tri(f.p1.uv, f.p2.uv, f.p3.uv));
+	});
+
+	for (size_t r = 0; r < range_count; ++r) {
+		v_start[r + 1] += v_start[r];
+		uv_start[r + 1] += uv_start[r];
+		n_start[r + 1] += n_start[r];
+	}
+
+	vertex_tri.resize(v_start[range_count]);
+	uv_tri.resize(uv_start[range_count]);
+	normal_tri.resize(n_start[range_count]);
+
+	const WavefrontObj::FaceRuns &runs = obj.materials();
+	material_names = runs.names;
+	materials.assign(material_names.size(), Material{ { 1.0f, 1.0f, 1.0f }, 1.0f });
+	if (!runs.runs.empty())
+		material_tri.resize(vertex_tri.size());
+
+	parallel_ranges(face_count, range_count, [&](size_t r, size_t begin, size_t end) {
+		size_t v_out = v_start[r], uv_out = uv_start[r], n_out = n_start[r];
+
+		// Index of the first material run after face i.
+		size_t next_run = std::upper_bound(runs.runs.begin(), runs.runs.end(), begin,
+			[](size_t face, const WavefrontObj::face_run &run) { return face < run.first_face; })
+			- runs.runs.begin();
+
+		for (size_t i = begin; i < end; ++i) {
+			const uint32_t *v = face_v + i * 3;
+
+			while (next_run < runs.runs.size() && runs.runs[next_run].first_face <= i)
+				++next_run;
+
+			if (v[0]) {
+				if (!material_tri.empty())
+					material_tri[v_out] = next_run ? runs.runs[next_run - 1].name : NO_MATERIAL;
+				vertex_tri[v_out++] = index_tri(v[0], v[1], v[2]);
+			}
+			if (face_uv && face_uv[i * 3]) {
+				const uint32_t *t = face_uv + i * 3;
+				uv_tri[uv_out++] = index_tri(t[0], t[1], t[2]);
+			}
+			if (face_n && face_n[i * 3]) {
+				const uint32_t *n = face_n + i * 3;
+				normal_tri[n_out++] = index_tri(n[0], n[1], n[2]);
+			}
 		}
-		if (f.p1.have.n) {
-			normal_tri.push_back(index_tri(f.p1.normal, f.p2.normal, f.p3.normal));
+	});
+}
+
+void Mesh::set_materials(const WavefrontMtl &mtl)
+{
+	for (size_t i = 0; i < material_names.size(); ++i) {
+		uint32_t found = mtl.find(material_names[i]);
+		if (found == WavefrontMtl::NOT_FOUND) {
+			std::cerr << "Material \"" << material_names[i] << "\" is not defined\n";
+			continue;
 		}
+
+		const WavefrontMtl::Material &m = mtl.material(found);
+		materials[i] = Material{ { m.diffuse[0], m.diffuse[1], m.diffuse[2] }, m.opacity };
 	}
 }
 
+void Mesh::generate_normals(float crease_degrees, unsigned thread_count)
+{
+	size_t tri_count = vertex_tri.size();
+
+	std::vector<uint32_t> indices(tri_count * 3);
+	parallel_for(tri_count, thread_count, [&](size_t begin, size_t end) {
+		for (size_t t = begin; t < end; ++t) {
+			indices[t * 3 + 0] = (uint32_t)(vertex_tri[t].p1 - 1);
+			indices[t * 3 + 1] = (uint32_t)(vertex_tri[t].p2 - 1);
+			indices[t * 3 + 2] = (uint32_t)(vertex_tri[t].p3 - 1);
+		}
+	});
+
+	std::vector<uint32_t> normal_indices;
+	MeshNormals::generate_normals(normal, normal_indices, indices.data(), indices.size(),
+		vertex.data(), vertex.size(), crease_degrees, thread_count);
+
+	normal_tri.resize(tri_count);
+	parallel_for(tri_count, thread_count, [&](size_t begin, size_t end) {
+		for (size_t t = begin; t < end; ++t) {
+			normal_tri[t] = { normal_indices[t * 3 + 0] + (size_t)1, normal_indices[t * 3 + 1] + (size_t)1,
+				normal_indices[t * 3 + 2] + (size_t)1 };
+		}
+	});
+}
+
 Mesh::Unpacked Mesh::unpack_to(GLenum mode)
 {
 	Unpacked unpacked;
@@ -49,29 +489,646 @@ Mesh::Unpacked Mesh::unpack_to(GLenum mode)
 	return unpacked;
 }
 
-Mesh::Unpacked Mesh::unpack_to_triangles()
+Mesh::Unpacked Mesh::unpack_to_triangles(unsigned thread_count)
 {
 	Unpacked unpacked;
 
-	for (const auto &v : vertex_tri) {
-		unpacked.vertex.push_back(vec3f(vertex[v.p1 - 1]));
-		unpacked.vertex.push_back(vec3f(vertex[v.p2 - 1]));
-		unpacked.vertex.push_back(vec3f(vertex[v.p3 - 1]));
+	unpacked.vertex.resize(vertex_tri.size() * 3);
+	unpacked.uv.resize(uv_tri.size() * 3);
+	unpacked.normal.resize(normal_tri.size() * 3);
+
+	parallel_for(vertex_tri.size(), thread_count, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			const index_tri &v = vertex_tri[i];
+			unpacked.vertex[i * 3 + 0] = vertex[v.p1 - 1];
+			unpacked.vertex[i * 3 + 1] = vertex[v.p2 - 1];
+			unpacked.vertex[i * 3 + 2] = vertex[v.p3 - 1];
+		}
+	});
+
+	parallel_for(uv_tri.size(), thread_count, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			const index_tri &u = uv_tri[i];
+			unpacked.uv[i * 3 + 0] = uv[u.p1 - 1];
+			unpacked.uv[i * 3 + 1] = uv[u.p2 - 1];
+			unpacked.uv[i * 3 + 2] = uv[u.p3 - 1];
+		}
+	});
+
+	parallel_for(normal_tri.size(), thread_count, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			const index_tri &n = normal_tri[i];
+			unpacked.normal[i * 3 + 0] = normal[n.p1 - 1];
+			unpacked.normal[i * 3 + 1] = normal[n.p2 - 1];
+			unpacked.normal[i * 3 + 2] = normal[n.p3 - 1];
+		}
+	});
+
+	return unpacked;
+}
+
+Mesh::Indexed Mesh::unpack_to_indexed()
+{
+	Indexed indexed;
+
+	// A stream only takes part if every triangle has it; a partial uv or
+	// normal stream cannot be lined up with the vertex stream.
+	size_t tri_count = vertex_tri.size();
+	bool have_uv = uv_tri.size() == tri_count && !uv.empty();
+	bool have_normal = normal_tri.size() == tri_count && !normal.empty();
+
+	// Unique corners usually number about as many as the largest stream.
+	size_t expected = std::max({ vertex.size(),
+		have_uv ? uv.size() : 0,
+		have_normal ? normal.size() : 0 });
+	CornerMap map(expected);
+
+	indexed.vertex.reserve(expected);
+	if (have_uv)
+		indexed.uv.reserve(expected);
+	if (have_normal)
+		indexed.normal.reserve(expected);
+
+	// Counting sort of the triangles by material, NO_MATERIAL last. Stable,
+	// so each material keeps the order of the file.
+	size_t material_count = material_names.size();
+	auto material_key = [&](size_t t) {
+		uint32_t m = material_tri.empty() ? NO_MATERIAL : material_tri[t];
+		return m == NO_MATERIAL ? material_count : (size_t)m;
+	};
+
+	std::vector<size_t> start(material_count + 2, 0);
+	for (size_t t = 0; t < tri_count; ++t)
+		++start[material_key(t) + 1];
+	for (size_t m = 0; m <= material_count; ++m) {
+		if (start[m + 1] != 0) {
+			uint32_t material = m == material_count ? NO_MATERIAL : (uint32_t)m;
+			indexed.submeshes.push_back({ material, 0, (uint32_t)(start[m] * 3),
+				(uint32_t)(start[m + 1] * 3), 0, 0, Mesh::Bounds() });
+		}
+		start[m + 1] += start[m];
 	}
 
-	for (const auto &u : uv_tri) {
-		unpacked.uv.push_back(vec2f(uv[u.p1 - 1]));
-		unpacked.uv.push_back(vec2f(uv[u.p2 - 1]));
-		unpacked.uv.push_back(vec2f(uv[u.p3 - 1]));
+	std::vector<size_t> order(tri_count);
+	for (size_t t = 0; t < tri_count; ++t)
+		order[start[material_key(t)]++] = t;
+
+	std::vector<uint32_t> indices;
+	indices.reserve(tri_count * 3);
+
+	// order runs through the submeshes in turn.
+	size_t sub = 0;
+
+	for (size_t o = 0; o < tri_count; ++o) {
+		size_t t = order[o];
+		const size_t vi[3] = { vertex_tri[t].p1, vertex_tri[t].p2, vertex_tri[t].p3 };
+
+		while (o * 3 >= indexed.submeshes[sub].first_index + indexed.submeshes[sub].index_count)
+			++sub;
+		Bounds &sub_bounds = indexed.submeshes[sub].bounds;
+
+		for (int c = 0; c < 3; ++c) {
+			corner_key key = { vi[c], 0, 0 };
+			if (have_uv)
+				key.uv = c == 0 ? uv_tri[t].p1 : c == 1 ? uv_tri[t].p2 : uv_tri[t].p3;
+			if (have_normal)
+				key.n = c == 0 ? normal_tri[t].p1 : c == 1 ? normal_tri[t].p2 : normal_tri[t].p3;
+
+			bool inserted;
+			uint32_t id = map.insert(key, inserted);
+
+			if (inserted) {
+				assert(key.v - 1 < vertex.size());
+				indexed.vertex.push_back(vertex[key.v - 1]);
+
+				if (have_uv) {
+					assert(key.uv - 1 < uv.size());
+					indexed.uv.push_back(uv[key.uv - 1]);
+				}
+				if (have_normal) {
+					assert(key.n - 1 < normal.size());
+					indexed.normal.push_back(normal[key.n - 1]);
+				}
+			}
+
+			const vec3f &p = vertex[key.v - 1];
+			sub_bounds.add(p.x, p.y, p.z);
+			indices.push_back(id);
+		}
 	}
 
-	for (const auto &n : normal_tri) {
-		unpacked.normal.push_back(vec3f(normal[n.p1 - 1]));
-		unpacked.normal.push_back(vec3f(normal[n.p2 - 1]));
-		unpacked.normal.push_back(vec3f(normal[n.p3 - 1]));
+	for (const Submesh &s : indexed.submeshes)
+		indexed.bounds.merge(s.bounds);
+
+	if (indexed.vertex.size() <= (size_t)std::numeric_limits<uint16_t>::max() + 1) {
+		indexed.index16.assign(indices.begin(), indices.end());
+		indexed.index_type = GL_UNSIGNED_SHORT;
+	}
+	else {
+		indexed.index32 = std::move(indices);
+		indexed.index_type = GL_UNSIGNED_INT;
 	}
 
-	return unpacked;
+	return indexed;
+}
+
+Mesh::Indexed::Indexed()
+	: index_type(GL_UNSIGNED_SHORT)
+{
+}
+
+size_t Mesh::Indexed::index_count() const
+{
+	return index_type == GL_UNSIGNED_SHORT ? index16.size() : index32.size();
+}
+
+size_t Mesh::Indexed::index_size() const
+{
+	return index_type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+const void *Mesh::Indexed::index_data() const
+{
+	return index_type == GL_UNSIGNED_SHORT ? (const void *)index16.data() : (const void *)index32.data();
+}
+
+size_t Mesh::Indexed::vertex_count() const
+{
+	return vertex.size();
+}
+
+size_t Mesh::Indexed::vertex_stride() const
+{
+	return sizeof(vec3f)
+		+ (uv.empty() ? 0 : sizeof(vec2f))
+		+ (normal.empty() ? 0 : sizeof(vec3f))
+		+ (tangent.empty() ? 0 : sizeof(vec4f));
+}
+
+VertexLayout Mesh::Indexed::default_layout() const
+{
+	VertexLayout layout;
+	layout.add(VertexLayout::POSITION, 3);
+	if (!normal.empty())
+		layout.add(VertexLayout::NORMAL, 3);
+	if (!uv.empty())
+		layout.add(VertexLayout::UV, 2);
+	if (!tangent.empty())
+		layout.add(VertexLayout::TANGENT, 4);
+
+	return layout;
+}
+
+Mesh::Interleaved Mesh::Indexed::interleave(const VertexLayout &layout) const
+{
+	const float *streams[VertexLayout::ATTRIBUTE_COUNT] = {
+		stream_data(vertex),
+		stream_data(normal),
+		stream_data(uv),
+		stream_data(tangent)
+	};
+
+	return interleave_streams(layout, vertex.size(), streams);
+}
+
+Mesh::Interleaved Mesh::Indexed::quantize(const QuantizeOptions &options, QuantizeError *error) const
+{
+	VertexLayout layout;
+
+	switch (options.position) {
+	case QuantizeOptions::POSITION_FLOAT:
+		layout.add(VertexLayout::POSITION, 3);
+		break;
+	case QuantizeOptions::POSITION_HALF:
+		layout.add(VertexLayout::POSITION, 3, GL_HALF_FLOAT);
+		break;
+	case QuantizeOptions::POSITION_UNORM16:
+		layout.add(VertexLayout::POSITION, 3, GL_UNSIGNED_SHORT, true);
+		break;
+	}
+
+	if (!normal.empty()) {
+		switch (options.normal) {
+		case QuantizeOptions::NORMAL_FLOAT:
+			layout.add(VertexLayout::NORMAL, 3);
+			break;
+		case QuantizeOptions::NORMAL_OCT8:
+			layout.add(VertexLayout::NORMAL, 2, GL_BYTE, true);
+			break;
+		case QuantizeOptions::NORMAL_OCT16:
+			layout.add(VertexLayout::NORMAL, 2, GL_SHORT, true);
+			break;
+		}
+	}
+
+	if (!uv.empty()) {
+		if (options.uv == QuantizeOptions::UV_UNORM16)
+			layout.add(VertexLayout::UV, 2, GL_UNSIGNED_SHORT, true);
+		else
+			layout.add(VertexLayout::UV, 2);
+	}
+
+	if (!tangent.empty())
+		layout.add(VertexLayout::TANGENT, 4);
+
+	Interleaved out;
+	out.layout = layout;
+	out.vertex_count = vertex.size();
+	out.data.assign(vertex.size() * layout.stride(), 0);
+
+	QuantizeError max_error = { 0.0f, 0.0f, 0.0f };
+	VertexLayout::Dequantize &dq = out.dequantize;
+	const uint32_t stride = layout.stride();
+
+	// Bounding boxes for the range based formats.
+	float position_min[3] = { 0.0f, 0.0f, 0.0f }, position_max[3] = { 0.0f, 0.0f, 0.0f };
+	if (!vertex.empty()) {
+		position_min[0] = position_max[0] = vertex[0].x;
+		position_min[1] = position_max[1] = vertex[0].y;
+		position_min[2] = position_max[2] = vertex[0].z;
+	}
+	for (const vec3f &v : vertex) {
+		const float p[3] = { v.x, v.y, v.z };
+		for (int i = 0; i < 3; ++i) {
+			position_min[i] = std::min(position_min[i], p[i]);
+			position_max[i] = std::max(position_max[i], p[i]);
+		}
+	}
+
+	float uv_min[2] = { 0.0f, 0.0f }, uv_max[2] = { 0.0f, 0.0f };
+	if (!uv.empty()) {
+		uv_min[0] = uv_max[0] = uv[0].x;
+		uv_min[1] = uv_max[1] = uv[0].y;
+	}
+	for (const vec2f &t : uv) {
+		uv_min[0] = std::min(uv_min[0], t.x);
+		uv_min[1] = std::min(uv_min[1], t.y);
+		uv_max[0] = std::max(uv_max[0], t.x);
+		uv_max[1] = std::max(uv_max[1], t.y);
+	}
+
+	if (options.position == QuantizeOptions::POSITION_HALF) {
+		for (int i = 0; i < 3; ++i)
+			dq.position_offset[i] = (position_min[i] + position_max[i]) * 0.5f;
+	}
+	else if (options.position == QuantizeOptions::POSITION_UNORM16) {
+		for (int i = 0; i < 3; ++i) {
+			dq.position_offset[i] = position_min[i];
+			dq.position_scale[i] = position_max[i] - position_min[i];
+		}
+	}
+
+	if (!uv.empty() && options.uv == QuantizeOptions::UV_UNORM16) {
+		for (int i = 0; i < 2; ++i) {
+			dq.uv_offset[i] = uv_min[i];
+			dq.uv_scale[i] = uv_max[i] - uv_min[i];
+		}
+	}
+
+	dq.normal_octahedral = !normal.empty() && options.normal != QuantizeOptions::NORMAL_FLOAT;
+	const int normal_bits = options.normal == QuantizeOptions::NORMAL_OCT8 ? 8 : 16;
+
+	const VertexLayout::Element &pe = layout.element(VertexLayout::POSITION);
+	const VertexLayout::Element &ne = layout.element(VertexLayout::NORMAL);
+	const VertexLayout::Element &ue = layout.element(VertexLayout::UV);
+	const VertexLayout::Element &te = layout.element(VertexLayout::TANGENT);
+
+	for (size_t v = 0; v < vertex.size(); ++v) {
+		uint8_t *dst = out.data.data() + v * stride;
+
+		const float p[3] = { vertex[v].x, vertex[v].y, vertex[v].z };
+		float decoded[3];
+
+		switch (options.position) {
+		case QuantizeOptions::POSITION_FLOAT:
+			std::memcpy(dst + pe.offset, p, sizeof(p));
+			std::memcpy(decoded, p, sizeof(p));
+			break;
+
+		case QuantizeOptions::POSITION_HALF: {
+			uint16_t h[3];
+			for (int i = 0; i < 3; ++i) {
+				h[i] = VertexQuantize::float_to_half(p[i] - dq.position_offset[i]);
+				decoded[i] = dq.position_offset[i] + VertexQuantize::half_to_float(h[i]);
+			}
+			std::memcpy(dst + pe.offset, h, sizeof(h));
+			break;
+		}
+
+		case QuantizeOptions::POSITION_UNORM16: {
+			uint16_t q[3];
+			for (int i = 0; i < 3; ++i) {
+				q[i] = VertexQuantize::encode_unorm16(p[i], dq.position_offset[i], dq.position_scale[i]);
+				decoded[i] = VertexQuantize::decode_unorm16(q[i], dq.position_offset[i], dq.position_scale[i]);
+			}
+			std::memcpy(dst + pe.offset, q, sizeof(q));
+			break;
+		}
+		}
+
+		for (int i = 0; i < 3; ++i)
+			max_error.position = std::max(max_error.position, std::fabs(decoded[i] - p[i]));
+
+		if (ne.size) {
+			const vec3f &n = normal[v];
+
+			if (options.normal == QuantizeOptions::NORMAL_FLOAT) {
+				std::memcpy(dst + ne.offset, &n, sizeof(vec3f));
+			}
+			else {
+				int32_t q[2];
+				VertexQuantize::encode_octahedral(n, normal_bits, q);
+
+				if (normal_bits == 8) {
+					const int8_t b[2] = { (int8_t)q[0], (int8_t)q[1] };
+					std::memcpy(dst + ne.offset, b, sizeof(b));
+				}
+				else {
+					const int16_t w[2] = { (int16_t)q[0], (int16_t)q[1] };
+					std::memcpy(dst + ne.offset, w, sizeof(w));
+				}
+
+				float length = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+				if (length > 0.0f) {
+					vec3f d = VertexQuantize::decode_octahedral(q, normal_bits);
+					float dot = (d.x * n.x + d.y * n.y + d.z * n.z) / length;
+					float degrees = std::acos(std::min(std::max(dot, -1.0f), 1.0f)) * 57.29578f;
+					max_error.normal_degrees = std::max(max_error.normal_degrees, degrees);
+				}
+			}
+		}
+
+		if (ue.size) {
+			const float t[2] = { uv[v].x, uv[v].y };
+
+			if (options.uv == QuantizeOptions::UV_FLOAT) {
+				std::memcpy(dst + ue.offset, t, sizeof(t));
+			}
+			else {
+				uint16_t q[2];
+				for (int i = 0; i < 2; ++i) {
+					q[i] = VertexQuantize::encode_unorm16(t[i], dq.uv_offset[i], dq.uv_scale[i]);
+					float d = VertexQuantize::decode_unorm16(q[i], dq.uv_offset[i], dq.uv_scale[i]);
+					max_error.uv = std::max(max_error.uv, std::fabs(d - t[i]));
+				}
+				std::memcpy(dst + ue.offset, q, sizeof(q));
+			}
+		}
+
+		if (te.size)
+			std::memcpy(dst + te.offset, &tangent[v], sizeof(vec4f));
+	}
+
+	if (error)
+		*error = max_error;
+
+	return out;
+}
+
+void Mesh::Indexed::generate_tangents(unsigned thread_count)
+{
+	if (uv.empty() || normal.empty())
+		return;
+
+	std::vector<uint32_t> indices;
+	if (index_type == GL_UNSIGNED_SHORT)
+		indices.assign(index16.begin(), index16.end());
+	else
+		indices = index32;
+
+	if (lods.size() != 0) {
+		const MeshLod::Level &finest = lods.level(0);
+		indices.erase(indices.begin() + finest.first_index + finest.index_count, indices.end());
+		indices.erase(indices.begin(), indices.begin() + finest.first_index);
+	}
+
+	tangent.resize(vertex.size());
+	MeshNormals::generate_tangents(tangent.data(), indices.data(), indices.size(),
+		vertex.data(), normal.data(), uv.data(), vertex.size(), thread_count);
+}
+
+void Mesh::Indexed::optimize(size_t cache_size,
+	MeshOptimize::CacheStats *before, MeshOptimize::CacheStats *after)
+{
+	assert(lods.size() <= 1);
+
+	std::vector<uint32_t> indices;
+	if (index_type == GL_UNSIGNED_SHORT)
+		indices.assign(index16.begin(), index16.end());
+	else
+		indices = index32;
+
+	if (before)
+		*before = MeshOptimize::analyze_vertex_cache(indices.data(), indices.size(), vertex.size(), cache_size);
+
+	// Triangles must stay inside their submesh.
+	std::vector<uint32_t> ordered(indices.size());
+	std::vector<uint32_t> local_ordered;
+	SubmeshVertices local(vertex.size());
+	for (const Submesh &sub : submeshes) {
+		local.gather(indices.data() + sub.first_index, sub.index_count);
+		std::vector<vec3f> position = local.pick(vertex.data());
+
+		local_ordered.resize(sub.index_count);
+		MeshOptimize::optimize_vertex_cache(local_ordered.data(), local.indices.data(),
+			sub.index_count, position.size(), cache_size);
+		MeshOptimize::optimize_overdraw(local_ordered.data(), sub.index_count,
+			position.data(), position.size(), cache_size);
+
+		for (size_t i = 0; i < sub.index_count; ++i)
+			ordered[sub.first_index + i] = local.global[local_ordered[i]];
+	}
+
+	std::vector<uint32_t> remap;
+	size_t used = MeshOptimize::optimize_vertex_fetch(ordered.data(), ordered.size(), vertex.size(), remap);
+
+	auto reorder = [&](auto &attribute) {
+		if (attribute.empty())
+			return;
+
+		typename std::remove_reference<decltype(attribute)>::type moved(used);
+		for (size_t v = 0; v < remap.size(); ++v) {
+			if (remap[v] != std::numeric_limits<uint32_t>::max())
+				moved[remap[v]] = attribute[v];
+		}
+		attribute.swap(moved);
+	};
+
+	reorder(vertex);
+	reorder(uv);
+	reorder(normal);
+	reorder(tangent);
+
+	if (after)
+		*after = MeshOptimize::analyze_vertex_cache(ordered.data(), ordered.size(), vertex.size(), cache_size);
+
+	if (index_type == GL_UNSIGNED_SHORT)
+		index16.assign(ordered.begin(), ordered.end());
+	else
+		index32 = std::move(ordered);
+}
+
+void Mesh::Indexed::build_lods(const std::vector<float> &ratios, float max_error)
+{
+	std::vector<uint32_t> indices;
+	if (index_type == GL_UNSIGNED_SHORT)
+		indices.assign(index16.begin(), index16.end());
+	else
+		indices = index32;
+
+	if (lods.empty()) {
+		lods.add({ 0, (uint32_t)indices.size(), 0.0f });
+	}
+
+	std::vector<Submesh> finest;
+	for (const Submesh &sub : submeshes) {
+		if (sub.level == 0)
+			finest.push_back(sub);
+	}
+
+	// uvs and normals tell the simplifier which vertices at one position
+	// lie on a seam.
+	size_t attribute_count = (uv.empty() ? 0 : 2) + (normal.empty() ? 0 : 3);
+	std::vector<float> attributes;
+	attributes.reserve(vertex.size() * attribute_count);
+	for (size_t v = 0; v < vertex.size(); ++v) {
+		if (!uv.empty())
+			attributes.insert(attributes.end(), { uv[v].x, uv[v].y });
+		if (!normal.empty())
+			attributes.insert(attributes.end(), { normal[v].x, normal[v].y, normal[v].z });
+	}
+
+	// levels[s][i] is level i + 1 of submesh s. A target never drops
+	// below one triangle, so no material disappears from a level.
+	std::vector<std::vector<std::vector<uint32_t>>> levels(finest.size());
+	std::vector<std::vector<float>> errors(finest.size());
+
+	SubmeshVertices local(vertex.size());
+	for (size_t s = 0; s < finest.size(); ++s) {
+		std::vector<size_t> targets;
+		for (float ratio : ratios)
+			targets.push_back(std::max<size_t>(1, (size_t)(finest[s].index_count / 3 * (double)ratio)) * 3);
+
+		local.gather(indices.data() + finest[s].first_index, finest[s].index_count);
+		std::vector<vec3f> position = local.pick(vertex.data());
+		std::vector<float> local_attributes = local.pick(attributes.data(), attribute_count);
+
+		MeshSimplify::simplify_chain(local.indices.data(), local.indices.size(),
+			position.data(), position.size(), targets.data(), targets.size(), max_error, levels[s], errors[s],
+			local_attributes.data(), attribute_count);
+
+		for (std::vector<uint32_t> &simplified : levels[s]) {
+			for (uint32_t &v : simplified)
+				v = local.global[v];
+		}
+	}
+
+	std::vector<uint32_t> ordered;
+	for (size_t i = 0; i < ratios.size(); ++i) {
+		size_t count = 0;
+		float error = 0.0f;
+		for (size_t s = 0; s < finest.size(); ++s) {
+			count += levels[s][i].size();
+			error = std::max(error, errors[s][i]);
+		}
+
+		if (count == 0 || count >= lods.level(lods.size() - 1).index_count)
+			continue;
+
+		uint32_t level = (uint32_t)lods.size();
+		lods.add({ (uint32_t)indices.size(), (uint32_t)count, error });
+
+		for (size_t s = 0; s < finest.size(); ++s) {
+			const std::vector<uint32_t> &simplified = levels[s][i];
+
+			local.gather(simplified.data(), simplified.size());
+			ordered.resize(simplified.size());
+			MeshOptimize::optimize_vertex_cache(ordered.data(), local.indices.data(), simplified.size(),
+				local.global.size());
+
+			submeshes.push_back({ finest[s].material, level, (uint32_t)indices.size(),
+				(uint32_t)simplified.size(), 0, 0, finest[s].bounds });
+			for (uint32_t v : ordered)
+				indices.push_back(local.global[v]);
+		}
+	}
+
+	if (index_type == GL_UNSIGNED_SHORT)
+		index16.assign(indices.begin(), indices.end());
+	else
+		index32 = std::move(indices);
+}
+
+void Mesh::Indexed::build_meshlets(size_t max_vertices, size_t max_triangles)
+{
+	assert(max_vertices >= 3 && max_triangles >= 1);
+
+	std::vector<uint32_t> indices;
+	if (index_type == GL_UNSIGNED_SHORT)
+		indices.assign(index16.begin(), index16.end());
+	else
+		indices = index32;
+
+	meshlets.clear();
+
+	// seen[v] is the number of the meshlet that last took v, plus one.
+	std::vector<uint32_t> seen(vertex.size(), 0);
+	std::vector<uint32_t> members;
+	members.reserve(max_vertices);
+
+	Meshlet current = {};
+
+	auto flush = [&]() {
+		if (current.index_count == 0)
+			return;
+
+		current.vertex_count = (uint32_t)members.size();
+		compute_meshlet_bounds(current, indices.data() + current.first_index, vertex.data(),
+			members.data(), members.size());
+		meshlets.push_back(current);
+
+		uint32_t next = current.first_index + current.index_count;
+		current = Meshlet();
+		current.first_index = next;
+		members.clear();
+	};
+
+	for (Submesh &sub : submeshes) {
+		if (sub.level != 0)
+			continue;
+
+		sub.first_meshlet = (uint32_t)meshlets.size();
+		current = Meshlet();
+		current.first_index = sub.first_index;
+
+		for (uint32_t i = sub.first_index; i < sub.first_index + sub.index_count; i += 3) {
+			const uint32_t *t = &indices[i];
+			uint32_t id = (uint32_t)meshlets.size() + 1;
+
+			size_t fresh = 0;
+			for (int c = 0; c < 3; ++c) {
+				if (seen[t[c]] != id && (c == 0 || t[c] != t[0]) && (c < 2 || t[c] != t[1]))
+					++fresh;
+			}
+
+			if (members.size() + fresh > max_vertices || current.index_count / 3 + 1 > max_triangles) {
+				flush();
+				id = (uint32_t)meshlets.size() + 1;
+			}
+
+			for (int c = 0; c < 3; ++c) {
+				if (seen[t[c]] != id) {
+					seen[t[c]] = id;
+					members.push_back(t[c]);
+				}
+			}
+
+			current.index_count += 3;
+		}
+
+		flush();
+		sub.meshlet_count = (uint32_t)meshlets.size() - sub.first_meshlet;
+	}
 }
 
 Mesh::index_tri::index_tri()
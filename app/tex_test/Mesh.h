@@ -1,14 +1,21 @@
 #pragma once
 
 #include "WavefrontObj.h"
+#include "WavefrontMtl.h"
+#include "MeshLod.h"
+#include "Meshlet.h"
+#include "MeshOptimize.h"
+#include "VertexLayout.h"
 
 #include "vec3f.h"
 #include "vec2f.h"
+#include "vec4f.h"
 
 #include "GL/glew.h"
 #include "GL/glut.h"
 
 #include <cstdint>
+#include <string>
 #include <vector>
 
 struct Mesh {
@@ -19,10 +26,142 @@ struct Mesh {
 		index_tri(size_t i1, size_t i2, size_t i3);
 	};
 
+	// Triangles given before any "usemtl" have no material.
+	static const uint32_t NO_MATERIAL = WavefrontObj::NO_NAME;
+
+	typedef WavefrontObj::Bounds Bounds;
+
+	// What the renderer needs of a material, see set_materials().
+	struct Material {
+		float diffuse[3];
+		float opacity;
+	};
+
+	// A range of one level of the index buffer drawn with one material.
+	// The submeshes of a level are contiguous and sorted by material, with
+	// NO_MATERIAL last. Meshlets are only cut for the finest level, so
+	// the meshlet range is empty on the others. bounds covers the vertices
+	// of the finest level; coarser levels use a subset of them.
+	struct Submesh {
+		uint32_t material;
+		uint32_t level;
+		uint32_t first_index;
+		uint32_t index_count;
+		uint32_t first_meshlet;
+		uint32_t meshlet_count;
+		Bounds bounds;
+	};
+
+	// One buffer holding every attribute of each vertex back to back, as
+	// described by layout.
+	struct Interleaved {
+		VertexLayout layout;
+		VertexLayout::Dequantize dequantize;
+		std::vector<uint8_t> data;
+		size_t vertex_count;
+
+		Interleaved();
+	};
+
+	// Storage formats for Indexed::quantize(). Positions and uvs in 16-bit
+	// formats are relative to their bounding box; half positions are
+	// relative to its centre.
+	struct QuantizeOptions {
+		enum Position { POSITION_FLOAT, POSITION_HALF, POSITION_UNORM16 } position;
+		enum Normal { NORMAL_FLOAT, NORMAL_OCT8, NORMAL_OCT16 } normal;
+		enum Uv { UV_FLOAT, UV_UNORM16 } uv;
+
+		QuantizeOptions();
+		QuantizeOptions(Position p, Normal n, Uv u);
+	};
+
+	// Largest error over all vertices after decoding.
+	struct QuantizeError {
+		float position;
+		float normal_degrees;
+		float uv;
+	};
+
 	struct Unpacked {
 		std::vector<vec3f> vertex;
 		std::vector<vec2f> uv;
 		std::vector<vec3f> normal;
+
+		// Float attributes for every stream that is present.
+		VertexLayout default_layout() const;
+		Interleaved interleave(const VertexLayout &layout) const;
+	};
+
+	// One entry per unique (vertex, uv, normal) combination, plus an index
+	// buffer for glDrawElements(). Only one of index16/index32 is filled,
+	// whichever is the smallest type that can address every vertex.
+	struct Indexed {
+		std::vector<vec3f> vertex;
+		std::vector<vec2f> uv;
+		std::vector<vec3f> normal;
+		// xyz is the tangent, w the handedness of the bitangent. Empty
+		// unless tangents were generated.
+		std::vector<vec4f> tangent;
+
+		std::vector<uint16_t> index16;
+		std::vector<uint32_t> index32;
+		GLenum index_type;
+
+		// Ranges of the index buffer, finest first. Empty until
+		// build_lods() runs; the whole buffer is then a single level.
+		MeshLod lods;
+
+		// Consecutive runs of the finest level, see build_meshlets().
+		std::vector<Meshlet> meshlets;
+
+		// Material ranges of every level, finest first.
+		std::vector<Submesh> submeshes;
+
+		// Every vertex the index buffer uses.
+		Bounds bounds;
+
+		Indexed();
+
+		size_t index_count() const;
+		size_t index_size() const;
+		const void *index_data() const;
+		size_t vertex_count() const;
+
+		// Bytes per vertex for the attributes present.
+		size_t vertex_stride() const;
+
+		VertexLayout default_layout() const;
+		Interleaved interleave(const VertexLayout &layout) const;
+
+		// Interleaves into the formats chosen by options. Tangents, if any,
+		// stay as floats.
+		Interleaved quantize(const QuantizeOptions &options, QuantizeError *error = nullptr) const;
+
+		// Fills tangent from the triangles of the finest level, see
+		// MeshNormals. Needs uvs and normals; does nothing without them.
+		void generate_tangents(unsigned thread_count = 0);
+
+		// Reorders triangles for the post-transform cache and for overdraw,
+		// each submesh on its own, then vertices into the order they are
+		// first used. The cache statistics before and after are stored if
+		// asked for.
+		void optimize(size_t cache_size = MeshOptimize::DEFAULT_CACHE_SIZE,
+			MeshOptimize::CacheStats *before = nullptr, MeshOptimize::CacheStats *after = nullptr);
+
+		// Appends one simplified copy of the full mesh per entry of ratios
+		// (fractions of the full triangle count, largest first) to the index
+		// buffer and records each in lods. Each submesh is simplified on its
+		// own, so none disappears and their shared edges stay closed. Levels
+		// that cannot get any coarser than the one before them are dropped.
+		// Run after optimize(), which only handles a single level.
+		void build_lods(const std::vector<float> &ratios, float max_error = 1e30f);
+
+		// Cuts the finest level into meshlets of at most max_vertices unique
+		// vertices and max_triangles triangles, in index buffer order, and
+		// computes their bounds. No meshlet spans two submeshes. The index
+		// buffer is not changed, so run it after optimize() to get compact
+		// meshlets.
+		void build_meshlets(size_t max_vertices = 64, size_t max_triangles = 124);
 	};
 
 	std::vector<vec3f> vertex;
@@ -33,9 +172,35 @@ struct Mesh {
 	std::vector<index_tri> uv_tri;
 	std::vector<index_tri> normal_tri;
 
+	// Material of each vertex_tri entry, or empty if the file has no
+	// "usemtl" at all. Indexes material_names and materials.
+	std::vector<uint32_t> material_tri;
+	std::vector<std::string> material_names;
+	std::vector<Material> materials;
+
+	// Every position in vertex, as the parser gathered it.
+	Bounds bounds;
+
 public:
-	explicit Mesh(WavefrontObj &obj);
+	// thread_count 0 uses every hardware thread, 1 stays on the calling
+	// thread. Small meshes are always handled serially.
+	explicit Mesh(WavefrontObj &obj, unsigned thread_count = 0);
+
+	// Looks up every material name in mtl. Names it does not define stay
+	// white and opaque.
+	void set_materials(const WavefrontMtl &mtl);
+
+	// Replaces normal and normal_tri with normals generated from the
+	// triangles, for files that have none. Edges sharper than
+	// crease_degrees stay hard; 180 smooths everything.
+	void generate_normals(float crease_degrees = 180.0f, unsigned thread_count = 0);
 
 	Unpacked unpack_to(GLenum mode);
-	Unpacked unpack_to_triangles();
+	Unpacked unpack_to_triangles(unsigned thread_count = 0);
+
+	// Like unpack_to_triangles(), but corners sharing the same vertex, uv
+	// and normal index are emitted once and referenced from an index buffer.
+	// Triangles are grouped by material, one submesh each, keeping file
+	// order within a material. Submesh bounds are gathered on the way.
+	Indexed unpack_to_indexed();
 };
\ No newline at end of file
@@ -0,0 +1,496 @@
+#include "MeshCache.h"
+
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+const char MAGIC[4] = { 'T', 'G', 'M', 'C' };
+
+inline uint64_t rotl64(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t read64(const uint8_t *p)
+{
+	uint64_t v;
+	std::memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+inline uint32_t read32(const uint8_t *p)
+{
+	uint32_t v;
+	std::memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+size_t align_up(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+// Patches the source mtime in the header of an accepted cache in place.
+bool write_source_mtime(const std::string &cache_file, int64_t mtime)
+{
+	std::fstream fs(cache_file, std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+	if (!fs.is_open()) {
+		return false;
+	}
+
+	fs.seekp(offsetof(MeshCache::Header, source) + offsetof(MeshCache::SourceKey, mtime));
+	fs.write((const char *)&mtime, sizeof(mtime));
+	return fs.good();
+}
+
+struct pending_section {
+	MeshCache::SectionId id;
+	uint32_t stride;
+	size_t count;
+	const void *data;
+};
+
+}
+
+MeshCache::MeshCache()
+	: file(), header(nullptr), sections(nullptr)
+{
+}
+
+bool MeshCache::load(const std::string &source, const std::string &cache_file, bool verify)
+{
+	header = nullptr;
+	sections = nullptr;
+
+	// Size and mtime come from a stat; the source is only read and hashed
+	// when asked to, or when the mtime moved without the size changing.
+	SourceKey key;
+	if (!stat_key(source, key)) {
+		return false;
+	}
+
+	if (!file.open(cache_file) || file.size() < sizeof(Header)) {
+		file.close();
+		return false;
+	}
+
+	const Header *h = (const Header *)file.data();
+	bool valid = std::memcmp(h->magic, MAGIC, sizeof(MAGIC)) == 0
+		&& h->version == VERSION
+		&& h->header_size == sizeof(Header)
+		&& h->file_size == file.size()
+		&& sizeof(Header) + (uint64_t)h->section_count * sizeof(Section) <= file.size();
+
+	if (!valid) {
+		std::cerr << "MeshCache: ignoring \"" << cache_file << "\", bad header or version\n";
+		file.close();
+		return false;
+	}
+
+	bool current = h->source.size == key.size;
+	bool mtime_moved = h->source.mtime != key.mtime;
+	if (current && (verify || mtime_moved))
+		current = compute_key(source, key) && h->source.size == key.size && h->source.hash == key.hash;
+
+	if (!current) {
+		file.close();
+		return false;
+	}
+
+	const Section *s = (const Section *)(file.data() + sizeof(Header));
+	for (uint32_t i = 0; i < h->section_count; ++i) {
+		bool in_bounds = s[i].offset % SECTION_ALIGNMENT == 0
+			&& s[i].stride != 0
+			&& s[i].offset <= file.size()
+			&& s[i].count <= (file.size() - s[i].offset) / s[i].stride;
+
+		if (!in_bounds) {
+			std::cerr << "MeshCache: section out of bounds in \"" << cache_file << "\"\n";
+			file.close();
+			return false;
+		}
+	}
+
+	header = h;
+	sections = s;
+
+	if (!libraries_current()) {
+		header = nullptr;
+		sections = nullptr;
+		file.close();
+		return false;
+	}
+
+	// The source was touched but not changed. Store its new mtime so the
+	// next load() skips the hash again. Windows will not open a mapped file
+	// for writing, so the mapping is dropped around that.
+	if (mtime_moved) {
+		uint64_t file_size = h->file_size;
+		header = nullptr;
+		sections = nullptr;
+		file.close();
+
+		if (!write_source_mtime(cache_file, key.mtime))
+			std::cerr << "MeshCache: could not update \"" << cache_file << "\"\n";
+
+		if (!file.open(cache_file) || file.size() != file_size) {
+			file.close();
+			return false;
+		}
+
+		header = (const Header *)file.data();
+		sections = (const Section *)(file.data() + sizeof(Header));
+	}
+
+	return true;
+}
+
+bool MeshCache::libraries_current() const
+{
+	size_t library_count, name_count;
+	const LibraryKey *libraries = get<LibraryKey>(MATERIAL_LIBRARIES, library_count);
+	const char *names = get<char>(MATERIAL_LIBRARY_NAMES, name_count);
+
+	for (size_t i = 0; i < library_count; ++i) {
+		const LibraryKey &library = libraries[i];
+		if (library.name_offset > name_count || library.name_length > name_count - library.name_offset) {
+			std::cerr << "MeshCache: bad material library name\n";
+			return false;
+		}
+
+		std::string path;
+		if (library.name_length)
+			path.assign(names + library.name_offset, (size_t)library.name_length);
+
+		SourceKey key;
+		bool current = stat_key(path, key)
+			? library.size == key.size && library.mtime == key.mtime
+			: library.size == MISSING_LIBRARY;
+
+		if (!current)
+			return false;
+	}
+
+	return true;
+}
+
+bool MeshCache::is_loaded() const
+{
+	return header != nullptr;
+}
+
+const void *MeshCache::find(SectionId id, size_t stride, size_t &count) const
+{
+	count = 0;
+	if (!header) {
+		return nullptr;
+	}
+
+	for (uint32_t i = 0; i < header->section_count; ++i) {
+		if (sections[i].id != id)
+			continue;
+
+		if (sections[i].stride != stride) {
+			std::cerr << "MeshCache: section " << id << " has stride " << sections[i].stride
+				<< ", expected " << stride << "\n";
+			return nullptr;
+		}
+
+		count = (size_t)sections[i].count;
+		return file.data() + sections[i].offset;
+	}
+
+	return nullptr;
+}
+
+const void *MeshCache::get_interleaved(VertexLayout &layout, VertexLayout::Dequantize &dequantize,
+	size_t &vertex_count) const
+{
+	vertex_count = 0;
+	if (!header) {
+		return nullptr;
+	}
+
+	size_t element_count;
+	const VertexLayout::Element *elements = get<VertexLayout::Element>(VERTEX_LAYOUT, element_count);
+	if (!elements || element_count != VertexLayout::ATTRIBUTE_COUNT) {
+		return nullptr;
+	}
+
+	size_t dequantize_count;
+	const VertexLayout::Dequantize *dq = get<VertexLayout::Dequantize>(VERTEX_DEQUANTIZE, dequantize_count);
+	if (!dq || dequantize_count != 1) {
+		return nullptr;
+	}
+
+	for (uint32_t i = 0; i < header->section_count; ++i) {
+		if (sections[i].id != INTERLEAVED_VERTEX)
+			continue;
+
+		for (size_t a = 0; a < element_count; ++a) {
+			const VertexLayout::Element &e = elements[a];
+			if (e.size == 0)
+				continue;
+
+			if (e.size > 4 || e.offset + e.size * VertexLayout::type_size(e.type) > sections[i].stride) {
+				std::cerr << "MeshCache: bad vertex layout\n";
+				return nullptr;
+			}
+		}
+
+		layout = VertexLayout(elements, element_count, sections[i].stride);
+		dequantize = *dq;
+		vertex_count = (size_t)sections[i].count;
+		return file.data() + sections[i].offset;
+	}
+
+	return nullptr;
+}
+
+bool MeshCache::write(const std::string &source, const std::vector<std::string> &libraries,
+	const std::string &cache_file, const Mesh &mesh, const Mesh::Indexed &indexed,
+	const Mesh::Interleaved &interleaved)
+{
+	SourceKey key;
+	if (!compute_key(source, key)) {
+		return false;
+	}
+
+	// Indices are stored narrowed to 32 bits.
+	auto narrow = [](const std::vector<Mesh::index_tri> &tris, std::vector<uint32_t> &out) {
+		out.reserve(tris.size() * 3);
+		for (const auto &t : tris) {
+			if (t.p1 > UINT32_MAX || t.p2 > UINT32_MAX || t.p3 > UINT32_MAX)
+				return false;
+
+			out.push_back((uint32_t)t.p1);
+			out.push_back((uint32_t)t.p2);
+			out.push_back((uint32_t)t.p3);
+		}
+		return true;
+	};
+
+	std::vector<uint32_t> vertex_tri, uv_tri, normal_tri;
+	if (!narrow(mesh.vertex_tri, vertex_tri) || !narrow(mesh.uv_tri, uv_tri)
+		|| !narrow(mesh.normal_tri, normal_tri)) {
+		std::cerr << "MeshCache: \"" << source << "\" has indices too large to cache\n";
+		return false;
+	}
+
+	std::vector<LibraryKey> library_keys;
+	std::string library_names;
+	for (const std::string &library : libraries) {
+		SourceKey stat;
+		LibraryKey k;
+		k.size = stat_key(library, stat) ? stat.size : MISSING_LIBRARY;
+		k.mtime = k.size == MISSING_LIBRARY ? 0 : stat.mtime;
+		k.name_offset = library_names.size();
+		k.name_length = library.size();
+
+		library_keys.push_back(k);
+		library_names += library;
+	}
+
+	const pending_section pending[] = {
+		{ MESH_VERTEX, sizeof(vec3f), mesh.vertex.size(), mesh.vertex.data() },
+		{ MESH_UV, sizeof(vec2f), mesh.uv.size(), mesh.uv.data() },
+		{ MESH_NORMAL, sizeof(vec3f), mesh.normal.size(), mesh.normal.data() },
+		{ MESH_VERTEX_TRI, 3 * sizeof(uint32_t), vertex_tri.size() / 3, vertex_tri.data() },
+		{ MESH_UV_TRI, 3 * sizeof(uint32_t), uv_tri.size() / 3, uv_tri.data() },
+		{ MESH_NORMAL_TRI, 3 * sizeof(uint32_t), normal_tri.size() / 3, normal_tri.data() },
+		{ VERTEX_LAYOUT, sizeof(VertexLayout::Element), VertexLayout::ATTRIBUTE_COUNT, interleaved.layout.elements() },
+		{ VERTEX_DEQUANTIZE, sizeof(VertexLayout::Dequantize), 1, &interleaved.dequantize },
+		{ INTERLEAVED_VERTEX, interleaved.layout.stride(), interleaved.vertex_count, interleaved.data.data() },
+		indexed.index_type == GL_UNSIGNED_SHORT
+			? pending_section{ INDEX16, sizeof(uint16_t), indexed.index16.size(), indexed.index16.data() }
+			: pending_section{ INDEX32, sizeof(uint32_t), indexed.index32.size(), indexed.index32.data() },
+		{ LOD_LEVELS, sizeof(MeshLod::Level), indexed.lods.size(), indexed.lods.levels() },
+		{ MESHLETS, sizeof(Meshlet), indexed.meshlets.size(), indexed.meshlets.data() },
+		{ MESH_MATERIAL_TRI, sizeof(uint32_t), mesh.material_tri.size(), mesh.material_tri.data() },
+		{ SUBMESHES, sizeof(Mesh::Submesh), indexed.submeshes.size(), indexed.submeshes.data() },
+		{ MATERIALS, sizeof(Mesh::Material), mesh.materials.size(), mesh.materials.data() },
+		{ MESH_BOUNDS, sizeof(Mesh::Bounds), 1, &indexed.bounds },
+		{ MATERIAL_LIBRARIES, sizeof(LibraryKey), library_keys.size(), library_keys.data() },
+		{ MATERIAL_LIBRARY_NAMES, 1, library_names.size(), library_names.data() },
+	};
+	const uint32_t section_count = sizeof(pending) / sizeof(pending[0]);
+
+	std::vector<Section> table(section_count);
+	size_t offset = align_up(sizeof(Header) + section_count * sizeof(Section), SECTION_ALIGNMENT);
+
+	for (uint32_t i = 0; i < section_count; ++i) {
+		table[i].id = pending[i].id;
+		table[i].stride = pending[i].stride;
+		table[i].offset = offset;
+		table[i].count = pending[i].count;
+
+		offset = align_up(offset + pending[i].count * pending[i].stride, SECTION_ALIGNMENT);
+	}
+
+	Header h;
+	std::memset(&h, 0, sizeof(h));
+	std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+	h.version = VERSION;
+	h.header_size = sizeof(Header);
+	h.section_count = section_count;
+	h.file_size = offset;
+	h.source = key;
+
+	std::vector<char> buffer(offset, 0);
+	std::memcpy(buffer.data(), &h, sizeof(h));
+	std::memcpy(buffer.data() + sizeof(h), table.data(), section_count * sizeof(Section));
+
+	for (uint32_t i = 0; i < section_count; ++i) {
+		if (pending[i].count) {
+			std::memcpy(buffer.data() + table[i].offset, pending[i].data,
+				pending[i].count * pending[i].stride);
+		}
+	}
+
+	// Write next to the target and rename over it, so a reader never maps a
+	// half-written cache.
+	std::string temp_file = cache_file + ".tmp";
+	{
+		std::ofstream ofs(temp_file, std::ios_base::out | std::ios_base::binary);
+		if (!ofs.is_open()) {
+			std::cerr << "Failed to open \"" << temp_file << "\" for writing\n";
+			return false;
+		}
+
+		ofs.write(buffer.data(), buffer.size());
+		if (!ofs.good()) {
+			std::cerr << "Failed to write mesh cache \"" << temp_file << "\"\n";
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(temp_file, cache_file, ec);
+	if (ec) {
+		std::cerr << "Failed to move \"" << temp_file << "\" to \"" << cache_file << "\"\n";
+		std::filesystem::remove(temp_file, ec);
+		return false;
+	}
+
+	return true;
+}
+
+bool MeshCache::stat_key(const std::string &source, SourceKey &key)
+{
+	std::error_code ec;
+	std::filesystem::file_time_type mtime = std::filesystem::last_write_time(source, ec);
+	if (ec) {
+		return false;
+	}
+
+	uintmax_t size = std::filesystem::file_size(source, ec);
+	if (ec) {
+		return false;
+	}
+
+	key.size = size;
+	key.mtime = (int64_t)mtime.time_since_epoch().count();
+	key.hash = 0;
+	return true;
+}
+
+bool MeshCache::compute_key(const std::string &source, SourceKey &key)
+{
+	if (!stat_key(source, key)) {
+		return false;
+	}
+
+	MappedFile mapped(source);
+	if (!mapped.is_open()) {
+		return false;
+	}
+
+	mapped.advise_sequential();
+
+	key.size = mapped.size();
+	key.hash = hash(mapped.data(), mapped.size());
+	return true;
+}
+
+uint64_t MeshCache::hash(const void *data, size_t size, uint64_t seed)
+{
+	// XXH64
+	const uint64_t P1 = 0x9E3779B185EBCA87ULL;
+	const uint64_t P2 = 0xC2B2AE3D27D4EB4FULL;
+	const uint64_t P3 = 0x165667B19E3779F9ULL;
+	const uint64_t P4 = 0x85EBCA77C2B2AE63ULL;
+	const uint64_t P5 = 0x27D4EB2F165667C5ULL;
+
+	auto round = [=](uint64_t acc, uint64_t input) {
+		acc += input * P2;
+		acc = rotl64(acc, 31);
+		return acc * P1;
+	};
+
+	auto merge = [=](uint64_t acc, uint64_t val) {
+		acc ^= round(0, val);
+		return acc * P1 + P4;
+	};
+
+	const uint8_t *p = (const uint8_t *)data;
+	const uint8_t *end = p + size;
+	uint64_t h;
+
+	if (size >= 32) {
+		uint64_t v1 = seed + P1 + P2;
+		uint64_t v2 = seed + P2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - P1;
+
+		const uint8_t *limit = end - 32;
+		do {
+			v1 = round(v1, read64(p));
+			v2 = round(v2, read64(p + 8));
+			v3 = round(v3, read64(p + 16));
+			v4 = round(v4, read64(p + 24));
+			p += 32;
+		} while (p <= limit);
+
+		h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+		h = merge(h, v1);
+		h = merge(h, v2);
+		h = merge(h, v3);
+		h = merge(h, v4);
+	}
+	else {
+		h = seed + P5;
+	}
+
+	h += (uint64_t)size;
+
+	while (end - p >= 8) {
+		h ^= round(0, read64(p));
+		h = rotl64(h, 27) * P1 + P4;
+		p += 8;
+	}
+
+	if (end - p >= 4) {
+		h ^= (uint64_t)read32(p) * P1;
+		h = rotl64(h, 23) * P2 + P3;
+		p += 4;
+	}
+
+	while (p != end) {
+		h ^= (*p) * P5;
+		h = rotl64(h, 11) * P1;
+		++p;
+	}
+
+	h ^= h >> 33;
+	h *= P2;
+	h ^= h >> 29;
+	h *= P3;
+	h ^= h >> 32;
+
+	return h;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "Mesh.h"
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+Binary cache of a Mesh cooked from a Wavefront .obj file.
+
+Layout, all in native byte order:
+	Header
+	Section[section_count]
+	section data, each block starting on a SECTION_ALIGNMENT boundary
+
+The header records the size, mtime and content hash of the source file,
+and the MATERIAL_LIBRARIES section the size and mtime of each .mtl file
+its materials came from. load() accepts the cache when size and mtime
+still match, without reading the source. If only the source's mtime
+moved, or verify is set, the source is hashed and the hash decides; a
+cache accepted that way has its stored mtime updated, so the next load
+skips the hash again. Any change to a material library rejects the cache.
+The accepted cache hands out pointers straight into the mapping, so the
+arrays can be passed to glBufferData() without being parsed or copied.
+*/
+
+class MeshCache {
+public:
+	static const uint32_t VERSION = 10;
+	static const size_t SECTION_ALIGNMENT = 64;
+
+	enum SectionId : uint32_t {
+		MESH_VERTEX = 1,
+		MESH_UV,
+		MESH_NORMAL,
+		// Index triples as uint32_t[3], 1-based like the .obj file.
+		MESH_VERTEX_TRI,
+		MESH_UV_TRI,
+		MESH_NORMAL_TRI,
+		// The output of Mesh::unpack_to_indexed() after Indexed::optimize(),
+		// interleaved and ready for upload. VERTEX_LAYOUT holds the
+		// VertexLayout::Element array and INTERLEAVED_VERTEX uses the layout
+		// stride as its own. VERTEX_DEQUANTIZE is a single
+		// VertexLayout::Dequantize. Only one of INDEX16/INDEX32 is present.
+		VERTEX_LAYOUT,
+		VERTEX_DEQUANTIZE,
+		INTERLEAVED_VERTEX,
+		INDEX16,
+		INDEX32,
+		// MeshLod::Level ranges of the index buffer, finest first.
+		LOD_LEVELS,
+		// Meshlet runs of the finest level, with their bounds.
+		MESHLETS,
+		// Mesh::material_tri, and Mesh::Submesh ranges of every level.
+		MESH_MATERIAL_TRI,
+		SUBMESHES,
+		// Mesh::Material, indexed by Submesh::material.
+		MATERIALS,
+		// A single Mesh::Bounds around the vertices of the index buffer.
+		MESH_BOUNDS,
+		// One LibraryKey per "mtllib" of the source, and the characters of
+		// their paths.
+		MATERIAL_LIBRARIES,
+		MATERIAL_LIBRARY_NAMES
+	};
+
+	struct SourceKey {
+		uint64_t size;
+		int64_t mtime;
+		uint64_t hash;
+	};
+
+	// A library that could not be read when the cache was written has
+	// size MISSING_LIBRARY, and must still be missing.
+	struct LibraryKey {
+		uint64_t size;
+		int64_t mtime;
+		uint64_t name_offset;
+		uint64_t name_length;
+	};
+
+	static const uint64_t MISSING_LIBRARY = UINT64_MAX;
+
+	struct Header {
+		char magic[4];
+		uint32_t version;
+		uint32_t header_size;
+		uint32_t section_count;
+		uint64_t file_size;
+		SourceKey source;
+	};
+
+	struct Section {
+		uint32_t id;
+		uint32_t stride;
+		uint64_t offset;
+		uint64_t count;
+	};
+
+	MeshCache();
+
+	// Maps cache_file if it was written for the current contents of source.
+	bool load(const std::string &source, const std::string &cache_file, bool verify = false);
+	bool is_loaded() const;
+
+	template <class T>
+	const T *get(SectionId id, size_t &count) const;
+
+	// Layout, dequantisation and data of INTERLEAVED_VERTEX, or nullptr if
+	// any of them is missing.
+	const void *get_interleaved(VertexLayout &layout, VertexLayout::Dequantize &dequantize,
+		size_t &vertex_count) const;
+
+	// libraries are the paths of the .mtl files the materials were read
+	// from, as WavefrontMtl::library_path() resolves them.
+	static bool write(const std::string &source, const std::vector<std::string> &libraries,
+		const std::string &cache_file, const Mesh &mesh, const Mesh::Indexed &indexed,
+		const Mesh::Interleaved &interleaved);
+
+	// Size and mtime only, with hash left 0.
+	static bool stat_key(const std::string &source, SourceKey &key);
+	static bool compute_key(const std::string &source, SourceKey &key);
+	static uint64_t hash(const void *data, size_t size, uint64_t seed = 0);
+
+private:
+	const void *find(SectionId id, size_t stride, size_t &count) const;
+	bool libraries_current() const;
+
+	MappedFile file;
+	const Header *header;
+	const Section *sections;
+};
+
+template <class T>
+const T *MeshCache::get(SectionId id, size_t &count) const
+{
+	return (const T *)find(id, sizeof(T), count);
+}
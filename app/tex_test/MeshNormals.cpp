@@ -0,0 +1,278 @@
+#include "MeshNormals.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MESHNORMALS_SSE2 1
+#include <emmintrin.h>
+#else
+#define MESHNORMALS_SSE2 0
+#endif
+
+namespace {
+
+inline vec3f add(const vec3f &a, const vec3f &b) { return vec3f(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline vec3f sub(const vec3f &a, const vec3f &b) { return vec3f(a.x - b.x, a.y - b.y, a.z - b.z); }
+inline vec3f scale(const vec3f &a, float s) { return vec3f(a.x * s, a.y * s, a.z * s); }
+inline float dot(const vec3f &a, const vec3f &b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+inline vec3f cross(const vec3f &a, const vec3f &b)
+{
+	return vec3f(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+inline vec3f normalize_or(const vec3f &a, const vec3f &fallback)
+{
+	float length = std::sqrt(dot(a, a));
+	return length > 0.0f ? scale(a, 1.0f / length) : fallback;
+}
+
+inline bool equal(const vec3f &a, const vec3f &b)
+{
+	return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+// Any unit vector at right angles to n.
+vec3f perpendicular(const vec3f &n)
+{
+	vec3f axis = std::fabs(n.x) < 0.9f ? vec3f(1.0f, 0.0f, 0.0f) : vec3f(0.0f, 1.0f, 0.0f);
+	return normalize_or(cross(n, axis), vec3f(1.0f, 0.0f, 0.0f));
+}
+
+// The corners around each vertex: corners[offset[v] .. offset[v + 1]),
+// in index order.
+struct VertexCorners {
+	std::vector<uint32_t> offset;
+	std::vector<uint32_t> corners;
+
+	VertexCorners(const uint32_t *indices, size_t index_count, size_t vertex_count)
+		: offset(vertex_count + 1, 0), corners(index_count)
+	{
+		assert(index_count <= UINT32_MAX);
+
+		for (size_t i = 0; i < index_count; ++i) {
+			assert(indices[i] < vertex_count);
+			++offset[indices[i] + 1];
+		}
+		for (size_t v = 0; v < vertex_count; ++v)
+			offset[v + 1] += offset[v];
+
+		std::vector<uint32_t> next(offset.begin(), offset.end() - 1);
+		for (size_t i = 0; i < index_count; ++i)
+			corners[next[indices[i]]++] = (uint32_t)i;
+	}
+};
+
+// The unnormalised normal of every triangle; its length is twice the area.
+void face_normals(vec3f *out, const uint32_t *indices, size_t tri_count, const vec3f *position,
+	unsigned thread_count)
+{
+	parallel_for(tri_count, thread_count, [&](size_t begin, size_t end) {
+		size_t t = begin;
+
+#if MESHNORMALS_SSE2
+		// Four triangles at a time, one per lane: gather the corners into
+		// x, y and z rows and take both edges and the cross product there.
+		for (; t + 4 <= end; t += 4) {
+			alignas(16) float p[3][3][4];
+			for (int lane = 0; lane < 4; ++lane) {
+				const uint32_t *tri = indices + (t + lane) * 3;
+				for (int c = 0; c < 3; ++c) {
+					const vec3f &v = position[tri[c]];
+					p[c][0][lane] = v.x;
+					p[c][1][lane] = v.y;
+					p[c][2][lane] = v.z;
+				}
+			}
+
+			__m128 x0 = _mm_load_ps(p[0][0]), y0 = _mm_load_ps(p[0][1]), z0 = _mm_load_ps(p[0][2]);
+			__m128 ax = _mm_sub_ps(_mm_load_ps(p[1][0]), x0);
+			__m128 ay = _mm_sub_ps(_mm_load_ps(p[1][1]), y0);
+			__m128 az = _mm_sub_ps(_mm_load_ps(p[1][2]), z0);
+			__m128 bx = _mm_sub_ps(_mm_load_ps(p[2][0]), x0);
+			__m128 by = _mm_sub_ps(_mm_load_ps(p[2][1]), y0);
+			__m128 bz = _mm_sub_ps(_mm_load_ps(p[2][2]), z0);
+
+			alignas(16) float n[3][4];
+			_mm_store_ps(n[0], _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by)));
+			_mm_store_ps(n[1], _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(ax, bz)));
+			_mm_store_ps(n[2], _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx)));
+
+			for (int lane = 0; lane < 4; ++lane)
+				out[t + lane] = vec3f(n[0][lane], n[1][lane], n[2][lane]);
+		}
+#endif
+
+		for (; t < end; ++t) {
+			const uint32_t *tri = indices + t * 3;
+			const vec3f &p0 = position[tri[0]];
+			out[t] = cross(sub(position[tri[1]], p0), sub(position[tri[2]], p0));
+		}
+	});
+}
+
+} // namespace
+
+void MeshNormals::generate_normals(std::vector<vec3f> &normals, std::vector<uint32_t> &normal_indices,
+	const uint32_t *indices, size_t index_count, const vec3f *position, size_t vertex_count,
+	float crease_degrees, unsigned thread_count)
+{
+	assert(index_count % 3 == 0);
+	size_t tri_count = index_count / 3;
+	const vec3f up(0.0f, 0.0f, 1.0f);
+
+	std::vector<vec3f> face(tri_count);
+	face_normals(face.data(), indices, tri_count, position, thread_count);
+
+	VertexCorners around(indices, index_count, vertex_count);
+
+	if (crease_degrees >= 180.0f) {
+		normals.resize(vertex_count);
+		parallel_for(vertex_count, thread_count, [&](size_t begin, size_t end) {
+			for (size_t v = begin; v < end; ++v) {
+				vec3f sum;
+				for (uint32_t i = around.offset[v]; i < around.offset[v + 1]; ++i)
+					sum = add(sum, face[around.corners[i] / 3]);
+				normals[v] = normalize_or(sum, up);
+			}
+		});
+
+		normal_indices.assign(indices, indices + index_count);
+		return;
+	}
+
+	const float min_cos = std::cos(crease_degrees * 3.14159265f / 180.0f);
+
+	std::vector<vec3f> direction(tri_count);
+	parallel_for(tri_count, thread_count, [&](size_t begin, size_t end) {
+		for (size_t t = begin; t < end; ++t)
+			direction[t] = normalize_or(face[t], vec3f());
+	});
+
+	// The normal of every corner, which of its vertex's distinct normals
+	// that is, and how many distinct normals each vertex has. A corner
+	// always takes its own triangle, even a degenerate one.
+	std::vector<vec3f> corner_normal(index_count);
+	std::vector<uint32_t> slot(index_count);
+	std::vector<uint32_t> first_normal(vertex_count + 1, 0);
+
+	parallel_for(vertex_count, thread_count, [&](size_t begin, size_t end) {
+		for (size_t v = begin; v < end; ++v) {
+			uint32_t first = around.offset[v], last = around.offset[v + 1];
+			uint32_t distinct = 0;
+
+			for (uint32_t i = first; i < last; ++i) {
+				uint32_t c = around.corners[i];
+				const vec3f &own = direction[c / 3];
+
+				vec3f sum;
+				for (uint32_t j = first; j < last; ++j) {
+					uint32_t f = around.corners[j] / 3;
+					if (j == i || dot(own, direction[f]) >= min_cos)
+						sum = add(sum, face[f]);
+				}
+
+				vec3f n = normalize_or(sum, up);
+				corner_normal[c] = n;
+
+				uint32_t s = distinct;
+				for (uint32_t k = first; k < i; ++k) {
+					uint32_t other = around.corners[k];
+					if (equal(corner_normal[other], n)) {
+						s = slot[other];
+						break;
+					}
+				}
+				slot[c] = s;
+				if (s == distinct)
+					++distinct;
+			}
+
+			first_normal[v + 1] = distinct;
+		}
+	});
+
+	for (size_t v = 0; v < vertex_count; ++v)
+		first_normal[v + 1] += first_normal[v];
+
+	normals.resize(first_normal[vertex_count]);
+	normal_indices.resize(index_count);
+
+	parallel_for(vertex_count, thread_count, [&](size_t begin, size_t end) {
+		for (size_t v = begin; v < end; ++v) {
+			for (uint32_t i = around.offset[v]; i < around.offset[v + 1]; ++i) {
+				uint32_t c = around.corners[i];
+				uint32_t id = first_normal[v] + slot[c];
+				normal_indices[c] = id;
+				normals[id] = corner_normal[c];
+			}
+		}
+	});
+}
+
+void MeshNormals::generate_tangents(vec4f *out, const uint32_t *indices, size_t index_count,
+	const vec3f *position, const vec3f *normal, const vec2f *uv, size_t vertex_count,
+	unsigned thread_count)
+{
+	assert(index_count % 3 == 0);
+	size_t tri_count = index_count / 3;
+
+	// The directions of increasing u and v at every corner, in the plane of
+	// the corner's normal and weighted by the corner angle. Triangles whose
+	// uvs are degenerate contribute nothing.
+	std::vector<vec3f> corner_s(index_count), corner_t(index_count);
+
+	parallel_for(tri_count, thread_count, [&](size_t begin, size_t end) {
+		for (size_t t = begin; t < end; ++t) {
+			const uint32_t *tri = indices + t * 3;
+			const vec3f p[3] = { position[tri[0]], position[tri[1]], position[tri[2]] };
+			const vec2f w[3] = { uv[tri[0]], uv[tri[1]], uv[tri[2]] };
+
+			float s1 = w[1].x - w[0].x, t1 = w[1].y - w[0].y;
+			float s2 = w[2].x - w[0].x, t2 = w[2].y - w[0].y;
+			float det = s1 * t2 - s2 * t1;
+			if (det == 0.0f)
+				continue;
+
+			vec3f e1 = sub(p[1], p[0]), e2 = sub(p[2], p[0]);
+			float r = 1.0f / det;
+			vec3f sdir = scale(sub(scale(e1, t2), scale(e2, t1)), r);
+			vec3f tdir = scale(sub(scale(e2, s1), scale(e1, s2)), r);
+
+			for (int c = 0; c < 3; ++c) {
+				const vec3f &n = normal[tri[c]];
+
+				vec3f a = sub(p[(c + 1) % 3], p[c]);
+				vec3f b = sub(p[(c + 2) % 3], p[c]);
+				float lengths = std::sqrt(dot(a, a) * dot(b, b));
+				float angle = lengths > 0.0f
+					? std::acos(std::max(-1.0f, std::min(1.0f, dot(a, b) / lengths))) : 0.0f;
+
+				vec3f ts = normalize_or(sub(sdir, scale(n, dot(n, sdir))), vec3f());
+				vec3f bs = normalize_or(sub(tdir, scale(n, dot(n, tdir))), vec3f());
+				corner_s[t * 3 + c] = scale(ts, angle);
+				corner_t[t * 3 + c] = scale(bs, angle);
+			}
+		}
+	});
+
+	VertexCorners around(indices, index_count, vertex_count);
+
+	parallel_for(vertex_count, thread_count, [&](size_t begin, size_t end) {
+		for (size_t v = begin; v < end; ++v) {
+			vec3f ts, bs;
+			for (uint32_t i = around.offset[v]; i < around.offset[v + 1]; ++i) {
+				ts = add(ts, corner_s[around.corners[i]]);
+				bs = add(bs, corner_t[around.corners[i]]);
+			}
+
+			const vec3f &n = normal[v];
+			vec3f tangent = normalize_or(sub(ts, scale(n, dot(n, ts))), perpendicular(n));
+			float handedness = dot(cross(n, tangent), bs) < 0.0f ? -1.0f : 1.0f;
+			out[v] = vec4f(tangent.x, tangent.y, tangent.z, handedness);
+		}
+	});
+}
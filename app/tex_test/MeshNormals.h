@@ -0,0 +1,40 @@
+#pragma once
+
+#include "vec2f.h"
+#include "vec3f.h"
+#include "vec4f.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+Generates the shading frame of a mesh that came without one. Indices are
+0-based triangle lists; thread_count 0 uses every hardware thread.
+
+ - generate_normals() gives every vertex the sum of the unnormalised
+   (so area weighted) normals of the triangles around it. With a crease
+   angle below 180 degrees each corner only takes the triangles within
+   that angle of its own, so hard edges stay hard; corners that end up
+   with the same normal share it.
+ - generate_tangents() accumulates per vertex, after Lengyel: each
+   corner's uv derivatives are projected into the normal's plane and
+   weighted by the corner angle, and w is the handedness of the bitangent.
+   This only approximates MikkTSpace, which also splits vertices whose
+   corners disagree on the tangent frame. Here a vertex shared across a uv
+   mirror seam gets the average and a single handedness, so normal maps
+   baked for MikkTSpace can shade wrong along such seams.
+*/
+
+struct MeshNormals {
+	// normals gets one entry per distinct normal, normal_indices one per
+	// entry of indices.
+	static void generate_normals(std::vector<vec3f> &normals, std::vector<uint32_t> &normal_indices,
+		const uint32_t *indices, size_t index_count, const vec3f *position, size_t vertex_count,
+		float crease_degrees = 180.0f, unsigned thread_count = 0);
+
+	// out must hold vertex_count entries.
+	static void generate_tangents(vec4f *out, const uint32_t *indices, size_t index_count,
+		const vec3f *position, const vec3f *normal, const vec2f *uv, size_t vertex_count,
+		unsigned thread_count = 0);
+};
@@ -0,0 +1,313 @@
+#include "MeshOptimize.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+const uint32_t INVALID = std::numeric_limits<uint32_t>::max();
+
+/*
+Triangles adjacent to each vertex, in compressed row form: the triangles of
+vertex v are triangles[offset[v] .. offset[v + 1]).
+*/
+struct Adjacency {
+	std::vector<uint32_t> offset;
+	std::vector<uint32_t> triangles;
+
+	Adjacency(const uint32_t *indices, size_t index_count, size_t vertex_count)
+		: offset(vertex_count + 1, 0), triangles(index_count)
+	{
+		for (size_t i = 0; i < index_count; ++i)
+			++offset[indices[i] + 1];
+
+		for (size_t v = 0; v < vertex_count; ++v)
+			offset[v + 1] += offset[v];
+
+		std::vector<uint32_t> fill(offset.begin(), offset.end() - 1);
+		for (size_t i = 0; i < index_count; ++i)
+			triangles[fill[indices[i]]++] = (uint32_t)(i / 3);
+	}
+
+	uint32_t count(uint32_t v) const {
+		return offset[v + 1] - offset[v];
+	}
+};
+
+}
+
+MeshOptimize::CacheStats MeshOptimize::analyze_vertex_cache(const uint32_t *indices,
+	size_t index_count, size_t vertex_count, size_t cache_size)
+{
+	CacheStats stats = { 0.0, 0.0 };
+	if (index_count < 3 || vertex_count == 0) {
+		return stats;
+	}
+
+	// A vertex is in the FIFO if fewer than cache_size misses happened
+	// since it was last loaded.
+	std::vector<size_t> loaded_at(vertex_count, 0);
+	std::vector<bool> used(vertex_count, false);
+	size_t misses = 0;
+	size_t unique = 0;
+
+	for (size_t i = 0; i < index_count; ++i) {
+		uint32_t v = indices[i];
+		assert(v < vertex_count);
+
+		if (!used[v]) {
+			used[v] = true;
+			++unique;
+		}
+
+		if (loaded_at[v] == 0 || misses - loaded_at[v] >= cache_size) {
+			++misses;
+			loaded_at[v] = misses;
+		}
+	}
+
+	stats.acmr = (double)misses / (index_count / 3);
+	stats.atvr = (double)misses / unique;
+	return stats;
+}
+
+void MeshOptimize::optimize_vertex_cache(uint32_t *out, const uint32_t *indices,
+	size_t index_count, size_t vertex_count, size_t cache_size)
+{
+	assert(out != indices);
+
+	size_t triangle_count = index_count / 3;
+	if (triangle_count == 0 || vertex_count == 0) {
+		return;
+	}
+
+	Adjacency adjacency(indices, index_count, vertex_count);
+
+	// Triangles not yet emitted that use each vertex.
+	std::vector<uint32_t> live(vertex_count);
+	for (uint32_t v = 0; v < vertex_count; ++v)
+		live[v] = adjacency.count(v);
+
+	// cache_time[v] is the timestamp at which v entered the cache; it is
+	// still cached while stamp - cache_time[v] <= cache_size.
+	std::vector<size_t> cache_time(vertex_count, 0);
+	size_t stamp = cache_size + 1;
+
+	std::vector<bool> emitted(triangle_count, false);
+	std::vector<uint32_t> dead_end;
+	dead_end.reserve(index_count);
+
+	std::vector<uint32_t> candidates;
+	candidates.reserve(64);
+
+	size_t written = 0;
+	uint32_t cursor = 0;
+	uint32_t fan = 0;
+
+	while (fan != INVALID) {
+		candidates.clear();
+
+		// Emit every remaining triangle around the fanning vertex.
+		for (uint32_t a = adjacency.offset[fan]; a < adjacency.offset[fan + 1]; ++a) {
+			uint32_t t = adjacency.triangles[a];
+			if (emitted[t])
+				continue;
+
+			for (int c = 0; c < 3; ++c) {
+				uint32_t v = indices[t * 3 + c];
+				out[written++] = v;
+
+				dead_end.push_back(v);
+				candidates.push_back(v);
+				--live[v];
+
+				if (stamp - cache_time[v] > cache_size) {
+					cache_time[v] = stamp;
+					++stamp;
+				}
+			}
+
+			emitted[t] = true;
+		}
+
+		// Next fan: the candidate that will still be cached after its
+		// remaining triangles are emitted, preferring the oldest one.
+		uint32_t best = INVALID;
+		size_t best_priority = 0;
+		bool have_best = false;
+
+		for (uint32_t v : candidates) {
+			if (live[v] == 0)
+				continue;
+
+			size_t priority = 0;
+			if (stamp - cache_time[v] + 2 * live[v] <= cache_size)
+				priority = stamp - cache_time[v];
+
+			if (!have_best || priority > best_priority) {
+				best = v;
+				best_priority = priority;
+				have_best = true;
+			}
+		}
+
+		if (best == INVALID) {
+			// Dead end: back up through recently used vertices, then scan
+			// forward for any vertex with triangles left.
+			while (!dead_end.empty()) {
+				uint32_t v = dead_end.back();
+				dead_end.pop_back();
+				if (live[v] > 0) {
+					best = v;
+					break;
+				}
+			}
+
+			while (best == INVALID && cursor < vertex_count) {
+				if (live[cursor] > 0)
+					best = cursor;
+				++cursor;
+			}
+		}
+
+		fan = best;
+	}
+
+	assert(written == triangle_count * 3);
+}
+
+void MeshOptimize::optimize_overdraw(uint32_t *indices, size_t index_count,
+	const vec3f *position, size_t vertex_count, size_t cache_size)
+{
+	size_t triangle_count = index_count / 3;
+	if (triangle_count == 0 || vertex_count == 0) {
+		return;
+	}
+
+	// Start a new cluster wherever the cache is effectively flushed, i.e. a
+	// triangle misses on all three corners. Cutting there keeps the cache
+	// behaviour of each cluster intact.
+	std::vector<uint32_t> cluster_start;
+	{
+		std::vector<size_t> loaded_at(vertex_count, 0);
+		size_t misses = 0;
+
+		for (size_t t = 0; t < triangle_count; ++t) {
+			int tri_misses = 0;
+			for (int c = 0; c < 3; ++c) {
+				uint32_t v = indices[t * 3 + c];
+				if (loaded_at[v] == 0 || misses - loaded_at[v] >= cache_size) {
+					++misses;
+					loaded_at[v] = misses;
+					++tri_misses;
+				}
+			}
+
+			if (t == 0 || tri_misses == 3)
+				cluster_start.push_back((uint32_t)t);
+		}
+	}
+
+	size_t cluster_count = cluster_start.size();
+	cluster_start.push_back((uint32_t)triangle_count);
+
+	// Area weighted centroid and normal per cluster, and of the whole mesh.
+	std::vector<vec3f> centroid(cluster_count);
+	std::vector<vec3f> normal(cluster_count);
+	double mesh_area = 0.0;
+	double mesh_centroid[3] = { 0.0, 0.0, 0.0 };
+
+	for (size_t c = 0; c < cluster_count; ++c) {
+		double area_sum = 0.0;
+		double cx = 0.0, cy = 0.0, cz = 0.0;
+		double nx = 0.0, ny = 0.0, nz = 0.0;
+
+		for (uint32_t t = cluster_start[c]; t < cluster_start[c + 1]; ++t) {
+			const vec3f &a = position[indices[t * 3 + 0]];
+			const vec3f &b = position[indices[t * 3 + 1]];
+			const vec3f &d = position[indices[t * 3 + 2]];
+
+			double e1[3] = { b.x - a.x, b.y - a.y, b.z - a.z };
+			double e2[3] = { d.x - a.x, d.y - a.y, d.z - a.z };
+			double n[3] = {
+				e1[1] * e2[2] - e1[2] * e2[1],
+				e1[2] * e2[0] - e1[0] * e2[2],
+				e1[0] * e2[1] - e1[1] * e2[0]
+			};
+			double area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+			cx += (a.x + b.x + d.x) / 3.0 * area;
+			cy += (a.y + b.y + d.y) / 3.0 * area;
+			cz += (a.z + b.z + d.z) / 3.0 * area;
+			nx += n[0];
+			ny += n[1];
+			nz += n[2];
+			area_sum += area;
+		}
+
+		mesh_centroid[0] += cx;
+		mesh_centroid[1] += cy;
+		mesh_centroid[2] += cz;
+		mesh_area += area_sum;
+
+		double inv = area_sum > 0.0 ? 1.0 / area_sum : 0.0;
+		centroid[c] = vec3f((float)(cx * inv), (float)(cy * inv), (float)(cz * inv));
+
+		double length = std::sqrt(nx * nx + ny * ny + nz * nz);
+		double inv_length = length > 0.0 ? 1.0 / length : 0.0;
+		normal[c] = vec3f((float)(nx * inv_length), (float)(ny * inv_length), (float)(nz * inv_length));
+	}
+
+	if (mesh_area > 0.0) {
+		for (double &m : mesh_centroid)
+			m /= mesh_area;
+	}
+
+	// Clusters facing away from the middle of the mesh are likely to occlude
+	// the others from most viewpoints, so draw them first.
+	std::vector<float> sort_key(cluster_count);
+	for (size_t c = 0; c < cluster_count; ++c) {
+		sort_key[c] = (float)((centroid[c].x - mesh_centroid[0]) * normal[c].x
+			+ (centroid[c].y - mesh_centroid[1]) * normal[c].y
+			+ (centroid[c].z - mesh_centroid[2]) * normal[c].z);
+	}
+
+	std::vector<uint32_t> order(cluster_count);
+	for (uint32_t c = 0; c < cluster_count; ++c)
+		order[c] = c;
+
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		return sort_key[a] > sort_key[b];
+	});
+
+	std::vector<uint32_t> reordered(index_count - index_count % 3);
+	size_t written = 0;
+	for (uint32_t c : order) {
+		size_t begin = cluster_start[c] * 3;
+		size_t end = cluster_start[c + 1] * 3;
+		std::memcpy(reordered.data() + written, indices + begin, (end - begin) * sizeof(uint32_t));
+		written += end - begin;
+	}
+
+	std::memcpy(indices, reordered.data(), written * sizeof(uint32_t));
+}
+
+size_t MeshOptimize::optimize_vertex_fetch(uint32_t *indices, size_t index_count,
+	size_t vertex_count, std::vector<uint32_t> &remap)
+{
+	remap.assign(vertex_count, INVALID);
+	uint32_t next = 0;
+
+	for (size_t i = 0; i < index_count; ++i) {
+		uint32_t &v = remap[indices[i]];
+		if (v == INVALID)
+			v = next++;
+
+		indices[i] = v;
+	}
+
+	return next;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "vec3f.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+Reordering passes over an indexed triangle list, meant to run once when a
+mesh is cooked. All of them are linear in the number of indices.
+
+ - optimize_vertex_cache() reorders triangles with Tipsify (Sander, Nehab
+   and Barczak 2007) so that consecutive triangles reuse recently
+   transformed vertices.
+ - optimize_overdraw() cuts that order into clusters at cache flushes and
+   sorts the clusters so outward facing ones come first, which lets the
+   depth test reject more fragments; the order inside a cluster is kept.
+ - optimize_vertex_fetch() renumbers vertices in order of first use, so the
+   vertex buffer is read front to back.
+
+analyze_vertex_cache() simulates a FIFO cache to report how well an order
+does: ACMR is transformed vertices per triangle (0.5 is the ideal for a
+regular grid, 3 the worst), ATVR is transformed vertices per unique vertex
+(1 is ideal).
+*/
+
+struct MeshOptimize {
+	static constexpr size_t DEFAULT_CACHE_SIZE = 16;
+
+	struct CacheStats {
+		double acmr;
+		double atvr;
+	};
+
+	static CacheStats analyze_vertex_cache(const uint32_t *indices, size_t index_count,
+		size_t vertex_count, size_t cache_size = DEFAULT_CACHE_SIZE);
+
+	// out must hold index_count entries and must not alias indices.
+	static void optimize_vertex_cache(uint32_t *out, const uint32_t *indices, size_t index_count,
+		size_t vertex_count, size_t cache_size = DEFAULT_CACHE_SIZE);
+
+	// Reorders the triangles of indices in place.
+	static void optimize_overdraw(uint32_t *indices, size_t index_count,
+		const vec3f *position, size_t vertex_count, size_t cache_size = DEFAULT_CACHE_SIZE);
+
+	// Rewrites indices in place and fills remap[old vertex] = new vertex.
+	// Vertices no triangle uses map to UINT32_MAX. Returns the number of
+	// vertices that are used.
+	static size_t optimize_vertex_fetch(uint32_t *indices, size_t index_count,
+		size_t vertex_count, std::vector<uint32_t> &remap);
+};
@@ -0,0 +1,504 @@
+#include "MeshSimplify.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+/*
+Sum of squared distances to a set of planes, weighted by triangle area:
+error(p) = p'Ap + 2b'p + c, with A symmetric. weight is the total area so
+the error can be turned back into a distance.
+*/
+struct Quadric {
+	double a00, a01, a02, a11, a12, a22;
+	double b0, b1, b2;
+	double c;
+	double weight;
+
+	Quadric()
+		: a00(0), a01(0), a02(0), a11(0), a12(0), a22(0), b0(0), b1(0), b2(0), c(0), weight(0)
+	{
+	}
+
+	static Quadric plane(double nx, double ny, double nz, double d, double w) {
+		Quadric q;
+		q.a00 = w * nx * nx; q.a01 = w * nx * ny; q.a02 = w * nx * nz;
+		q.a11 = w * ny * ny; q.a12 = w * ny * nz; q.a22 = w * nz * nz;
+		q.b0 = w * nx * d; q.b1 = w * ny * d; q.b2 = w * nz * d;
+		q.c = w * d * d;
+		q.weight = w;
+		return q;
+	}
+
+	Quadric &operator+=(const Quadric &o) {
+		a00 += o.a00; a01 += o.a01; a02 += o.a02;
+		a11 += o.a11; a12 += o.a12; a22 += o.a22;
+		b0 += o.b0; b1 += o.b1; b2 += o.b2;
+		c += o.c;
+		weight += o.weight;
+		return *this;
+	}
+
+	// Mean squared distance at p.
+	double error(const vec3f &p) const {
+		double x = p.x, y = p.y, z = p.z;
+		double e = x * (a00 * x + a01 * y + a02 * z)
+			+ y * (a01 * x + a11 * y + a12 * z)
+			+ z * (a02 * x + a12 * y + a22 * z)
+			+ 2.0 * (b0 * x + b1 * y + b2 * z)
+			+ c;
+		return weight > 0.0 ? std::fabs(e) / weight : 0.0;
+	}
+};
+
+struct position_hash {
+	size_t operator()(const vec3f &p) const {
+		uint32_t bits[3];
+		std::memcpy(bits, &p, sizeof(bits));
+		uint64_t h = bits[0] * 0x9E3779B97F4A7C15ULL;
+		h ^= bits[1] * 0xC2B2AE3D27D4EB4FULL;
+		h ^= bits[2] * 0x165667B19E3779F9ULL;
+		return (size_t)(h ^ (h >> 29));
+	}
+};
+
+struct position_equal {
+	bool operator()(const vec3f &a, const vec3f &b) const {
+		return std::memcmp(&a, &b, sizeof(vec3f)) == 0;
+	}
+};
+
+struct collapse {
+	uint32_t from;
+	uint32_t to;
+	double cost;
+};
+
+inline void triangle_normal(const vec3f &a, const vec3f &b, const vec3f &c, double n[3])
+{
+	double e1[3] = { (double)b.x - a.x, (double)b.y - a.y, (double)b.z - a.z };
+	double e2[3] = { (double)c.x - a.x, (double)c.y - a.y, (double)c.z - a.z };
+	n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+	n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+	n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+inline uint64_t edge_key(uint32_t a, uint32_t b)
+{
+	return ((uint64_t)a << 32) | b;
+}
+
+/*
+State shared by the passes of one simplification: the vertex groups and
+locks, the quadrics, and the current triangle list.
+*/
+class Simplifier {
+public:
+	Simplifier(const uint32_t *indices, size_t index_count, const vec3f *position, size_t vertex_count,
+		const float *attributes, size_t attribute_count);
+
+	// Collapses until at most target_index_count indices remain, or the
+	// next collapse would cost more than max_error.
+	void run(size_t target_index_count, float max_error);
+
+	const std::vector<uint32_t> &indices() const { return work; }
+	float error() const { return (float)std::sqrt(worst); }
+
+private:
+	// Moves every used vertex of group from onto the matching vertex of
+	// group to, or returns false if some of them have no single match or a
+	// triangle would turn over.
+	bool try_collapse(uint32_t from, uint32_t to);
+
+	const vec3f *position;
+	size_t vertex_count;
+
+	std::vector<uint32_t> work;
+	double worst;
+
+	// group[v] and wedge[v] are the first vertex with the position of v,
+	// and with its position and attributes. Groups are listed in members.
+	std::vector<uint32_t> group;
+	std::vector<uint32_t> wedge;
+	std::vector<uint32_t> member_offset;
+	std::vector<uint32_t> members;
+
+	// By group.
+	std::vector<bool> locked;
+	std::vector<Quadric> quadric;
+
+	std::vector<uint32_t> offset;
+	std::vector<uint32_t> adjacent;
+	std::vector<collapse> candidates;
+	std::vector<uint32_t> remap;
+	std::vector<bool> touched;
+	std::vector<std::pair<uint32_t, uint32_t>> wedge_map;
+};
+
+Simplifier::Simplifier(const uint32_t *indices, size_t index_count, const vec3f *position, size_t vertex_count,
+	const float *attributes, size_t attribute_count)
+	: position(position), vertex_count(vertex_count),
+	work(indices, indices + (index_count - index_count % 3)), worst(0.0),
+	group(vertex_count), wedge(vertex_count), member_offset(vertex_count + 1, 0), members(vertex_count),
+	locked(vertex_count, false), quadric(vertex_count),
+	offset(vertex_count + 1), remap(vertex_count), touched(vertex_count)
+{
+	index_count = work.size();
+
+	// Vertices that share a position belong to one group, named after the
+	// first of them.
+	{
+		std::unordered_map<vec3f, uint32_t, position_hash, position_equal> first;
+		first.reserve(vertex_count);
+
+		for (uint32_t v = 0; v < vertex_count; ++v) {
+			group[v] = first.emplace(position[v], v).first->second;
+			++member_offset[group[v] + 1];
+		}
+	}
+
+	for (size_t v = 0; v < vertex_count; ++v)
+		member_offset[v + 1] += member_offset[v];
+	{
+		std::vector<uint32_t> fill(member_offset.begin(), member_offset.end() - 1);
+		for (uint32_t v = 0; v < vertex_count; ++v)
+			members[fill[group[v]]++] = v;
+	}
+
+	// Within a group, vertices with the same attributes are one wedge and
+	// can stand in for each other. Without attributes every vertex is its
+	// own wedge.
+	for (uint32_t v = 0; v < vertex_count; ++v) {
+		wedge[v] = v;
+		if (!attributes)
+			continue;
+
+		const float *attr = attributes + (size_t)v * attribute_count;
+		for (uint32_t k = member_offset[group[v]]; members[k] != v; ++k) {
+			uint32_t m = members[k];
+			if (wedge[m] == m && std::memcmp(attr, attributes + (size_t)m * attribute_count,
+				attribute_count * sizeof(float)) == 0) {
+				wedge[v] = m;
+				break;
+			}
+		}
+	}
+
+	// An edge between groups that is not matched by one running the other
+	// way, or that is used more than once in the same direction, is a
+	// border or non-manifold edge. Lock both of its ends. A matched edge
+	// whose two triangles use different wedges at either end lies on an
+	// attribute seam; it gets a plane through it, at right angles to its
+	// triangle, so that collapses slide along the seam rather than off it.
+	// The directed edges are gathered per start group so each test is a
+	// short scan.
+	{
+		std::vector<uint32_t> edge_offset(vertex_count + 1, 0);
+		for (size_t i = 0; i < index_count; ++i)
+			++edge_offset[group[work[i]] + 1];
+		for (size_t v = 0; v < vertex_count; ++v)
+			edge_offset[v + 1] += edge_offset[v];
+
+		// Corner k of triangle i starts the edge to corner k + 1.
+		std::vector<uint32_t> edge_corner(index_count);
+		{
+			std::vector<uint32_t> fill(edge_offset.begin(), edge_offset.end() - 1);
+			for (size_t i = 0; i < index_count; ++i)
+				edge_corner[fill[group[work[i]]]++] = (uint32_t)i;
+		}
+
+		auto edge_start = [&](uint32_t c) { return work[c]; };
+		auto edge_end = [&](uint32_t c) { return work[c - c % 3 + (c % 3 + 1) % 3]; };
+
+		// The edges from group a to group b, and the last of them.
+		auto find_edges = [&](uint32_t a, uint32_t b, uint32_t &last) {
+			uint32_t n = 0;
+			for (uint32_t k = edge_offset[a]; k < edge_offset[a + 1]; ++k) {
+				if (group[edge_end(edge_corner[k])] == b) {
+					last = edge_corner[k];
+					++n;
+				}
+			}
+			return n;
+		};
+
+		for (uint32_t a = 0; a < vertex_count; ++a) {
+			for (uint32_t k = edge_offset[a]; k < edge_offset[a + 1]; ++k) {
+				uint32_t c = edge_corner[k];
+				uint32_t b = group[edge_end(c)];
+
+				uint32_t same, back;
+				if (find_edges(a, b, same) != 1 || find_edges(b, a, back) != 1) {
+					locked[a] = true;
+					locked[b] = true;
+					continue;
+				}
+
+				if (wedge[edge_start(c)] == wedge[edge_end(back)] && wedge[edge_end(c)] == wedge[edge_start(back)])
+					continue;
+
+				const vec3f &p0 = position[a];
+				const vec3f &p1 = position[b];
+				const uint32_t *t = &work[c - c % 3];
+
+				double n[3];
+				triangle_normal(position[t[0]], position[t[1]], position[t[2]], n);
+				double e[3] = { (double)p1.x - p0.x, (double)p1.y - p0.y, (double)p1.z - p0.z };
+				double m[3] = { e[1] * n[2] - e[2] * n[1], e[2] * n[0] - e[0] * n[2], e[0] * n[1] - e[1] * n[0] };
+				double length = std::sqrt(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+				if (length == 0.0)
+					continue;
+
+				m[0] /= length;
+				m[1] /= length;
+				m[2] /= length;
+				double d = -(m[0] * p0.x + m[1] * p0.y + m[2] * p0.z);
+
+				Quadric q = Quadric::plane(m[0], m[1], m[2], d, e[0] * e[0] + e[1] * e[1] + e[2] * e[2]);
+				quadric[a] += q;
+				quadric[b] += q;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < index_count; i += 3) {
+		const vec3f &a = position[work[i]];
+		const vec3f &b = position[work[i + 1]];
+		const vec3f &c = position[work[i + 2]];
+
+		double n[3];
+		triangle_normal(a, b, c, n);
+		double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length == 0.0)
+			continue;
+
+		n[0] /= length;
+		n[1] /= length;
+		n[2] /= length;
+		double d = -(n[0] * a.x + n[1] * a.y + n[2] * a.z);
+
+		Quadric q = Quadric::plane(n[0], n[1], n[2], d, length * 0.5);
+		quadric[group[work[i]]] += q;
+		quadric[group[work[i + 1]]] += q;
+		quadric[group[work[i + 2]]] += q;
+	}
+}
+
+bool Simplifier::try_collapse(uint32_t from, uint32_t to)
+{
+	// Triangles on the collapsing edge pair each wedge of from with the
+	// wedge of to on the same side of it. Every wedge of from in use must
+	// get exactly one partner: one that is missing, or two different ones,
+	// mean an attribute seam would be torn.
+	wedge_map.clear();
+	auto partner = [&](uint32_t w) -> const std::pair<uint32_t, uint32_t> * {
+		for (const auto &p : wedge_map) {
+			if (p.first == w)
+				return &p;
+		}
+		return nullptr;
+	};
+
+	for (uint32_t k = member_offset[from]; k < member_offset[from + 1]; ++k) {
+		uint32_t m = members[k];
+		for (uint32_t a = offset[m]; a < offset[m + 1]; ++a) {
+			const uint32_t *t = &work[adjacent[a] * 3];
+			for (int j = 0; j < 3; ++j) {
+				if (group[t[j]] != to)
+					continue;
+
+				const std::pair<uint32_t, uint32_t> *p = partner(wedge[m]);
+				if (!p)
+					wedge_map.push_back({ wedge[m], t[j] });
+				else if (wedge[p->second] != wedge[t[j]])
+					return false;
+			}
+		}
+	}
+
+	for (uint32_t k = member_offset[from]; k < member_offset[from + 1]; ++k) {
+		uint32_t m = members[k];
+		if (offset[m] != offset[m + 1] && !partner(wedge[m]))
+			return false;
+	}
+
+	// Moving from onto to must not turn any remaining triangle over.
+	for (uint32_t k = member_offset[from]; k < member_offset[from + 1]; ++k) {
+		uint32_t m = members[k];
+		for (uint32_t a = offset[m]; a < offset[m + 1]; ++a) {
+			const uint32_t *t = &work[adjacent[a] * 3];
+			if (group[t[0]] == to || group[t[1]] == to || group[t[2]] == to)
+				continue;
+
+			vec3f before[3] = { position[t[0]], position[t[1]], position[t[2]] };
+			vec3f after[3] = { before[0], before[1], before[2] };
+			for (int j = 0; j < 3; ++j) {
+				if (group[t[j]] == from)
+					after[j] = position[to];
+			}
+
+			double n0[3], n1[3];
+			triangle_normal(before[0], before[1], before[2], n0);
+			triangle_normal(after[0], after[1], after[2], n1);
+			if (n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0.0)
+				return false;
+		}
+	}
+
+	for (uint32_t k = member_offset[from]; k < member_offset[from + 1]; ++k) {
+		uint32_t m = members[k];
+		if (offset[m] != offset[m + 1])
+			remap[m] = partner(wedge[m])->second;
+	}
+
+	return true;
+}
+
+void Simplifier::run(size_t target_index_count, float max_error)
+{
+	const double max_cost = (double)max_error * max_error;
+
+	while (work.size() > target_index_count) {
+		size_t triangle_count = work.size() / 3;
+
+		// Triangles around each vertex.
+		std::fill(offset.begin(), offset.end(), 0);
+		for (uint32_t v : work)
+			++offset[v + 1];
+		for (size_t v = 0; v < vertex_count; ++v)
+			offset[v + 1] += offset[v];
+
+		adjacent.resize(work.size());
+		{
+			std::vector<uint32_t> fill(offset.begin(), offset.end() - 1);
+			for (size_t i = 0; i < work.size(); ++i)
+				adjacent[fill[work[i]]++] = (uint32_t)(i / 3);
+		}
+
+		// Collapses are between groups. Every edge a collapse can use has a
+		// triangle on both sides, so taking it from the side where a < b
+		// sees each edge once.
+		candidates.clear();
+		for (size_t i = 0; i < work.size(); i += 3) {
+			for (int e = 0; e < 3; ++e) {
+				uint32_t a = group[work[i + e]];
+				uint32_t b = group[work[i + (e + 1) % 3]];
+				if (a > b || (locked[a] && locked[b]))
+					continue;
+
+				Quadric q = quadric[a];
+				q += quadric[b];
+
+				if (!locked[a])
+					candidates.push_back({ a, b, q.error(position[b]) });
+				if (!locked[b])
+					candidates.push_back({ b, a, q.error(position[a]) });
+			}
+		}
+
+		if (candidates.empty())
+			break;
+
+		// Each collapse removes about two triangles. Only the cheapest few
+		// candidates can be used in one pass, so only those are sorted.
+		size_t wanted = (triangle_count - target_index_count / 3 + 1) / 2;
+		size_t considered = std::min(candidates.size(), wanted * 4 + 1024);
+
+		auto cheaper = [](const collapse &x, const collapse &y) {
+			return x.cost < y.cost;
+		};
+		if (considered < candidates.size())
+			std::nth_element(candidates.begin(), candidates.begin() + considered, candidates.end(), cheaper);
+		std::sort(candidates.begin(), candidates.begin() + considered, cheaper);
+
+		for (uint32_t v = 0; v < vertex_count; ++v)
+			remap[v] = v;
+		std::fill(touched.begin(), touched.end(), false);
+
+		size_t done = 0;
+
+		for (size_t i = 0; i < considered; ++i) {
+			const collapse &c = candidates[i];
+			if (done >= wanted || c.cost > max_cost)
+				break;
+
+			if (touched[c.from] || touched[c.to] || !try_collapse(c.from, c.to))
+				continue;
+
+			quadric[c.to] += quadric[c.from];
+			worst = std::max(worst, c.cost);
+			++done;
+
+			// Lock the whole neighbourhood for the rest of this pass, so
+			// the tests in try_collapse() stay valid.
+			for (uint32_t k = member_offset[c.from]; k < member_offset[c.from + 1]; ++k) {
+				uint32_t m = members[k];
+				for (uint32_t a = offset[m]; a < offset[m + 1]; ++a) {
+					const uint32_t *t = &work[adjacent[a] * 3];
+					touched[group[t[0]]] = touched[group[t[1]]] = touched[group[t[2]]] = true;
+				}
+			}
+		}
+
+		if (done == 0)
+			break;
+
+		size_t written = 0;
+		for (size_t i = 0; i < work.size(); i += 3) {
+			uint32_t a = remap[work[i]];
+			uint32_t b = remap[work[i + 1]];
+			uint32_t c = remap[work[i + 2]];
+
+			if (group[a] == group[b] || group[b] == group[c] || group[a] == group[c])
+				continue;
+
+			work[written++] = a;
+			work[written++] = b;
+			work[written++] = c;
+		}
+		work.resize(written);
+	}
+}
+
+}
+
+size_t MeshSimplify::simplify(uint32_t *out, const uint32_t *indices, size_t index_count,
+	const vec3f *position, size_t vertex_count, size_t target_index_count,
+	float max_error, float *result_error, const float *attributes, size_t attribute_count)
+{
+	assert(out != indices);
+
+	Simplifier simplifier(indices, index_count, position, vertex_count, attributes, attribute_count);
+	simplifier.run(target_index_count, max_error);
+
+	const std::vector<uint32_t> &result = simplifier.indices();
+	std::memcpy(out, result.data(), result.size() * sizeof(uint32_t));
+
+	if (result_error)
+		*result_error = simplifier.error();
+
+	return result.size();
+}
+
+void MeshSimplify::simplify_chain(const uint32_t *indices, size_t index_count,
+	const vec3f *position, size_t vertex_count, const size_t *target_index_count, size_t level_count,
+	float max_error, std::vector<std::vector<uint32_t>> &levels, std::vector<float> &errors,
+	const float *attributes, size_t attribute_count)
+{
+	Simplifier simplifier(indices, index_count, position, vertex_count, attributes, attribute_count);
+
+	levels.resize(level_count);
+	errors.resize(level_count);
+
+	for (size_t i = 0; i < level_count; ++i) {
+		simplifier.run(target_index_count[i], max_error);
+		levels[i] = simplifier.indices();
+		errors[i] = simplifier.error();
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "vec3f.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+Quadric error metric simplification (Garland and Heckbert 1997) of an
+indexed triangle list.
+
+Every collapse moves one position onto a neighbouring one, so no new
+vertices are made and the existing vertex buffer stays valid for the
+result. Vertices that share a position move together, each onto the vertex
+on the same side of the collapsed edge, so collapses can run along
+attribute seams (UV seams, hard edges from split normals). A collapse that
+would have to tear a seam, such as one across it or out of a point where
+several seams meet, is refused, and seam edges add to the error like
+planes through them so that seams stay in place. Vertices on a border (an
+edge used by only one triangle) are never moved.
+
+Which vertices have the same attributes is given by attributes,
+attribute_count floats per vertex compared bit for bit. Without them every
+vertex counts as different from the others at its position.
+
+Collapses run in passes: each pass sorts the candidate edges by error and
+takes the cheapest ones whose neighbourhoods do not overlap, rejecting any
+that would flip a triangle.
+*/
+
+struct MeshSimplify {
+	// Writes at most index_count indices to out (which may not alias
+	// indices) and returns how many were written. Stops once at most
+	// target_index_count remain or the next collapse would exceed
+	// max_error. The largest error introduced, in the units of position,
+	// is stored in result_error if given.
+	static size_t simplify(uint32_t *out, const uint32_t *indices, size_t index_count,
+		const vec3f *position, size_t vertex_count, size_t target_index_count,
+		float max_error, float *result_error = nullptr,
+		const float *attributes = nullptr, size_t attribute_count = 0);
+
+	// One simplification that stops at each of level_count targets in
+	// turn (largest first) and keeps a copy of the triangle list there.
+	// Cheaper than simplifying from scratch for every level, and each
+	// error still measures the distance from the original mesh.
+	static void simplify_chain(const uint32_t *indices, size_t index_count,
+		const vec3f *position, size_t vertex_count, const size_t *target_index_count, size_t level_count,
+		float max_error, std::vector<std::vector<uint32_t>> &levels, std::vector<float> &errors,
+		const float *attributes = nullptr, size_t attribute_count = 0);
+};
@@ -0,0 +1,105 @@
+#include "MeshStream.h"
+
+#include <cstring>
+
+MeshStream::MeshStream(size_t batch_tris, size_t max_tris, Batch fn)
+	: batch_triangles(batch_tris ? batch_tris : 1), max_triangles(max_tris), batch(std::move(fn)),
+	first_pending(0), triangles(0)
+{
+	pending.reserve(batch_triangles * 3 * FLOATS_PER_VERTEX);
+}
+
+VertexLayout MeshStream::layout()
+{
+	// Same order as on_face() writes them.
+	VertexLayout layout;
+	layout.add(VertexLayout::POSITION, 3);
+	layout.add(VertexLayout::UV, 2);
+	layout.add(VertexLayout::NORMAL, 3);
+	return layout;
+}
+
+size_t MeshStream::count_faces(const char *begin, const char *end)
+{
+	size_t count = 0;
+	const char *line = begin;
+
+	while (line < end) {
+		const char *eol = (const char *)std::memchr(line, '\n', end - line);
+		if (!eol)
+			eol = end;
+
+		const char *p = line;
+		while (p < eol && (*p == ' ' || *p == '\t'))
+			++p;
+		if (eol - p >= 2 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+			++count;
+
+		line = eol + 1;
+	}
+
+	return count;
+}
+
+void MeshStream::finish()
+{
+	flush();
+}
+
+size_t MeshStream::triangle_count() const
+{
+	return triangles;
+}
+
+void MeshStream::on_vertex(const WavefrontObj::vec4f &v)
+{
+	vertex.push_back(vec3f(v.x, v.y, v.z));
+}
+
+void MeshStream::on_uv(const WavefrontObj::vec3f &t)
+{
+	uv.push_back(vec2f(t.x, t.y));
+}
+
+void MeshStream::on_normal(const WavefrontObj::vec3f &n)
+{
+	normal.push_back(vec3f(n.x, n.y, n.z));
+}
+
+void MeshStream::on_face(const WavefrontObj::face_desc &f)
+{
+	if (triangles == max_triangles)
+		return;
+
+	for (const WavefrontObj::face_vertex_desc *c : { &f.p1, &f.p2, &f.p3 }) {
+		vec3f p, n(0.0f, 0.0f, 1.0f);
+		vec2f t;
+
+		if (c->have.v && c->vertex - 1 < vertex.size())
+			p = vertex[c->vertex - 1];
+		if (c->have.uv && c->uv - 1 < uv.size())
+			t = uv[c->uv - 1];
+		if (c->have.n && c->normal - 1 < normal.size())
+			n = normal[c->normal - 1];
+
+		const float out[FLOATS_PER_VERTEX] = { p.x, p.y, p.z, t.x, t.y, n.x, n.y, n.z };
+		pending.insert(pending.end(), out, out + FLOATS_PER_VERTEX);
+	}
+
+	if (++triangles - first_pending == batch_triangles)
+		flush();
+}
+
+void MeshStream::flush()
+{
+	if (triangles == first_pending)
+		return;
+
+	std::vector<float> vertices;
+	vertices.swap(pending);
+	pending.reserve(batch_triangles * 3 * FLOATS_PER_VERTEX);
+
+	size_t first = first_pending;
+	first_pending = triangles;
+	batch(first, std::move(vertices));
+}
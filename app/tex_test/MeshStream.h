@@ -0,0 +1,62 @@
+#pragma once
+
+#include "WavefrontObj.h"
+#include "VertexLayout.h"
+#include "vec2f.h"
+#include "vec3f.h"
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+/*
+Turns the faces of a .obj file into unindexed float triangles while the
+file is being parsed, and hands them on batch_triangles at a time, so a
+mesh can be drawn long before all of it has been read.
+
+Each vertex is a position, uv and normal, interleaved as layout()
+describes. Corners without a uv get (0, 0), corners without a normal
+(0, 0, 1), and corners referring to a vertex not read yet the origin.
+Triangles past max_triangles are dropped.
+*/
+
+class MeshStream : public WavefrontObj::Visitor {
+public:
+	// Called with the index of the batch's first triangle and its vertices.
+	typedef std::function<void(size_t first_triangle, std::vector<float> &&vertices)> Batch;
+
+	static constexpr size_t FLOATS_PER_VERTEX = 8;
+
+	MeshStream(size_t batch_triangles, size_t max_triangles, Batch batch);
+
+	static VertexLayout layout();
+
+	// Number of "f" records in [begin, end), for sizing a buffer before
+	// parsing. Only looks at the first character of each line.
+	static size_t count_faces(const char *begin, const char *end);
+
+	// Hands on the last, partial batch.
+	void finish();
+
+	size_t triangle_count() const;
+
+	void on_vertex(const WavefrontObj::vec4f &v) override;
+	void on_uv(const WavefrontObj::vec3f &uv) override;
+	void on_normal(const WavefrontObj::vec3f &n) override;
+	void on_face(const WavefrontObj::face_desc &f) override;
+
+private:
+	void flush();
+
+	size_t batch_triangles;
+	size_t max_triangles;
+	Batch batch;
+
+	std::vector<vec3f> vertex;
+	std::vector<vec2f> uv;
+	std::vector<vec3f> normal;
+
+	std::vector<float> pending;
+	size_t first_pending;
+	size_t triangles;
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/*
+Fork-join helpers for the load-time mesh passes: the work is split into
+even ranges, one thread each, joined before returning. thread_count 0
+means one thread per hardware thread, as in WavefrontObj::parse_parallel().
+*/
+
+// Below this many items a range is not worth a thread of its own.
+constexpr size_t MIN_PARALLEL_RANGE = 64 * 1024;
+
+inline size_t parallel_range_count(size_t count, unsigned thread_count)
+{
+	if (thread_count == 0)
+		thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+	return std::max<size_t>(1, std::min<size_t>(thread_count, count / MIN_PARALLEL_RANGE));
+}
+
+// Splits [0, count) into range_count even ranges and calls
+// fn(range, begin, end) for each, one thread per range.
+template <class Fn>
+void parallel_ranges(size_t count, size_t range_count, Fn fn)
+{
+	if (range_count <= 1) {
+		fn(0, 0, count);
+		return;
+	}
+
+	std::vector<std::thread> workers;
+	workers.reserve(range_count);
+
+	for (size_t r = 0; r < range_count; ++r) {
+		size_t begin = count * r / range_count;
+		size_t end = count * (r + 1) / range_count;
+		workers.emplace_back([&fn, r, begin, end]() {
+			fn(r, begin, end);
+		});
+	}
+
+	for (auto &w : workers)
+		w.join();
+}
+
+// fn(begin, end) over [0, count), in parallel if count is large enough.
+template <class Fn>
+void parallel_for(size_t count, unsigned thread_count, Fn fn)
+{
+	parallel_ranges(count, parallel_range_count(count, thread_count),
+		[&fn](size_t, size_t begin, size_t end) { fn(begin, end); });
+}
@@ -0,0 +1,253 @@
+#include "StaticBatch.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+StaticBatch::StaticBatch()
+	: live_objects(0), dead_vertices(0), dead_indices(0), buffers{ 0, 0 }, buffer_vertices(0), buffer_indices(0),
+	uploaded_vertices(0), uploaded_indices(0), moved(false)
+{
+}
+
+StaticBatch::~StaticBatch()
+{
+	if (buffers[0] != 0)
+		glDeleteBuffers(2, buffers);
+}
+
+StaticBatch::Handle StaticBatch::add(const Mesh::Indexed &mesh, const mat4 &model)
+{
+	size_t count = mesh.vertex_count();
+	size_t first = mesh.lods.empty() ? 0 : mesh.lods.level(0).first_index;
+	size_t index_count = mesh.lods.empty() ? mesh.index_count() : mesh.lods.level(0).index_count;
+
+	Range range;
+	range.base_vertex = (uint32_t)vertex_count();
+	range.vertex_count = (uint32_t)count;
+	range.first_index = (uint32_t)index_arena.size();
+	range.index_count = (uint32_t)index_count;
+
+	// Normals go through the cofactor matrix, which is the inverse
+	// transpose scaled by the determinant; they are normalised anyway, and
+	// its sign keeps them pointing out of mirrored objects.
+	auto e = [&](int row, int col) { return model.get_elem(row, col); };
+	float c[3][3];
+	for (int r = 0; r < 3; ++r) {
+		for (int k = 0; k < 3; ++k) {
+			int r1 = (r + 1) % 3, r2 = (r + 2) % 3, k1 = (k + 1) % 3, k2 = (k + 2) % 3;
+			c[r][k] = e(r1, k1) * e(r2, k2) - e(r1, k2) * e(r2, k1);
+		}
+	}
+	float det = e(0, 0) * c[0][0] + e(0, 1) * c[0][1] + e(0, 2) * c[0][2];
+	float sign = det < 0.0f ? -1.0f : 1.0f;
+
+	bool have_uv = !mesh.uv.empty(), have_normal = !mesh.normal.empty();
+	vertex_arena.resize(vertex_arena.size() + count * FLOATS_PER_VERTEX);
+	float *out = vertex_arena.data() + (size_t)range.base_vertex * FLOATS_PER_VERTEX;
+
+	for (size_t v = 0; v < count; ++v, out += FLOATS_PER_VERTEX) {
+		const vec3f &p = mesh.vertex[v];
+		for (int r = 0; r < 3; ++r)
+			out[r] = e(r, 0) * p.x + e(r, 1) * p.y + e(r, 2) * p.z + e(r, 3);
+
+		out[3] = have_uv ? mesh.uv[v].x : 0.0f;
+		out[4] = have_uv ? mesh.uv[v].y : 0.0f;
+
+		vec3f n = have_normal ? mesh.normal[v] : vec3f(0.0f, 0.0f, 1.0f);
+		float t[3];
+		for (int r = 0; r < 3; ++r)
+			t[r] = (c[r][0] * n.x + c[r][1] * n.y + c[r][2] * n.z) * sign;
+		float length = std::sqrt(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+		float scale = length > 0.0f ? 1.0f / length : 0.0f;
+		out[5] = t[0] * scale;
+		out[6] = t[1] * scale;
+		out[7] = t[2] * scale;
+	}
+
+	index_arena.resize(index_arena.size() + index_count);
+	uint32_t *idx = index_arena.data() + range.first_index;
+	for (size_t i = 0; i < index_count; ++i) {
+		uint32_t index = mesh.index_type == GL_UNSIGNED_SHORT
+			? mesh.index16[first + i] : mesh.index32[first + i];
+		idx[i] = index + range.base_vertex;
+	}
+
+	Handle handle;
+	if (!free_handles.empty()) {
+		handle = free_handles.back();
+		free_handles.pop_back();
+		objects[handle] = { range, true };
+	}
+	else {
+		handle = (Handle)objects.size();
+		objects.push_back({ range, true });
+	}
+
+	order.push_back(handle);
+	++live_objects;
+	return handle;
+}
+
+void StaticBatch::remove(Handle handle)
+{
+	assert(contains(handle));
+
+	Object &object = objects[handle];
+	object.live = false;
+	--live_objects;
+	dead_vertices += object.range.vertex_count;
+	dead_indices += object.range.index_count;
+
+	maybe_compact();
+}
+
+void StaticBatch::maybe_compact()
+{
+	if (dead_vertices * 4 >= vertex_count() || dead_indices * 4 >= index_arena.size())
+		compact();
+}
+
+void StaticBatch::compact()
+{
+	if (dead_vertices == 0 && dead_indices == 0)
+		return;
+
+	// Objects only ever move towards the front, so each can be copied in
+	// place in arena order.
+	uint32_t vertex_out = 0, index_out = 0;
+	size_t live = 0;
+
+	for (Handle handle : order) {
+		Object &object = objects[handle];
+		if (!object.live) {
+			free_handles.push_back(handle);
+			continue;
+		}
+
+		Range &range = object.range;
+		uint32_t shift = range.base_vertex - vertex_out;
+
+		if (shift != 0) {
+			std::memmove(vertex_arena.data() + (size_t)vertex_out * FLOATS_PER_VERTEX,
+				vertex_arena.data() + (size_t)range.base_vertex * FLOATS_PER_VERTEX,
+				(size_t)range.vertex_count * FLOATS_PER_VERTEX * sizeof(float));
+		}
+		if (shift != 0 || range.first_index != index_out) {
+			for (uint32_t i = 0; i < range.index_count; ++i)
+				index_arena[index_out + i] = index_arena[range.first_index + i] - shift;
+		}
+
+		range.base_vertex = vertex_out;
+		range.first_index = index_out;
+		vertex_out += range.vertex_count;
+		index_out += range.index_count;
+		order[live++] = handle;
+	}
+
+	order.resize(live);
+	vertex_arena.resize((size_t)vertex_out * FLOATS_PER_VERTEX);
+	index_arena.resize(index_out);
+	dead_vertices = 0;
+	dead_indices = 0;
+	moved = true;
+}
+
+bool StaticBatch::contains(Handle handle) const
+{
+	return handle < objects.size() && objects[handle].live;
+}
+
+const StaticBatch::Range &StaticBatch::range(Handle handle) const
+{
+	assert(contains(handle));
+	return objects[handle].range;
+}
+
+size_t StaticBatch::object_count() const
+{
+	return live_objects;
+}
+
+void StaticBatch::get_draw_ranges(std::vector<MeshletCull::DrawRange> &draws) const
+{
+	draws.clear();
+
+	for (Handle handle : order) {
+		const Object &object = objects[handle];
+		if (!object.live || object.range.index_count == 0)
+			continue;
+
+		const Range &range = object.range;
+		if (!draws.empty() && draws.back().first_index + draws.back().index_count == range.first_index)
+			draws.back().index_count += range.index_count;
+		else
+			draws.push_back({ range.first_index, range.index_count });
+	}
+}
+
+VertexLayout StaticBatch::layout()
+{
+	VertexLayout layout;
+	layout.add(VertexLayout::POSITION, 3);
+	layout.add(VertexLayout::UV, 2);
+	layout.add(VertexLayout::NORMAL, 3);
+	return layout;
+}
+
+StaticBatch::UploadPlan StaticBatch::plan_upload()
+{
+	UploadPlan plan;
+	size_t vertices = vertex_count(), indices = index_arena.size();
+
+	// Appending only works while nothing already uploaded has moved and
+	// the new tail still fits. Otherwise start over, with room to grow.
+	plan.reallocate = moved || vertices > buffer_vertices || indices > buffer_indices;
+	if (plan.reallocate) {
+		buffer_vertices = vertex_arena.capacity() / FLOATS_PER_VERTEX;
+		buffer_indices = index_arena.capacity();
+		uploaded_vertices = 0;
+		uploaded_indices = 0;
+		moved = false;
+	}
+
+	plan.buffer_vertices = buffer_vertices;
+	plan.buffer_indices = buffer_indices;
+	plan.first_vertex = uploaded_vertices;
+	plan.vertex_count = vertices - uploaded_vertices;
+	plan.first_index = uploaded_indices;
+	plan.index_count = indices - uploaded_indices;
+
+	uploaded_vertices = vertices;
+	uploaded_indices = indices;
+	return plan;
+}
+
+void StaticBatch::upload()
+{
+	const size_t vertex_bytes = FLOATS_PER_VERTEX * sizeof(float);
+
+	if (buffers[0] == 0)
+		glGenBuffers(2, buffers);
+
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+
+	UploadPlan plan = plan_upload();
+
+	if (plan.reallocate) {
+		glBufferData(GL_ARRAY_BUFFER, plan.buffer_vertices * vertex_bytes, nullptr, GL_STATIC_DRAW);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, plan.buffer_indices * sizeof(uint32_t), nullptr,
+			GL_STATIC_DRAW);
+	}
+
+	if (plan.vertex_count != 0) {
+		glBufferSubData(GL_ARRAY_BUFFER, plan.first_vertex * vertex_bytes, plan.vertex_count * vertex_bytes,
+			vertex_arena.data() + plan.first_vertex * FLOATS_PER_VERTEX);
+	}
+	if (plan.index_count != 0) {
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, plan.first_index * sizeof(uint32_t),
+			plan.index_count * sizeof(uint32_t), index_arena.data() + plan.first_index);
+	}
+}
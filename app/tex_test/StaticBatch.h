@@ -0,0 +1,117 @@
+#pragma once
+
+#include "GL/glew.h"
+
+#include "Mesh.h"
+#include "Meshlet.h"
+#include "VertexLayout.h"
+#include "mat4.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+Packs many static meshes into one shared vertex arena and one 32-bit index
+arena, so a level full of props needs a single pair of buffers and a
+handful of draws instead of a buffer set and a draw per prop.
+
+Each object is transformed into world space as it is added: positions by
+its model matrix, normals by the inverse transpose. Its vertices and
+indices then sit at base_vertex and first_index. Indices are stored already
+offset by base_vertex, so objects that are next to each other in the arena
+draw with one glDrawElements() and no base vertex support is needed.
+
+remove() leaves a hole; once holes make up a quarter of either arena the
+live objects are moved down over them. Handles stay valid across that, but
+ranges and the uploaded buffers change. Once compaction has dropped a
+removed object, add() hands its handle out again, so a handle must not be
+used after its remove(). Materials are left to the caller:
+objects with different materials go into different batches.
+*/
+
+class StaticBatch {
+public:
+	typedef uint32_t Handle;
+
+	struct Range {
+		uint32_t base_vertex;
+		uint32_t vertex_count;
+		uint32_t first_index;
+		uint32_t index_count;
+	};
+
+	static constexpr size_t FLOATS_PER_VERTEX = 8;
+
+	StaticBatch();
+	~StaticBatch();
+
+	StaticBatch(const StaticBatch &) = delete;
+	StaticBatch &operator=(const StaticBatch &) = delete;
+
+	// Appends the finest level of mesh. Attributes the mesh lacks become
+	// uv (0, 0) and normal (0, 0, 1).
+	Handle add(const Mesh::Indexed &mesh, const mat4 &model);
+	void remove(Handle handle);
+
+	// Closes every hole left by remove().
+	void compact();
+
+	bool contains(Handle handle) const;
+	const Range &range(Handle handle) const;
+	size_t object_count() const;
+
+	// One range per run of live objects that touch in the index arena; a
+	// compacted batch draws in one.
+	void get_draw_ranges(std::vector<MeshletCull::DrawRange> &draws) const;
+
+	// Position, uv and normal floats, as layout() describes.
+	static VertexLayout layout();
+	const std::vector<float> &vertices() const { return vertex_arena; }
+	const std::vector<uint32_t> &indices() const { return index_arena; }
+	size_t vertex_count() const { return vertex_arena.size() / FLOATS_PER_VERTEX; }
+
+	// Render thread only. Brings the GL buffers up to date: objects added
+	// since the last call are appended, anything else (compaction, growth)
+	// uploads the arenas again. Binds both buffers.
+	void upload();
+	GLuint vertex_buffer() const { return buffers[0]; }
+	GLuint index_buffer() const { return buffers[1]; }
+
+	// The part of upload() that needs no GL: works out what has to be sent
+	// and records it as sent. With reallocate, the buffers are made
+	// buffer_vertices and buffer_indices long before the ranges, which then
+	// start at 0, go up. Calling it without the upload is only for tests.
+	struct UploadPlan {
+		bool reallocate;
+		size_t buffer_vertices, buffer_indices;
+		size_t first_vertex, vertex_count;
+		size_t first_index, index_count;
+	};
+	UploadPlan plan_upload();
+
+private:
+	struct Object {
+		Range range;
+		bool live;
+	};
+
+	void maybe_compact();
+
+	std::vector<float> vertex_arena;
+	std::vector<uint32_t> index_arena;
+
+	// By handle, and the live handles in arena order. Removed objects stay
+	// in order until compact(), which moves their handles to free_handles.
+	std::vector<Object> objects;
+	std::vector<Handle> order;
+	std::vector<Handle> free_handles;
+	size_t live_objects;
+
+	size_t dead_vertices, dead_indices;
+
+	GLuint buffers[2];
+	size_t buffer_vertices, buffer_indices;
+	size_t uploaded_vertices, uploaded_indices;
+	bool moved;
+};
@@ -0,0 +1,150 @@
+#include "VertexQuantize.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+inline float sign_not_zero(float v)
+{
+	return v < 0.0f ? -1.0f : 1.0f;
+}
+
+inline float snorm_to_float(int32_t v, int bits)
+{
+	float max = (float)((1 << (bits - 1)) - 1);
+	return std::max(v / max, -1.0f);
+}
+
+}
+
+uint16_t VertexQuantize::float_to_half(float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+
+	uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+	uint32_t magnitude = bits & 0x7FFFFFFF;
+
+	// Infinity and NaN; NaNs stay quiet NaNs.
+	if (magnitude >= 0x7F800000)
+		return sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x0200 : 0);
+
+	// 65520 and up round to infinity.
+	if (magnitude >= 0x477FF000)
+		return sign | 0x7C00;
+
+	// Below the smallest normal half: the result is a multiple of 2^-24.
+	if (magnitude < 0x38800000) {
+		float f;
+		std::memcpy(&f, &magnitude, sizeof(f));
+		return sign | (uint16_t)std::nearbyint(f * 16777216.0f);
+	}
+
+	// Rebias the exponent from 127 to 15 and round the dropped 13 mantissa
+	// bits to nearest even.
+	uint32_t odd = (magnitude >> 13) & 1;
+	magnitude += 0xC8000FFF + odd;
+	return sign | (uint16_t)(magnitude >> 13);
+}
+
+float VertexQuantize::half_to_float(uint16_t value)
+{
+	uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+	uint32_t exponent = (value >> 10) & 0x1F;
+	uint32_t mantissa = value & 0x3FF;
+	uint32_t bits;
+
+	if (exponent == 0) {
+		float f = mantissa * (1.0f / 16777216.0f);
+		return sign ? -f : f;
+	}
+	else if (exponent == 31) {
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	}
+	else {
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+
+	float f;
+	std::memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+uint16_t VertexQuantize::encode_unorm16(float value, float offset, float scale)
+{
+	if (scale == 0.0f)
+		return 0;
+
+	float unit = std::min(std::max((value - offset) / scale, 0.0f), 1.0f);
+	return (uint16_t)std::lround(unit * 65535.0f);
+}
+
+float VertexQuantize::decode_unorm16(uint16_t value, float offset, float scale)
+{
+	return offset + value * (1.0f / 65535.0f) * scale;
+}
+
+void VertexQuantize::encode_octahedral(const vec3f &normal, int bits, int32_t out[2])
+{
+	float length = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+	if (!(length > 0.0f)) {
+		out[0] = 0;
+		out[1] = 0;
+		return;
+	}
+
+	float x = normal.x / length;
+	float y = normal.y / length;
+
+	if (normal.z < 0.0f) {
+		float folded_x = (1.0f - std::fabs(y)) * sign_not_zero(x);
+		float folded_y = (1.0f - std::fabs(x)) * sign_not_zero(y);
+		x = folded_x;
+		y = folded_y;
+	}
+
+	float max = (float)((1 << (bits - 1)) - 1);
+	float gx = x * max;
+	float gy = y * max;
+
+	float inv_length = 1.0f / std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+	vec3f unit(normal.x * inv_length, normal.y * inv_length, normal.z * inv_length);
+
+	out[0] = (int32_t)std::lround(gx);
+	out[1] = (int32_t)std::lround(gy);
+
+	float best_dot = -2.0f;
+	for (int i = 0; i < 4; ++i) {
+		int32_t candidate[2] = {
+			(int32_t)((i & 1) ? std::ceil(gx) : std::floor(gx)),
+			(int32_t)((i & 2) ? std::ceil(gy) : std::floor(gy))
+		};
+
+		vec3f decoded = decode_octahedral(candidate, bits);
+		float dot = decoded.x * unit.x + decoded.y * unit.y + decoded.z * unit.z;
+		if (dot > best_dot) {
+			best_dot = dot;
+			out[0] = candidate[0];
+			out[1] = candidate[1];
+		}
+	}
+}
+
+vec3f VertexQuantize::decode_octahedral(const int32_t in[2], int bits)
+{
+	float x = snorm_to_float(in[0], bits);
+	float y = snorm_to_float(in[1], bits);
+	float z = 1.0f - std::fabs(x) - std::fabs(y);
+
+	if (z < 0.0f) {
+		float unfolded_x = (1.0f - std::fabs(y)) * sign_not_zero(x);
+		float unfolded_y = (1.0f - std::fabs(x)) * sign_not_zero(y);
+		x = unfolded_x;
+		y = unfolded_y;
+	}
+
+	float inv_length = 1.0f / std::sqrt(x * x + y * y + z * z);
+	return vec3f(x * inv_length, y * inv_length, z * inv_length);
+}
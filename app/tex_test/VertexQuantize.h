@@ -0,0 +1,31 @@
+#pragma once
+
+#include "vec2f.h"
+#include "vec3f.h"
+
+#include <cstdint>
+
+/*
+Encoders for compact vertex attributes, and the matching decoders so the
+error can be measured on the CPU exactly as the GPU will see it.
+
+ - Half floats round to nearest even, as the hardware conversion does.
+ - Unit vectors use the octahedral mapping: the vector is projected onto
+   the octahedron |x| + |y| + |z| = 1, the lower half is folded over the
+   upper one, and the resulting square is stored as two signed normalised
+   integers. The encoder tries the four nearest grid points and keeps the
+   one that decodes closest to the input.
+*/
+
+struct VertexQuantize {
+	static uint16_t float_to_half(float value);
+	static float half_to_float(uint16_t value);
+
+	// (value - offset) / scale mapped onto [0, 65535]. A zero scale gives 0.
+	static uint16_t encode_unorm16(float value, float offset, float scale);
+	static float decode_unorm16(uint16_t value, float offset, float scale);
+
+	// bits is 8 or 16; out receives two values in [-(2^(bits-1) - 1), 2^(bits-1) - 1].
+	static void encode_octahedral(const vec3f &normal, int bits, int32_t out[2]);
+	static vec3f decode_octahedral(const int32_t in[2], int bits);
+};
@@ -0,0 +1,428 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <random>
+#include <string>
+
+#include "WavefrontObj.h"
+#include "Mesh.h"
+#include "MeshStream.h"
+#include "StaticBatch.h"
+
+/*
+Builds an n x n grid of quads (two triangles each, every corner carrying a
+vertex, uv and normal index) and compares Mesh::unpack_to_triangles() with
+Mesh::unpack_to_indexed(): time, corners per second and buffer sizes, and
+times interleaving the result.
+Then runs Mesh::Indexed::optimize() on the grid in file order and with its
+triangles shuffled, and reports ACMR/ATVR before and after. Finally
+quantises the vertices in several formats and reports bytes per vertex and
+the largest decoding error, builds a LOD chain, and builds and culls
+meshlets.
+Generating normals and tangents is timed against parsing the same file,
+and streaming the file in batches (time to the first batch) against
+parsing and unpacking all of it. Last, many copies of a small grid are
+packed into a StaticBatch, a third of them removed again, and the draws
+needed before and after compaction are reported.
+
+Usage: bench_Mesh [grid size...]
+*/
+
+typedef std::chrono::steady_clock bench_clock;
+
+static double seconds_since(bench_clock::time_point start) {
+	return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+static std::string make_grid_obj(size_t n) {
+	std::string obj;
+	obj.reserve((n + 1) * (n + 1) * 120 + n * n * 120);
+
+	// A gently rolling height field, so the normals vary.
+	char buf[256];
+	for (size_t y = 0; y <= n; ++y) {
+		for (size_t x = 0; x <= n; ++x) {
+			float z = 4.0f * std::sin(x * 0.1f) * std::cos(y * 0.1f);
+			float dx = 0.4f * std::cos(x * 0.1f) * std::cos(y * 0.1f);
+			float dy = -0.4f * std::sin(x * 0.1f) * std::sin(y * 0.1f);
+			float length = std::sqrt(dx * dx + dy * dy + 1.0f);
+
+			snprintf(buf, sizeof(buf), "v %zu %zu %f\nvt %f %f\nvn %f %f %f\n",
+				x, y, z, (float)x / n, (float)y / n, -dx / length, -dy / length, 1.0f / length);
+			obj += buf;
+		}
+	}
+
+	for (size_t y = 0; y < n; ++y) {
+		for (size_t x = 0; x < n; ++x) {
+			size_t a = y * (n + 1) + x + 1;
+			size_t b = a + 1;
+			size_t c = a + n + 1;
+			size_t d = c + 1;
+			snprintf(buf, sizeof(buf), "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\nf %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n",
+				a, a, a, b, b, b, d, d, d, a, a, a, d, d, d, c, c, c);
+			obj += buf;
+		}
+	}
+
+	return obj;
+}
+
+static void bench_grid(size_t n) {
+	std::string text = make_grid_obj(n);
+
+	WavefrontObj obj;
+	obj.parse_parallel(text.data(), text.data() + text.size());
+	Mesh mesh(obj);
+
+	bench_clock::time_point start = bench_clock::now();
+	Mesh::Unpacked unpacked = mesh.unpack_to_triangles();
+	double unpack_time = seconds_since(start);
+
+	start = bench_clock::now();
+	Mesh::Indexed indexed = mesh.unpack_to_indexed();
+	double index_time = seconds_since(start);
+
+	start = bench_clock::now();
+	Mesh::Interleaved interleaved = indexed.interleave(indexed.default_layout());
+	double interleave_time = seconds_since(start);
+
+	size_t corners = indexed.index_count();
+	size_t unpacked_size = unpacked.vertex.size() * sizeof(vec3f)
+		+ unpacked.uv.size() * sizeof(vec2f)
+		+ unpacked.normal.size() * sizeof(vec3f);
+	size_t indexed_size = indexed.vertex_count() * indexed.vertex_stride()
+		+ corners * indexed.index_size();
+
+	printf("grid %5zu: %10zu corners -> %9zu vertices (%u-bit)   "
+		"unpack: %12.0f corners/s   indexed: %12.0f corners/s   "
+		"%6.1f MB -> %6.1f MB (%.2fx)\n",
+		n, corners, indexed.vertex_count(),
+		indexed.index_type == GL_UNSIGNED_SHORT ? 16u : 32u,
+		corners / unpack_time, corners / index_time,
+		unpacked_size / 1e6, indexed_size / 1e6, (double)unpacked_size / indexed_size);
+	printf("grid %5zu: interleave %u-byte vertices: %12.0f vertices/s\n",
+		n, interleaved.layout.stride(), interleaved.vertex_count / interleave_time);
+}
+
+static void bench_construct(size_t n) {
+	std::string text = make_grid_obj(n);
+
+	WavefrontObj obj;
+	obj.parse_parallel(text.data(), text.data() + text.size());
+	size_t faces = obj.data().f.size();
+
+	// thread_count 1 is the serial baseline.
+	for (unsigned threads : { 1u, 0u }) {
+		bench_clock::time_point start = bench_clock::now();
+		Mesh mesh(obj, threads);
+		double construct_time = seconds_since(start);
+
+		start = bench_clock::now();
+		Mesh::Unpacked unpacked = mesh.unpack_to_triangles(threads);
+		double unpack_time = seconds_since(start);
+
+		printf("grid %5zu %-8s: %10zu faces   construct: %12.0f faces/s   unpack: %12.0f corners/s\n",
+			n, threads == 1 ? "serial" : "parallel", faces,
+			faces / construct_time, unpacked.vertex.size() / unpack_time);
+	}
+}
+
+static void shuffle_triangles(Mesh &mesh) {
+	std::vector<size_t> order(mesh.vertex_tri.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::shuffle(order.begin(), order.end(), std::mt19937(1234));
+
+	auto permute = [&](std::vector<Mesh::index_tri> &tris) {
+		if (tris.size() != order.size())
+			return;
+
+		std::vector<Mesh::index_tri> shuffled(tris.size());
+		for (size_t i = 0; i < order.size(); ++i)
+			shuffled[i] = tris[order[i]];
+		tris.swap(shuffled);
+	};
+
+	permute(mesh.vertex_tri);
+	permute(mesh.uv_tri);
+	permute(mesh.normal_tri);
+}
+
+static void bench_optimize(size_t n, bool shuffle) {
+	std::string text = make_grid_obj(n);
+
+	WavefrontObj obj;
+	obj.parse_parallel(text.data(), text.data() + text.size());
+	Mesh mesh(obj);
+	if (shuffle)
+		shuffle_triangles(mesh);
+
+	Mesh::Indexed indexed = mesh.unpack_to_indexed();
+
+	MeshOptimize::CacheStats before, after;
+	bench_clock::time_point start = bench_clock::now();
+	indexed.optimize(MeshOptimize::DEFAULT_CACHE_SIZE, &before, &after);
+	double time = seconds_since(start);
+
+	size_t triangles = indexed.index_count() / 3;
+	printf("grid %5zu %-8s: ACMR %.3f -> %.3f   ATVR %.3f -> %.3f   %12.0f tris/s\n",
+		n, shuffle ? "shuffled" : "ordered",
+		before.acmr, after.acmr, before.atvr, after.atvr, triangles / time);
+}
+
+static void bench_quantize(size_t n) {
+	typedef Mesh::QuantizeOptions Q;
+
+	static const struct {
+		const char *name;
+		Q options;
+	} formats[] = {
+		{ "float", Q(Q::POSITION_FLOAT, Q::NORMAL_FLOAT, Q::UV_FLOAT) },
+		{ "half/oct16/unorm16", Q(Q::POSITION_HALF, Q::NORMAL_OCT16, Q::UV_UNORM16) },
+		{ "unorm16/oct16/unorm16", Q(Q::POSITION_UNORM16, Q::NORMAL_OCT16, Q::UV_UNORM16) },
+		{ "unorm16/oct8/unorm16", Q(Q::POSITION_UNORM16, Q::NORMAL_OCT8, Q::UV_UNORM16) },
+	};
+
+	std::string text = make_grid_obj(n);
+
+	WavefrontObj obj;
+	obj.parse_parallel(text.data(), text.data() + text.size());
+	Mesh mesh(obj);
+	Mesh::Indexed indexed = mesh.unpack_to_indexed();
+
+	for (const auto &f : formats) {
+		Mesh::QuantizeError error;
+		bench_clock::time_point start = bench_clock::now();
+		Mesh::Interleaved q = indexed.quantize(f.options, &error);
+		double time = seconds_since(start);
+
+		printf("grid %5zu %-22s: %2u bytes/vertex (%4.1f%%)   max error: position %.2e, "
+			"normal %6.3f deg, uv %.2e   %12.0f vertices/s\n",
+			n, f.name, q.layout.stride(), 100.0 * q.layout.stride() / indexed.vertex_stride(),
+			error.position, error.normal_degrees, error.uv, q.vertex_count / time);
+	}
+}
+
+static void bench_lods(size_t n) {
+	std::string text = make_grid_obj(n);
+
+	WavefrontObj obj;
+	obj.parse_parallel(text.data(), text.data() + text.size());
+	Mesh mesh(obj);
+	Mesh::Indexed indexed = mesh.unpack_to_indexed();
+
+	bench_clock::time_point start = bench_clock::now();
+	indexed.build_lods({ 0.5f, 0.25f, 0.125f, 0.0625f });
+	double time = seconds_since(start);
+
+	for (size_t i = 0; i < indexed.lods.size(); ++i) {
+		const MeshLod::Level &level = indexed.lods.level(i);
+		printf("grid %5zu LOD %zu: %10u triangles   error %.4f\n",
+			n, i, level.index_count / 3, level.error);
+	}
+	printf("grid %5zu: LOD chain built in %.3f s (%12.0f source triangles/s per level)\n",
+		n, time, (indexed.lods.level(0).index_count / 3) * (indexed.lods.size() - 1) / time);
+}
+
+static void bench_normals(size_t n) {
+	std::string text = make_grid_obj(n);
+
+	bench_clock::time_point start = bench_clock::now();
+	WavefrontObj obj;
+	obj.parse_parallel(text.data(), text.data() + text.size());
+	double parse_time = seconds_since(start);
+
+	Mesh mesh(obj);
+	size_t triangles = mesh.vertex_tri.size();
+	printf("grid %5zu: %10zu triangles   parse: %8.3f s\n", n, triangles, parse_time);
+
+	for (float crease : { 180.0f, 60.0f }) {
+		start = bench_clock::now();
+		mesh.generate_normals(crease);
+		double time = seconds_since(start);
+
+		printf("grid %5zu normals, crease %3.0f: %8.3f s (%5.1f%% of parse)   %12.0f triangles/s   %zu normals\n",
+			n, crease, time, 100.0 * time / parse_time, triangles / time, mesh.normal.size());
+	}
+
+	Mesh::Indexed indexed = mesh.unpack_to_indexed();
+	start = bench_clock::now();
+	indexed.generate_tangents();
+	double time = seconds_since(start);
+
+	printf("grid %5zu tangents            : %8.3f s (%5.1f%% of parse)   %12.0f triangles/s\n",
+		n, time, 100.0 * time / parse_time, triangles / time);
+}
+
+static void bench_stream(size_t n) {
+	std::string text = make_grid_obj(n);
+	const char *begin = text.data(), *end = text.data() + text.size();
+
+	// The whole file parsed and unpacked before anything can be drawn.
+	bench_clock::time_point start = bench_clock::now();
+	WavefrontObj obj;
+	obj.parse_mapped(begin, end);
+	Mesh mesh(obj, 1);
+	Mesh::Unpacked unpacked = mesh.unpack_to_triangles(1);
+	double full_time = seconds_since(start);
+
+	start = bench_clock::now();
+	size_t capacity = MeshStream::count_faces(begin, end);
+	double count_time = seconds_since(start);
+
+	double first_batch = -1.0;
+	size_t batches = 0;
+	MeshStream stream(8192, capacity, [&](size_t, std::vector<float> &&) {
+		if (batches++ == 0)
+			first_batch = seconds_since(start);
+	});
+	WavefrontObj::visit(begin, end, stream);
+	stream.finish();
+	double stream_time = seconds_since(start);
+
+	printf("grid %5zu: unpack_to_triangles %8.3f s   stream: count %6.3f s, first batch %6.3f s, "
+		"all %zu batches %8.3f s\n",
+		n, full_time, count_time, first_batch, batches, stream_time);
+}
+
+static void bench_batch(size_t n, size_t objects) {
+	std::string text = make_grid_obj(n);
+
+	WavefrontObj obj;
+	obj.parse_mapped(text.data(), text.data() + text.size());
+	Mesh mesh(obj, 1);
+	Mesh::Indexed prop = mesh.unpack_to_indexed();
+
+	StaticBatch batch;
+	std::vector<StaticBatch::Handle> handles;
+
+	bench_clock::time_point start = bench_clock::now();
+	for (size_t i = 0; i < objects; ++i) {
+		mat4 model = mat4::translate(vec3((float)(i % 32) * n, (float)(i / 32) * n, 0.0f));
+		handles.push_back(batch.add(prop, model));
+	}
+	double add_time = seconds_since(start);
+
+	std::vector<MeshletCull::DrawRange> draws;
+	batch.get_draw_ranges(draws);
+	printf("batch %4zu x grid %3zu: added in %.4f s (%12.0f vertices/s), %zu draws instead of %zu\n",
+		objects, n, add_time, batch.vertex_count() / add_time, draws.size(), objects);
+
+	// Every third object goes; the holes trigger compaction on the way.
+	start = bench_clock::now();
+	for (size_t i = 0; i < objects; i += 3)
+		batch.remove(handles[i]);
+	double remove_time = seconds_since(start);
+
+	batch.get_draw_ranges(draws);
+	size_t holes = draws.size();
+	batch.compact();
+	batch.get_draw_ranges(draws);
+
+	printf("batch %4zu x grid %3zu: removed a third in %.4f s, %zu draws with holes left, %zu after compact()\n",
+		objects, n, remove_time, holes, draws.size());
+}
+
+static void bench_meshlets(size_t n) {
+	std::string text = make_grid_obj(n);
+
+	WavefrontObj obj;
+	obj.parse_parallel(text.data(), text.data() + text.size());
+	Mesh mesh(obj);
+	Mesh::Indexed indexed = mesh.unpack_to_indexed();
+	indexed.optimize();
+
+	bench_clock::time_point start = bench_clock::now();
+	indexed.build_meshlets();
+	double build_time = seconds_since(start);
+
+	size_t meshlet_count = indexed.meshlets.size();
+	size_t vertices = 0, triangles = 0;
+	for (const Meshlet &m : indexed.meshlets) {
+		vertices += m.vertex_count;
+		triangles += m.index_count / 3;
+	}
+
+	printf("grid %5zu: %zu meshlets, %.1f vertices and %.1f triangles each   built at %12.0f triangles/s\n",
+		n, meshlet_count, (double)vertices / meshlet_count, (double)triangles / meshlet_count,
+		triangles / build_time);
+
+	// An orthographic view of the quarter x, y in [0, n / 2].
+	float half = n * 0.5f;
+	const float view[16] = {
+		2.0f / half, 0.0f, 0.0f, 0.0f,
+		0.0f, 2.0f / half, 0.0f, 0.0f,
+		0.0f, 0.0f, 0.1f, 0.0f,
+		-1.0f, -1.0f, 0.0f, 1.0f
+	};
+	Frustum frustum = Frustum::from_matrix(view);
+
+	// From far above the height field most clusters face the camera, from
+	// far below almost none do.
+	const float above[3] = { half, half, 1000.0f };
+	const float below[3] = { half, half, -1000.0f };
+
+	std::vector<MeshletCull::DrawRange> draws;
+	const struct {
+		const char *name;
+		const float *camera;
+	} cases[] = { { "frustum", nullptr }, { "frustum+cone above", above }, { "frustum+cone below", below } };
+
+	for (const auto &c : cases) {
+		draws.clear();
+		start = bench_clock::now();
+		size_t visible = MeshletCull::cull(indexed.meshlets.data(), meshlet_count, frustum, c.camera, draws);
+		double cull_time = seconds_since(start);
+
+		printf("grid %5zu %-18s: %6.2f%% of meshlets visible in %zu draws   %12.0f meshlets/s\n",
+			n, c.name, 100.0 * visible / meshlet_count, draws.size(), meshlet_count / cull_time);
+	}
+}
+
+int main(int argc, char *argv[]) {
+	if (argc > 1) {
+		for (int i = 1; i < argc; ++i) {
+			size_t n = (size_t)strtoull(argv[i], nullptr, 10);
+			bench_grid(n);
+			bench_construct(n);
+			bench_optimize(n, false);
+			bench_optimize(n, true);
+			bench_quantize(n);
+			bench_lods(n);
+			bench_normals(n);
+			bench_stream(n);
+			bench_batch(n, 1000);
+			bench_meshlets(n);
+		}
+		return 0;
+	}
+
+	bench_grid(100);
+	bench_grid(250);
+	bench_grid(1000);
+	bench_grid(2000);
+
+	bench_construct(1000);
+	bench_construct(2000);
+
+	bench_optimize(100, false);
+	bench_optimize(100, true);
+	bench_optimize(1000, false);
+	bench_optimize(1000, true);
+
+	bench_quantize(1000);
+
+	bench_lods(300);
+
+	bench_normals(1000);
+
+	bench_stream(1000);
+
+	bench_batch(10, 1000);
+
+	bench_meshlets(1000);
+	return 0;
+}
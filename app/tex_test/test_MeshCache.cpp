@@ -0,0 +1,260 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "MeshCache.h"
+#include "TestCheck.h"
+
+static const char *obj_file = "test_MeshCache.obj";
+static const char *mtl_file = "test_MeshCache.mtl";
+static const char *cache_file = "test_MeshCache.obj.cache";
+
+// Two materials on a unit quad.
+static const char *quad_obj =
+	"mtllib test_MeshCache.mtl\n"
+	"v 0 0 0\n"
+	"v 1 0 0\n"
+	"v 1 1 0\n"
+	"v 0 1 0\n"
+	"vt 0 0\n"
+	"vt 1 0\n"
+	"vt 1 1\n"
+	"vt 0 1\n"
+	"vn 0 0 1\n"
+	"usemtl Red\n"
+	"f 1/1/1 2/2/1 3/3/1\n"
+	"usemtl Blue\n"
+	"f 1/1/1 3/3/1 4/4/1\n";
+
+static const char *quad_mtl =
+	"newmtl Red\n"
+	"Kd 1 0 0\n"
+	"newmtl Blue\n"
+	"Kd 0 0 1\n";
+
+static void write_file(const std::string &filename, const std::string &contents) {
+	std::ofstream ofs(filename, std::ios_base::binary);
+	ofs << contents;
+}
+
+static std::vector<char> read_file(const std::string &filename) {
+	std::ifstream ifs(filename, std::ios_base::binary);
+	return std::vector<char>(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+}
+
+static void write_bytes(const std::string &filename, const std::vector<char> &bytes) {
+	std::ofstream ofs(filename, std::ios_base::binary);
+	ofs.write(bytes.data(), bytes.size());
+}
+
+static MeshCache::Header read_header(const std::string &filename) {
+	MeshCache::Header h;
+	std::memset(&h, 0, sizeof(h));
+	std::vector<char> bytes = read_file(filename);
+	if (bytes.size() >= sizeof(h))
+		std::memcpy(&h, bytes.data(), sizeof(h));
+	return h;
+}
+
+// Moves the mtime of filename by seconds without touching its contents.
+static void touch(const std::string &filename, int seconds) {
+	std::filesystem::file_time_type mtime = std::filesystem::last_write_time(filename);
+	std::filesystem::last_write_time(filename, mtime + std::chrono::seconds(seconds));
+}
+
+// Cooks the quad as the asset loader does, without LODs, and caches it.
+struct Cooked {
+	Mesh::Indexed indexed;
+	Mesh::Interleaved interleaved;
+
+	Cooked() {
+		write_file(obj_file, quad_obj);
+		write_file(mtl_file, quad_mtl);
+
+		WavefrontObj obj(obj_file, WavefrontObj::PARSE_MAPPED);
+		Mesh mesh(obj, 1);
+		WavefrontMtl mtl;
+		mtl.load_libraries(obj.material_libraries(), obj_file);
+		mesh.set_materials(mtl);
+
+		indexed = mesh.unpack_to_indexed();
+		interleaved = indexed.quantize(Mesh::QuantizeOptions());
+
+		std::vector<std::string> libraries;
+		for (const std::string &library : obj.material_libraries())
+			libraries.push_back(WavefrontMtl::library_path(library, obj_file));
+
+		CHECK(MeshCache::write(obj_file, libraries, cache_file, mesh, indexed, interleaved));
+	}
+};
+
+static bool loads(bool verify = false) {
+	MeshCache cache;
+	return cache.load(obj_file, cache_file, verify) && cache.is_loaded();
+}
+
+static void test_round_trip() {
+	Cooked cooked;
+
+	MeshCache cache;
+	CHECK(cache.load(obj_file, cache_file));
+	CHECK(cache.is_loaded());
+
+	VertexLayout layout;
+	VertexLayout::Dequantize dequantize;
+	size_t vertex_count;
+	const void *vertices = cache.get_interleaved(layout, dequantize, vertex_count);
+	CHECK(vertices && vertex_count == cooked.interleaved.vertex_count);
+	CHECK(layout.stride() == cooked.interleaved.layout.stride());
+	CHECK(vertices && std::memcmp(vertices, cooked.interleaved.data.data(), cooked.interleaved.data.size()) == 0);
+
+	size_t index_count;
+	const uint16_t *indices = cache.get<uint16_t>(MeshCache::INDEX16, index_count);
+	CHECK(indices && std::vector<uint16_t>(indices, indices + index_count) == cooked.indexed.index16);
+
+	size_t material_count;
+	const Mesh::Material *materials = cache.get<Mesh::Material>(MeshCache::MATERIALS, material_count);
+	CHECK(materials && material_count == 2);
+	CHECK(materials && materials[0].diffuse[0] == 1.0f && materials[1].diffuse[2] == 1.0f);
+
+	size_t submesh_count;
+	CHECK(cache.get<Mesh::Submesh>(MeshCache::SUBMESHES, submesh_count) && submesh_count == 2);
+
+	// A section asked for with the wrong element size is refused.
+	CHECK(!cache.get<uint32_t>(MeshCache::INDEX16, index_count) && index_count == 0);
+
+	CHECK(loads(true));
+}
+
+static void test_source_changed() {
+	// A different size is rejected from the stat alone.
+	Cooked cooked;
+	write_file(obj_file, std::string(quad_obj) + "# edited\n");
+	CHECK(!loads());
+
+	// The same size with other contents: the mtime moved, so the source is
+	// hashed and the hash rejects it.
+	Cooked again;
+	std::string edited = quad_obj;
+	edited.replace(edited.find("v 1 1 0"), 7, "v 1 2 0");
+	write_file(obj_file, edited);
+	touch(obj_file, 10);
+	CHECK(!loads());
+}
+
+static void test_touched_source() {
+	Cooked cooked;
+	MeshCache::Header before = read_header(cache_file);
+
+	// Only the mtime moved: the hash still matches, and the new mtime is
+	// stored so the next load is a stat again.
+	touch(obj_file, 10);
+	MeshCache::SourceKey key;
+	CHECK(MeshCache::stat_key(obj_file, key));
+	CHECK(key.mtime != before.source.mtime);
+
+	CHECK(loads());
+	MeshCache::Header after = read_header(cache_file);
+	CHECK(after.source.mtime == key.mtime);
+	CHECK(after.source.size == before.source.size && after.source.hash == before.source.hash);
+	CHECK(loads());
+}
+
+static void test_libraries_changed() {
+	// An edited material library rejects the cache, even though the .obj
+	// is untouched.
+	Cooked cooked;
+	write_file(mtl_file, std::string(quad_mtl) + "Ks 1 1 1\n");
+	CHECK(!loads());
+
+	Cooked again;
+	touch(mtl_file, 10);
+	CHECK(!loads());
+
+	// So does a library that disappeared, or one that was missing when the
+	// cache was written and has turned up since.
+	Cooked gone;
+	std::remove(mtl_file);
+	CHECK(!loads());
+
+	write_file(obj_file, quad_obj);
+	{
+		WavefrontObj obj(obj_file, WavefrontObj::PARSE_MAPPED);
+		Mesh mesh(obj, 1);
+		Mesh::Indexed indexed = mesh.unpack_to_indexed();
+		Mesh::Interleaved interleaved = indexed.quantize(Mesh::QuantizeOptions());
+		CHECK(MeshCache::write(obj_file, { mtl_file }, cache_file, mesh, indexed, interleaved));
+	}
+	CHECK(loads());
+	write_file(mtl_file, quad_mtl);
+	CHECK(!loads());
+}
+
+static void test_version_bumped() {
+	Cooked cooked;
+	std::vector<char> bytes = read_file(cache_file);
+	uint32_t version = MeshCache::VERSION + 1;
+	std::memcpy(bytes.data() + offsetof(MeshCache::Header, version), &version, sizeof(version));
+	write_bytes(cache_file, bytes);
+	CHECK(!loads());
+}
+
+static void test_damaged_file() {
+	// Cut short: the size no longer matches the header.
+	Cooked cooked;
+	std::vector<char> bytes = read_file(cache_file);
+	CHECK(bytes.size() == read_header(cache_file).file_size);
+	write_bytes(cache_file, std::vector<char>(bytes.begin(), bytes.end() - 64));
+	CHECK(!loads());
+
+	write_bytes(cache_file, std::vector<char>(bytes.begin(), bytes.begin() + sizeof(MeshCache::Header) / 2));
+	CHECK(!loads());
+
+	// A section running past the end of the file.
+	MeshCache::Section section;
+	char *first = bytes.data() + sizeof(MeshCache::Header);
+	std::memcpy(&section, first, sizeof(section));
+	section.count = bytes.size();
+	std::memcpy(first, &section, sizeof(section));
+	write_bytes(cache_file, bytes);
+	CHECK(!loads());
+
+	// And one whose offset lies past it.
+	Cooked again;
+	bytes = read_file(cache_file);
+	first = bytes.data() + sizeof(MeshCache::Header);
+	std::memcpy(&section, first, sizeof(section));
+	section.offset = (bytes.size() / MeshCache::SECTION_ALIGNMENT + 1) * MeshCache::SECTION_ALIGNMENT;
+	section.count = 0;
+	std::memcpy(first, &section, sizeof(section));
+	write_bytes(cache_file, bytes);
+	CHECK(!loads());
+}
+
+int main()
+{
+	test_round_trip();
+	test_source_changed();
+	test_touched_source();
+	test_libraries_changed();
+	test_version_bumped();
+	test_damaged_file();
+
+	std::remove(obj_file);
+	std::remove(mtl_file);
+	std::remove(cache_file);
+
+	if (failures) {
+		std::cerr << failures << " check(s) failed\n";
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,163 @@
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "MeshNormals.h"
+#include "TestCheck.h"
+
+static bool near(float a, float b) {
+	return std::fabs(a - b) < 1e-5f;
+}
+
+static bool near(const vec3f &a, const vec3f &b) {
+	return near(a.x, b.x) && near(a.y, b.y) && near(a.z, b.z);
+}
+
+static vec3f sub(const vec3f &a, const vec3f &b) {
+	return vec3f(a.x - b.x, a.y - b.y, a.z - b.z);
+}
+
+static vec3f cross(const vec3f &a, const vec3f &b) {
+	return vec3f(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+static float dot(const vec3f &a, const vec3f &b) {
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+// The unit cube on 8 shared vertices, two triangles per face, all wound
+// outwards.
+struct Cube {
+	std::vector<vec3f> position;
+	std::vector<uint32_t> indices;
+
+	Cube() {
+		for (uint32_t i = 0; i < 8; ++i)
+			position.push_back(vec3f((float)(i & 1), (float)(i >> 1 & 1), (float)(i >> 2 & 1)));
+
+		const uint32_t faces[6][4] = {
+			{ 0, 2, 6, 4 }, { 1, 3, 7, 5 },
+			{ 0, 1, 5, 4 }, { 2, 3, 7, 6 },
+			{ 0, 1, 3, 2 }, { 4, 5, 7, 6 },
+		};
+
+		const vec3f center(0.5f, 0.5f, 0.5f);
+		for (const uint32_t (&f)[4] : faces) {
+			const uint32_t tris[2][3] = { { f[0], f[1], f[2] }, { f[0], f[2], f[3] } };
+			for (const uint32_t (&tri)[3] : tris) {
+				vec3f n = face_normal(tri[0], tri[1], tri[2]);
+				if (dot(n, sub(position[tri[0]], center)) > 0.0f)
+					indices.insert(indices.end(), { tri[0], tri[1], tri[2] });
+				else
+					indices.insert(indices.end(), { tri[0], tri[2], tri[1] });
+			}
+		}
+	}
+
+	vec3f face_normal(uint32_t a, uint32_t b, uint32_t c) const {
+		return cross(sub(position[b], position[a]), sub(position[c], position[a]));
+	}
+};
+
+static void test_cube_crease() {
+	Cube cube;
+	std::vector<vec3f> normals;
+	std::vector<uint32_t> normal_indices;
+
+	// Every edge of a cube is 90 degrees, so with a 60 degree crease each
+	// corner keeps the normal of its own face: three per vertex.
+	MeshNormals::generate_normals(normals, normal_indices, cube.indices.data(), cube.indices.size(),
+		cube.position.data(), cube.position.size(), 60.0f);
+	CHECK(normals.size() == 24);
+	CHECK(normal_indices.size() == cube.indices.size());
+
+	bool flat = true;
+	for (size_t c = 0; c < cube.indices.size(); ++c) {
+		const uint32_t *tri = cube.indices.data() + c / 3 * 3;
+		vec3f n = cube.face_normal(tri[0], tri[1], tri[2]);
+		float length = std::sqrt(dot(n, n));
+		flat &= near(normals[normal_indices[c]], vec3f(n.x / length, n.y / length, n.z / length));
+	}
+	CHECK(flat);
+
+	// Without a crease the vertices stay shared, and each normal points out
+	// of its corner of the cube.
+	MeshNormals::generate_normals(normals, normal_indices, cube.indices.data(), cube.indices.size(),
+		cube.position.data(), cube.position.size());
+	CHECK(normals.size() == 8);
+	CHECK(normal_indices == cube.indices);
+
+	bool outwards = true;
+	for (size_t v = 0; v < 8; ++v) {
+		vec3f out = sub(cube.position[v], vec3f(0.5f, 0.5f, 0.5f));
+		outwards &= normals[v].x * out.x > 0.0f && normals[v].y * out.y > 0.0f && normals[v].z * out.z > 0.0f;
+		outwards &= near(dot(normals[v], normals[v]), 1.0f);
+	}
+	CHECK(outwards);
+}
+
+static void test_area_weighting() {
+	// Two triangles meet at the origin at right angles: one facing +z with
+	// an area of 2, one facing +x with an area of 1/2. The shared normal
+	// leans towards the larger in proportion, (1, 0, 4) normalised.
+	const std::vector<vec3f> position = {
+		vec3f(0, 0, 0), vec3f(2, 0, 0), vec3f(0, 2, 0), vec3f(0, 1, 0), vec3f(0, 0, 1),
+	};
+	const std::vector<uint32_t> indices = { 0, 1, 2, 0, 3, 4 };
+
+	std::vector<vec3f> normals;
+	std::vector<uint32_t> normal_indices;
+	MeshNormals::generate_normals(normals, normal_indices, indices.data(), indices.size(),
+		position.data(), position.size());
+
+	float l = std::sqrt(17.0f);
+	CHECK(near(normals[0], vec3f(1 / l, 0, 4 / l)));
+	CHECK(near(normals[1], vec3f(0, 0, 1)));
+	CHECK(near(normals[3], vec3f(1, 0, 0)));
+}
+
+static void test_mirrored_tangents() {
+	// Two unit quads facing +z, side by side but with their own vertices.
+	// The second has u running the other way, as the mirrored half of a
+	// symmetric model would.
+	const std::vector<vec3f> position = {
+		vec3f(0, 0, 0), vec3f(1, 0, 0), vec3f(1, 1, 0), vec3f(0, 1, 0),
+		vec3f(2, 0, 0), vec3f(3, 0, 0), vec3f(3, 1, 0), vec3f(2, 1, 0),
+	};
+	const std::vector<vec2f> uv = {
+		vec2f(0, 0), vec2f(1, 0), vec2f(1, 1), vec2f(0, 1),
+		vec2f(1, 0), vec2f(0, 0), vec2f(0, 1), vec2f(1, 1),
+	};
+	const std::vector<vec3f> normal(8, vec3f(0, 0, 1));
+	const std::vector<uint32_t> indices = { 0, 1, 2, 0, 2, 3, 4, 5, 6, 4, 6, 7 };
+
+	std::vector<vec4f> tangent(8);
+	MeshNormals::generate_tangents(tangent.data(), indices.data(), indices.size(), position.data(),
+		normal.data(), uv.data(), position.size());
+
+	bool plain = true, mirrored = true;
+	for (size_t v = 0; v < 4; ++v) {
+		const vec4f &t = tangent[v];
+		plain &= near(vec3f(t.x, t.y, t.z), vec3f(1, 0, 0)) && t.w == 1.0f;
+	}
+	for (size_t v = 4; v < 8; ++v) {
+		const vec4f &t = tangent[v];
+		mirrored &= near(vec3f(t.x, t.y, t.z), vec3f(-1, 0, 0)) && t.w == -1.0f;
+	}
+	CHECK(plain);
+	CHECK(mirrored);
+}
+
+int main()
+{
+	test_cube_crease();
+	test_area_weighting();
+	test_mirrored_tangents();
+
+	if (failures) {
+		std::cerr << failures << " check(s) failed\n";
+		return 1;
+	}
+
+	return 0;
+}
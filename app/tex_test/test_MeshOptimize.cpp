@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "Mesh.h"
+#include "MeshOptimize.h"
+#include "TestCheck.h"
+
+typedef std::array<uint32_t, 3> Triangle;
+
+// The triangles of indices, each rotated to start at its smallest index so
+// that winding is kept, sorted.
+static std::vector<Triangle> triangle_set(const uint32_t *indices, size_t index_count) {
+	std::vector<Triangle> out;
+	for (size_t i = 0; i < index_count; i += 3) {
+		Triangle t = { indices[i], indices[i + 1], indices[i + 2] };
+		std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+		out.push_back(t);
+	}
+	std::sort(out.begin(), out.end());
+	return out;
+}
+
+// An n x n grid of quads on shared vertices, two triangles each, with the
+// triangles in random order.
+struct Grid {
+	std::vector<vec3f> position;
+	std::vector<uint32_t> indices;
+
+	explicit Grid(uint32_t n) {
+		for (uint32_t y = 0; y <= n; ++y) {
+			for (uint32_t x = 0; x <= n; ++x)
+				position.push_back(vec3f((float)x, (float)y, 0.0f));
+		}
+
+		std::vector<Triangle> tris;
+		for (uint32_t y = 0; y < n; ++y) {
+			for (uint32_t x = 0; x < n; ++x) {
+				uint32_t a = y * (n + 1) + x, b = a + 1, c = a + n + 1, d = c + 1;
+				tris.push_back({ a, b, d });
+				tris.push_back({ a, d, c });
+			}
+		}
+
+		std::mt19937 rng(7);
+		std::shuffle(tris.begin(), tris.end(), rng);
+		for (const Triangle &t : tris)
+			indices.insert(indices.end(), t.begin(), t.end());
+	}
+};
+
+static void test_vertex_cache() {
+	Grid grid(32);
+	std::vector<uint32_t> out(grid.indices.size());
+	MeshOptimize::optimize_vertex_cache(out.data(), grid.indices.data(), grid.indices.size(),
+		grid.position.size());
+
+	CHECK(triangle_set(out.data(), out.size()) == triangle_set(grid.indices.data(), grid.indices.size()));
+
+	MeshOptimize::CacheStats before = MeshOptimize::analyze_vertex_cache(grid.indices.data(),
+		grid.indices.size(), grid.position.size());
+	MeshOptimize::CacheStats after = MeshOptimize::analyze_vertex_cache(out.data(), out.size(),
+		grid.position.size());
+
+	// Random order misses the cache on nearly every corner; a good order
+	// stays well under one vertex per triangle on a grid.
+	CHECK(before.acmr > 2.0);
+	CHECK(after.acmr < 1.0);
+	CHECK(after.acmr < before.acmr && after.atvr < before.atvr);
+
+	// Overdraw ordering only moves clusters of triangles around.
+	std::vector<uint32_t> drawn = out;
+	MeshOptimize::optimize_overdraw(drawn.data(), drawn.size(), grid.position.data(), grid.position.size());
+	CHECK(triangle_set(drawn.data(), drawn.size()) == triangle_set(out.data(), out.size()));
+}
+
+static void test_vertex_fetch() {
+	// Vertex 2 is never used.
+	std::vector<uint32_t> indices = { 4, 0, 3, 3, 0, 1 };
+	std::vector<uint32_t> remap;
+	size_t used = MeshOptimize::optimize_vertex_fetch(indices.data(), indices.size(), 5, remap);
+
+	CHECK(used == 4);
+	CHECK(remap == std::vector<uint32_t>({ 1, 3, UINT32_MAX, 2, 0 }));
+	CHECK(indices == std::vector<uint32_t>({ 0, 1, 2, 2, 1, 3 }));
+}
+
+// The triangles of indices[first, first + count) as corner positions.
+static std::vector<std::array<float, 9>> position_set(const Mesh::Indexed &mesh, size_t first, size_t count) {
+	std::vector<std::array<float, 9>> out;
+	for (size_t i = first; i < first + count; i += 3) {
+		Triangle t = { mesh.index16[i], mesh.index16[i + 1], mesh.index16[i + 2] };
+		std::rotate(t.begin(), std::min_element(t.begin(), t.end(), [&](uint32_t a, uint32_t b) {
+			const vec3f &p = mesh.vertex[a], &q = mesh.vertex[b];
+			return std::make_pair(p.x, p.y) < std::make_pair(q.x, q.y);
+		}), t.end());
+
+		std::array<float, 9> corners;
+		for (size_t c = 0; c < 3; ++c) {
+			corners[c * 3] = mesh.vertex[t[c]].x;
+			corners[c * 3 + 1] = mesh.vertex[t[c]].y;
+			corners[c * 3 + 2] = mesh.vertex[t[c]].z;
+		}
+		out.push_back(corners);
+	}
+	std::sort(out.begin(), out.end());
+	return out;
+}
+
+static void test_indexed_submeshes() {
+	// The left and right halves of a grid as two submeshes, each in random
+	// order.
+	Grid grid(16);
+	std::vector<uint32_t> left, right;
+	for (size_t i = 0; i < grid.indices.size(); i += 3) {
+		std::vector<uint32_t> &side = grid.position[grid.indices[i]].x + grid.position[grid.indices[i + 1]].x
+			+ grid.position[grid.indices[i + 2]].x < 3 * 8.0f ? left : right;
+		side.insert(side.end(), grid.indices.begin() + i, grid.indices.begin() + i + 3);
+	}
+
+	Mesh::Indexed mesh;
+	mesh.vertex = grid.position;
+	mesh.index_type = GL_UNSIGNED_SHORT;
+	mesh.index16.assign(left.begin(), left.end());
+	mesh.index16.insert(mesh.index16.end(), right.begin(), right.end());
+	mesh.submeshes.push_back({ 0, 0, 0, (uint32_t)left.size(), 0, 0, Mesh::Bounds() });
+	mesh.submeshes.push_back({ 1, 0, (uint32_t)left.size(), (uint32_t)right.size(), 0, 0, Mesh::Bounds() });
+
+	Mesh::Indexed original = mesh;
+	MeshOptimize::CacheStats before, after;
+	mesh.optimize(MeshOptimize::DEFAULT_CACHE_SIZE, &before, &after);
+
+	CHECK(mesh.index16.size() == original.index16.size());
+	CHECK(mesh.vertex.size() == original.vertex.size());
+	CHECK(position_set(mesh, 0, left.size()) == position_set(original, 0, left.size()));
+	CHECK(position_set(mesh, left.size(), right.size()) == position_set(original, left.size(), right.size()));
+	CHECK(after.acmr < before.acmr);
+
+	// Vertices come in order of first use.
+	uint32_t next = 0;
+	bool in_order = true;
+	for (uint16_t i : mesh.index16) {
+		in_order &= i <= next;
+		if (i == next)
+			++next;
+	}
+	CHECK(in_order);
+}
+
+int main()
+{
+	test_vertex_cache();
+	test_vertex_fetch();
+	test_indexed_submeshes();
+
+	if (failures) {
+		std::cerr << failures << " check(s) failed\n";
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,155 @@
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "MeshSimplify.h"
+#include "TestCheck.h"
+
+// An n x n grid of quads in the xy plane, two triangles each, folded up
+// along x = n / 2 by fold (the slope of the right half). With split, every
+// triangle gets vertices of its own; otherwise vertices are shared, except
+// that the fold has one vertex per side when fold is set. Each vertex
+// carries the normal of its side as its attributes.
+struct Grid {
+	std::vector<vec3f> position;
+	std::vector<float> normal;
+	std::vector<uint32_t> indices;
+
+	Grid(size_t n, bool split, float fold = 0.0f) {
+		size_t half = n / 2;
+		float length = std::sqrt(fold * fold + 1.0f);
+		const float left[3] = { 0.0f, 0.0f, 1.0f };
+		const float right[3] = { -fold / length, 0.0f, 1.0f / length };
+
+		// shared[side][point] is the vertex of a grid point on one side.
+		std::vector<uint32_t> shared[2];
+		auto add = [&](size_t x, size_t y, int side) {
+			float z = x > half ? (x - half) * fold : 0.0f;
+			position.push_back(vec3f((float)x, (float)y, z));
+			normal.insert(normal.end(), side ? right : left, (side ? right : left) + 3);
+			return (uint32_t)(position.size() - 1);
+		};
+
+		for (int side = 0; side < 2; ++side) {
+			for (size_t y = 0; y <= n; ++y) {
+				for (size_t x = 0; x <= n; ++x) {
+					bool used = fold == 0.0f ? side == 0 : side ? x >= half : x <= half;
+					shared[side].push_back(used && !split ? add(x, y, side) : 0);
+				}
+			}
+		}
+
+		auto corner = [&](size_t x, size_t y, int side) {
+			if (fold == 0.0f)
+				side = 0;
+			else if (!split && x != half)
+				side = x > half;
+			return split ? add(x, y, side) : shared[side][y * (n + 1) + x];
+		};
+
+		for (size_t y = 0; y < n; ++y) {
+			for (size_t x = 0; x < n; ++x) {
+				int side = x >= half;
+				uint32_t a = corner(x, y, side), b = corner(x + 1, y, side);
+				uint32_t d = corner(x + 1, y + 1, side);
+				indices.insert(indices.end(), { a, b, d });
+				a = corner(x, y, side);
+				d = corner(x + 1, y + 1, side);
+				uint32_t c = corner(x, y + 1, side);
+				indices.insert(indices.end(), { a, d, c });
+			}
+		}
+	}
+
+	size_t simplify(std::vector<uint32_t> &out, size_t target, bool attributes, float *error = nullptr) const {
+		out.resize(indices.size());
+		size_t count = MeshSimplify::simplify(out.data(), indices.data(), indices.size(), position.data(),
+			position.size(), target, 1e30f, error, attributes ? normal.data() : nullptr, attributes ? 3 : 0);
+		out.resize(count);
+		return count;
+	}
+};
+
+static void test_flat_grid() {
+	std::vector<uint32_t> out;
+
+	Grid shared(64, false);
+	CHECK(shared.indices.size() == 24576);
+	float error = 1.0f;
+	CHECK(shared.simplify(out, 6144, true, &error) <= 6144);
+	CHECK(error < 1e-3f);
+
+	// Every corner split, but with equal attributes: the same as shared.
+	Grid split(64, true);
+	CHECK(split.position.size() == 24576);
+	CHECK(split.simplify(out, 6144, true) <= 6144);
+
+	// Without attributes each of those corners may differ from the others
+	// at its position, and no collapse could keep them apart.
+	CHECK(split.simplify(out, 6144, false) == split.indices.size());
+}
+
+static void test_split_normals() {
+	// Split normals along the fold, as generate_normals() makes for a hard
+	// edge.
+	const size_t n = 64;
+	Grid folded(n, false, 0.5f);
+	std::vector<uint32_t> out;
+	float error = 1.0f;
+	size_t count = folded.simplify(out, folded.indices.size() / 4, true, &error);
+	CHECK(count <= folded.indices.size() / 3);
+	CHECK(error < 1e-3f);
+
+	// No triangle mixes the sides, and the fold was simplified along its
+	// length rather than kept whole.
+	bool mixed = false;
+	std::vector<bool> fold_used(n + 1, false);
+	for (size_t i = 0; i < out.size(); i += 3) {
+		const float *n0 = &folded.normal[out[i] * 3];
+		for (int k = 1; k < 3; ++k)
+			mixed |= folded.normal[out[i + k] * 3] != n0[0];
+
+		for (int k = 0; k < 3; ++k) {
+			const vec3f &p = folded.position[out[i + k]];
+			if (p.x == n / 2)
+				fold_used[(size_t)p.y] = true;
+		}
+	}
+	CHECK(!mixed);
+
+	size_t fold_points = 0;
+	for (bool used : fold_used)
+		fold_points += used;
+	CHECK(fold_points >= 2 && fold_points < (n + 1) / 2);
+
+	// The same fold with every corner split simplifies the same way.
+	Grid split(n, true, 0.5f);
+	CHECK(split.simplify(out, split.indices.size() / 4, true) <= split.indices.size() / 3);
+}
+
+static void test_chain() {
+	Grid folded(32, false, 0.5f);
+	const size_t targets[3] = { folded.indices.size() / 2, folded.indices.size() / 4, folded.indices.size() / 8 };
+	std::vector<std::vector<uint32_t>> levels;
+	std::vector<float> errors;
+
+	MeshSimplify::simplify_chain(folded.indices.data(), folded.indices.size(), folded.position.data(),
+		folded.position.size(), targets, 3, 1e30f, levels, errors, folded.normal.data(), 3);
+	CHECK(levels.size() == 3);
+	for (size_t i = 0; i < levels.size(); ++i)
+		CHECK(levels[i].size() <= targets[i]);
+}
+
+int main()
+{
+	test_flat_grid();
+	test_split_normals();
+	test_chain();
+
+	if (failures) {
+		std::cerr << failures << " check(s) failed\n";
+		return 1;
+	}
+
+	return 0;
+}
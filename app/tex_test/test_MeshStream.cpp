@@ -0,0 +1,167 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "Mesh.h"
+#include "MeshStream.h"
+#include "TestCheck.h"
+
+static const char *obj_file = "test_MeshStream.obj";
+
+// Ten triangles, with every corner giving a position, a uv and a normal.
+static const char *fan_obj =
+	"v 0 0 0\n"
+	"v 1 0 0\n"
+	"v 1 1 0\n"
+	"v 0 1 0\n"
+	"v -1 1 0.5\n"
+	"v -1 0 0.5\n"
+	"v 0 -1 1\n"
+	"vt 0 0\n"
+	"vt 1 0\n"
+	"vt 1 1\n"
+	"vt 0 1\n"
+	"vn 0 0 1\n"
+	"vn 0 0.6 0.8\n"
+	"f 1/1/1 2/2/1 3/3/1\n"
+	"f 1/1/1 3/3/1 4/4/1\n"
+	"f 1/1/2 4/2/2 5/3/2\n"
+	"f 1/1/2 5/3/2 6/4/2\n"
+	"f 1/1/1 6/2/2 7/3/1\n"
+	"f 1/1/1 7/3/1 2/4/2\n"
+	"f 2/1/1 3/2/1 5/3/2\n"
+	"f 2/1/1 5/3/2 6/4/2\n"
+	"f 2/1/1 6/4/2 7/1/1\n"
+	"f 7/4/2 5/3/1 3/2/2\n";
+
+static void write_file(const std::string &filename, const std::string &contents) {
+	std::ofstream ofs(filename, std::ios_base::binary);
+	ofs << contents;
+}
+
+struct Collected {
+	std::vector<float> vertices;
+	std::vector<size_t> batch_sizes;
+	bool offsets_match = true;
+
+	MeshStream::Batch callback() {
+		return [this](size_t first_triangle, std::vector<float> &&batch) {
+			size_t floats_per_triangle = 3 * MeshStream::FLOATS_PER_VERTEX;
+			offsets_match &= first_triangle * floats_per_triangle == vertices.size();
+			offsets_match &= batch.size() % floats_per_triangle == 0;
+			batch_sizes.push_back(batch.size() / floats_per_triangle);
+			vertices.insert(vertices.end(), batch.begin(), batch.end());
+		};
+	}
+};
+
+static void test_matches_unpack() {
+	write_file(obj_file, fan_obj);
+
+	WavefrontObj obj(obj_file);
+	Mesh mesh(obj, 1);
+	Mesh::Unpacked unpacked = mesh.unpack_to_triangles(1);
+	CHECK(unpacked.vertex.size() == 30);
+	CHECK(unpacked.uv.size() == 30 && unpacked.normal.size() == 30);
+
+	std::vector<float> expected;
+	for (size_t i = 0; i < unpacked.vertex.size(); ++i) {
+		const vec3f &p = unpacked.vertex[i], &n = unpacked.normal[i];
+		const vec2f &t = unpacked.uv[i];
+		expected.insert(expected.end(), { p.x, p.y, p.z, t.x, t.y, n.x, n.y, n.z });
+	}
+
+	for (size_t batch : { 1, 2, 7 }) {
+		Collected collected;
+		MeshStream stream(batch, SIZE_MAX, collected.callback());
+		CHECK(WavefrontObj::stream(obj_file, stream));
+
+		// Only whole batches are handed on until finish().
+		CHECK(collected.vertices.size() == 10 / batch * batch * 3 * MeshStream::FLOATS_PER_VERTEX);
+		stream.finish();
+		stream.finish();
+
+		CHECK(stream.triangle_count() == 10);
+		CHECK(collected.offsets_match);
+		CHECK(collected.vertices == expected);
+		CHECK(collected.batch_sizes.size() == (10 + batch - 1) / batch);
+		for (size_t i = 0; i < collected.batch_sizes.size(); ++i) {
+			size_t size = i + 1 < collected.batch_sizes.size() ? batch : 10 - i * batch;
+			CHECK(collected.batch_sizes[i] == size);
+		}
+	}
+
+	// Past max_triangles, faces are dropped.
+	Collected capped;
+	MeshStream stream(2, 3, capped.callback());
+	CHECK(WavefrontObj::stream(obj_file, stream));
+	stream.finish();
+	CHECK(stream.triangle_count() == 3);
+	CHECK(capped.batch_sizes == std::vector<size_t>({ 2, 1 }));
+	CHECK(std::vector<float>(expected.begin(), expected.begin() + capped.vertices.size()) == capped.vertices);
+	CHECK(capped.vertices.size() == 3 * 3 * MeshStream::FLOATS_PER_VERTEX);
+
+	std::remove(obj_file);
+}
+
+static void test_missing_attributes() {
+	Collected collected;
+	MeshStream stream(4, SIZE_MAX, collected.callback());
+	const float position[3] = { 1, 2, 3 }, up[3] = { 0, 1, 0 };
+	stream.on_vertex(WavefrontObj::vec4f(position, 3));
+	stream.on_normal(WavefrontObj::vec3f(up, 3));
+
+	// One corner refers to a vertex that was not read yet, one to index 0,
+	// and none has a uv; only the first gives a normal.
+	WavefrontObj::face_desc face;
+	face.p1.have.v = face.p1.have.n = true;
+	face.p1.vertex = face.p1.normal = 1;
+	face.p2.have.v = true;
+	face.p2.vertex = 5;
+	face.p3.have.v = true;
+	face.p3.vertex = 0;
+	stream.on_face(face);
+	stream.finish();
+
+	const std::vector<float> expected = {
+		1, 2, 3, 0, 0, 0, 1, 0,
+		0, 0, 0, 0, 0, 0, 0, 1,
+		0, 0, 0, 0, 0, 0, 0, 1,
+	};
+	CHECK(collected.vertices == expected);
+}
+
+static void test_count_faces() {
+	const std::string text =
+		"v 0 0 0\n"
+		"f 1 1 1\n"
+		"  f 1 1 1\r\n"
+		"\tf\t1 1 1\n"
+		"# f 1 1 1\n"
+		"fo 1 1 1\n"
+		"f\n"
+		"\n"
+		"f 1 1 1";
+	CHECK(MeshStream::count_faces(text.data(), text.data() + text.size()) == 4);
+	CHECK(MeshStream::count_faces(text.data(), text.data()) == 0);
+
+	// Only the face lines of a real file.
+	CHECK(MeshStream::count_faces(fan_obj, fan_obj + std::strlen(fan_obj)) == 10);
+}
+
+int main()
+{
+	test_matches_unpack();
+	test_missing_attributes();
+	test_count_faces();
+
+	if (failures) {
+		std::cerr << failures << " check(s) failed\n";
+		return 1;
+	}
+
+	return 0;
+}
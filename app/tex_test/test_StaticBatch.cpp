@@ -0,0 +1,255 @@
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "StaticBatch.h"
+#include "TestCheck.h"
+
+// A unit quad in the xy plane with 16-bit indices. Its normals lean
+// towards +x, so that a non-uniform scale turns them.
+static Mesh::Indexed make_quad() {
+	Mesh::Indexed mesh;
+	mesh.vertex = { vec3f(0, 0, 0), vec3f(1, 0, 0), vec3f(1, 1, 0), vec3f(0, 1, 0) };
+	mesh.uv = { vec2f(0, 0), vec2f(1, 0), vec2f(1, 1), vec2f(0, 1) };
+	float s = 1.0f / std::sqrt(2.0f);
+	mesh.normal.assign(4, vec3f(s, 0, s));
+	mesh.index_type = GL_UNSIGNED_SHORT;
+	mesh.index16 = { 0, 1, 2, 0, 2, 3 };
+	return mesh;
+}
+
+// One triangle with 32-bit indices and neither uvs nor normals.
+static Mesh::Indexed make_triangle() {
+	Mesh::Indexed mesh;
+	mesh.vertex = { vec3f(0, 0, 0), vec3f(1, 0, 0), vec3f(0, 1, 0) };
+	mesh.index_type = GL_UNSIGNED_INT;
+	mesh.index32 = { 0, 1, 2 };
+	return mesh;
+}
+
+static bool near(float a, float b) {
+	return std::fabs(a - b) < 1e-5f;
+}
+
+static bool same_vertex(const float *v, const float (&expected)[8]) {
+	for (size_t k = 0; k < StaticBatch::FLOATS_PER_VERTEX; ++k) {
+		if (!near(v[k], expected[k]))
+			return false;
+	}
+	return true;
+}
+
+static const float *vertex(const StaticBatch &batch, size_t v) {
+	return batch.vertices().data() + v * StaticBatch::FLOATS_PER_VERTEX;
+}
+
+static bool same_range(const StaticBatch::Range &r, uint32_t base_vertex, uint32_t vertex_count,
+	uint32_t first_index, uint32_t index_count) {
+	return r.base_vertex == base_vertex && r.vertex_count == vertex_count
+		&& r.first_index == first_index && r.index_count == index_count;
+}
+
+// Indices of the object at handle, with its base vertex taken off again.
+static std::vector<uint32_t> local_indices(const StaticBatch &batch, StaticBatch::Handle handle) {
+	const StaticBatch::Range &r = batch.range(handle);
+	std::vector<uint32_t> out;
+	for (uint32_t i = 0; i < r.index_count; ++i)
+		out.push_back(batch.indices()[r.first_index + i] - r.base_vertex);
+	return out;
+}
+
+static const mat4 translate(1, 0, 0, 10,  0, 1, 0, 20,  0, 0, 1, 30,  0, 0, 0, 1);
+static const mat4 stretch(2, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1);
+static const mat4 mirror(-1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1);
+
+static void test_add() {
+	StaticBatch batch;
+	Mesh::Indexed quad = make_quad(), triangle = make_triangle();
+
+	StaticBatch::Handle a = batch.add(quad, translate);
+	StaticBatch::Handle b = batch.add(triangle, mirror);
+	StaticBatch::Handle c = batch.add(quad, stretch);
+
+	CHECK(batch.object_count() == 3);
+	CHECK(batch.vertex_count() == 11);
+	CHECK(batch.indices().size() == 15);
+	CHECK(same_range(batch.range(a), 0, 4, 0, 6));
+	CHECK(same_range(batch.range(b), 4, 3, 6, 3));
+	CHECK(same_range(batch.range(c), 7, 4, 9, 6));
+
+	// Indices are stored with the base vertex added.
+	const std::vector<uint32_t> expected_c = { 7, 8, 9, 7, 9, 10 };
+	CHECK(std::vector<uint32_t>(batch.indices().begin() + 9, batch.indices().end()) == expected_c);
+	CHECK(local_indices(batch, b) == std::vector<uint32_t>({ 0, 1, 2 }));
+
+	float s = 1.0f / std::sqrt(2.0f);
+
+	// A translation leaves the normals alone.
+	const float a2[8] = { 11, 21, 30, 1, 1, s, 0, s };
+	CHECK(same_vertex(vertex(batch, 2), a2));
+
+	// Mirrored, without normals or uvs: the default normal still faces
+	// +z, as the cofactor's sign puts it back out of the object.
+	const float b1[8] = { -1, 0, 0, 0, 0, 0, 0, 1 };
+	CHECK(same_vertex(vertex(batch, 5), b1));
+
+	// Stretched along x, the normal leans less towards x: (1/2, 0, 1)
+	// normalised.
+	float l = std::sqrt(1.25f);
+	const float c1[8] = { 2, 0, 0, 1, 0, 0.5f / l, 0, 1 / l };
+	CHECK(same_vertex(vertex(batch, 8), c1));
+
+	std::vector<MeshletCull::DrawRange> draws;
+	batch.get_draw_ranges(draws);
+	CHECK(draws.size() == 1 && draws[0].first_index == 0 && draws[0].index_count == 15);
+}
+
+static void test_remove_and_compact() {
+	StaticBatch batch;
+	Mesh::Indexed quad = make_quad(), triangle = make_triangle();
+
+	StaticBatch::Handle a = batch.add(quad, translate);
+	StaticBatch::Handle b = batch.add(triangle, mirror);
+	StaticBatch::Handle c = batch.add(quad, stretch);
+	StaticBatch::Handle d = batch.add(quad, translate);
+
+	// Three of fifteen vertices is under a quarter, so the hole stays.
+	batch.remove(b);
+	CHECK(!batch.contains(b));
+	CHECK(batch.contains(c));
+	CHECK(batch.object_count() == 3);
+	CHECK(batch.vertex_count() == 15);
+	CHECK(same_range(batch.range(c), 7, 4, 9, 6));
+
+	std::vector<MeshletCull::DrawRange> draws;
+	batch.get_draw_ranges(draws);
+	CHECK(draws.size() == 2);
+	CHECK(draws[0].first_index == 0 && draws[0].index_count == 6);
+	CHECK(draws[1].first_index == 9 && draws[1].index_count == 12);
+
+	batch.compact();
+	CHECK(batch.vertex_count() == 12);
+	CHECK(batch.indices().size() == 18);
+	CHECK(same_range(batch.range(a), 0, 4, 0, 6));
+	CHECK(same_range(batch.range(c), 4, 4, 6, 6));
+	CHECK(same_range(batch.range(d), 8, 4, 12, 6));
+
+	// Moved objects are rebased, and their vertices moved with them.
+	const std::vector<uint32_t> quad_indices = { 0, 1, 2, 0, 2, 3 };
+	CHECK(batch.indices()[6] == 4 && batch.indices()[17] == 11);
+	CHECK(local_indices(batch, c) == quad_indices);
+	CHECK(local_indices(batch, d) == quad_indices);
+
+	float l = std::sqrt(1.25f);
+	const float c1[8] = { 2, 0, 0, 1, 0, 0.5f / l, 0, 1 / l };
+	CHECK(same_vertex(vertex(batch, 5), c1));
+
+	float s = 1.0f / std::sqrt(2.0f);
+	const float d3[8] = { 10, 21, 30, 0, 1, s, 0, s };
+	CHECK(same_vertex(vertex(batch, 11), d3));
+
+	batch.get_draw_ranges(draws);
+	CHECK(draws.size() == 1 && draws[0].first_index == 0 && draws[0].index_count == 18);
+
+	// Removing two of the three quads passes a quarter and compacts on
+	// its own.
+	batch.remove(a);
+	batch.remove(c);
+	CHECK(batch.object_count() == 1);
+	CHECK(batch.vertex_count() == 4);
+	CHECK(same_range(batch.range(d), 0, 4, 0, 6));
+	CHECK(local_indices(batch, d) == quad_indices);
+	CHECK(same_vertex(vertex(batch, 3), d3));
+}
+
+static void test_handle_reuse() {
+	StaticBatch batch;
+	Mesh::Indexed quad = make_quad(), triangle = make_triangle();
+
+	StaticBatch::Handle a = batch.add(quad, translate);
+	StaticBatch::Handle b = batch.add(triangle, mirror);
+	StaticBatch::Handle c = batch.add(quad, stretch);
+	StaticBatch::Handle d = batch.add(quad, translate);
+
+	// A removed object is still in the arena until compaction, so its
+	// handle is not given out yet.
+	batch.remove(b);
+	CHECK(batch.object_count() == 3);
+	StaticBatch::Handle e = batch.add(triangle, mirror);
+	CHECK(e != a && e != b && e != c && e != d);
+	CHECK(batch.object_count() == 4);
+
+	// After compaction it is, and the new object gets its own range.
+	batch.compact();
+	StaticBatch::Handle f = batch.add(triangle, translate);
+	CHECK(f == b);
+	CHECK(batch.contains(f));
+	CHECK(batch.object_count() == 5);
+	CHECK(same_range(batch.range(e), 12, 3, 18, 3));
+	CHECK(same_range(batch.range(f), 15, 3, 21, 3));
+	CHECK(local_indices(batch, f) == std::vector<uint32_t>({ 0, 1, 2 }));
+
+	std::vector<MeshletCull::DrawRange> draws;
+	batch.get_draw_ranges(draws);
+	CHECK(draws.size() == 1 && draws[0].first_index == 0 && draws[0].index_count == 24);
+
+	// Handles keep being recycled rather than growing without bound.
+	for (int i = 0; i < 8; ++i) {
+		batch.remove(f);
+		batch.compact();
+		f = batch.add(triangle, translate);
+		CHECK(f == b);
+	}
+	CHECK(batch.object_count() == 5);
+}
+
+static void test_upload_plan() {
+	StaticBatch batch;
+	Mesh::Indexed quad = make_quad(), triangle = make_triangle();
+
+	StaticBatch::Handle a = batch.add(quad, translate);
+	batch.add(quad, translate);
+	batch.add(quad, translate);
+
+	// The first upload sends everything into buffers the size of the
+	// arenas' capacity.
+	StaticBatch::UploadPlan plan = batch.plan_upload();
+	CHECK(plan.reallocate);
+	CHECK(plan.buffer_vertices >= 12 && plan.buffer_indices >= 18);
+	CHECK(plan.first_vertex == 0 && plan.vertex_count == 12);
+	CHECK(plan.first_index == 0 && plan.index_count == 18);
+
+	plan = batch.plan_upload();
+	CHECK(!plan.reallocate && plan.vertex_count == 0 && plan.index_count == 0);
+
+	// Compaction moves what was uploaded, so everything goes again.
+	batch.remove(a);
+	batch.compact();
+	plan = batch.plan_upload();
+	CHECK(plan.reallocate);
+	CHECK(plan.first_vertex == 0 && plan.vertex_count == 8);
+	CHECK(plan.first_index == 0 && plan.index_count == 12);
+
+	// The arenas keep their capacity, so a small object after that is
+	// only appended.
+	batch.add(triangle, mirror);
+	plan = batch.plan_upload();
+	CHECK(!plan.reallocate);
+	CHECK(plan.first_vertex == 8 && plan.vertex_count == 3);
+	CHECK(plan.first_index == 12 && plan.index_count == 3);
+}
+
+int main()
+{
+	test_add();
+	test_remove_and_compact();
+	test_handle_reuse();
+	test_upload_plan();
+
+	if (failures) {
+		std::cerr << failures << " check(s) failed\n";
+		return 1;
+	}
+
+	return 0;
+}
@@ -8,6 +8,9 @@
 
 static App app;
 
+// Time each frame may spend creating GL objects for finished loads.
+static const double UPLOAD_BUDGET = 0.002;
+
 void display();
 
 void init() {
@@ -18,9 +21,33 @@ void init() {
 void display() {
 	glClearColor(0.8f, 0.8f, 0.8f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT);
-	
-	size_t count = app.get_triangle_count();
-	glDrawArrays(GL_TRIANGLES, 0, count);
+
+	// Keep frames coming while assets stream in.
+	if (app.update(UPLOAD_BUDGET))
+		glutPostRedisplay();
+
+	// The mesh is drawn straight in clip space, so one unit is half the
+	// window height.
+	static std::vector<MeshletCull::DrawRange> draws;
+	static std::vector<App::Batch> batches;
+	app.get_draw_ranges(glutGet(GLUT_WINDOW_HEIGHT) * 0.5f, draws, batches);
+
+	// Until the cooked mesh is in, draw what has streamed in of the raw
+	// triangles.
+	size_t streamed = app.get_streamed_vertex_count();
+	if (streamed != 0) {
+		app.use_material(Mesh::NO_MATERIAL);
+		glDrawArrays(GL_TRIANGLES, 0, (GLsizei)streamed);
+	}
+
+	for (const App::Batch &batch : batches) {
+		app.use_material(batch.material);
+
+		for (size_t i = batch.first_draw; i < batch.first_draw + batch.draw_count; ++i) {
+			glDrawElements(GL_TRIANGLES, draws[i].index_count, app.get_index_type(),
+				(void *)(draws[i].first_index * app.get_index_size()));
+		}
+	}
 	GLenum err = glGetError();
 	if (err != GL_NONE) {
 		std::cout << "Got error right on draw\n";
@@ -58,6 +85,7 @@ int main(int argc, char **argv)
 	init();
 	glutMainLoop();
 
+	app.shutdown();
 	glutDestroyWindow(win);
 	return 0;
 }
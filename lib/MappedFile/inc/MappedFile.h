@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/*
+Read-only memory mapping of a whole file. The mapping lives as long as the
+MappedFile object; pointers handed out by data() must not outlive it.
+An empty file opens successfully with data() == nullptr and size() == 0.
+*/
+
+class MappedFile {
+	const char *m_data;
+	size_t m_size;
+
+#ifdef _WIN32
+	void *m_file;
+	void *m_mapping;
+#else
+	int m_fd;
+#endif
+
+public:
+	MappedFile();
+	explicit MappedFile(const std::string &filename);
+	~MappedFile();
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	MappedFile(MappedFile &&other) noexcept;
+	MappedFile &operator=(MappedFile &&other) noexcept;
+
+	bool open(const std::string &filename);
+	void close();
+
+	// Hint to the OS that the mapping will be read front to back.
+	void advise_sequential() const;
+
+	// Getters
+	bool is_open() const;
+	const char *data() const { return m_data; }
+	size_t size() const { return m_size; }
+	const char *begin() const { return m_data; }
+	const char *end() const { return m_data + m_size; }
+
+private:
+	void release();
+	void take(MappedFile &other);
+};
@@ -0,0 +1,215 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+	: m_data(nullptr), m_size(0),
+#ifdef _WIN32
+	m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr)
+#else
+	m_fd(-1)
+#endif
+{
+}
+
+MappedFile::MappedFile(const std::string &filename)
+	: MappedFile()
+{
+	open(filename);
+}
+
+MappedFile::~MappedFile()
+{
+	release();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+	: MappedFile()
+{
+	take(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+	if (this != &other) {
+		release();
+		take(other);
+	}
+
+	return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string &filename)
+{
+	release();
+
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+		NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size)) {
+		CloseHandle(file);
+		return false;
+	}
+
+	m_file = file;
+	m_size = (size_t)size.QuadPart;
+
+	// CreateFileMapping refuses zero-length files, so an empty file is
+	// simply an open handle with no view.
+	if (m_size == 0) {
+		return true;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL) {
+		release();
+		return false;
+	}
+	m_mapping = mapping;
+
+	void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == NULL) {
+		release();
+		return false;
+	}
+
+	m_data = (const char *)view;
+	return true;
+}
+
+void MappedFile::advise_sequential() const
+{
+	// FILE_FLAG_SEQUENTIAL_SCAN was already passed at open time.
+}
+
+bool MappedFile::is_open() const
+{
+	return m_file != INVALID_HANDLE_VALUE;
+}
+
+void MappedFile::release()
+{
+	if (m_data) {
+		UnmapViewOfFile(m_data);
+	}
+	if (m_mapping) {
+		CloseHandle(m_mapping);
+	}
+	if (m_file != INVALID_HANDLE_VALUE) {
+		CloseHandle(m_file);
+	}
+
+	m_data = nullptr;
+	m_size = 0;
+	m_mapping = nullptr;
+	m_file = INVALID_HANDLE_VALUE;
+}
+
+void MappedFile::take(MappedFile &other)
+{
+	m_data = other.m_data;
+	m_size = other.m_size;
+	m_file = other.m_file;
+	m_mapping = other.m_mapping;
+
+	other.m_data = nullptr;
+	other.m_size = 0;
+	other.m_file = INVALID_HANDLE_VALUE;
+	other.m_mapping = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const std::string &filename)
+{
+	release();
+
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		::close(fd);
+		return false;
+	}
+
+	m_fd = fd;
+	m_size = (size_t)st.st_size;
+
+	// mmap() refuses zero-length mappings.
+	if (m_size == 0) {
+		return true;
+	}
+
+	// MAP_SHARED on a read-only descriptor maps the page cache directly, so
+	// every process mapping the same file shares the same physical pages.
+	void *addr = mmap(NULL, m_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED) {
+		release();
+		return false;
+	}
+
+	m_data = (const char *)addr;
+	return true;
+}
+
+void MappedFile::advise_sequential() const
+{
+	if (m_data) {
+		madvise((void *)m_data, m_size, MADV_SEQUENTIAL);
+	}
+}
+
+bool MappedFile::is_open() const
+{
+	return m_fd >= 0;
+}
+
+void MappedFile::release()
+{
+	if (m_data) {
+		munmap((void *)m_data, m_size);
+	}
+	if (m_fd >= 0) {
+		::close(m_fd);
+	}
+
+	m_data = nullptr;
+	m_size = 0;
+	m_fd = -1;
+}
+
+void MappedFile::take(MappedFile &other)
+{
+	m_data = other.m_data;
+	m_size = other.m_size;
+	m_fd = other.m_fd;
+
+	other.m_data = nullptr;
+	other.m_size = 0;
+	other.m_fd = -1;
+}
+
+#endif
+
+void MappedFile::close()
+{
+	release();
+}
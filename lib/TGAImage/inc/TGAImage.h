@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -71,11 +73,15 @@ public:
 		rgba(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255);
 	};
 
+	// Loads true colour (15, 16, 24 or 32-bit), grayscale (8-bit, or
+	// 16-bit with alpha) and colour-mapped (8 or 16-bit indices into 15 to
+	// 32-bit entries) images, uncompressed or RLE, into B, G, R, A pixels.
 	TGAImage();
 	TGAImage(std::string filename);
 	TGAImage(uint16_t width, uint16_t height, rgba fill = rgba(0, 0, 0));
 
-	void write(std::string filename) const;
+	// Always 32-bit true colour; with rle, RLE compressed (type 10).
+	void write(std::string filename, bool rle = false) const;
 	void reset();
 
 	int width() const;
@@ -91,7 +97,34 @@ public:
 
 	size_t computeOffset(uint16_t x, uint16_t y) const;
 
+	/*
+	Expands the RLE packets in [src, src_end) into pixel_count pixels of
+	pixel_bytes (1 to 4) bytes each at dst. Runs are written with 16-byte
+	stores that may run ahead of the packet, so bounds are only checked
+	once per packet. Returns the end of the packets used, or nullptr if one
+	would run past either buffer.
+	*/
+	static const uint8_t *decodeRLE(const uint8_t *src, const uint8_t *src_end, uint8_t *dst,
+		size_t pixel_count, size_t pixel_bytes);
+
+	/*
+	Appends RLE packets for width x height pixels to out. Each row is
+	encoded on its own, as TGA 2.0 asks, and any two or more equal pixels
+	become a run. Runs and the pairs that end raw packets are found by
+	comparing four pixels at a time.
+	*/
+	static void encodeRLE(const rgba *pixels, size_t width, size_t height, std::vector<uint8_t> &out);
+
 private:
+	// Bytes each pixel takes in the file, or 0 if the format is not
+	// supported.
+	static size_t storedPixelBytes(const Header &h);
+
+	// Turns the stored pixels at src, pixel_bytes each, into B, G, R, A at
+	// pixels. src may be the front of pixels; src_bytes is how much may be
+	// read from it, which the vector loads use as slack.
+	static bool expandPixels(const Header &h, const std::vector<uint8_t> &color_map,
+		const uint8_t *src, size_t src_bytes, rgba *pixels, size_t pixel_count, size_t pixel_bytes);
 
 	Header header;
 	std::vector<rgba> pixel_data;
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "MappedFile.h"
+#include "TGAImage.h"
+
+/*
+Read-only view of an uncompressed 32-bit true colour TGA file, with the
+pixels used straight from a memory mapping of it instead of being copied
+into a TGAImage. The mapping shares the page cache, so every process
+viewing the same file uses the same memory.
+
+Only files whose stored pixels already are B, G, R, A can be viewed;
+open() fails without a message for anything else, so callers can fall
+back to TGAImage. Pointers from getPixelData() must not outlive the view.
+*/
+
+class TGAImageView {
+public:
+	TGAImageView();
+	explicit TGAImageView(const std::string &filename);
+
+	TGAImageView(const TGAImageView &) = delete;
+	TGAImageView &operator=(const TGAImageView &) = delete;
+
+	TGAImageView(TGAImageView &&other) noexcept;
+	TGAImageView &operator=(TGAImageView &&other) noexcept;
+
+	bool open(const std::string &filename);
+	void close();
+	bool isOpen() const;
+
+	int width() const;
+	int height() const;
+
+	// width() * height() pixels, bottom row first as in the file.
+	const TGAImage::rgba *getPixelData() const;
+	TGAImage::rgba getPixel(uint16_t x, uint16_t y) const;
+	const TGAImage::Header &getHeader() const;
+
+	// Reads a byte of every page of pixels, so that whoever uses them
+	// next does not wait on the disk.
+	void prefetch() const;
+
+private:
+	MappedFile file;
+	TGAImage::Header header;
+	const TGAImage::rgba *pixels;
+};
@@ -1,9 +1,233 @@
 #include "TGAImage.h"
+#include "MappedFile.h"
 
 #include <string>
 #include <fstream>
+#include <algorithm>
+#include <cassert>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <type_traits>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TGAIMAGE_SSE2 1
+#include <emmintrin.h>
+#else
+#define TGAIMAGE_SSE2 0
+#endif
+
+namespace {
+
+// Runs are stored from a pattern of this many bytes, which is a whole
+// number of pixels for every pixel size from 1 to 4 bytes.
+const size_t PATTERN_BYTES = 48;
+
+inline void copy16(uint8_t *dst, const uint8_t *src)
+{
+#if TGAIMAGE_SSE2
+	_mm_storeu_si128((__m128i *)dst, _mm_loadu_si128((const __m128i *)src));
+#else
+	std::memcpy(dst, src, 16);
+#endif
+}
+
+// Fills pattern with copies of the pixel at src.
+inline void fill_pattern(uint8_t *pattern, const uint8_t *src, size_t pixel_bytes)
+{
+#if TGAIMAGE_SSE2
+	// Sizes that divide 16 are a single broadcast.
+	__m128i v;
+	switch (pixel_bytes) {
+	case 1: v = _mm_set1_epi8((char)src[0]); break;
+	case 2: v = _mm_set1_epi16((short)(src[0] | src[1] << 8)); break;
+	case 4: v = _mm_set1_epi32((int)(src[0] | src[1] << 8 | src[2] << 16 | (uint32_t)src[3] << 24)); break;
+	default: v = _mm_setzero_si128(); break;
+	}
+
+	if (pixel_bytes != 3) {
+		_mm_storeu_si128((__m128i *)pattern, v);
+		_mm_storeu_si128((__m128i *)(pattern + 16), v);
+		_mm_storeu_si128((__m128i *)(pattern + 32), v);
+		return;
+	}
+#endif
+
+	std::memcpy(pattern, src, pixel_bytes);
+	for (size_t filled = pixel_bytes; filled < PATTERN_BYTES; filled *= 2)
+		std::memcpy(pattern + filled, pattern, std::min(filled, PATTERN_BYTES - filled));
+}
+
+
+inline uint32_t load_pixel(const TGAImage::rgba *p)
+{
+	uint32_t v;
+	std::memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+inline int first_set(unsigned mask)
+{
+	int n = 0;
+	while (!(mask & 1)) {
+		mask >>= 1;
+		n++;
+	}
+	return n;
+}
+
+inline void store_pixel(uint8_t *dst, uint32_t v)
+{
+	std::memcpy(dst, &v, sizeof(v));
+}
+
+// A 16-bit A1R5G5B5 pixel as B, G, R, A, each 5-bit channel widened by
+// repeating its top bits. opaque is or'd in to ignore the attribute bit.
+inline uint32_t from_5551(uint16_t v, uint32_t opaque)
+{
+	uint32_t b = v & 0x1F, g = (v >> 5) & 0x1F, r = (v >> 10) & 0x1F;
+	b = b << 3 | b >> 2;
+	g = g << 3 | g >> 2;
+	r = r << 3 | r >> 2;
+	uint32_t a = (v & 0x8000) ? 0xFF000000u : 0;
+	return b | g << 8 | r << 16 | a | opaque;
+}
+
+/*
+Widens pixel_count stored pixels of pixel_bytes at src into 4-byte pixels at
+dst, last first, so dst may be the buffer src sits at the front of. Whole
+groups go through vector, which reads load_bytes at once, as long as that
+stays within the src_bytes there are; the rest through scalar. Every
+vector kernel writes 4 * group >= load_bytes bytes, so nothing is
+overwritten before it is read.
+*/
+struct NoVector {
+	void operator()(const uint8_t *, uint8_t *) const {}
+};
+
+template <class Scalar, class Vector>
+void widen(const uint8_t *src, size_t src_bytes, uint8_t *dst, size_t pixel_count, size_t pixel_bytes,
+	size_t group, size_t load_bytes, Scalar scalar, Vector vector)
+{
+	size_t groups = group != 0 && !std::is_same<Vector, NoVector>::value ? pixel_count / group : 0;
+	while (groups > 0 && (groups - 1) * group * pixel_bytes + load_bytes > src_bytes)
+		--groups;
+
+	for (size_t i = pixel_count; i-- > groups * group;)
+		scalar(src + i * pixel_bytes, dst + i * 4);
+
+	for (size_t g = groups; g-- > 0;)
+		vector(src + g * group * pixel_bytes, dst + g * group * 4);
+}
+
+#if TGAIMAGE_SSE2
+#define VECTOR_KERNEL(k) k
+
+// 16 gray bytes to 16 pixels.
+inline void expand_gray8(const uint8_t *src, uint8_t *dst)
+{
+	__m128i v = _mm_loadu_si128((const __m128i *)src);
+	__m128i ff = _mm_set1_epi8((char)0xFF);
+	__m128i gg_lo = _mm_unpacklo_epi8(v, v), ga_lo = _mm_unpacklo_epi8(v, ff);
+	__m128i gg_hi = _mm_unpackhi_epi8(v, v), ga_hi = _mm_unpackhi_epi8(v, ff);
+	_mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi16(gg_lo, ga_lo));
+	_mm_storeu_si128((__m128i *)(dst + 16), _mm_unpackhi_epi16(gg_lo, ga_lo));
+	_mm_storeu_si128((__m128i *)(dst + 32), _mm_unpacklo_epi16(gg_hi, ga_hi));
+	_mm_storeu_si128((__m128i *)(dst + 48), _mm_unpackhi_epi16(gg_hi, ga_hi));
+}
+
+// 8 gray and alpha pairs to 8 pixels.
+inline void expand_gray16(const uint8_t *src, uint8_t *dst)
+{
+	__m128i v = _mm_loadu_si128((const __m128i *)src);
+	__m128i gray = _mm_and_si128(v, _mm_set1_epi16(0xFF));
+	__m128i gg = _mm_or_si128(gray, _mm_slli_epi16(gray, 8));
+	_mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi16(gg, v));
+	_mm_storeu_si128((__m128i *)(dst + 16), _mm_unpackhi_epi16(gg, v));
+}
+
+// 4 B, G, R triples to 4 pixels. Reads 16 bytes, of which 12 are used.
+inline void expand_24(const uint8_t *src, uint8_t *dst)
+{
+	__m128i v = _mm_loadu_si128((const __m128i *)src);
+	__m128i p01 = _mm_unpacklo_epi32(v, _mm_srli_si128(v, 3));
+	__m128i p23 = _mm_unpacklo_epi32(_mm_srli_si128(v, 6), _mm_srli_si128(v, 9));
+	__m128i alpha = _mm_set1_epi32((int)0xFF000000u);
+	_mm_storeu_si128((__m128i *)dst, _mm_or_si128(_mm_unpacklo_epi64(p01, p23), alpha));
+}
+
+// 8 A1R5G5B5 pixels, as from_5551().
+inline void expand_5551(const uint8_t *src, uint8_t *dst, uint32_t opaque)
+{
+	__m128i v = _mm_loadu_si128((const __m128i *)src);
+	__m128i m5 = _mm_set1_epi16(0x1F);
+
+	__m128i b = _mm_and_si128(v, m5);
+	__m128i g = _mm_and_si128(_mm_srli_epi16(v, 5), m5);
+	__m128i r = _mm_and_si128(_mm_srli_epi16(v, 10), m5);
+	b = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+	g = _mm_or_si128(_mm_slli_epi16(g, 3), _mm_srli_epi16(g, 2));
+	r = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+
+	__m128i a = _mm_slli_epi16(_mm_srai_epi16(v, 15), 8);
+	a = _mm_or_si128(a, _mm_set1_epi16((short)(opaque >> 16)));
+
+	__m128i bg = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+	__m128i ra = _mm_or_si128(r, a);
+	_mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi16(bg, ra));
+	_mm_storeu_si128((__m128i *)(dst + 16), _mm_unpackhi_epi16(bg, ra));
+}
+#else
+// Without SSE2 everything goes through the scalar path.
+#define VECTOR_KERNEL(k) NoVector()
+#endif
+
+// How many of the first limit pixels equal the first.
+size_t run_length(const TGAImage::rgba *p, size_t limit)
+{
+	size_t k = 1;
+	uint32_t first = load_pixel(p);
+
+#if TGAIMAGE_SSE2
+	__m128i v = _mm_set1_epi32((int)first);
+	for (; k + 4 <= limit; k += 4) {
+		__m128i eq = _mm_cmpeq_epi32(v, _mm_loadu_si128((const __m128i *)(p + k)));
+		unsigned mask = (unsigned)_mm_movemask_ps(_mm_castsi128_ps(eq));
+		if (mask != 0xF)
+			return k + first_set(~mask);
+	}
+#endif
+
+	while (k < limit && load_pixel(p + k) == first)
+		++k;
+	return k;
+}
+
+// How many of the first limit pixels come before the first pair of equal
+// neighbours.
+size_t raw_length(const TGAImage::rgba *p, size_t limit)
+{
+	size_t k = 0;
+
+#if TGAIMAGE_SSE2
+	for (; k + 5 <= limit; k += 4) {
+		__m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(p + k)),
+			_mm_loadu_si128((const __m128i *)(p + k + 1)));
+		unsigned mask = (unsigned)_mm_movemask_ps(_mm_castsi128_ps(eq));
+		if (mask != 0)
+			return k + first_set(mask);
+	}
+#endif
+
+	for (; k + 1 < limit; ++k) {
+		if (load_pixel(p + k) == load_pixel(p + k + 1))
+			return k;
+	}
+	return limit;
+}
+
+}
 
 const size_t TGAImage::Header::size = 18;
 
@@ -106,53 +330,239 @@ TGAImage::TGAImage()
 
 TGAImage::TGAImage(std::string filename)
 {
-	std::ifstream file(filename, std::ios_base::binary);
+	MappedFile file(filename);
 
-	if (!file.is_open()) {
+	if (!file.is_open() || file.size() < Header::size) {
 		return;
 	}
 
-	std::vector<uint8_t> raw_header(Header::size, 0);
-	file.read((char *)raw_header.data(), Header::size);
-	if (!file.good()) {
-		return;
-	}
+	const uint8_t *begin = (const uint8_t *)file.begin();
+	const uint8_t *end = (const uint8_t *)file.end();
 
-	Header temp_header(raw_header);
+	Header temp_header(std::vector<uint8_t>(begin, begin + Header::size));
 
 	// Skip image ID data
-	file.seekg(temp_header.id_length, std::ios_base::cur);
-	// Skip color map data
-	file.seekg(temp_header.color_map.length, std::ios_base::cur);
+	const uint8_t *p = begin + Header::size + temp_header.id_length;
+
+	size_t color_map_bytes = 0;
+	if (temp_header.color_map_type != 0)
+		color_map_bytes = temp_header.color_map.length * (size_t)((temp_header.color_map.size + 7) / 8);
 
-	if (!file.good())
+	if ((size_t)(end - begin) < Header::size + temp_header.id_length + color_map_bytes)
 		return;
 
-	// Format: B, G, R, A
-	// Always integral number of bytes per pixel
-	if (temp_header.image_spec.bpp != 32) {
-		std::cerr << "TGAImage only supports loading 32-bit uncompressed files\n";
+	std::vector<uint8_t> color_map(p, p + color_map_bytes);
+	p += color_map_bytes;
+
+	size_t pixel_bytes = storedPixelBytes(temp_header);
+	if (pixel_bytes == 0) {
+		std::cerr << "TGAImage: unsupported image type " << (int)temp_header.image_type << " with "
+			<< (int)temp_header.image_spec.bpp << " bits per pixel\n";
 		return;
 	}
 
-	int width = temp_header.image_spec.width;
-	int height = temp_header.image_spec.height;
+	size_t pixel_count = (size_t)temp_header.image_spec.width * temp_header.image_spec.height;
 
+	// RLE pixels are decoded into the front of the buffer as stored, then
+	// widened in place; raw ones are widened straight out of the file.
 	std::vector<rgba> data_buffer;
-	data_buffer.resize(width * height, rgba());
-	char *data = (char *)data_buffer.data();
-
-	file.read(data, width * height * sizeof(rgba));
-	if (!file.good()) {
+	data_buffer.resize(pixel_count, rgba());
+	uint8_t *data = (uint8_t *)data_buffer.data();
+
+	const uint8_t *stored = p;
+	size_t stored_bytes = end - p;
+
+	if (temp_header.image_type >= RLE_COLOR_MAPPED) {
+		if (!decodeRLE(p, end, data, pixel_count, pixel_bytes)) {
+			std::cerr << "TGAImage: Corrupt RLE image data in \"" << filename << "\"\n";
+			return;
+		}
+		stored = data;
+		stored_bytes = pixel_count * sizeof(rgba);
+	}
+	else if (stored_bytes < pixel_count * pixel_bytes) {
 		std::cerr << "TGAImage: Failed to read image data block, expected size "
-			<< width * height << "\n";
+			<< pixel_count << "\n";
 		return;
 	}
 
+	if (!expandPixels(temp_header, color_map, stored, stored_bytes, data_buffer.data(), pixel_count,
+		pixel_bytes))
+		return;
+
 	pixel_data = std::move(data_buffer);
 	header = temp_header;
 }
 
+size_t TGAImage::storedPixelBytes(const Header &h)
+{
+	switch (h.image_type) {
+	case UNCOMPRESSED_TRUE_COLOR:
+	case RLE_TRUE_COLOR:
+		switch (h.image_spec.bpp) {
+		case 32: return 4;
+		case 24: return 3;
+		case 16:
+		case 15: return 2;
+		default: return 0;
+		}
+
+	case UNCOMPRESSED_GRAYSCALE:
+	case RLE_GRAYSCALE:
+		// 16-bit grayscale is a gray byte followed by an alpha byte.
+		return h.image_spec.bpp == 8 || h.image_spec.bpp == 16 ? h.image_spec.bpp / 8 : 0;
+
+	case UNCOMPRESSED_COLOR_MAPPED:
+	case RLE_COLOR_MAPPED:
+		if (h.color_map_type != 1 || (h.color_map.size != 15 && h.color_map.size != 16
+			&& h.color_map.size != 24 && h.color_map.size != 32))
+			return 0;
+		return h.image_spec.bpp == 8 || h.image_spec.bpp == 16 ? h.image_spec.bpp / 8 : 0;
+
+	default:
+		return 0;
+	}
+}
+
+bool TGAImage::expandPixels(const Header &h, const std::vector<uint8_t> &color_map,
+	const uint8_t *src, size_t src_bytes, rgba *pixels, size_t pixel_count, size_t pixel_bytes)
+{
+	uint8_t *dst = (uint8_t *)pixels;
+	bool mapped = h.image_type == UNCOMPRESSED_COLOR_MAPPED || h.image_type == RLE_COLOR_MAPPED;
+	bool gray = h.image_type == UNCOMPRESSED_GRAYSCALE || h.image_type == RLE_GRAYSCALE;
+
+	// The attribute bit of 16-bit pixels is only alpha if the header says
+	// there is any.
+	uint32_t opaque = h.image_spec.alpha.depth > 0 ? 0 : 0xFF000000u;
+
+	if (mapped) {
+		// Colour map entries widened once; indices outside the map stay
+		// black and transparent.
+		std::vector<uint32_t> table((size_t)1 << (8 * pixel_bytes), 0);
+		size_t entry_bytes = (h.color_map.size + 7) / 8;
+		uint32_t entry_opaque = h.color_map.size == 16 ? opaque : 0xFF000000u;
+
+		for (size_t entry = 0; entry < h.color_map.length; ++entry) {
+			size_t index = h.color_map.first_entry + entry;
+			if (index >= table.size())
+				break;
+
+			const uint8_t *e = color_map.data() + entry * entry_bytes;
+			switch (entry_bytes) {
+			case 2: table[index] = from_5551((uint16_t)(e[0] | e[1] << 8), entry_opaque); break;
+			case 3: table[index] = e[0] | e[1] << 8 | e[2] << 16 | 0xFF000000u; break;
+			default: table[index] = load_pixel((const rgba *)e); break;
+			}
+		}
+
+		const uint32_t *t = table.data();
+		if (pixel_bytes == 1)
+			widen(src, src_bytes, dst, pixel_count, 1, 0, 0,
+				[t](const uint8_t *s, uint8_t *d) { store_pixel(d, t[s[0]]); }, NoVector());
+		else
+			widen(src, src_bytes, dst, pixel_count, 2, 0, 0,
+				[t](const uint8_t *s, uint8_t *d) { store_pixel(d, t[s[0] | s[1] << 8]); }, NoVector());
+		return true;
+	}
+
+	if (gray && pixel_bytes == 1) {
+		widen(src, src_bytes, dst, pixel_count, 1, 16, 16,
+			[](const uint8_t *s, uint8_t *d) { store_pixel(d, s[0] * 0x010101u | 0xFF000000u); },
+			VECTOR_KERNEL(expand_gray8));
+		return true;
+	}
+
+	if (gray) {
+		widen(src, src_bytes, dst, pixel_count, 2, 8, 16,
+			[](const uint8_t *s, uint8_t *d) { store_pixel(d, s[0] * 0x010101u | (uint32_t)s[1] << 24); },
+			VECTOR_KERNEL(expand_gray16));
+		return true;
+	}
+
+	switch (pixel_bytes) {
+	case 2: {
+		uint32_t o = h.image_spec.bpp == 15 ? 0xFF000000u : opaque;
+		widen(src, src_bytes, dst, pixel_count, 2, 8, 16,
+			[o](const uint8_t *s, uint8_t *d) { store_pixel(d, from_5551((uint16_t)(s[0] | s[1] << 8), o)); },
+			VECTOR_KERNEL([o](const uint8_t *s, uint8_t *d) { expand_5551(s, d, o); }));
+		return true;
+	}
+
+	case 3:
+		widen(src, src_bytes, dst, pixel_count, 3, 4, 16,
+			[](const uint8_t *s, uint8_t *d) { store_pixel(d, s[0] | s[1] << 8 | s[2] << 16 | 0xFF000000u); },
+			VECTOR_KERNEL(expand_24));
+		return true;
+
+	default:
+		if (src != dst)
+			std::memcpy(dst, src, pixel_count * sizeof(rgba));
+		return true;
+	}
+}
+
+const uint8_t *TGAImage::decodeRLE(const uint8_t *src, const uint8_t *src_end, uint8_t *dst,
+	size_t pixel_count, size_t pixel_bytes)
+{
+	assert(pixel_bytes >= 1 && pixel_bytes <= 4);
+
+	uint8_t *const dst_end = dst + pixel_count * pixel_bytes;
+	uint8_t pattern[PATTERN_BYTES];
+
+	while (dst != dst_end) {
+		if (src == src_end)
+			return nullptr;
+
+		uint8_t packet = *src++;
+		size_t bytes = ((packet & 0x7f) + 1) * pixel_bytes;
+		size_t dst_left = dst_end - dst;
+		size_t src_left = src_end - src;
+
+		// The one check for the whole packet. Packets may not end past the
+		// image, and the wide stores need room to overshoot.
+		if (bytes > dst_left)
+			return nullptr;
+		bool dst_slack = dst_left >= bytes + PATTERN_BYTES;
+
+		if (packet & 0x80) {
+			if (src_left < pixel_bytes)
+				return nullptr;
+
+			fill_pattern(pattern, src, pixel_bytes);
+			src += pixel_bytes;
+
+			if (dst_slack) {
+				for (size_t i = 0; i < bytes; i += PATTERN_BYTES) {
+					copy16(dst + i, pattern);
+					copy16(dst + i + 16, pattern + 16);
+					copy16(dst + i + 32, pattern + 32);
+				}
+			}
+			else {
+				for (size_t i = 0; i < bytes; i += PATTERN_BYTES)
+					std::memcpy(dst + i, pattern, std::min(PATTERN_BYTES, bytes - i));
+			}
+		}
+		else {
+			if (src_left < bytes)
+				return nullptr;
+
+			if (dst_slack && src_left >= bytes + 16) {
+				for (size_t i = 0; i < bytes; i += 16)
+					copy16(dst + i, src + i);
+			}
+			else {
+				std::memcpy(dst, src, bytes);
+			}
+			src += bytes;
+		}
+
+		dst += bytes;
+	}
+
+	return src;
+}
+
 TGAImage::TGAImage(uint16_t width, uint16_t height, rgba fill)
 {
 	size_t size = width * height;
@@ -160,28 +570,86 @@ TGAImage::TGAImage(uint16_t width, uint16_t height, rgba fill)
 	header = Header::createFromParameters(width, height);
 }
 
-void TGAImage::write(std::string filename) const
+void TGAImage::write(std::string filename, bool rle) const
 {
 	std::ofstream ofs(filename, std::ios_base::out | std::ios_base::binary);
 	if (!ofs.is_open()) {
 		std::cerr << "Failed to open \"" << filename << "\" for writing\n";
 		return;
 	}
-	
-	const std::vector<uint8_t> header_buffer = header.serialize();
+
+	// Whatever the file was loaded from, pixel_data is B, G, R, A.
+	Header out = header;
+	out.id_length = 0;
+	out.color_map_type = 0;
+	out.color_map = { 0, 0, 0 };
+	out.image_type = rle ? RLE_TRUE_COLOR : UNCOMPRESSED_TRUE_COLOR;
+	out.image_spec.bpp = 32;
+	out.image_spec.alpha.depth = 8;
+
+	const std::vector<uint8_t> header_buffer = out.serialize();
 	ofs.write((char *)header_buffer.data(), header_buffer.size());
 	if (!ofs.good()) {
 		std::cerr << "Failed to write TGA header to file \"" << filename << "\"\n";
 		return;
 	}
 
-	ofs.write((char *)pixel_data.data(), pixel_data.size() * sizeof(rgba));
+	if (rle) {
+		// A band of rows at a time, so the buffer stays small and warm.
+		size_t row_bytes = std::max<size_t>(1, width() * sizeof(rgba));
+		size_t band = std::max<size_t>(1, (1 << 20) / row_bytes);
+		std::vector<uint8_t> packets;
+
+		for (size_t y = 0; y < (size_t)height() && ofs.good(); y += band) {
+			size_t rows = std::min(band, height() - y);
+			packets.clear();
+			encodeRLE(pixel_data.data() + y * width(), width(), rows, packets);
+			ofs.write((char *)packets.data(), packets.size());
+		}
+	}
+	else {
+		ofs.write((char *)pixel_data.data(), pixel_data.size() * sizeof(rgba));
+	}
+
 	if (!ofs.good()) {
 		std::cerr << "Failed to write TGA image date to file \"" << filename << "\"\n";
 		return;
 	}
 }
 
+void TGAImage::encodeRLE(const rgba *pixels, size_t width, size_t height, std::vector<uint8_t> &out)
+{
+	// At worst every pixel goes out raw, one header per 128.
+	size_t start = out.size();
+	out.resize(start + height * (width * sizeof(rgba) + (width + 127) / 128));
+	uint8_t *o = out.data() + start;
+
+	for (size_t y = 0; y < height; ++y) {
+		const rgba *row = pixels + y * width;
+
+		for (size_t x = 0; x < width;) {
+			size_t limit = std::min<size_t>(width - x, 128);
+
+			size_t run = run_length(row + x, limit);
+			if (run >= 2) {
+				*o++ = (uint8_t)(0x80 | (run - 1));
+				std::memcpy(o, row + x, sizeof(rgba));
+				o += sizeof(rgba);
+				x += run;
+				continue;
+			}
+
+			size_t raw = raw_length(row + x, limit);
+			*o++ = (uint8_t)(raw - 1);
+			std::memcpy(o, row + x, raw * sizeof(rgba));
+			o += raw * sizeof(rgba);
+			x += raw;
+		}
+	}
+
+	out.resize(o - out.data());
+}
+
 void TGAImage::reset()
 {
 	pixel_data.clear();
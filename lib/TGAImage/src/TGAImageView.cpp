@@ -0,0 +1,121 @@
+#include "TGAImageView.h"
+
+#include <utility>
+#include <vector>
+
+TGAImageView::TGAImageView()
+	: file(), header(), pixels(nullptr)
+{
+	header.image_spec.width = 0;
+	header.image_spec.height = 0;
+}
+
+TGAImageView::TGAImageView(const std::string &filename)
+	: TGAImageView()
+{
+	open(filename);
+}
+
+TGAImageView::TGAImageView(TGAImageView &&other) noexcept
+	: file(std::move(other.file)), header(other.header), pixels(other.pixels)
+{
+	other.close();
+}
+
+TGAImageView &TGAImageView::operator=(TGAImageView &&other) noexcept
+{
+	if (this != &other) {
+		file = std::move(other.file);
+		header = other.header;
+		pixels = other.pixels;
+		other.close();
+	}
+
+	return *this;
+}
+
+bool TGAImageView::open(const std::string &filename)
+{
+	close();
+
+	if (!file.open(filename) || file.size() < TGAImage::Header::size)
+		return false;
+
+	const uint8_t *begin = (const uint8_t *)file.begin();
+	TGAImage::Header h(std::vector<uint8_t>(begin, begin + TGAImage::Header::size));
+
+	if (h.image_type != TGAImage::UNCOMPRESSED_TRUE_COLOR || h.image_spec.bpp != 32) {
+		file.close();
+		return false;
+	}
+
+	// Skip the image ID and colour map, which true colour files may still
+	// carry.
+	size_t offset = TGAImage::Header::size + h.id_length;
+	if (h.color_map_type != 0)
+		offset += h.color_map.length * (size_t)((h.color_map.size + 7) / 8);
+
+	size_t pixel_bytes = (size_t)h.image_spec.width * h.image_spec.height * sizeof(TGAImage::rgba);
+	if (file.size() < offset || file.size() - offset < pixel_bytes) {
+		file.close();
+		return false;
+	}
+
+	header = h;
+	pixels = (const TGAImage::rgba *)(begin + offset);
+	return true;
+}
+
+void TGAImageView::close()
+{
+	file.close();
+	header = TGAImage::Header();
+	header.image_spec.width = 0;
+	header.image_spec.height = 0;
+	pixels = nullptr;
+}
+
+bool TGAImageView::isOpen() const
+{
+	return pixels != nullptr;
+}
+
+int TGAImageView::width() const
+{
+	return header.image_spec.width;
+}
+
+int TGAImageView::height() const
+{
+	return header.image_spec.height;
+}
+
+const TGAImage::rgba *TGAImageView::getPixelData() const
+{
+	return pixels;
+}
+
+TGAImage::rgba TGAImageView::getPixel(uint16_t x, uint16_t y) const
+{
+	return pixels[(size_t)y * header.image_spec.width + x];
+}
+
+const TGAImage::Header &TGAImageView::getHeader() const
+{
+	return header;
+}
+
+void TGAImageView::prefetch() const
+{
+	if (!pixels)
+		return;
+
+	file.advise_sequential();
+
+	const volatile uint8_t *p = (const volatile uint8_t *)pixels;
+	size_t bytes = (size_t)width() * height() * sizeof(TGAImage::rgba);
+	uint8_t sink = 0;
+	for (size_t i = 0; i < bytes; i += 4096)
+		sink ^= p[i];
+	(void)sink;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "TGAImage.h"
+
+// Helpers shared by the TGAImage tests.
+
+inline bool same_pixel(const TGAImage::rgba &a, const TGAImage::rgba &b) {
+	return a.b == b.b && a.g == b.g && a.r == b.r && a.a == b.a;
+}
+
+// Writes a file by hand: h, then extra (image ID and colour map bytes),
+// then data, whatever they hold.
+inline void write_tga(const std::string &filename, TGAImage::Header h, const std::vector<uint8_t> &extra,
+	const std::vector<uint8_t> &data) {
+	std::vector<uint8_t> header = h.serialize();
+	std::ofstream ofs(filename, std::ios_base::binary);
+	ofs.write((const char *)header.data(), header.size());
+	ofs.write((const char *)extra.data(), extra.size());
+	ofs.write((const char *)data.data(), data.size());
+}
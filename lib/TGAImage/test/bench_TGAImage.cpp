@@ -0,0 +1,376 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "TGAImage.h"
+
+/*
+Load-time benchmark for TGAImage.
+
+Generates images of three kinds, writes each both uncompressed and RLE
+compressed, and times:
+
+	load_raw      TGAImage(file), uncompressed
+	expand_naive  the stored pixels widened to B, G, R, A one at a time, for
+	              comparison with load_raw at 24, 16 and 8 bpp
+	copy          memcpy() of the loaded pixels, as the bandwidth to aim for
+	load_rle      TGAImage(file), RLE
+	decode_rle    TGAImage::decodeRLE() on packets already in memory
+	decode_naive  the same packets through a byte-at-a-time decoder, for
+	              comparison
+	encode_rle    TGAImage::encodeRLE(), 32 bpp only
+	encode_naive  a pixel-at-a-time encoder, for comparison
+	save_raw      TGAImage::write(), uncompressed, 32 bpp only
+	save_rle      TGAImage::write() with RLE, 32 bpp only
+
+The kinds are "flat" (large areas of one colour, like masks and UI art),
+"noise" (no two neighbours alike, so RLE only adds packet headers) and
+"mixed" (runs of 1 to 64 pixels, closer to painted textures).
+
+Each stage prints one JSON object per line on stdout; progress goes to
+stderr. mb_per_s is decoded pixel bytes per second, so raw and RLE loads
+compare directly; ratio is pixel bytes over file bytes. Stages run
+--repeat times and the fastest run counts.
+
+Usage: bench_TGAImage [options] [size...]
+	--kind flat|noise|mixed  only this kind (default all three)
+	--bpp 32|24|16|8         pixel size (default 32); 16 is A1R5G5B5 and 8
+	                         grayscale
+	--repeat n               runs per stage (default 5)
+	--dir path               where to write the generated files (default .)
+	--keep                   keep the generated files
+
+size is the width and height of the square image, 512 2048 4096 by
+default.
+*/
+
+typedef std::chrono::steady_clock bench_clock;
+
+static double seconds_since(bench_clock::time_point start) {
+	return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+enum Kind { FLAT, NOISE, MIXED };
+
+static const char *kind_names[] = { "flat", "noise", "mixed" };
+
+static std::vector<uint8_t> make_pixels(Kind kind, size_t size, size_t pixel_bytes) {
+	std::mt19937 rng((unsigned)size);
+	std::vector<uint8_t> pixels(size * size * pixel_bytes);
+
+	auto random_pixel = [&](uint8_t *p) {
+		for (size_t b = 0; b < pixel_bytes; ++b)
+			p[b] = (uint8_t)rng();
+	};
+
+	if (kind == NOISE) {
+		for (size_t i = 0; i < size * size; ++i)
+			random_pixel(&pixels[i * pixel_bytes]);
+	}
+	else if (kind == FLAT) {
+		// Blocks of 64x64 in a handful of colours.
+		std::vector<uint8_t> palette(8 * pixel_bytes);
+		for (size_t c = 0; c < 8; ++c)
+			random_pixel(&palette[c * pixel_bytes]);
+
+		for (size_t y = 0; y < size; ++y) {
+			for (size_t x = 0; x < size; ++x) {
+				size_t c = ((x / 64) * 7 + (y / 64) * 3) % 8;
+				std::memcpy(&pixels[(y * size + x) * pixel_bytes], &palette[c * pixel_bytes], pixel_bytes);
+			}
+		}
+	}
+	else {
+		uint8_t current[4];
+		for (size_t i = 0; i < size * size;) {
+			size_t run = std::min<size_t>(size * size - i, rng() % 64 + 1);
+			random_pixel(current);
+			for (size_t k = 0; k < run; ++k, ++i)
+				std::memcpy(&pixels[i * pixel_bytes], current, pixel_bytes);
+		}
+	}
+
+	return pixels;
+}
+
+// Greedy packets: a run as soon as two pixels repeat, raw otherwise. Runs
+// may cross rows, which the loader accepts.
+static std::vector<uint8_t> encode_naive(const std::vector<uint8_t> &pixels, size_t pixel_bytes) {
+	std::vector<uint8_t> out;
+	size_t count = pixels.size() / pixel_bytes;
+	const uint8_t *p = pixels.data();
+
+	auto same = [&](size_t a, size_t b) {
+		return std::memcmp(p + a * pixel_bytes, p + b * pixel_bytes, pixel_bytes) == 0;
+	};
+
+	for (size_t i = 0; i < count;) {
+		size_t run = 1;
+		while (i + run < count && run < 128 && same(i, i + run))
+			++run;
+
+		if (run > 1) {
+			out.push_back((uint8_t)(0x80 | (run - 1)));
+			out.insert(out.end(), p + i * pixel_bytes, p + (i + 1) * pixel_bytes);
+			i += run;
+			continue;
+		}
+
+		size_t raw = 1;
+		while (i + raw < count && raw < 128 && (i + raw + 1 >= count || !same(i + raw, i + raw + 1)))
+			++raw;
+
+		out.push_back((uint8_t)(raw - 1));
+		out.insert(out.end(), p + i * pixel_bytes, p + (i + raw) * pixel_bytes);
+		i += raw;
+	}
+
+	return out;
+}
+
+// A pixel at a time, checking every byte; roughly what a first version of
+// the decoder would look like.
+static bool decode_naive(const uint8_t *src, const uint8_t *src_end, uint8_t *dst, size_t pixel_count,
+	size_t pixel_bytes) {
+	size_t done = 0;
+
+	while (done < pixel_count) {
+		if (src >= src_end)
+			return false;
+
+		uint8_t packet = *src++;
+		size_t count = (packet & 0x7f) + 1;
+		bool run = (packet & 0x80) != 0;
+
+		for (size_t i = 0; i < count; ++i) {
+			if (done >= pixel_count)
+				return false;
+
+			const uint8_t *pixel = run ? src : src + i * pixel_bytes;
+			for (size_t b = 0; b < pixel_bytes; ++b) {
+				if (pixel + b >= src_end)
+					return false;
+				dst[done * pixel_bytes + b] = pixel[b];
+			}
+			++done;
+		}
+
+		src += run ? pixel_bytes : count * pixel_bytes;
+	}
+
+	return true;
+}
+
+// Stored pixels to B, G, R, A, the way a per-pixel loader would.
+static void expand_naive(const std::vector<uint8_t> &pixels, size_t pixel_bytes,
+	std::vector<TGAImage::rgba> &out) {
+	size_t count = pixels.size() / pixel_bytes;
+	out.resize(count);
+
+	for (size_t i = 0; i < count; ++i) {
+		const uint8_t *p = &pixels[i * pixel_bytes];
+		switch (pixel_bytes) {
+		case 1:
+			out[i] = TGAImage::rgba(p[0], p[0], p[0]);
+			break;
+		case 2: {
+			uint16_t v = (uint16_t)(p[0] | p[1] << 8);
+			uint8_t r = (v >> 10) & 31, g = (v >> 5) & 31, b = v & 31;
+			out[i] = TGAImage::rgba((uint8_t)(r << 3 | r >> 2), (uint8_t)(g << 3 | g >> 2),
+				(uint8_t)(b << 3 | b >> 2), v & 0x8000 ? 255 : 0);
+			break;
+		}
+		case 3:
+			out[i] = TGAImage::rgba(p[2], p[1], p[0]);
+			break;
+		default:
+			out[i] = TGAImage::rgba(p[2], p[1], p[0], p[3]);
+			break;
+		}
+	}
+}
+
+static void write_file(const std::string &filename, uint8_t type, size_t size, size_t pixel_bytes,
+	const std::vector<uint8_t> &data) {
+	TGAImage::Header h = TGAImage::Header::createFromParameters((uint16_t)size, (uint16_t)size);
+	h.image_type = type;
+	h.image_spec.bpp = (uint8_t)(pixel_bytes * 8);
+	h.image_spec.alpha.depth = pixel_bytes == 4 ? 8 : pixel_bytes == 2 ? 1 : 0;
+
+	std::vector<uint8_t> header = h.serialize();
+	std::ofstream ofs(filename, std::ios_base::binary);
+	ofs.write((const char *)header.data(), header.size());
+	ofs.write((const char *)data.data(), data.size());
+}
+
+template <class Fn>
+static double best_of(int repeat, Fn fn) {
+	double best = 1e30;
+	for (int i = 0; i < repeat; ++i) {
+		bench_clock::time_point start = bench_clock::now();
+		fn();
+		best = std::min(best, seconds_since(start));
+	}
+	return best;
+}
+
+static void report(const char *stage, Kind kind, size_t size, size_t pixel_bytes, size_t file_bytes,
+	double seconds) {
+	size_t pixel_data_bytes = size * size * pixel_bytes;
+	printf("{\"kind\":\"%s\",\"bpp\":%zu,\"size\":%zu,\"file_bytes\":%zu,\"ratio\":%.2f,"
+		"\"stage\":\"%s\",\"seconds\":%.6f,\"mb_per_s\":%.2f}\n",
+		kind_names[kind], pixel_bytes * 8, size, file_bytes, (double)pixel_data_bytes / file_bytes, stage,
+		seconds, pixel_data_bytes / 1e6 / seconds);
+	fflush(stdout);
+}
+
+static void bench_kind(Kind kind, size_t size, size_t pixel_bytes, int repeat, const std::string &dir,
+	bool keep) {
+	std::string base = dir + "/bench_" + kind_names[kind] + "_" + std::to_string(pixel_bytes * 8) + "_"
+		+ std::to_string(size);
+	std::string raw_file = base + "_raw.tga", rle_file = base + "_rle.tga";
+
+	std::cerr << "Generating " << base << "\n";
+	std::vector<uint8_t> pixels = make_pixels(kind, size, pixel_bytes);
+	std::vector<uint8_t> packets = encode_naive(pixels, pixel_bytes);
+
+	bool gray = pixel_bytes == 1;
+	write_file(raw_file, gray ? TGAImage::UNCOMPRESSED_GRAYSCALE : TGAImage::UNCOMPRESSED_TRUE_COLOR,
+		size, pixel_bytes, pixels);
+	write_file(rle_file, gray ? TGAImage::RLE_GRAYSCALE : TGAImage::RLE_TRUE_COLOR,
+		size, pixel_bytes, packets);
+
+	size_t raw_bytes = TGAImage::Header::size + pixels.size();
+	size_t rle_bytes = TGAImage::Header::size + packets.size();
+
+	bool ok = true;
+	report("load_raw", kind, size, pixel_bytes, raw_bytes, best_of(repeat, [&]() {
+		TGAImage image(raw_file);
+		ok &= image.width() == (int)size;
+	}));
+
+	std::vector<TGAImage::rgba> expanded;
+	report("expand_naive", kind, size, pixel_bytes, raw_bytes, best_of(repeat, [&]() {
+		expand_naive(pixels, pixel_bytes, expanded);
+	}));
+
+	TGAImage loaded(raw_file);
+	ok &= loaded.getPixelData().size() == expanded.size()
+		&& std::memcmp(loaded.getPixelData().data(), expanded.data(), expanded.size() * 4) == 0;
+
+	std::vector<TGAImage::rgba> copied(expanded.size());
+	report("copy", kind, size, pixel_bytes, raw_bytes, best_of(repeat, [&]() {
+		std::memcpy(copied.data(), loaded.getPixelData().data(), copied.size() * 4);
+	}));
+	report("load_rle", kind, size, pixel_bytes, rle_bytes, best_of(repeat, [&]() {
+		TGAImage image(rle_file);
+		ok &= image.width() == (int)size;
+	}));
+
+	std::vector<uint8_t> decoded(pixels.size());
+	report("decode_rle", kind, size, pixel_bytes, rle_bytes, best_of(repeat, [&]() {
+		ok &= TGAImage::decodeRLE(packets.data(), packets.data() + packets.size(), decoded.data(),
+			size * size, pixel_bytes) != nullptr;
+	}));
+	ok &= decoded == pixels;
+
+	std::fill(decoded.begin(), decoded.end(), 0);
+	report("decode_naive", kind, size, pixel_bytes, rle_bytes, best_of(repeat, [&]() {
+		ok &= decode_naive(packets.data(), packets.data() + packets.size(), decoded.data(),
+			size * size, pixel_bytes);
+	}));
+	ok &= decoded == pixels;
+
+	if (pixel_bytes == 4) {
+		TGAImage image(raw_file);
+		std::vector<uint8_t> encoded;
+		TGAImage::encodeRLE(image.getPixelData().data(), size, size, encoded);
+		size_t encoded_bytes = TGAImage::Header::size + encoded.size();
+
+		report("encode_rle", kind, size, pixel_bytes, encoded_bytes, best_of(repeat, [&]() {
+			encoded.clear();
+			TGAImage::encodeRLE(image.getPixelData().data(), size, size, encoded);
+		}));
+		report("encode_naive", kind, size, pixel_bytes, rle_bytes, best_of(repeat, [&]() {
+			ok &= encode_naive(pixels, pixel_bytes).size() == packets.size();
+		}));
+
+		std::string saved = base + "_saved.tga";
+		report("save_raw", kind, size, pixel_bytes, raw_bytes, best_of(repeat, [&]() {
+			image.write(saved);
+		}));
+		report("save_rle", kind, size, pixel_bytes, encoded_bytes, best_of(repeat, [&]() {
+			image.write(saved, true);
+		}));
+
+		TGAImage reloaded(saved);
+		ok &= reloaded.getPixelData().size() == size * size
+			&& std::memcmp(reloaded.getPixelData().data(), pixels.data(), pixels.size()) == 0;
+		std::remove(saved.c_str());
+	}
+
+	if (!ok)
+		std::cerr << "Decoded pixels do not match for " << base << "\n";
+
+	if (!keep) {
+		std::remove(raw_file.c_str());
+		std::remove(rle_file.c_str());
+	}
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<size_t> sizes;
+	std::vector<Kind> kinds = { FLAT, NOISE, MIXED };
+	size_t pixel_bytes = 4;
+	int repeat = 5;
+	std::string dir = ".";
+	bool keep = false;
+
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+
+		if (arg == "--kind" && i + 1 < argc) {
+			std::string kind = argv[++i];
+			kinds = { kind == "flat" ? FLAT : kind == "noise" ? NOISE : MIXED };
+		}
+		else if (arg == "--bpp" && i + 1 < argc) {
+			int bpp = std::atoi(argv[++i]);
+			pixel_bytes = bpp == 24 ? 3 : bpp == 16 ? 2 : bpp == 8 ? 1 : 4;
+		}
+		else if (arg == "--repeat" && i + 1 < argc) {
+			repeat = std::max(1, std::atoi(argv[++i]));
+		}
+		else if (arg == "--dir" && i + 1 < argc) {
+			dir = argv[++i];
+		}
+		else if (arg == "--keep") {
+			keep = true;
+		}
+		else {
+			sizes.push_back((size_t)std::strtoull(arg.c_str(), nullptr, 10));
+		}
+	}
+
+	if (sizes.empty())
+		sizes = { 512, 2048, 4096 };
+
+	for (size_t size : sizes) {
+		if (size == 0 || size > 65535) {
+			std::cerr << "Size " << size << " does not fit a TGA header\n";
+			return 1;
+		}
+
+		for (Kind kind : kinds)
+			bench_kind(kind, size, pixel_bytes, repeat, dir, keep);
+	}
+
+	return 0;
+}
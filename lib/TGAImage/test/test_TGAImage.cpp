@@ -1,6 +1,249 @@
 #include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
 
 #include "TGAImage.h"
+#include "TestCheck.h"
+#include "TGAImageTest.h"
+
+// Random runs and raw packets of pixel_bytes each, with the pixels they
+// stand for appended to pixels.
+static std::vector<uint8_t> make_packets(std::mt19937 &rng, size_t pixel_count, size_t pixel_bytes,
+	std::vector<uint8_t> &pixels) {
+	std::vector<uint8_t> packets;
+
+	for (size_t done = 0; done < pixel_count;) {
+		size_t count = std::min<size_t>(pixel_count - done, rng() % 128 + 1);
+		bool run = rng() % 2 == 0;
+
+		packets.push_back((uint8_t)((run ? 0x80 : 0) | (count - 1)));
+		for (size_t i = 0; i < (run ? 1 : count); ++i) {
+			for (size_t b = 0; b < pixel_bytes; ++b)
+				packets.push_back((uint8_t)rng());
+		}
+
+		for (size_t i = 0; i < count; ++i) {
+			const uint8_t *pixel = &packets[packets.size() - (run ? 1 : count - i) * pixel_bytes];
+			pixels.insert(pixels.end(), pixel, pixel + pixel_bytes);
+		}
+		done += count;
+	}
+
+	return packets;
+}
+
+static TGAImage::Header make_header(uint8_t type, uint16_t width, uint16_t height, uint8_t bpp) {
+	TGAImage::Header h = TGAImage::Header::createFromParameters(width, height);
+	h.image_type = type;
+	h.image_spec.bpp = bpp;
+	h.image_spec.alpha.depth = bpp == 32 ? 8 : 0;
+	return h;
+}
+
+void test_decode_rle() {
+	std::mt19937 rng(9);
+
+	for (size_t pixel_bytes = 1; pixel_bytes <= 4; ++pixel_bytes) {
+		for (size_t pixel_count : { 1, 2, 17, 128, 129, 1000, 65536 }) {
+			std::vector<uint8_t> expected;
+			std::vector<uint8_t> packets = make_packets(rng, pixel_count, pixel_bytes, expected);
+
+			// Exactly sized, so the last packets have no slack to overshoot into.
+			std::vector<uint8_t> decoded(pixel_count * pixel_bytes, 0xcd);
+			const uint8_t *end = TGAImage::decodeRLE(packets.data(), packets.data() + packets.size(),
+				decoded.data(), pixel_count, pixel_bytes);
+			CHECK(end == packets.data() + packets.size());
+			CHECK(decoded == expected);
+		}
+	}
+
+	// A run of 4 where 3 pixels are left, a truncated raw packet and a
+	// run header without its pixel are all refused.
+	uint8_t out[16];
+	const uint8_t too_long[] = { 0x83, 1, 2, 3, 4 };
+	CHECK(!TGAImage::decodeRLE(too_long, too_long + sizeof(too_long), out, 3, 4));
+	const uint8_t truncated[] = { 0x02, 1, 2, 3, 4, 5 };
+	CHECK(!TGAImage::decodeRLE(truncated, truncated + sizeof(truncated), out, 3, 2));
+	const uint8_t no_pixel[] = { 0x00, 7, 0x80 };
+	CHECK(!TGAImage::decodeRLE(no_pixel, no_pixel + sizeof(no_pixel), out, 2, 1));
+
+	// Data past the last pixel is left alone.
+	const uint8_t exact[] = { 0x81, 9, 0x00, 8, 0x55 };
+	CHECK(TGAImage::decodeRLE(exact, exact + sizeof(exact), out, 3, 1) == exact + 4);
+	CHECK(out[0] == 9 && out[1] == 9 && out[2] == 8);
+}
+
+void test_load_rle() {
+	std::mt19937 rng(10);
+	const uint16_t width = 37, height = 23;
+	const size_t count = (size_t)width * height;
+
+	// 32-bit true colour, the same pixels raw and RLE.
+	std::vector<uint8_t> pixels;
+	std::vector<uint8_t> packets = make_packets(rng, count, 4, pixels);
+	write_tga("rle_true_color.tga", make_header(TGAImage::RLE_TRUE_COLOR, width, height, 32), {}, packets);
+	write_tga("raw_true_color.tga", make_header(TGAImage::UNCOMPRESSED_TRUE_COLOR, width, height, 32), {}, pixels);
+
+	TGAImage rle("rle_true_color.tga");
+	TGAImage raw("raw_true_color.tga");
+	CHECK(rle.width() == width && rle.height() == height);
+	CHECK(raw.getPixelData().size() == count);
+	CHECK(std::memcmp(rle.getPixelData().data(), pixels.data(), count * 4) == 0);
+	CHECK(std::memcmp(raw.getPixelData().data(), pixels.data(), count * 4) == 0);
+
+	// Grayscale.
+	std::vector<uint8_t> grays;
+	packets = make_packets(rng, count, 1, grays);
+	write_tga("rle_gray.tga", make_header(TGAImage::RLE_GRAYSCALE, width, height, 8), {}, packets);
+	TGAImage gray("rle_gray.tga");
+	CHECK(gray.getPixelData().size() == count);
+	for (size_t i = 0; i < count && i < gray.getPixelData().size(); ++i)
+		CHECK(same_pixel(gray.getPixelData()[i], TGAImage::rgba(grays[i], grays[i], grays[i])));
+
+	// Colour-mapped with a 24-bit map of 200 entries starting at 10;
+	// other indices come out black and transparent.
+	TGAImage::Header mapped_header = make_header(TGAImage::RLE_COLOR_MAPPED, width, height, 8);
+	mapped_header.color_map_type = 1;
+	mapped_header.color_map = { 10, 200, 24 };
+	std::vector<uint8_t> color_map(200 * 3);
+	for (uint8_t &c : color_map)
+		c = (uint8_t)rng();
+
+	std::vector<uint8_t> indices;
+	packets = make_packets(rng, count, 1, indices);
+	write_tga("rle_mapped.tga", mapped_header, color_map, packets);
+	TGAImage mapped("rle_mapped.tga");
+	CHECK(mapped.getPixelData().size() == count);
+	for (size_t i = 0; i < count && i < mapped.getPixelData().size(); ++i) {
+		size_t entry = (size_t)indices[i] - 10;
+		TGAImage::rgba expected = indices[i] < 10 || entry >= 200 ? TGAImage::rgba()
+			: TGAImage::rgba(color_map[entry * 3 + 2], color_map[entry * 3 + 1], color_map[entry * 3]);
+		CHECK(same_pixel(mapped.getPixelData()[i], expected));
+	}
+
+	// Cut off halfway: nothing is loaded.
+	packets.resize(packets.size() / 2);
+	write_tga("rle_truncated.tga", mapped_header, color_map, packets);
+	TGAImage truncated("rle_truncated.tga");
+	CHECK(truncated.width() == 0 && truncated.getPixelData().empty());
+
+	for (const char *name : { "rle_true_color.tga", "raw_true_color.tga", "rle_gray.tga",
+		"rle_mapped.tga", "rle_truncated.tga" })
+		std::remove(name);
+}
+
+static TGAImage::rgba expected_5551(const uint8_t *p, bool alpha) {
+	uint16_t v = (uint16_t)(p[0] | p[1] << 8);
+	auto widen5 = [](uint32_t c) { return (uint8_t)(c << 3 | c >> 2); };
+	return TGAImage::rgba(widen5((v >> 10) & 31), widen5((v >> 5) & 31), widen5(v & 31),
+		alpha && !(v & 0x8000) ? 0 : 255);
+}
+
+void test_load_depths() {
+	std::mt19937 rng(12);
+
+	struct Case {
+		const char *name;
+		uint8_t type, bpp, alpha_depth, map_size;
+	};
+	const Case cases[] = {
+		{ "24-bit", TGAImage::UNCOMPRESSED_TRUE_COLOR, 24, 0, 0 },
+		{ "16-bit with alpha", TGAImage::UNCOMPRESSED_TRUE_COLOR, 16, 1, 0 },
+		{ "16-bit without alpha", TGAImage::UNCOMPRESSED_TRUE_COLOR, 16, 0, 0 },
+		{ "15-bit", TGAImage::UNCOMPRESSED_TRUE_COLOR, 15, 1, 0 },
+		{ "8-bit gray", TGAImage::UNCOMPRESSED_GRAYSCALE, 8, 0, 0 },
+		{ "16-bit gray", TGAImage::UNCOMPRESSED_GRAYSCALE, 16, 8, 0 },
+		{ "8-bit index, 32-bit map", TGAImage::UNCOMPRESSED_COLOR_MAPPED, 8, 8, 32 },
+		{ "8-bit index, 16-bit map", TGAImage::UNCOMPRESSED_COLOR_MAPPED, 8, 1, 16 },
+		{ "16-bit index, 24-bit map", TGAImage::UNCOMPRESSED_COLOR_MAPPED, 16, 0, 24 },
+	};
+
+	// Odd sizes, so the vector groups are followed by a scalar tail; raw
+	// files end right after the pixels, so the last groups have no slack.
+	for (const Case &c : cases) {
+		for (uint16_t width : { 1, 3, 17, 61 }) {
+			const uint16_t height = 5;
+			const size_t count = (size_t)width * height;
+			const size_t pixel_bytes = (c.bpp + 7) / 8;
+
+			TGAImage::Header h = make_header(c.type, width, height, c.bpp);
+			h.image_spec.alpha.depth = c.alpha_depth;
+
+			std::vector<uint8_t> color_map;
+			size_t entry_bytes = (c.map_size + 7) / 8;
+			if (c.map_size) {
+				h.color_map_type = 1;
+				h.color_map = { 3, 300, c.map_size };
+				color_map.resize(300 * entry_bytes);
+				for (uint8_t &e : color_map)
+					e = (uint8_t)rng();
+			}
+
+			std::vector<uint8_t> stored;
+			std::vector<uint8_t> packets = make_packets(rng, count, pixel_bytes, stored);
+
+			// 16-bit indices mostly inside the map, in the packets as well.
+			if (c.map_size && pixel_bytes == 2) {
+				for (size_t i = 1; i < stored.size(); i += 2)
+					stored[i] &= 1;
+				for (size_t p = 0; p < packets.size();) {
+					size_t pixels = packets[p] & 0x80 ? 1 : (packets[p] & 0x7f) + 1;
+					for (size_t i = 0; i < pixels; ++i)
+						packets[p + 2 + i * 2] &= 1;
+					p += 1 + pixels * 2;
+				}
+			}
+
+			std::vector<TGAImage::rgba> expected(count);
+			for (size_t i = 0; i < count; ++i) {
+				const uint8_t *s = &stored[i * pixel_bytes];
+				if (c.map_size) {
+					size_t index = pixel_bytes == 2 ? (size_t)(s[0] | s[1] << 8) : s[0];
+					if (index < 3 || index >= 303)
+						continue;
+					const uint8_t *e = &color_map[(index - 3) * entry_bytes];
+					if (entry_bytes == 2)
+						expected[i] = expected_5551(e, c.alpha_depth > 0);
+					else
+						expected[i] = TGAImage::rgba(e[2], e[1], e[0], entry_bytes == 4 ? e[3] : 255);
+				}
+				else if (c.type == TGAImage::UNCOMPRESSED_GRAYSCALE)
+					expected[i] = TGAImage::rgba(s[0], s[0], s[0], pixel_bytes == 2 ? s[1] : 255);
+				else if (pixel_bytes == 2)
+					expected[i] = expected_5551(s, c.bpp == 16 && c.alpha_depth > 0);
+				else
+					expected[i] = TGAImage::rgba(s[2], s[1], s[0]);
+			}
+
+			// Raw and RLE.
+			for (bool rle : { false, true }) {
+				TGAImage::Header file_header = h;
+				if (rle)
+					file_header.image_type += TGAImage::RLE_COLOR_MAPPED - TGAImage::UNCOMPRESSED_COLOR_MAPPED;
+				write_tga("depth.tga", file_header, color_map, rle ? packets : stored);
+
+				TGAImage image("depth.tga");
+				bool same = image.getPixelData().size() == count;
+				for (size_t i = 0; same && i < count; ++i)
+					same = same_pixel(image.getPixelData()[i], expected[i]);
+				if (!same)
+					std::cerr << c.name << (rle ? " RLE" : " raw") << ", width " << width << ":\n";
+				CHECK(same);
+			}
+		}
+	}
+
+	// Depths with no meaning are still refused.
+	write_tga("depth.tga", make_header(TGAImage::UNCOMPRESSED_TRUE_COLOR, 2, 2, 12), {}, std::vector<uint8_t>(8));
+	TGAImage refused("depth.tga");
+	CHECK(refused.getPixelData().empty());
+
+	std::remove("depth.tga");
+}
 
 void test_read_modify_write() {
 	TGAImage image("800x600white.tga");
@@ -57,9 +300,130 @@ void test_write_1x1() {
 	pixel.write("pixel.tga");
 }
 
+// The encoder's rules one pixel at a time: per row, a run for two or more
+// equal pixels, otherwise raw up to the next such pair.
+static std::vector<uint8_t> encode_reference(const TGAImage &image) {
+	std::vector<uint8_t> out;
+	const std::vector<TGAImage::rgba> &pixels = image.getPixelData();
+	size_t width = image.width();
+
+	for (size_t y = 0; y < (size_t)image.height(); ++y) {
+		const uint8_t *row = (const uint8_t *)(pixels.data() + y * width);
+		auto same = [row](size_t a, size_t b) { return std::memcmp(row + a * 4, row + b * 4, 4) == 0; };
+
+		for (size_t x = 0; x < width;) {
+			size_t limit = std::min<size_t>(width - x, 128);
+			size_t run = 1;
+			while (run < limit && same(x, x + run))
+				++run;
+
+			if (run >= 2) {
+				out.push_back((uint8_t)(0x80 | (run - 1)));
+				out.insert(out.end(), row + x * 4, row + x * 4 + 4);
+				x += run;
+				continue;
+			}
+
+			size_t raw = 1;
+			while (raw < limit && !(raw + 1 < limit && same(x + raw, x + raw + 1)))
+				++raw;
+			out.push_back((uint8_t)(raw - 1));
+			out.insert(out.end(), row + x * 4, row + (x + raw) * 4);
+			x += raw;
+		}
+	}
+
+	return out;
+}
+
+void test_encode_rle() {
+	std::mt19937 rng(11);
+
+	for (uint16_t width : { 1, 2, 5, 127, 128, 129, 300 }) {
+		const uint16_t height = 7;
+		TGAImage image(width, height);
+
+		// Runs of 1 to 200 pixels of a few colours, carried across rows.
+		TGAImage::rgba colors[3] = { TGAImage::rgba(1, 2, 3), TGAImage::rgba(1, 2, 3, 0), TGAImage::rgba(9, 9, 9) };
+		size_t left = 0, c = 0;
+		for (uint16_t y = 0; y < height; ++y) {
+			for (uint16_t x = 0; x < width; ++x) {
+				if (left == 0) {
+					left = rng() % 4 == 0 ? rng() % 200 + 1 : 1;
+					c = rng() % 3;
+				}
+				--left;
+				image.setPixel(x, y, colors[c]);
+			}
+		}
+
+		std::vector<uint8_t> packets;
+		TGAImage::encodeRLE(image.getPixelData().data(), width, height, packets);
+		CHECK(packets == encode_reference(image));
+
+		// No packet crosses a row, so the rows decode one at a time.
+		const uint8_t *p = packets.data();
+		std::vector<uint8_t> row(width * 4);
+		for (uint16_t y = 0; y < height && p; ++y) {
+			p = TGAImage::decodeRLE(p, packets.data() + packets.size(), row.data(), width, 4);
+			CHECK(p && std::memcmp(row.data(), image.getPixelData().data() + y * width, width * 4) == 0);
+		}
+		CHECK(p == packets.data() + packets.size());
+
+		image.write("encoded.tga", true);
+		TGAImage loaded("encoded.tga");
+		CHECK(loaded.getHeader().image_type == TGAImage::RLE_TRUE_COLOR);
+		CHECK(loaded.width() == width && loaded.height() == height);
+		CHECK(loaded.getPixelData().size() == image.getPixelData().size());
+		CHECK(std::memcmp(loaded.getPixelData().data(), image.getPixelData().data(),
+			image.getPixelData().size() * 4) == 0);
+	}
+
+	// A flat image shrinks to a run per 128 pixels; noise grows only by
+	// the packet headers.
+	TGAImage flat(1024, 64, TGAImage::rgba(10, 20, 30));
+	flat.write("encoded.tga", true);
+	TGAImage flat_loaded("encoded.tga");
+	CHECK(flat_loaded.getPixelData().size() == 1024 * 64);
+	std::vector<uint8_t> packets;
+	TGAImage::encodeRLE(flat.getPixelData().data(), 1024, 64, packets);
+	CHECK(packets.size() == 64 * 8 * 5);
+
+	TGAImage noise(256, 16);
+	for (uint16_t y = 0; y < 16; ++y) {
+		for (uint16_t x = 0; x < 256; ++x)
+			noise.setPixel(x, y, TGAImage::rgba((uint8_t)x, (uint8_t)y, (uint8_t)rng(), 255));
+	}
+	packets.clear();
+	TGAImage::encodeRLE(noise.getPixelData().data(), 256, 16, packets);
+	CHECK(packets.size() == 16 * (256 * 4 + 2));
+
+	// An image loaded as 8-bit grayscale is written back as 32-bit.
+	std::vector<uint8_t> grays(8 * 8, 77);
+	write_tga("gray.tga", make_header(TGAImage::UNCOMPRESSED_GRAYSCALE, 8, 8, 8), {}, grays);
+	TGAImage gray("gray.tga");
+	gray.write("encoded.tga");
+	TGAImage gray_loaded("encoded.tga");
+	CHECK(gray_loaded.getHeader().image_spec.bpp == 32 && gray_loaded.getPixelData().size() == 64);
+	CHECK(same_pixel(gray_loaded.getPixel(3, 3), TGAImage::rgba(77, 77, 77)));
+
+	std::remove("encoded.tga");
+	std::remove("gray.tga");
+}
+
 int main()
 {
 	test_write_2();
+	test_decode_rle();
+	test_load_rle();
+	test_encode_rle();
+	test_load_depths();
+
+	if (failures) {
+		std::cerr << failures << " check(s) failed\n";
+		return 1;
+	}
+
 	return 0;
 }
 
@@ -0,0 +1,113 @@
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "TGAImage.h"
+#include "TGAImageView.h"
+#include "TestCheck.h"
+#include "TGAImageTest.h"
+
+static bool same_pixels(const TGAImageView &view, const TGAImage &image) {
+	return view.isOpen() && view.width() == image.width() && view.height() == image.height()
+		&& std::memcmp(view.getPixelData(), image.getPixelData().data(),
+			image.getPixelData().size() * sizeof(TGAImage::rgba)) == 0;
+}
+
+void test_view_written() {
+	TGAImage image(37, 11);
+	for (uint16_t y = 0; y < 11; ++y) {
+		for (uint16_t x = 0; x < 37; ++x)
+			image.setPixel(x, y, TGAImage::rgba((uint8_t)x, (uint8_t)y, (uint8_t)(x * y), (uint8_t)(x + y)));
+	}
+	image.write("view.tga");
+
+	TGAImageView view("view.tga");
+	CHECK(same_pixels(view, image));
+	CHECK(view.getHeader().image_spec.bpp == 32);
+	TGAImage::rgba p = view.getPixel(5, 7);
+	CHECK(p.r == 5 && p.g == 7 && p.b == 35 && p.a == 12);
+	view.prefetch();
+
+	// Moving hands the mapping over.
+	TGAImageView moved(std::move(view));
+	CHECK(!view.isOpen() && view.getPixelData() == nullptr && view.width() == 0);
+	CHECK(same_pixels(moved, image));
+
+	view = std::move(moved);
+	CHECK(same_pixels(view, image));
+	CHECK(!moved.isOpen());
+
+	view.close();
+	CHECK(!view.isOpen() && view.width() == 0 && view.height() == 0);
+
+	std::remove("view.tga");
+}
+
+void test_view_offsets() {
+	// An image ID and a colour map ahead of true colour pixels are skipped.
+	TGAImage::Header h = TGAImage::Header::createFromParameters(3, 2);
+	h.id_length = 5;
+	h.color_map_type = 1;
+	h.color_map = { 0, 4, 24 };
+
+	std::vector<uint8_t> extra(5 + 4 * 3, 0xee);
+	std::vector<uint8_t> pixels(3 * 2 * 4);
+	for (size_t i = 0; i < pixels.size(); ++i)
+		pixels[i] = (uint8_t)i;
+	write_tga("view.tga", h, extra, pixels);
+
+	TGAImageView view("view.tga");
+	TGAImage image("view.tga");
+	CHECK(view.isOpen());
+	CHECK(same_pixels(view, image));
+	CHECK(std::memcmp(view.getPixelData(), pixels.data(), pixels.size()) == 0);
+
+	std::remove("view.tga");
+}
+
+void test_view_refused() {
+	std::vector<uint8_t> pixels(4 * 4 * 4, 1);
+
+	// RLE and narrower pixels need decoding, so only TGAImage loads them.
+	TGAImage::Header rle = TGAImage::Header::createFromParameters(4, 4);
+	rle.image_type = TGAImage::RLE_TRUE_COLOR;
+	write_tga("view.tga", rle, {}, { 0x8f, 1, 2, 3, 4 });
+	CHECK(!TGAImageView("view.tga").isOpen());
+	CHECK(TGAImage("view.tga").width() == 4);
+
+	TGAImage::Header narrow = TGAImage::Header::createFromParameters(4, 4);
+	narrow.image_spec.bpp = 24;
+	write_tga("view.tga", narrow, {}, pixels);
+	CHECK(!TGAImageView("view.tga").isOpen());
+
+	// Too short for its pixels, too short for a header, or missing.
+	TGAImage::Header h = TGAImage::Header::createFromParameters(4, 4);
+	write_tga("view.tga", h, {}, std::vector<uint8_t>(pixels.size() - 1));
+	CHECK(!TGAImageView("view.tga").isOpen());
+
+	std::ofstream("view.tga", std::ios_base::binary) << "TGA";
+	CHECK(!TGAImageView("view.tga").isOpen());
+
+	std::remove("view.tga");
+	TGAImageView missing;
+	CHECK(!missing.open("view.tga"));
+	CHECK(missing.getPixelData() == nullptr);
+}
+
+int main()
+{
+	test_view_written();
+	test_view_offsets();
+	test_view_refused();
+
+	if (failures) {
+		std::cerr << failures << " check(s) failed\n";
+		return 1;
+	}
+
+	return 0;
+}
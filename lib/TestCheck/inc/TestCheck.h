@@ -0,0 +1,19 @@
+#pragma once
+
+#include <iostream>
+
+/*
+CHECK() for the test executables. A failed check prints its file, line and
+condition and counts towards failures; main() returns non-zero if any did,
+so ctest sees the failure without the test stopping at the first one.
+*/
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed\n"; \
+			++failures; \
+		} \
+	} while (0)
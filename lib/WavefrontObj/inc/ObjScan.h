@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "WavefrontObj.h"
+
+/*
+Numeric scanning layer for the records WavefrontObj cares about. Everything
+here works on [p, end) byte ranges and never allocates.
+
+ - Delimiter searches use SSE2 when it is available, 16 bytes per step.
+ - Runs of eight digits are decoded at once (SWAR), which covers most
+   mantissas and indices in a single step.
+ - Floats are rounded exactly and without reference to the locale: short
+   inputs take the Clinger fast path, everything else goes through the
+   Eisel-Lemire algorithm, and the rare inputs neither can decide
+   (more than 19 significant digits, halfway cases) fall back to
+   std::from_chars().
+
+The accepted syntax matches what operator>> accepts for the same records,
+so switching a caller over does not change what gets parsed.
+*/
+
+struct ObjScan {
+	static inline bool is_space(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+	}
+
+	static inline const char *skip_space(const char *p, const char *end)
+	{
+		while (p != end && is_space(*p))
+			++p;
+		return p;
+	}
+
+	// First whitespace byte at or after p, or end.
+	static const char *skip_token(const char *p, const char *end);
+
+	// Parses one float starting at p. On success p is moved past it.
+	static bool scan_float(const char *&p, const char *end, float &out);
+
+	// Reads floats until the range runs out or one fails to parse; a failed
+	// one is stored as 0 and ends the list. Returns how many were read,
+	// which may be more than max (only the first max are stored).
+	static size_t scan_float_list(const char *p, const char *end, float *out, size_t max);
+
+	// Equivalent of "std::istringstream(str) >> value" for a size_t, on a
+	// token that contains no whitespace: failure gives 0, overflow gives
+	// SIZE_MAX, and "-n" wraps around.
+	static size_t scan_index(const char *p, const char *end);
+
+	// Decodes one "v", "v/vt", "v//vn" or "v/vt/vn" face corner token.
+	static WavefrontObj::face_vertex_desc scan_face_corner(const char *p, const char *end);
+
+	// Eisel-Lemire: w * 10^q rounded to the nearest float. Returns false if
+	// the product is too close to a halfway point to decide.
+	static bool compute_float(uint64_t w, int64_t q, bool negative, float &out);
+
+private:
+	static WavefrontObj::face_vertex_desc scan_face_corner_slow(const char *p, const char *end);
+};
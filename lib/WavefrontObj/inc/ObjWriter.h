@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "WavefrontObj.h"
+
+/*
+Writes a WavefrontObj back out as .obj text that parses back to exactly the
+same data: the same float bits, face indices, object/group/material runs
+and material libraries. Tools that generate meshes fill one in through
+data() and hand it here.
+
+ - Floats are printed with std::to_chars() in its shortest round-trip form
+   (Ryu in libstdc++ and MSVC), never through a stream or the locale. A w
+   of 1 and a third uv component of +0 are left out, as the parser fills
+   them in.
+ - Indices are written absolute, and every corner in the form its have
+   flags call for.
+ - Records are formatted into blocks of about WRITE_BUFFER_SIZE bytes,
+   each written with one call. With thread_count other than 1, that many
+   blocks are formatted at once and then written in order, so memory use
+   stays bounded whatever the file size.
+*/
+
+struct ObjWriter {
+	static const size_t WRITE_BUFFER_SIZE = 4 * 1024 * 1024;
+
+	// Enough for any float written by format_float().
+	static const size_t MAX_FLOAT_CHARS = 16;
+
+	// thread_count 0 means one thread per hardware thread.
+	static bool write(const std::string &filename, WavefrontObj &obj, unsigned thread_count = 1);
+
+	// The same text, appended to out.
+	static void format(std::string &out, WavefrontObj &obj, unsigned thread_count = 1);
+
+	// Writes the shortest text that reads back as value, and returns the
+	// end of it.
+	static char *format_float(char *p, float value);
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/*
+Wavefront .mtl material library, as referenced from a .obj file by
+"mtllib". Only the colour, shininess, opacity and texture map records are
+read; anything else (PBR extensions, reflection maps, ...) is skipped
+without a warning, since exporters add their own freely.
+*/
+
+class WavefrontMtl {
+public:
+	struct Material {
+		std::string name;
+
+		float ambient[3];
+		float diffuse[3];
+		float specular[3];
+		float emissive[3];
+		float shininess;
+		// "d", or 1 - "Tr".
+		float opacity;
+		int illum;
+
+		// Texture filenames as written in the file; map options such as
+		// "-s 1 1 1" are dropped.
+		std::string ambient_map;
+		std::string diffuse_map;
+		std::string specular_map;
+		std::string opacity_map;
+		std::string bump_map;
+
+		explicit Material(std::string_view name = std::string_view());
+	};
+
+	static const uint32_t NOT_FOUND = UINT32_MAX;
+
+private:
+	std::vector<Material> material_list;
+	std::unordered_map<std::string, uint32_t> index;
+
+public:
+	WavefrontMtl();
+	explicit WavefrontMtl(const std::string &filename);
+
+	// Adds the materials of filename. A material defined again replaces
+	// the earlier definition.
+	bool load(const std::string &filename);
+	void parse(const char *begin, const char *end);
+
+	// Loads each library named in a .obj file, resolved relative to the
+	// directory of obj_filename. Returns how many could be read.
+	size_t load_libraries(const std::vector<std::string> &libraries, const std::string &obj_filename);
+
+	// The file load_libraries() reads for library.
+	static std::string library_path(const std::string &library, const std::string &obj_filename);
+
+	size_t size() const;
+	const Material &material(uint32_t i) const;
+	uint32_t find(std::string_view name) const;
+
+private:
+	void parse_line(std::string_view line, uint32_t &current);
+};
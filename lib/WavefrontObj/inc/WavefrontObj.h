@@ -1,18 +1,34 @@
 #pragma once
 
+#include <cstdint>
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 class WavefrontObj {
 public:
 	static const size_t MAX_LINE_LENGTH = 256;
 
+	enum ParseMode {
+		// ifstream::getline() + stringstream per line, limited to MAX_LINE_LENGTH.
+		PARSE_STREAM,
+		// mmap the whole file and tokenise straight from the mapped bytes.
+		PARSE_MAPPED,
+		// PARSE_MAPPED, split into line-aligned chunks parsed on all cores.
+		PARSE_PARALLEL
+	};
+
+	// Chunks smaller than this are not worth a thread of their own.
+	static const size_t MIN_PARALLEL_CHUNK = 256 * 1024;
+
 	struct vec4f {
 		float x, y, z, w;
 
 		vec4f();
 		vec4f(std::vector<float> &vec);
+		vec4f(const float *values, size_t count);
 	};
 
 	struct vec3f {
@@ -20,6 +36,7 @@ public:
 
 		vec3f();
 		vec3f(std::vector<float> &vec);
+		vec3f(const float *values, size_t count);
 	};
 
 	struct face_vertex_desc {
@@ -40,36 +57,203 @@ public:
 		face_desc();
 	};
 
+	/*
+	Stored faces: one uint32_t stream per attribute, three entries per face
+	in corner order. Indices are 1-based as in the file, relative ones
+	already resolved; 0 marks a corner that did not give the attribute. The
+	uv and normal streams are only allocated once a face uses them, which
+	mask records, so a position-only file stores 12 bytes per face.
+	Indices are kept to 32 bits, enough for 4G elements of each kind.
+	*/
+	struct FaceIndices {
+		enum Attribute : uint8_t {
+			VERTEX = 1,
+			UV = 2,
+			NORMAL = 4
+		};
+
+		std::vector<uint32_t> vertex;
+		std::vector<uint32_t> uv;
+		std::vector<uint32_t> normal;
+		uint8_t mask;
+
+		FaceIndices();
+
+		size_t size() const;
+		bool empty() const;
+		bool has(Attribute attr) const;
+
+		// Face i expanded back into a face_desc; have flags are set for the
+		// non-zero indices.
+		face_desc operator[](size_t face) const;
+
+		void push_back(const face_desc &face);
+		// Resizes every stream in mask to face_count faces, new corners
+		// having no index.
+		void resize(size_t face_count, uint8_t mask);
+		void clear();
+
+	private:
+		void add_stream(Attribute attr);
+	};
+
+	// Faces from first_face up to the first_face of the next run were
+	// given under the state directive naming name.
+	struct face_run {
+		size_t first_face;
+		uint32_t name;
+	};
+
+	static const uint32_t NO_NAME = UINT32_MAX;
+
+	/*
+	The names set by one kind of state directive ("o", "g" or "usemtl"),
+	each stored once, and the runs of faces they apply to. Faces before the
+	first run have NO_NAME.
+	*/
+	struct FaceRuns {
+		std::vector<std::string> names;
+		std::vector<face_run> runs;
+
+		// Index of name in names, added if it is new.
+		uint32_t intern(std::string_view name);
+		// Starts a run at face, unless it would not change anything.
+		void begin(size_t face, uint32_t name);
+		// Name of the run that contains face.
+		uint32_t name_of(size_t face) const;
+
+	private:
+		std::unordered_map<std::string, uint32_t> index;
+	};
+
+	/*
+	Axis-aligned box around a set of positions, and the sphere around that
+	box, for culling. An empty box has min above max, so adding the first
+	point sets both.
+	*/
+	struct Bounds {
+		float min[3];
+		float max[3];
+
+		Bounds();
+
+		bool empty() const;
+		void add(float x, float y, float z);
+		// Grows to contain other as well.
+		void merge(const Bounds &other);
+
+		// Centre of the box, and half its diagonal.
+		void sphere(float center[3], float &radius) const;
+	};
+
+	/*
+	Receives records one at a time from WavefrontObj::stream(), in file
+	order, without anything being stored. Face indices arrive resolved
+	(relative indices already made absolute). Override what you need;
+	the defaults ignore the record.
+	*/
+	class Visitor {
+	public:
+		virtual ~Visitor();
+
+		virtual void on_object(std::string_view name);
+		virtual void on_group(std::string_view name);
+		virtual void on_material(std::string_view name);
+		virtual void on_material_library(std::string_view filename);
+		virtual void on_vertex(const vec4f &v);
+		virtual void on_uv(const vec3f &uv);
+		virtual void on_normal(const vec3f &n);
+		virtual void on_face(const face_desc &f);
+	};
+
+	// Read size used by stream(); a line longer than this grows the buffer.
+	static const size_t STREAM_BUFFER_SIZE = 4 * 1024 * 1024;
+
+	// View of everything parsed, without copying it.
 	struct MeshData {
 		std::vector<vec4f> &vert;
 		std::vector<vec3f> &norm;
 		std::vector<vec3f> &uv;
-		std::vector<face_desc> &f;
+		FaceIndices &f;
 
 		MeshData(std::vector<vec4f> &a, std::vector<vec3f> &b,
-			std::vector<vec3f> &c, std::vector<face_desc> &d);
+			std::vector<vec3f> &c, FaceIndices &d);
 	};
 
 
 private:
+	// A face index given relative to the end of its list ("f -1 -2 -3").
+	// Only recorded while parsing a chunk for parse_parallel(): the chunk
+	// resolves it against its own counts, and the merge adds the counts of
+	// every chunk before it.
+	struct relative_ref {
+		size_t face;
+		uint8_t corner;
+		uint8_t attr;
+	};
+
 	std::string object_name;
 
+	FaceRuns object_runs;
+	FaceRuns group_runs;
+	FaceRuns material_runs;
+	std::vector<std::string> material_libs;
+
 	std::vector<vec4f> vert;
 	std::vector<vec3f> norm;
 	std::vector<vec3f> uv;
-	std::vector<face_desc> f;
+	FaceIndices f;
+
+	std::vector<relative_ref> relative_refs;
+	bool track_relative;
+
+	// Bounds of vert so far, four lanes wide so each vertex is a single
+	// min and max. The fourth lane tracks w and is ignored.
+	float bounds_min[4];
+	float bounds_max[4];
 
 
 public:
 	WavefrontObj();
-	explicit WavefrontObj(std::string filename);
+	explicit WavefrontObj(std::string filename, ParseMode mode = PARSE_STREAM);
 	~WavefrontObj();
 
 	MeshData data();
 
+	// Which object, group and material ("o", "g", "usemtl") each face
+	// was given under.
+	const FaceRuns &objects() const;
+	const FaceRuns &groups() const;
+	const FaceRuns &materials() const;
+
+	// Every file named by "mtllib", in order, as written in the file.
+	const std::vector<std::string> &material_libraries() const;
+
+	// Box around every "v" position, gathered while parsing, so it costs
+	// no pass of its own. Vertices added through data() afterwards are
+	// not counted.
+	Bounds bounds() const;
+
 	void parse(std::ifstream &ifs);
 	void parse_line(std::string &line);
 
+	// Allocation-free path: [begin, end) is the whole file, usually a mapping.
+	// Produces exactly the same vert/norm/uv/f as parse().
+	void parse_mapped(const char *begin, const char *end);
+	void parse_line(std::string_view line);
+
+	// Same result as parse_mapped(), with the work split over thread_count
+	// threads (0 means one per hardware thread).
+	void parse_parallel(const char *begin, const char *end, unsigned thread_count = 0);
+
+	// Feeds a whole file through visitor, reading buffer_size bytes at a
+	// time, so memory use is bounded by the buffer and not by the file.
+	static bool stream(const std::string &filename, Visitor &visitor,
+		size_t buffer_size = STREAM_BUFFER_SIZE);
+
+	// Feeds data already in memory (e.g. a MappedFile) through visitor.
+	static void visit(const char *begin, const char *end, Visitor &visitor);
+
 	void process_object_name(std::stringstream &ss);
 	void process_vertex_coord(std::stringstream &ss);
 	void process_vertex_normal_coord(std::stringstream &ss);
@@ -81,4 +265,23 @@ public:
 	face_vertex_desc parse_two_param(std::string & arg);
 	face_vertex_desc parse_three_param(std::string & arg);
 
+	void process_object_name(std::string_view args);
+	void process_vertex_coord(std::string_view args);
+	void process_vertex_normal_coord(std::string_view args);
+	void process_uv_coord(std::string_view args);
+	void process_face(std::string_view args);
+	void process_group(std::string_view args);
+	void process_material(std::string_view args);
+	void process_material_library(std::string_view args);
+
+	face_vertex_desc parse_face_arg(std::string_view arg);
+
+private:
+	void load_stream(const std::string &filename);
+	void load_mapped(const std::string &filename, bool parallel);
+
+	void resolve_relative(face_desc &desc);
+	void add_vertex(const vec4f &v);
+	void append_chunk(WavefrontObj &chunk, size_t v_base, size_t uv_base, size_t n_base,
+		size_t f_base);
 };
\ No newline at end of file
@@ -0,0 +1,642 @@
+#include "ObjScan.h"
+
+#include <algorithm>
+#include <cassert>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OBJSCAN_SSE2 1
+#include <emmintrin.h>
+#else
+#define OBJSCAN_SSE2 0
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define OBJSCAN_SWAR 0
+#else
+#define OBJSCAN_SWAR 1
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+/*
+128-bit approximations of 5^q for the exponents a float can reach from a
+mantissa of at most 19 digits, normalised so the top bit is set. Positive
+powers are truncated, negative ones are the rounded-up reciprocal, exactly
+as the Eisel-Lemire paper and fast_float use them.
+*/
+const int SMALLEST_POWER_OF_TEN = -65;
+const int LARGEST_POWER_OF_TEN = 38;
+
+const uint64_t power_of_five_128[] = {
+	0x86ccbb52ea94baeaULL, 0x98e947129fc2b4e9ULL, // 5^-65
+	0xa87fea27a539e9a5ULL, 0x3f2398d747b36224ULL, // 5^-64
+	0xd29fe4b18e88640eULL, 0x8eec7f0d19a03aadULL, // 5^-63
+	0x83a3eeeef9153e89ULL, 0x1953cf68300424acULL, // 5^-62
+	0xa48ceaaab75a8e2bULL, 0x5fa8c3423c052dd7ULL, // 5^-61
+	0xcdb02555653131b6ULL, 0x3792f412cb06794dULL, // 5^-60
+	0x808e17555f3ebf11ULL, 0xe2bbd88bbee40bd0ULL, // 5^-59
+	0xa0b19d2ab70e6ed6ULL, 0x5b6aceaeae9d0ec4ULL, // 5^-58
+	0xc8de047564d20a8bULL, 0xf245825a5a445275ULL, // 5^-57
+	0xfb158592be068d2eULL, 0xeed6e2f0f0d56712ULL, // 5^-56
+	0x9ced737bb6c4183dULL, 0x55464dd69685606bULL, // 5^-55
+	0xc428d05aa4751e4cULL, 0xaa97e14c3c26b886ULL, // 5^-54
+	0xf53304714d9265dfULL, 0xd53dd99f4b3066a8ULL, // 5^-53
+	0x993fe2c6d07b7fabULL, 0xe546a8038efe4029ULL, // 5^-52
+	0xbf8fdb78849a5f96ULL, 0xde98520472bdd033ULL, // 5^-51
+	0xef73d256a5c0f77cULL, 0x963e66858f6d4440ULL, // 5^-50
+	0x95a8637627989aadULL, 0xdde7001379a44aa8ULL, // 5^-49
+	0xbb127c53b17ec159ULL, 0x5560c018580d5d52ULL, // 5^-48
+	0xe9d71b689dde71afULL, 0xaab8f01e6e10b4a6ULL, // 5^-47
+	0x9226712162ab070dULL, 0xcab3961304ca70e8ULL, // 5^-46
+	0xb6b00d69bb55c8d1ULL, 0x3d607b97c5fd0d22ULL, // 5^-45
+	0xe45c10c42a2b3b05ULL, 0x8cb89a7db77c506aULL, // 5^-44
+	0x8eb98a7a9a5b04e3ULL, 0x77f3608e92adb242ULL, // 5^-43
+	0xb267ed1940f1c61cULL, 0x55f038b237591ed3ULL, // 5^-42
+	0xdf01e85f912e37a3ULL, 0x6b6c46dec52f6688ULL, // 5^-41
+	0x8b61313bbabce2c6ULL, 0x2323ac4b3b3da015ULL, // 5^-40
+	0xae397d8aa96c1b77ULL, 0xabec975e0a0d081aULL, // 5^-39
+	0xd9c7dced53c72255ULL, 0x96e7bd358c904a21ULL, // 5^-38
+	0x881cea14545c7575ULL, 0x7e50d64177da2e54ULL, // 5^-37
+	0xaa242499697392d2ULL, 0xdde50bd1d5d0b9e9ULL, // 5^-36
+	0xd4ad2dbfc3d07787ULL, 0x955e4ec64b44e864ULL, // 5^-35
+	0x84ec3c97da624ab4ULL, 0xbd5af13bef0b113eULL, // 5^-34
+	0xa6274bbdd0fadd61ULL, 0xecb1ad8aeacdd58eULL, // 5^-33
+	0xcfb11ead453994baULL, 0x67de18eda5814af2ULL, // 5^-32
+	0x81ceb32c4b43fcf4ULL, 0x80eacf948770ced7ULL, // 5^-31
+	0xa2425ff75e14fc31ULL, 0xa1258379a94d028dULL, // 5^-30
+	0xcad2f7f5359a3b3eULL, 0x096ee45813a04330ULL, // 5^-29
+	0xfd87b5f28300ca0dULL, 0x8bca9d6e188853fcULL, // 5^-28
+	0x9e74d1b791e07e48ULL, 0x775ea264cf55347eULL, // 5^-27
+	0xc612062576589ddaULL, 0x95364afe032a819eULL, // 5^-26
+	0xf79687aed3eec551ULL, 0x3a83ddbd83f52205ULL, // 5^-25
+	0x9abe14cd44753b52ULL, 0xc4926a9672793543ULL, // 5^-24
+	0xc16d9a0095928a27ULL, 0x75b7053c0f178294ULL, // 5^-23
+	0xf1c90080baf72cb1ULL, 0x5324c68b12dd6339ULL, // 5^-22
+	0x971da05074da7beeULL, 0xd3f6fc16ebca5e04ULL, // 5^-21
+	0xbce5086492111aeaULL, 0x88f4bb1ca6bcf585ULL, // 5^-20
+	0xec1e4a7db69561a5ULL, 0x2b31e9e3d06c32e6ULL, // 5^-19
+	0x9392ee8e921d5d07ULL, 0x3aff322e62439fd0ULL, // 5^-18
+	0xb877aa3236a4b449ULL, 0x09befeb9fad487c3ULL, // 5^-17
+	0xe69594bec44de15bULL, 0x4c2ebe687989a9b4ULL, // 5^-16
+	0x901d7cf73ab0acd9ULL, 0x0f9d37014bf60a11ULL, // 5^-15
+	0xb424dc35095cd80fULL, 0x538484c19ef38c95ULL, // 5^-14
+	0xe12e13424bb40e13ULL, 0x2865a5f206b06fbaULL, // 5^-13
+	0x8cbccc096f5088cbULL, 0xf93f87b7442e45d4ULL, // 5^-12
+	0xafebff0bcb24aafeULL, 0xf78f69a51539d749ULL, // 5^-11
+	0xdbe6fecebdedd5beULL, 0xb573440e5a884d1cULL, // 5^-10
+	0x89705f4136b4a597ULL, 0x31680a88f8953031ULL, // 5^-9
+	0xabcc77118461cefcULL, 0xfdc20d2b36ba7c3eULL, // 5^-8
+	0xd6bf94d5e57a42bcULL, 0x3d32907604691b4dULL, // 5^-7
+	0x8637bd05af6c69b5ULL, 0xa63f9a49c2c1b110ULL, // 5^-6
+	0xa7c5ac471b478423ULL, 0x0fcf80dc33721d54ULL, // 5^-5
+	0xd1b71758e219652bULL, 0xd3c36113404ea4a9ULL, // 5^-4
+	0x83126e978d4fdf3bULL, 0x645a1cac083126eaULL, // 5^-3
+	0xa3d70a3d70a3d70aULL, 0x3d70a3d70a3d70a4ULL, // 5^-2
+	0xccccccccccccccccULL, 0xcccccccccccccccdULL, // 5^-1
+	0x8000000000000000ULL, 0x0000000000000000ULL, // 5^0
+	0xa000000000000000ULL, 0x0000000000000000ULL, // 5^1
+	0xc800000000000000ULL, 0x0000000000000000ULL, // 5^2
+	0xfa00000000000000ULL, 0x0000000000000000ULL, // 5^3
+	0x9c40000000000000ULL, 0x0000000000000000ULL, // 5^4
+	0xc350000000000000ULL, 0x0000000000000000ULL, // 5^5
+	0xf424000000000000ULL, 0x0000000000000000ULL, // 5^6
+	0x9896800000000000ULL, 0x0000000000000000ULL, // 5^7
+	0xbebc200000000000ULL, 0x0000000000000000ULL, // 5^8
+	0xee6b280000000000ULL, 0x0000000000000000ULL, // 5^9
+	0x9502f90000000000ULL, 0x0000000000000000ULL, // 5^10
+	0xba43b74000000000ULL, 0x0000000000000000ULL, // 5^11
+	0xe8d4a51000000000ULL, 0x0000000000000000ULL, // 5^12
+	0x9184e72a00000000ULL, 0x0000000000000000ULL, // 5^13
+	0xb5e620f480000000ULL, 0x0000000000000000ULL, // 5^14
+	0xe35fa931a0000000ULL, 0x0000000000000000ULL, // 5^15
+	0x8e1bc9bf04000000ULL, 0x0000000000000000ULL, // 5^16
+	0xb1a2bc2ec5000000ULL, 0x0000000000000000ULL, // 5^17
+	0xde0b6b3a76400000ULL, 0x0000000000000000ULL, // 5^18
+	0x8ac7230489e80000ULL, 0x0000000000000000ULL, // 5^19
+	0xad78ebc5ac620000ULL, 0x0000000000000000ULL, // 5^20
+	0xd8d726b7177a8000ULL, 0x0000000000000000ULL, // 5^21
+	0x878678326eac9000ULL, 0x0000000000000000ULL, // 5^22
+	0xa968163f0a57b400ULL, 0x0000000000000000ULL, // 5^23
+	0xd3c21bcecceda100ULL, 0x0000000000000000ULL, // 5^24
+	0x84595161401484a0ULL, 0x0000000000000000ULL, // 5^25
+	0xa56fa5b99019a5c8ULL, 0x0000000000000000ULL, // 5^26
+	0xcecb8f27f4200f3aULL, 0x0000000000000000ULL, // 5^27
+	0x813f3978f8940984ULL, 0x4000000000000000ULL, // 5^28
+	0xa18f07d736b90be5ULL, 0x5000000000000000ULL, // 5^29
+	0xc9f2c9cd04674edeULL, 0xa400000000000000ULL, // 5^30
+	0xfc6f7c4045812296ULL, 0x4d00000000000000ULL, // 5^31
+	0x9dc5ada82b70b59dULL, 0xf020000000000000ULL, // 5^32
+	0xc5371912364ce305ULL, 0x6c28000000000000ULL, // 5^33
+	0xf684df56c3e01bc6ULL, 0xc732000000000000ULL, // 5^34
+	0x9a130b963a6c115cULL, 0x3c7f400000000000ULL, // 5^35
+	0xc097ce7bc90715b3ULL, 0x4b9f100000000000ULL, // 5^36
+	0xf0bdc21abb48db20ULL, 0x1e86d40000000000ULL, // 5^37
+	0x96769950b50d88f4ULL, 0x1314448000000000ULL, // 5^38
+};
+
+const float exact_power_of_ten[] = {
+	1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+
+inline void mul128(uint64_t a, uint64_t b, uint64_t &hi, uint64_t &lo)
+{
+#if defined(__SIZEOF_INT128__)
+	unsigned __int128 r = (unsigned __int128)a * b;
+	hi = (uint64_t)(r >> 64);
+	lo = (uint64_t)r;
+#elif defined(_MSC_VER) && defined(_M_X64)
+	lo = _umul128(a, b, &hi);
+#else
+	uint64_t a_lo = (uint32_t)a, a_hi = a >> 32;
+	uint64_t b_lo = (uint32_t)b, b_hi = b >> 32;
+
+	uint64_t ll = a_lo * b_lo, lh = a_lo * b_hi;
+	uint64_t hl = a_hi * b_lo, hh = a_hi * b_hi;
+
+	uint64_t mid = (ll >> 32) + (uint32_t)lh + (uint32_t)hl;
+	hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+	lo = (mid << 32) | (uint32_t)ll;
+#endif
+}
+
+inline int clz64(uint64_t v)
+{
+#if defined(__GNUC__)
+	return __builtin_clzll(v);
+#elif defined(_MSC_VER) && defined(_M_X64)
+	unsigned long idx;
+	_BitScanReverse64(&idx, v);
+	return 63 - (int)idx;
+#else
+	int n = 0;
+	while (!(v & (UINT64_C(1) << 63))) {
+		v <<= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+inline int ctz64(uint64_t v)
+{
+#if defined(__GNUC__)
+	return __builtin_ctzll(v);
+#elif defined(_MSC_VER) && defined(_M_X64)
+	unsigned long idx;
+	_BitScanForward64(&idx, v);
+	return (int)idx;
+#else
+	int n = 0;
+	while (!(v & 1)) {
+		v >>= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+inline bool is_digit(char c)
+{
+	return (unsigned char)(c - '0') < 10;
+}
+
+#if OBJSCAN_SWAR
+inline uint64_t load8(const char *p)
+{
+	uint64_t v;
+	std::memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+// Eight bytes holding 0..9 each, first digit in the lowest byte.
+inline uint32_t combine_eight_digits(uint64_t val)
+{
+	const uint64_t mask = 0x000000FF000000FF;
+	const uint64_t mul1 = 0x000F424000000064; // 100 + (1000000ULL << 32)
+	const uint64_t mul2 = 0x0000271000000001; // 1 + (10000ULL << 32)
+
+	val = (val * 10) + (val >> 8);
+	val = (((val & mask) * mul1) + (((val >> 16) & mask) * mul2)) >> 32;
+	return (uint32_t)val;
+}
+#endif
+
+// Appends the run of decimal digits at s to v and returns the end of the run.
+// With eight readable bytes, the length of the run is found with one mask
+// and up to eight digits are combined without a branch per digit.
+inline const char *scan_digits(const char *s, const char *end, uint64_t &v)
+{
+#if OBJSCAN_SWAR
+	while (end - s >= 8) {
+		uint64_t val = load8(s);
+
+		// High bit set in every byte that is not '0'..'9'. Borrows and
+		// carries only travel upwards from a byte that is itself flagged,
+		// so the lowest flagged byte is exact.
+		uint64_t non_digit = ((val + 0x4646464646464646) | (val - 0x3030303030303030))
+			& 0x8080808080808080;
+
+		int n = non_digit ? ctz64(non_digit) >> 3 : 8;
+		if (n == 0)
+			return s;
+
+		static const uint64_t pow10[9] = {
+			1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000
+		};
+
+		// Move the n digits to the top so the empty low bytes act as leading zeros.
+		uint64_t digits = (val - 0x3030303030303030) << (8 * (8 - n));
+		v = v * pow10[n] + combine_eight_digits(digits);
+		s += n;
+
+		if (n != 8)
+			return s;
+	}
+#endif
+
+	while (s != end && is_digit(*s)) {
+		v = v * 10 + (uint64_t)(*s - '0');
+		++s;
+	}
+
+	return s;
+}
+
+bool scan_float_fallback(const char *&p, const char *end, float &out)
+{
+	const char *first = p;
+
+	// std::from_chars() does not accept an explicit plus sign, operator>> does.
+	if (first != end && *first == '+' && first + 1 != end && first[1] != '-')
+		++first;
+
+	std::from_chars_result res = std::from_chars(first, end, out);
+	if (res.ec != std::errc()) {
+		return false;
+	}
+
+	p = res.ptr;
+	return true;
+}
+
+}
+
+const char *ObjScan::skip_token(const char *p, const char *end)
+{
+#if OBJSCAN_SSE2
+	// Whitespace is ' ' or '\t'..'\r'; the latter is c - '\t' <= 4 unsigned.
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i four = _mm_set1_epi8(4);
+
+	while (end - p >= 16) {
+		__m128i chunk = _mm_loadu_si128((const __m128i *)p);
+		__m128i ctrl = _mm_sub_epi8(chunk, tab);
+
+		__m128i ws = _mm_or_si128(
+			_mm_cmpeq_epi8(chunk, space),
+			_mm_cmpeq_epi8(_mm_min_epu8(ctrl, four), ctrl));
+
+		int mask = _mm_movemask_epi8(ws);
+		if (mask)
+			return p + ctz64((uint64_t)mask);
+
+		p += 16;
+	}
+#endif
+
+	while (p != end && !is_space(*p))
+		++p;
+	return p;
+}
+
+bool ObjScan::scan_float(const char *&p, const char *end, float &out)
+{
+	const char *s = p;
+
+	bool negative = false;
+	if (s != end && (*s == '-' || *s == '+')) {
+		negative = *s == '-';
+		++s;
+	}
+
+	uint64_t w = 0;
+	const char *int_begin = s;
+	s = scan_digits(s, end, w);
+	int64_t digit_count = s - int_begin;
+	int64_t exponent = 0;
+
+	if (s != end && *s == '.') {
+		++s;
+		const char *frac_begin = s;
+		s = scan_digits(s, end, w);
+		digit_count += s - frac_begin;
+		exponent = -(s - frac_begin);
+	}
+
+	if (digit_count == 0) {
+		return false;
+	}
+
+	// An exponent without digits is not part of the number ("1e" reads as 1).
+	if (s != end && (*s == 'e' || *s == 'E')) {
+		const char *e = s + 1;
+
+		bool exp_negative = false;
+		if (e != end && (*e == '-' || *e == '+')) {
+			exp_negative = *e == '-';
+			++e;
+		}
+
+		if (e != end && is_digit(*e)) {
+			int64_t exp_number = 0;
+			while (e != end && is_digit(*e)) {
+				if (exp_number < 0x10000)
+					exp_number = exp_number * 10 + (*e - '0');
+				++e;
+			}
+
+			exponent += exp_negative ? -exp_number : exp_number;
+			s = e;
+		}
+	}
+
+	// w no longer holds every digit; let the library do the slow, exact thing.
+	if (digit_count > 19) {
+		return scan_float_fallback(p, end, out);
+	}
+
+	// Clinger: both operands are exact floats, so one IEEE operation rounds
+	// the result correctly.
+	if (exponent >= -10 && exponent <= 10 && w <= (UINT64_C(1) << 24)) {
+		float value = (float)w;
+		value = exponent < 0 ? value / exact_power_of_ten[-exponent]
+			: value * exact_power_of_ten[exponent];
+
+		out = negative ? -value : value;
+		p = s;
+		return true;
+	}
+
+	float value;
+	if (!compute_float(w, exponent, negative, value)) {
+		return scan_float_fallback(p, end, out);
+	}
+
+	// Overflow fails like it does for std::from_chars().
+	if (std::isinf(value)) {
+		return false;
+	}
+
+	out = value;
+	p = s;
+	return true;
+}
+
+bool ObjScan::compute_float(uint64_t w, int64_t q, bool negative, float &out)
+{
+	const int MANTISSA_BITS = 23;
+	const int MINIMUM_EXPONENT = -127;
+	const int INFINITE_POWER = 0xFF;
+	const int MIN_EXPONENT_ROUND_TO_EVEN = -17;
+	const int MAX_EXPONENT_ROUND_TO_EVEN = 10;
+
+	uint64_t mantissa = 0;
+	int64_t power2 = 0;
+
+	if (w == 0 || q < SMALLEST_POWER_OF_TEN) {
+		// Zero, or so small it rounds to zero.
+	}
+	else if (q > LARGEST_POWER_OF_TEN) {
+		power2 = INFINITE_POWER;
+	}
+	else {
+		int lz = clz64(w);
+		w <<= lz;
+
+		const uint64_t *pow5 = &power_of_five_128[2 * (q - SMALLEST_POWER_OF_TEN)];
+
+		// Only MANTISSA_BITS + 3 bits of the product matter; the second
+		// half of the table entry is needed when those might still change.
+		uint64_t hi, lo;
+		mul128(w, pow5[0], hi, lo);
+
+		const uint64_t precision_mask = UINT64_MAX >> (MANTISSA_BITS + 3);
+		if ((hi & precision_mask) == precision_mask) {
+			uint64_t hi2, lo2;
+			mul128(w, pow5[1], hi2, lo2);
+
+			lo += hi2;
+			if (hi2 > lo)
+				hi++;
+		}
+
+		// Too close to call outside the range where the table is exact.
+		if (lo == UINT64_MAX && (q < -27 || q > 55)) {
+			return false;
+		}
+
+		int upperbit = (int)(hi >> 63);
+		int shift = upperbit + 64 - MANTISSA_BITS - 3;
+
+		mantissa = hi >> shift;
+		power2 = (((152170 + 65536) * q) >> 16) + 63 + upperbit - lz - MINIMUM_EXPONENT;
+
+		if (power2 <= 0) {
+			// Subnormal, or rounds to zero.
+			if (-power2 + 1 >= 64) {
+				mantissa = 0;
+				power2 = 0;
+			}
+			else {
+				mantissa >>= -power2 + 1;
+				mantissa += mantissa & 1;
+				mantissa >>= 1;
+				power2 = mantissa < (UINT64_C(1) << MANTISSA_BITS) ? 0 : 1;
+			}
+		}
+		else {
+			// Exactly halfway between two floats: round to even.
+			if (lo <= 1 && q >= MIN_EXPONENT_ROUND_TO_EVEN && q <= MAX_EXPONENT_ROUND_TO_EVEN
+				&& (mantissa & 3) == 1 && (mantissa << shift) == hi) {
+				mantissa &= ~UINT64_C(1);
+			}
+
+			mantissa += mantissa & 1;
+			mantissa >>= 1;
+
+			if (mantissa >= (UINT64_C(2) << MANTISSA_BITS)) {
+				mantissa = UINT64_C(1) << MANTISSA_BITS;
+				power2++;
+			}
+
+			mantissa &= ~(UINT64_C(1) << MANTISSA_BITS);
+
+			if (power2 >= INFINITE_POWER) {
+				mantissa = 0;
+				power2 = INFINITE_POWER;
+			}
+		}
+	}
+
+	uint32_t bits = (uint32_t)mantissa | ((uint32_t)power2 << MANTISSA_BITS);
+	if (negative)
+		bits |= UINT32_C(1) << 31;
+
+	std::memcpy(&out, &bits, sizeof(out));
+	return true;
+}
+
+size_t ObjScan::scan_float_list(const char *p, const char *end, float *out, size_t max)
+{
+	size_t count = 0;
+
+	while (p != end) {
+		p = skip_space(p, end);
+		if (p == end)
+			break;
+
+		float v = 0.0f;
+		bool ok = scan_float(p, end, v);
+
+		if (count < max)
+			out[count] = ok ? v : 0.0f;
+		count++;
+
+		if (!ok)
+			break;
+	}
+
+	return count;
+}
+
+size_t ObjScan::scan_index(const char *p, const char *end)
+{
+	bool negative = false;
+	if (p != end && (*p == '+' || *p == '-')) {
+		negative = *p == '-';
+		++p;
+	}
+
+	unsigned long long value = 0;
+	std::from_chars_result res = std::from_chars(p, end, value);
+	if (res.ec == std::errc::result_out_of_range) {
+		return SIZE_MAX;
+	}
+	if (res.ec != std::errc()) {
+		return 0;
+	}
+
+	return negative ? (size_t)(0 - value) : (size_t)value;
+}
+
+WavefrontObj::face_vertex_desc ObjScan::scan_face_corner(const char *p, const char *end)
+{
+	// Fast path for plain digits separated by at most two slashes. Signs,
+	// overlong numbers, stray characters or extra slashes go to the slow
+	// path, which handles them exactly like the stream parser.
+	uint64_t value[3] = { 0, 0, 0 };
+	bool present[3] = { false, false, false };
+	int field = 0;
+
+	const char *s = p;
+	for (;;) {
+		const char *digits = s;
+		s = scan_digits(s, end, value[field]);
+
+		ptrdiff_t n = s - digits;
+		if (n > 19)
+			return scan_face_corner_slow(p, end);
+		present[field] = n != 0;
+
+		if (s == end)
+			break;
+		if (*s != '/' || field == 2)
+			return scan_face_corner_slow(p, end);
+
+		++field;
+		++s;
+	}
+
+	WavefrontObj::face_vertex_desc desc;
+
+	switch (field) {
+	case 0:
+		if (!present[0])
+			return scan_face_corner_slow(p, end);
+
+		desc.have = { true, false, false };
+		desc.vertex = (size_t)value[0];
+		break;
+
+	case 1:
+		// "v/vt" claims a texture coord even when it is left empty.
+		desc.have = { true, true, false };
+		desc.vertex = (size_t)value[0];
+		desc.uv = (size_t)value[1];
+		break;
+
+	default:
+		desc.have = { present[0], present[1], present[2] };
+		desc.vertex = (size_t)value[0];
+		desc.uv = (size_t)value[1];
+		desc.normal = (size_t)value[2];
+		break;
+	}
+
+	return desc;
+}
+
+WavefrontObj::face_vertex_desc ObjScan::scan_face_corner_slow(const char *p, const char *end)
+{
+	WavefrontObj::face_vertex_desc desc;
+
+	const char *delim1 = std::find(p, end, '/');
+	if (delim1 == end) {
+		// Vertex only
+		desc.have = { true, false, false };
+		desc.vertex = scan_index(p, end);
+		return desc;
+	}
+
+	const char *delim2 = std::find(delim1 + 1, end, '/');
+	if (delim2 == end) {
+		// Vertex and texture coord (maybe), see WavefrontObj::parse_two_param()
+		desc.have = { true, true, false };
+
+		if (delim1 != p)
+			desc.vertex = scan_index(p, delim1);
+		if (delim1 + 1 != end)
+			desc.uv = scan_index(delim1 + 1, end);
+
+		return desc;
+	}
+
+	if (std::find(delim2 + 1, end, '/') != end) {
+		assert(false);
+		return desc;
+	}
+
+	// Some combination of vertex, texture and normal coord
+	if (delim1 != p) {
+		desc.have.v = true;
+		desc.vertex = scan_index(p, delim1);
+	}
+	if (delim2 != delim1 + 1) {
+		desc.have.uv = true;
+		desc.uv = scan_index(delim1 + 1, delim2);
+	}
+	if (delim2 + 1 != end) {
+		desc.have.n = true;
+		desc.normal = scan_index(delim2 + 1, end);
+	}
+
+	return desc;
+}
@@ -0,0 +1,290 @@
+#include "ObjWriter.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// One block of output: a range of one kind of record.
+struct Block {
+	enum Kind { HEADER, VERTEX, UV, NORMAL, FACE } kind;
+	size_t begin, end;
+};
+
+// Records per block, sized so a block comes to about WRITE_BUFFER_SIZE.
+const size_t VERTEX_RECORD_BYTES = 40;
+const size_t FACE_RECORD_BYTES = 64;
+
+bool same_bits(float a, float b)
+{
+	return std::memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+char *format_index(char *p, size_t value)
+{
+	return std::to_chars(p, p + 20, value).ptr;
+}
+
+char *format_corner(char *p, const WavefrontObj::face_vertex_desc &c)
+{
+	*p++ = ' ';
+	if (c.have.v)
+		p = format_index(p, c.vertex);
+
+	if (c.have.uv || c.have.n) {
+		*p++ = '/';
+		if (c.have.uv)
+			p = format_index(p, c.uv);
+	}
+
+	if (c.have.n) {
+		*p++ = '/';
+		p = format_index(p, c.normal);
+	}
+
+	return p;
+}
+
+void append_directive(std::string &out, const char *directive, const WavefrontObj::FaceRuns &runs,
+	uint32_t name)
+{
+	out += directive;
+	out += ' ';
+	out += runs.names[name];
+	out += '\n';
+}
+
+class Formatter {
+	WavefrontObj &obj;
+	WavefrontObj::MeshData data;
+
+public:
+	explicit Formatter(WavefrontObj &o)
+		: obj(o), data(o.data())
+	{
+	}
+
+	std::vector<Block> blocks() const
+	{
+		std::vector<Block> out;
+		out.push_back({ Block::HEADER, 0, 0 });
+
+		auto split = [&out](Block::Kind kind, size_t count, size_t record_bytes) {
+			size_t per_block = std::max<size_t>(1, ObjWriter::WRITE_BUFFER_SIZE / record_bytes);
+			for (size_t begin = 0; begin < count; begin += per_block)
+				out.push_back({ kind, begin, std::min(count, begin + per_block) });
+		};
+
+		split(Block::VERTEX, data.vert.size(), VERTEX_RECORD_BYTES);
+		split(Block::UV, data.uv.size(), VERTEX_RECORD_BYTES);
+		split(Block::NORMAL, data.norm.size(), VERTEX_RECORD_BYTES);
+
+		// The last face block also carries the runs that start after the
+		// last face, so there always is one.
+		size_t faces = data.f.size();
+		if (faces == 0)
+			out.push_back({ Block::FACE, 0, 0 });
+		split(Block::FACE, faces, FACE_RECORD_BYTES);
+
+		return out;
+	}
+
+	void format(const Block &block, std::string &out) const
+	{
+		char line[256];
+
+		switch (block.kind) {
+		case Block::HEADER:
+			for (const std::string &library : obj.material_libraries())
+				out += "mtllib " + library + "\n";
+			break;
+
+		case Block::VERTEX:
+			for (size_t i = block.begin; i < block.end; ++i) {
+				const WavefrontObj::vec4f &v = data.vert[i];
+				char *p = line;
+				*p++ = 'v';
+				for (float value : { v.x, v.y, v.z }) {
+					*p++ = ' ';
+					p = ObjWriter::format_float(p, value);
+				}
+				if (!same_bits(v.w, 1.0f)) {
+					*p++ = ' ';
+					p = ObjWriter::format_float(p, v.w);
+				}
+				*p++ = '\n';
+				out.append(line, p - line);
+			}
+			break;
+
+		case Block::UV:
+			for (size_t i = block.begin; i < block.end; ++i) {
+				const WavefrontObj::vec3f &t = data.uv[i];
+				char *p = line;
+				*p++ = 'v';
+				*p++ = 't';
+				for (float value : { t.x, t.y }) {
+					*p++ = ' ';
+					p = ObjWriter::format_float(p, value);
+				}
+				if (!same_bits(t.z, 0.0f)) {
+					*p++ = ' ';
+					p = ObjWriter::format_float(p, t.z);
+				}
+				*p++ = '\n';
+				out.append(line, p - line);
+			}
+			break;
+
+		case Block::NORMAL:
+			for (size_t i = block.begin; i < block.end; ++i) {
+				const WavefrontObj::vec3f &n = data.norm[i];
+				char *p = line;
+				*p++ = 'v';
+				*p++ = 'n';
+				for (float value : { n.x, n.y, n.z }) {
+					*p++ = ' ';
+					p = ObjWriter::format_float(p, value);
+				}
+				*p++ = '\n';
+				out.append(line, p - line);
+			}
+			break;
+
+		case Block::FACE:
+			format_faces(block, out, line);
+			break;
+		}
+	}
+
+private:
+	void format_faces(const Block &block, std::string &out, char *line) const
+	{
+		const WavefrontObj::FaceRuns *runs[3] = { &obj.objects(), &obj.groups(), &obj.materials() };
+		static const char *const directives[3] = { "o", "g", "usemtl" };
+
+		// The next run of each kind at or after the block.
+		size_t next[3];
+		for (int k = 0; k < 3; ++k) {
+			const std::vector<WavefrontObj::face_run> &r = runs[k]->runs;
+			next[k] = std::lower_bound(r.begin(), r.end(), block.begin,
+				[](const WavefrontObj::face_run &run, size_t face) { return run.first_face < face; })
+				- r.begin();
+		}
+
+		// Runs that start at face i are written before it; after the last
+		// face, whatever is left.
+		bool last = block.end == data.f.size();
+		auto directives_at = [&](size_t i) {
+			for (int k = 0; k < 3; ++k) {
+				const std::vector<WavefrontObj::face_run> &r = runs[k]->runs;
+				while (next[k] < r.size() && r[next[k]].first_face == i) {
+					append_directive(out, directives[k], *runs[k], r[next[k]].name);
+					++next[k];
+				}
+			}
+		};
+
+		for (size_t i = block.begin; i < block.end; ++i) {
+			directives_at(i);
+
+			WavefrontObj::face_desc face = data.f[i];
+			char *p = line;
+			*p++ = 'f';
+			p = format_corner(p, face.p1);
+			p = format_corner(p, face.p2);
+			p = format_corner(p, face.p3);
+			*p++ = '\n';
+			out.append(line, p - line);
+		}
+
+		if (last)
+			directives_at(data.f.size());
+	}
+};
+
+// Formats the blocks thread_count at a time and hands each to sink in
+// order.
+template <class Sink>
+void format_blocks(WavefrontObj &obj, unsigned thread_count, Sink sink)
+{
+	if (thread_count == 0)
+		thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+	Formatter formatter(obj);
+	std::vector<Block> blocks = formatter.blocks();
+	std::vector<std::string> buffers(std::min<size_t>(thread_count, blocks.size()));
+
+	for (std::string &buffer : buffers)
+		buffer.reserve(ObjWriter::WRITE_BUFFER_SIZE + ObjWriter::WRITE_BUFFER_SIZE / 4);
+
+	for (size_t first = 0; first < blocks.size(); first += buffers.size()) {
+		size_t count = std::min(buffers.size(), blocks.size() - first);
+
+		if (count == 1) {
+			buffers[0].clear();
+			formatter.format(blocks[first], buffers[0]);
+		}
+		else {
+			std::vector<std::thread> workers;
+			workers.reserve(count);
+			for (size_t i = 0; i < count; ++i) {
+				workers.emplace_back([&formatter, &blocks, &buffers, first, i]() {
+					buffers[i].clear();
+					formatter.format(blocks[first + i], buffers[i]);
+				});
+			}
+			for (auto &w : workers)
+				w.join();
+		}
+
+		for (size_t i = 0; i < count; ++i) {
+			if (!sink(buffers[i]))
+				return;
+		}
+	}
+}
+
+}
+
+char *ObjWriter::format_float(char *p, float value)
+{
+	return std::to_chars(p, p + MAX_FLOAT_CHARS, value).ptr;
+}
+
+bool ObjWriter::write(const std::string &filename, WavefrontObj &obj, unsigned thread_count)
+{
+	std::ofstream ofs(filename, std::ios_base::binary | std::ios_base::trunc);
+	if (!ofs.is_open()) {
+		std::cerr << "Failed to create Wavefront .obj file: \"" << filename << "\"\n";
+		return false;
+	}
+
+	bool ok = true;
+	format_blocks(obj, thread_count, [&ofs, &ok](const std::string &block) {
+		ofs.write(block.data(), block.size());
+		ok = ofs.good();
+		return ok;
+	});
+
+	ofs.close();
+	if (!ok || ofs.fail()) {
+		std::cerr << "Failed to write Wavefront .obj file: \"" << filename << "\"\n";
+		return false;
+	}
+
+	return true;
+}
+
+void ObjWriter::format(std::string &out, WavefrontObj &obj, unsigned thread_count)
+{
+	format_blocks(obj, thread_count, [&out](const std::string &block) {
+		out += block;
+		return true;
+	});
+}
@@ -0,0 +1,197 @@
+#include "WavefrontMtl.h"
+#include "MappedFile.h"
+#include "ObjScan.h"
+
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+std::string_view trim(std::string_view s)
+{
+	const char *end = s.data() + s.size();
+	const char *begin = ObjScan::skip_space(s.data(), end);
+
+	while (end != begin && ObjScan::is_space(end[-1]))
+		--end;
+
+	return std::string_view(begin, end - begin);
+}
+
+void scan_rgb(std::string_view args, float out[3])
+{
+	float values[3];
+	size_t count = ObjScan::scan_float_list(args.data(), args.data() + args.size(), values, 3);
+
+	// A single value sets all three channels.
+	if (count == 1) {
+		out[0] = out[1] = out[2] = values[0];
+	}
+	else if (count >= 3) {
+		std::memcpy(out, values, sizeof(values));
+	}
+}
+
+float scan_one(std::string_view args, float fallback)
+{
+	float value;
+	return ObjScan::scan_float_list(args.data(), args.data() + args.size(), &value, 1) ? value : fallback;
+}
+
+// The filename is the last token: any options ("-bm 0.5", "-s 1 1 1")
+// come before it.
+std::string_view map_filename(std::string_view args)
+{
+	args = trim(args);
+
+	const char *begin = args.data();
+	const char *p = begin + args.size();
+	while (p != begin && !ObjScan::is_space(p[-1]))
+		--p;
+
+	return std::string_view(p, args.data() + args.size() - p);
+}
+
+}
+
+WavefrontMtl::Material::Material(std::string_view n)
+	: name(n),
+	ambient{ 0.2f, 0.2f, 0.2f }, diffuse{ 0.8f, 0.8f, 0.8f },
+	specular{ 1.0f, 1.0f, 1.0f }, emissive{ 0.0f, 0.0f, 0.0f },
+	shininess(0.0f), opacity(1.0f), illum(2)
+{
+}
+
+WavefrontMtl::WavefrontMtl()
+{
+}
+
+WavefrontMtl::WavefrontMtl(const std::string &filename)
+{
+	load(filename);
+}
+
+bool WavefrontMtl::load(const std::string &filename)
+{
+	MappedFile file(filename);
+	if (!file.is_open()) {
+		std::cerr << "Failed to open Wavefront .mtl file: \"" << filename << "\"\n";
+		return false;
+	}
+
+	parse(file.begin(), file.end());
+	return true;
+}
+
+void WavefrontMtl::parse(const char *begin, const char *end)
+{
+	uint32_t current = NOT_FOUND;
+	const char *line = begin;
+
+	while (line < end) {
+		const char *eol = (const char *)std::memchr(line, '\n', end - line);
+		if (!eol)
+			eol = end;
+
+		parse_line(std::string_view(line, eol - line), current);
+		line = eol + 1;
+	}
+}
+
+size_t WavefrontMtl::load_libraries(const std::vector<std::string> &libraries, const std::string &obj_filename)
+{
+	size_t loaded = 0;
+	for (const std::string &library : libraries) {
+		if (load(library_path(library, obj_filename)))
+			++loaded;
+	}
+
+	return loaded;
+}
+
+std::string WavefrontMtl::library_path(const std::string &library, const std::string &obj_filename)
+{
+	size_t slash = obj_filename.find_last_of("/\\");
+	std::string dir = slash == std::string::npos ? std::string() : obj_filename.substr(0, slash + 1);
+	return dir + library;
+}
+
+size_t WavefrontMtl::size() const
+{
+	return material_list.size();
+}
+
+const WavefrontMtl::Material &WavefrontMtl::material(uint32_t i) const
+{
+	return material_list[i];
+}
+
+uint32_t WavefrontMtl::find(std::string_view name) const
+{
+	auto found = index.find(std::string(name));
+	return found == index.end() ? NOT_FOUND : found->second;
+}
+
+void WavefrontMtl::parse_line(std::string_view line, uint32_t &current)
+{
+	size_t hashpos = line.find('#');
+	if (hashpos != std::string_view::npos) {
+		line = line.substr(0, hashpos);
+	}
+
+	const char *end = line.data() + line.size();
+	const char *direct_begin = ObjScan::skip_space(line.data(), end);
+	const char *direct_end = ObjScan::skip_token(direct_begin, end);
+
+	std::string_view direct(direct_begin, direct_end - direct_begin);
+	std::string_view args(direct_end, end - direct_end);
+
+	if (direct.empty())
+		return;
+
+	if (direct == "newmtl") {
+		std::string name(trim(args));
+
+		auto found = index.emplace(name, (uint32_t)material_list.size());
+		if (found.second)
+			material_list.emplace_back(name);
+		else
+			material_list[found.first->second] = Material(name);
+
+		current = found.first->second;
+		return;
+	}
+
+	// Records before the first "newmtl" have nothing to apply to.
+	if (current == NOT_FOUND)
+		return;
+
+	Material &m = material_list[current];
+
+	if (direct == "Ka")
+		scan_rgb(args, m.ambient);
+	else if (direct == "Kd")
+		scan_rgb(args, m.diffuse);
+	else if (direct == "Ks")
+		scan_rgb(args, m.specular);
+	else if (direct == "Ke")
+		scan_rgb(args, m.emissive);
+	else if (direct == "Ns")
+		m.shininess = scan_one(args, m.shininess);
+	else if (direct == "d")
+		m.opacity = scan_one(args, m.opacity);
+	else if (direct == "Tr")
+		m.opacity = 1.0f - scan_one(args, 1.0f - m.opacity);
+	else if (direct == "illum")
+		m.illum = (int)scan_one(args, (float)m.illum);
+	else if (direct == "map_Ka")
+		m.ambient_map = map_filename(args);
+	else if (direct == "map_Kd")
+		m.diffuse_map = map_filename(args);
+	else if (direct == "map_Ks")
+		m.specular_map = map_filename(args);
+	else if (direct == "map_d")
+		m.opacity_map = map_filename(args);
+	else if (direct == "map_Bump" || direct == "map_bump" || direct == "bump")
+		m.bump_map = map_filename(args);
+}
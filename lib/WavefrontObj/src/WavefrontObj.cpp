@@ -1,25 +1,345 @@
 #include "WavefrontObj.h"
+#include "MappedFile.h"
+#include "ObjScan.h"
 
 #include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WAVEFRONTOBJ_SSE2 1
+#include <emmintrin.h>
+#else
+#define WAVEFRONTOBJ_SSE2 0
+#endif
+
+namespace {
+
+enum DirectiveType {
+	OBJECT_NAME,
+	VERTEX_COORD,
+	VERTEX_TEXTURE_COORD,
+	VERTEX_NORMAL_COORD,
+	FACE,
+	GROUP,
+	USE_MATERIAL,
+	MATERIAL_LIBRARY,
+	// Recognised so they do not count as unknown, but not used: smoothing
+	// groups are replaced by the normals in the file, and lines are not
+	// drawn.
+	SMOOTHING_GROUP,
+	LINE,
+
+	DIRECTIVE_COUNT
+};
+
+const struct directive_map {
+	DirectiveType type;
+	const char *str;
+} directive[] = {
+	{OBJECT_NAME, "o"},
+	{VERTEX_COORD, "v"},
+	{VERTEX_TEXTURE_COORD, "vt"},
+	{VERTEX_NORMAL_COORD, "vn"},
+	{FACE, "f"},
+	{GROUP, "g"},
+	{USE_MATERIAL, "usemtl"},
+	{MATERIAL_LIBRARY, "mtllib"},
+	{SMOOTHING_GROUP, "s"},
+	{LINE, "l"}
+};
+
+int find_directive(std::string_view direct)
+{
+	for (int idx = 0; idx < DIRECTIVE_COUNT; ++idx) {
+		if (direct == directive[idx].str) {
+			return idx;
+		}
+	}
+
+	return -1;
+}
+
+/*
+Record decoding shared by the in-memory and the streaming (Visitor) parsers.
+Both take a line or the arguments after the directive, as a view into the
+caller's buffer.
+*/
+
+// Strips the comment and splits off the directive. Returns the directive
+// index, or -1 if there is nothing to do for this line.
+int split_line(std::string_view line, std::string_view &args)
+{
+	size_t hashpos = line.find('#');
+	if (hashpos != std::string_view::npos) {
+		line = line.substr(0, hashpos);
+	}
+
+	if (line.size() == 0)
+		return -1;
+
+	const char *end = line.data() + line.size();
+	const char *direct_begin = ObjScan::skip_space(line.data(), end);
+	const char *direct_end = ObjScan::skip_token(direct_begin, end);
+
+	std::string_view direct(direct_begin, direct_end - direct_begin);
+	args = std::string_view(direct_end, end - direct_end);
+
+	int idx = find_directive(direct);
+	if (idx < 0) {
+		std::cerr << "Unknown directive \"" << direct << "\"\n";
+	}
+
+	return idx;
+}
+
+std::string_view decode_name(std::string_view args)
+{
+	const char *end = args.data() + args.size();
+	const char *name_begin = ObjScan::skip_space(args.data(), end);
+	const char *name_end = ObjScan::skip_token(name_begin, end);
+
+	return std::string_view(name_begin, name_end - name_begin);
+}
+
+// Everything after the directive, without surrounding whitespace. Group
+// names may contain spaces.
+std::string_view decode_rest(std::string_view args)
+{
+	const char *end = args.data() + args.size();
+	const char *begin = ObjScan::skip_space(args.data(), end);
+
+	while (end != begin && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+		--end;
+
+	return std::string_view(begin, end - begin);
+}
+
+// Calls fn once for each whitespace separated token in args.
+template <class Fn>
+void for_each_token(std::string_view args, Fn fn)
+{
+	const char *p = args.data();
+	const char *end = p + args.size();
+
+	for (;;) {
+		p = ObjScan::skip_space(p, end);
+		if (p == end)
+			break;
+
+		const char *token_begin = p;
+		p = ObjScan::skip_token(p, end);
+		fn(std::string_view(token_begin, p - token_begin));
+	}
+}
+
+bool decode_vec4(std::string_view args, WavefrontObj::vec4f &out)
+{
+	float values[4];
+	size_t count = ObjScan::scan_float_list(args.data(), args.data() + args.size(), values, 4);
+
+	if (count == 0) {
+		return false;
+	}
+
+	out = WavefrontObj::vec4f(values, std::min<size_t>(count, 4));
+	return true;
+}
+
+bool decode_vec3(std::string_view args, WavefrontObj::vec3f &out)
+{
+	float values[3];
+	size_t count = ObjScan::scan_float_list(args.data(), args.data() + args.size(), values, 3);
+
+	if (count == 0) {
+		return false;
+	}
+
+	out = WavefrontObj::vec3f(values, std::min<size_t>(count, 3));
+	return true;
+}
+
+WavefrontObj::face_desc decode_face(std::string_view args)
+{
+	const char *p = args.data();
+	const char *end = p + args.size();
+
+	WavefrontObj::face_desc f_desc;
+
+	size_t arg_cnt = 0;
+
+	while (p != end) {
+		p = ObjScan::skip_space(p, end);
+		if (p == end)
+			break;
+
+		const char *arg_begin = p;
+		p = ObjScan::skip_token(p, end);
+
+		WavefrontObj::face_vertex_desc desc = ObjScan::scan_face_corner(arg_begin, p);
+
+		switch (arg_cnt) {
+		case 0: f_desc.p1 = desc; break;
+		case 1: f_desc.p2 = desc; break;
+		case 2: f_desc.p3 = desc; break;
+		default:
+			assert(false);
+		}
+
+		arg_cnt++;
+	}
+
+	assert(arg_cnt == 3);
+
+	return f_desc;
+}
+
+// Negative indices count back from the most recent element: -1 is the
+// last one read so far. operator>> and ObjScan both wrap them around,
+// which makes them the top half of the size_t range. Returns true if
+// index was relative.
+bool resolve_relative_index(size_t &index, size_t count)
+{
+	if ((ptrdiff_t)index >= 0)
+		return false;
+
+	index += count + 1;
+	return true;
+}
+
+// Drives a WavefrontObj::Visitor. Keeps only the element counts needed to
+// resolve relative indices, so memory use does not grow with the file.
+class StreamParser {
+	WavefrontObj::Visitor &visitor;
+	size_t v_count, uv_count, n_count;
+
+public:
+	explicit StreamParser(WavefrontObj::Visitor &v)
+		: visitor(v), v_count(0), uv_count(0), n_count(0)
+	{
+	}
+
+	void parse_lines(const char *begin, const char *end)
+	{
+		const char *line = begin;
+
+		while (line < end) {
+			const char *eol = (const char *)std::memchr(line, '\n', end - line);
+			if (!eol)
+				eol = end;
+
+			parse_line(std::string_view(line, eol - line));
+			line = eol + 1;
+		}
+	}
+
+	void parse_line(std::string_view line)
+	{
+		std::string_view args;
+		int idx = split_line(line, args);
+		if (idx < 0)
+			return;
+
+		switch (directive[idx].type) {
+		case OBJECT_NAME:
+			visitor.on_object(decode_name(args));
+			break;
+
+		case GROUP:
+			visitor.on_group(decode_rest(args));
+			break;
+
+		case USE_MATERIAL:
+			visitor.on_material(decode_name(args));
+			break;
+
+		case MATERIAL_LIBRARY:
+			for_each_token(args, [this](std::string_view filename) {
+				visitor.on_material_library(filename);
+			});
+			break;
+
+		case VERTEX_COORD: {
+			WavefrontObj::vec4f v;
+			if (decode_vec4(args, v)) {
+				v_count++;
+				visitor.on_vertex(v);
+			}
+			break;
+		}
+
+		case VERTEX_TEXTURE_COORD: {
+			WavefrontObj::vec3f uv;
+			if (decode_vec3(args, uv)) {
+				uv_count++;
+				visitor.on_uv(uv);
+			}
+			break;
+		}
+
+		case VERTEX_NORMAL_COORD: {
+			WavefrontObj::vec3f n;
+			if (decode_vec3(args, n)) {
+				n_count++;
+				visitor.on_normal(n);
+			}
+			break;
+		}
+
+		case FACE: {
+			WavefrontObj::face_desc f = decode_face(args);
+
+			for (WavefrontObj::face_vertex_desc *c : { &f.p1, &f.p2, &f.p3 }) {
+				if (c->have.v)
+					resolve_relative_index(c->vertex, v_count);
+				if (c->have.uv)
+					resolve_relative_index(c->uv, uv_count);
+				if (c->have.n)
+					resolve_relative_index(c->normal, n_count);
+			}
+
+			visitor.on_face(f);
+			break;
+		}
+
+		default:
+			break;
+		}
+	}
+};
+
+}
 
 WavefrontObj::vec4f::vec4f() : x(0.0f), y(0.0f), z(0.0f), w(1.0f) {
 	
 }
 
-WavefrontObj::vec4f::vec4f(std::vector<float> &vec) : x(0.0f), y(0.0f), z(0.0f), w(1.0f) {
-	switch (vec.size()) {
-	default: /* Fallthrough */
-	case 4: /* Fallthrough */
+WavefrontObj::vec4f::vec4f(std::vector<float> &vec)
+	: vec4f(vec.data(), vec.size())
+{
+}
+
+WavefrontObj::vec4f::vec4f(const float *vec, size_t count) : x(0.0f), y(0.0f), z(0.0f), w(1.0f) {
+	switch (count) {
+	default:
+	case 4:
 		w = vec[3];
-	case 3: /* Fallthrough */
+		[[fallthrough]];
+	case 3:
 		z = vec[2];
-	case 2: /* Fallthrough */
+		[[fallthrough]];
+	case 2:
 		y = vec[1];
+		[[fallthrough]];
 	case 1:
 		x = vec[0];
 		break;
@@ -33,14 +353,21 @@ WavefrontObj::vec3f::vec3f()
 }
 
 WavefrontObj::vec3f::vec3f(std::vector<float> &vec)
+	: vec3f(vec.data(), vec.size())
+{
+}
+
+WavefrontObj::vec3f::vec3f(const float *vec, size_t count)
 	: x(0.0f), y(0.0f), z(0.0f)
 {
-	switch (vec.size()) {
-	default: /* Fallthrough */
-	case 3: /* Fallthrough */
+	switch (count) {
+	default:
+	case 3:
 		z = vec[2];
-	case 2: /* Fallthrough */
+		[[fallthrough]];
+	case 2:
 		y = vec[1];
+		[[fallthrough]];
 	case 1:
 		x = vec[0];
 		break;
@@ -58,18 +385,249 @@ WavefrontObj::face_desc::face_desc()
 {
 }
 
+WavefrontObj::FaceIndices::FaceIndices()
+	: mask(0)
+{
+}
+
+size_t WavefrontObj::FaceIndices::size() const
+{
+	return vertex.size() / 3;
+}
+
+bool WavefrontObj::FaceIndices::empty() const
+{
+	return vertex.empty();
+}
+
+bool WavefrontObj::FaceIndices::has(Attribute attr) const
+{
+	return (mask & attr) != 0;
+}
+
+WavefrontObj::face_desc WavefrontObj::FaceIndices::operator[](size_t face) const
+{
+	face_desc desc;
+	face_vertex_desc *corner[3] = { &desc.p1, &desc.p2, &desc.p3 };
+
+	for (size_t c = 0; c < 3; ++c) {
+		size_t i = face * 3 + c;
+		face_vertex_desc &d = *corner[c];
+
+		d.vertex = vertex[i];
+		d.uv = uv.empty() ? 0 : uv[i];
+		d.normal = normal.empty() ? 0 : normal[i];
+		d.have = { d.vertex != 0, d.uv != 0, d.normal != 0 };
+	}
+
+	return desc;
+}
+
+void WavefrontObj::FaceIndices::add_stream(Attribute attr)
+{
+	mask |= attr;
+
+	std::vector<uint32_t> &stream = attr == UV ? uv : normal;
+	stream.resize(vertex.size(), 0);
+}
+
+void WavefrontObj::FaceIndices::push_back(const face_desc &face)
+{
+	const face_vertex_desc *corner[3] = { &face.p1, &face.p2, &face.p3 };
+
+	// A stream is added the first time a face uses it, padded with "no
+	// index" for the faces before.
+	bool any_v = false, any_uv = false, any_n = false;
+	for (const face_vertex_desc *c : corner) {
+		any_v |= c->have.v;
+		any_uv |= c->have.uv;
+		any_n |= c->have.n;
+	}
+	if (any_v)
+		mask |= VERTEX;
+	if (any_uv && !has(UV))
+		add_stream(UV);
+	if (any_n && !has(NORMAL))
+		add_stream(NORMAL);
+
+	for (const face_vertex_desc *c : corner) {
+		vertex.push_back(c->have.v ? (uint32_t)c->vertex : 0);
+		if (has(UV))
+			uv.push_back(c->have.uv ? (uint32_t)c->uv : 0);
+		if (has(NORMAL))
+			normal.push_back(c->have.n ? (uint32_t)c->normal : 0);
+	}
+}
+
+void WavefrontObj::FaceIndices::resize(size_t face_count, uint8_t new_mask)
+{
+	mask |= new_mask;
+
+	vertex.resize(face_count * 3, 0);
+	if (has(UV))
+		uv.resize(face_count * 3, 0);
+	if (has(NORMAL))
+		normal.resize(face_count * 3, 0);
+}
+
+void WavefrontObj::FaceIndices::clear()
+{
+	std::vector<uint32_t>().swap(vertex);
+	std::vector<uint32_t>().swap(uv);
+	std::vector<uint32_t>().swap(normal);
+	mask = 0;
+}
+
+uint32_t WavefrontObj::FaceRuns::intern(std::string_view name)
+{
+	auto found = index.emplace(std::string(name), (uint32_t)names.size());
+	if (found.second)
+		names.emplace_back(name);
+
+	return found.first->second;
+}
+
+void WavefrontObj::FaceRuns::begin(size_t face, uint32_t name)
+{
+	// A directive with no faces after it is replaced by the next one.
+	if (!runs.empty() && runs.back().first_face == face) {
+		runs.pop_back();
+	}
+
+	uint32_t current = runs.empty() ? NO_NAME : runs.back().name;
+	if (name != current)
+		runs.push_back({ face, name });
+}
+
+uint32_t WavefrontObj::FaceRuns::name_of(size_t face) const
+{
+	auto after = std::upper_bound(runs.begin(), runs.end(), face,
+		[](size_t f, const face_run &run) { return f < run.first_face; });
+
+	return after == runs.begin() ? NO_NAME : (after - 1)->name;
+}
+
+WavefrontObj::Bounds::Bounds()
+	: min{ FLT_MAX, FLT_MAX, FLT_MAX }, max{ -FLT_MAX, -FLT_MAX, -FLT_MAX }
+{
+}
+
+bool WavefrontObj::Bounds::empty() const
+{
+	return min[0] > max[0];
+}
+
+void WavefrontObj::Bounds::add(float x, float y, float z)
+{
+	const float p[3] = { x, y, z };
+	for (int i = 0; i < 3; ++i) {
+		min[i] = std::min(min[i], p[i]);
+		max[i] = std::max(max[i], p[i]);
+	}
+}
+
+void WavefrontObj::Bounds::merge(const Bounds &other)
+{
+	for (int i = 0; i < 3; ++i) {
+		min[i] = std::min(min[i], other.min[i]);
+		max[i] = std::max(max[i], other.max[i]);
+	}
+}
+
+void WavefrontObj::Bounds::sphere(float center[3], float &radius) const
+{
+	if (empty()) {
+		center[0] = center[1] = center[2] = 0.0f;
+		radius = 0.0f;
+		return;
+	}
+
+	float squared = 0.0f;
+	for (int i = 0; i < 3; ++i) {
+		center[i] = (min[i] + max[i]) * 0.5f;
+		float half = (max[i] - min[i]) * 0.5f;
+		squared += half * half;
+	}
+	radius = std::sqrt(squared);
+}
+
 WavefrontObj::MeshData::MeshData(
 	std::vector<vec4f>& a, std::vector<vec3f>& b,
-	std::vector<vec3f>& c, std::vector<face_desc>& d)
+	std::vector<vec3f>& c, FaceIndices& d)
 	: vert(a), norm(b), uv(c), f(d)
 {
 }
 
+WavefrontObj::Visitor::~Visitor()
+{
+}
+
+void WavefrontObj::Visitor::on_object(std::string_view)
+{
+}
+
+void WavefrontObj::Visitor::on_group(std::string_view)
+{
+}
+
+void WavefrontObj::Visitor::on_material(std::string_view)
+{
+}
+
+void WavefrontObj::Visitor::on_material_library(std::string_view)
+{
+}
+
+void WavefrontObj::Visitor::on_vertex(const vec4f &)
+{
+}
+
+void WavefrontObj::Visitor::on_uv(const vec3f &)
+{
+}
+
+void WavefrontObj::Visitor::on_normal(const vec3f &)
+{
+}
+
+void WavefrontObj::Visitor::on_face(const face_desc &)
+{
+}
+
 WavefrontObj::WavefrontObj()
+	: track_relative(false),
+	bounds_min{ FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX },
+	bounds_max{ -FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX }
 {
 }
 
-WavefrontObj::WavefrontObj(std::string filename)
+WavefrontObj::WavefrontObj(std::string filename, ParseMode mode)
+	: WavefrontObj()
+{
+	switch (mode) {
+	case PARSE_STREAM:
+		load_stream(filename);
+		break;
+
+	case PARSE_MAPPED:
+		load_mapped(filename, false);
+		break;
+
+	case PARSE_PARALLEL:
+		load_mapped(filename, true);
+		break;
+
+	default:
+		std::cerr << "Unknown parse mode passed to WavefrontObj::WavefrontObj()\n";
+		break;
+	}
+}
+
+WavefrontObj::~WavefrontObj()
+{
+}
+
+void WavefrontObj::load_stream(const std::string &filename)
 {
 	std::ifstream ifs(filename, std::ios_base::binary);
 	if (!ifs.is_open()) {
@@ -81,8 +639,21 @@ WavefrontObj::WavefrontObj(std::string filename)
 	ifs.close();
 }
 
-WavefrontObj::~WavefrontObj()
+void WavefrontObj::load_mapped(const std::string &filename, bool parallel)
 {
+	MappedFile file(filename);
+	if (!file.is_open()) {
+		std::cerr << "Failed to open Wavefront .obj file: \"" << filename << "\"\n";
+		return;
+	}
+
+	if (parallel) {
+		parse_parallel(file.begin(), file.end());
+	}
+	else {
+		file.advise_sequential();
+		parse_mapped(file.begin(), file.end());
+	}
 }
 
 void WavefrontObj::parse(std::ifstream &ifs) {
@@ -111,27 +682,6 @@ void WavefrontObj::parse(std::ifstream &ifs) {
 }
 
 void WavefrontObj::parse_line(std::string &line) {
-	enum DirectiveType {
-		OBJECT_NAME,
-		VERTEX_COORD,
-		VERTEX_TEXTURE_COORD,
-		VERTEX_NORMAL_COORD,
-		FACE,
-
-		DIRECTIVE_COUNT
-	};
-
-	static const struct directive_map {
-		DirectiveType type;
-		const char *str;
-	} directive[] = {
-		{OBJECT_NAME, "o"},
-		{VERTEX_COORD, "v"},
-		{VERTEX_TEXTURE_COORD, "vt"},
-		{VERTEX_NORMAL_COORD, "vn"},
-		{FACE, "f"}
-	};
-
 	// Check if we have a hash anywhere, and if we do, discard the string including it
 	// and everything after.
 	size_t hashpos = line.find_first_of('#');
@@ -147,17 +697,8 @@ void WavefrontObj::parse_line(std::string &line) {
 	std::string direct;
 	ss >> direct;
 
-	int found = 0;
-	int idx;
-
-	for (idx = 0; idx < DIRECTIVE_COUNT; ++idx) {
-		if (direct.compare(directive[idx].str) == 0) {
-			found = 1;
-			break;
-		}
-	}
-
-	if (!found) {
+	int idx = find_directive(direct);
+	if (idx < 0) {
 		std::cerr << "Unknown directive \"" << direct << "\"\n";
 		return;
 	}
@@ -184,24 +725,323 @@ void WavefrontObj::parse_line(std::string &line) {
 		process_face(ss);
 		break;
 
+	case GROUP:
+	case USE_MATERIAL:
+	case MATERIAL_LIBRARY: {
+		// Names need no number parsing, the view overloads do.
+		std::string args;
+		std::getline(ss, args);
+		parse_line(std::string_view(direct + " " + args));
+		break;
+	}
+
+	case SMOOTHING_GROUP:
+	case LINE:
+		break;
+
+	default:
+		std::cerr << "Unknown type caught in WavefrontObj::parse_line()\n";
+		break;
+	}
+}
+
+void WavefrontObj::parse_mapped(const char *begin, const char *end)
+{
+	const char *line = begin;
+
+	while (line < end) {
+		const char *eol = (const char *)std::memchr(line, '\n', end - line);
+		if (!eol)
+			eol = end;
+
+		parse_line(std::string_view(line, eol - line));
+		line = eol + 1;
+	}
+}
+
+void WavefrontObj::parse_line(std::string_view line)
+{
+	// Same rules as the std::string overload, without copying the line.
+	std::string_view args;
+	int idx = split_line(line, args);
+	if (idx < 0)
+		return;
+
+	DirectiveType type = directive[idx].type;
+	switch (type) {
+	case OBJECT_NAME:
+		process_object_name(args);
+		break;
+
+	case VERTEX_COORD:
+		process_vertex_coord(args);
+		break;
+
+	case VERTEX_TEXTURE_COORD:
+		process_uv_coord(args);
+		break;
+
+	case VERTEX_NORMAL_COORD:
+		process_vertex_normal_coord(args);
+		break;
+
+	case FACE:
+		process_face(args);
+		break;
+
+	case GROUP:
+		process_group(args);
+		break;
+
+	case USE_MATERIAL:
+		process_material(args);
+		break;
+
+	case MATERIAL_LIBRARY:
+		process_material_library(args);
+		break;
+
+	case SMOOTHING_GROUP:
+	case LINE:
+		break;
+
 	default:
 		std::cerr << "Unknown type caught in WavefrontObj::parse_line()\n";
 		break;
 	}
 }
 
+void WavefrontObj::parse_parallel(const char *begin, const char *end, unsigned thread_count)
+{
+	if (thread_count == 0)
+		thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+	size_t size = end - begin;
+	size_t chunk_count = std::min<size_t>(thread_count, size / MIN_PARALLEL_CHUNK);
+
+	if (chunk_count <= 1) {
+		parse_mapped(begin, end);
+		return;
+	}
+
+	// Cut at the first newline after each even split point, so no line
+	// straddles two chunks. A long line can swallow a whole chunk, which
+	// just leaves that chunk empty.
+	std::vector<const char *> bounds(chunk_count + 1);
+	bounds[0] = begin;
+	bounds[chunk_count] = end;
+
+	for (size_t i = 1; i < chunk_count; ++i) {
+		const char *split = std::max(begin + size / chunk_count * i, bounds[i - 1]);
+		const char *eol = (const char *)std::memchr(split, '\n', end - split);
+		bounds[i] = eol ? eol + 1 : end;
+	}
+
+	std::vector<WavefrontObj> chunks(chunk_count);
+	std::vector<std::thread> workers;
+	workers.reserve(chunk_count);
+
+	for (size_t i = 0; i < chunk_count; ++i) {
+		chunks[i].track_relative = true;
+		workers.emplace_back([&chunks, &bounds, i]() {
+			chunks[i].parse_mapped(bounds[i], bounds[i + 1]);
+		});
+	}
+	for (auto &w : workers)
+		w.join();
+	workers.clear();
+
+	// Every chunk lands at a known offset, so the copy out is parallel too.
+	struct offsets { size_t v, uv, n, f; };
+	std::vector<offsets> base(chunk_count);
+	offsets total = { vert.size(), uv.size(), norm.size(), f.size() };
+	uint8_t face_mask = f.mask;
+
+	for (size_t i = 0; i < chunk_count; ++i) {
+		base[i] = total;
+		total.v += chunks[i].vert.size();
+		total.uv += chunks[i].uv.size();
+		total.n += chunks[i].norm.size();
+		total.f += chunks[i].f.size();
+		face_mask |= chunks[i].f.mask;
+
+		for (int k = 0; k < 4; ++k) {
+			bounds_min[k] = std::min(bounds_min[k], chunks[i].bounds_min[k]);
+			bounds_max[k] = std::max(bounds_max[k], chunks[i].bounds_max[k]);
+		}
+
+		if (!chunks[i].object_name.empty())
+			object_name = chunks[i].object_name;
+
+		// Faces before a chunk's first run carry on the run before them.
+		auto merge_runs = [&](FaceRuns &into, const FaceRuns &from) {
+			for (const face_run &run : from.runs)
+				into.begin(run.first_face + base[i].f, into.intern(from.names[run.name]));
+		};
+
+		merge_runs(object_runs, chunks[i].object_runs);
+		merge_runs(group_runs, chunks[i].group_runs);
+		merge_runs(material_runs, chunks[i].material_runs);
+		material_libs.insert(material_libs.end(),
+			chunks[i].material_libs.begin(), chunks[i].material_libs.end());
+	}
+
+	vert.resize(total.v);
+	uv.resize(total.uv);
+	norm.resize(total.n);
+	f.resize(total.f, face_mask);
+
+	for (size_t i = 0; i < chunk_count; ++i) {
+		workers.emplace_back([this, &chunks, &base, i]() {
+			append_chunk(chunks[i], base[i].v, base[i].uv, base[i].n, base[i].f);
+		});
+	}
+	for (auto &w : workers)
+		w.join();
+}
+
+bool WavefrontObj::stream(const std::string &filename, Visitor &visitor, size_t buffer_size)
+{
+	std::ifstream ifs(filename, std::ios_base::binary);
+	if (!ifs.is_open()) {
+		std::cerr << "Failed to open Wavefront .obj file: \"" << filename << "\"\n";
+		return false;
+	}
+
+	StreamParser parser(visitor);
+	std::vector<char> buffer(std::max<size_t>(buffer_size, 1));
+
+	// Bytes at the front of buffer left over from the previous read: the
+	// start of a line whose end has not been read yet.
+	size_t carry = 0;
+
+	for (;;) {
+		ifs.read(buffer.data() + carry, buffer.size() - carry);
+		if (ifs.bad()) {
+			std::cerr << "Failed to read Wavefront .obj file during parse phase\n";
+			return false;
+		}
+
+		size_t avail = carry + (size_t)ifs.gcount();
+		const char *begin = buffer.data();
+		const char *end = begin + avail;
+
+		if (ifs.eof()) {
+			parser.parse_lines(begin, end);
+			return true;
+		}
+
+		const char *last_eol = end;
+		while (last_eol != begin && last_eol[-1] != '\n')
+			--last_eol;
+
+		if (last_eol == begin) {
+			// Not a single complete line in the buffer.
+			carry = avail;
+			buffer.resize(buffer.size() * 2);
+			continue;
+		}
+
+		parser.parse_lines(begin, last_eol);
+
+		carry = end - last_eol;
+		std::memmove(buffer.data(), last_eol, carry);
+	}
+}
+
+void WavefrontObj::visit(const char *begin, const char *end, Visitor &visitor)
+{
+	StreamParser parser(visitor);
+	parser.parse_lines(begin, end);
+}
+
+void WavefrontObj::append_chunk(WavefrontObj &chunk, size_t v_base, size_t uv_base, size_t n_base,
+	size_t f_base)
+{
+	// Relative indices were resolved against the chunk's own counts. They
+	// may have wrapped below zero there; adding the base in 32-bit
+	// arithmetic brings them back.
+	for (const relative_ref &ref : chunk.relative_refs) {
+		size_t i = ref.face * 3 + ref.corner;
+
+		switch (ref.attr) {
+		case 0: chunk.f.vertex[i] += (uint32_t)v_base; break;
+		case 1: chunk.f.uv[i] += (uint32_t)uv_base; break;
+		case 2: chunk.f.normal[i] += (uint32_t)n_base; break;
+		}
+	}
+
+	std::copy(chunk.vert.begin(), chunk.vert.end(), vert.begin() + v_base);
+	std::copy(chunk.uv.begin(), chunk.uv.end(), uv.begin() + uv_base);
+	std::copy(chunk.norm.begin(), chunk.norm.end(), norm.begin() + n_base);
+
+	// Streams the chunk never used stay zero, which is "no index".
+	std::copy(chunk.f.vertex.begin(), chunk.f.vertex.end(), f.vertex.begin() + f_base * 3);
+	std::copy(chunk.f.uv.begin(), chunk.f.uv.end(), f.uv.begin() + f_base * 3);
+	std::copy(chunk.f.normal.begin(), chunk.f.normal.end(), f.normal.begin() + f_base * 3);
+
+	// Hand the chunk's memory back as soon as it has been copied out.
+	std::vector<vec4f>().swap(chunk.vert);
+	std::vector<vec3f>().swap(chunk.uv);
+	std::vector<vec3f>().swap(chunk.norm);
+	chunk.f.clear();
+	std::vector<relative_ref>().swap(chunk.relative_refs);
+}
+
+void WavefrontObj::add_vertex(const vec4f &v)
+{
+	vert.push_back(v);
+
+	// The point goes second so a NaN coordinate leaves the bounds alone.
+#if WAVEFRONTOBJ_SSE2
+	__m128 p = _mm_loadu_ps(&v.x);
+	_mm_storeu_ps(bounds_min, _mm_min_ps(p, _mm_loadu_ps(bounds_min)));
+	_mm_storeu_ps(bounds_max, _mm_max_ps(p, _mm_loadu_ps(bounds_max)));
+#else
+	const float p[4] = { v.x, v.y, v.z, v.w };
+	for (int i = 0; i < 4; ++i) {
+		bounds_min[i] = p[i] < bounds_min[i] ? p[i] : bounds_min[i];
+		bounds_max[i] = p[i] > bounds_max[i] ? p[i] : bounds_max[i];
+	}
+#endif
+}
+
+void WavefrontObj::resolve_relative(face_desc &desc)
+{
+	face_vertex_desc *corner[3] = { &desc.p1, &desc.p2, &desc.p3 };
+
+	for (uint8_t i = 0; i < 3; ++i) {
+		face_vertex_desc &c = *corner[i];
+
+		size_t *index[3] = { &c.vertex, &c.uv, &c.normal };
+		bool have[3] = { c.have.v, c.have.uv, c.have.n };
+		size_t count[3] = { vert.size(), uv.size(), norm.size() };
+
+		for (uint8_t attr = 0; attr < 3; ++attr) {
+			if (!have[attr] || !resolve_relative_index(*index[attr], count[attr]))
+				continue;
+
+			if (track_relative)
+				relative_refs.push_back({ f.size(), i, attr });
+		}
+	}
+}
+
 void WavefrontObj::process_object_name(std::stringstream & ss)
 {
 	std::string name;
 	ss >> name;
 	object_name = name;
+	object_runs.begin(f.size(), object_runs.intern(name));
 }
 
 void WavefrontObj::process_vertex_coord(std::stringstream & ss)
 {
 	std::vector<float> values;
 
-	while (ss.good()) {
+	// Skip whitespace first so trailing blanks or a '\r' don't count as
+	// one more (failed) extraction.
+	while ((ss >> std::ws).good()) {
 		float v;
 		ss >> v;
 		values.push_back(v);
@@ -212,14 +1052,16 @@ void WavefrontObj::process_vertex_coord(std::stringstream & ss)
 	}
 
 	vec4f vec(values);
-	vert.push_back(vec);
+	add_vertex(vec);
 }
 
 void WavefrontObj::process_vertex_normal_coord(std::stringstream & ss)
 {
 	std::vector<float> values;
 
-	while (ss.good()) {
+	// Skip whitespace first so trailing blanks or a '\r' don't count as
+	// one more (failed) extraction.
+	while ((ss >> std::ws).good()) {
 		float v;
 		ss >> v;
 		values.push_back(v);
@@ -237,7 +1079,9 @@ void WavefrontObj::process_uv_coord(std::stringstream & ss)
 {
 	std::vector<float> values;
 
-	while (ss.good()) {
+	// Skip whitespace first so trailing blanks or a '\r' don't count as
+	// one more (failed) extraction.
+	while ((ss >> std::ws).good()) {
 		float v;
 		ss >> v;
 		values.push_back(v);
@@ -259,7 +1103,7 @@ void WavefrontObj::process_face(std::stringstream & ss)
 
 	size_t arg_cnt = 0;
 
-	while (ss.good()) {
+	while ((ss >> std::ws).good()) {
 		ss >> arg;
 		face_vertex_desc desc = parse_face_arg(arg);
 
@@ -276,6 +1120,7 @@ void WavefrontObj::process_face(std::stringstream & ss)
 
 	assert(arg_cnt == 3);
 
+	resolve_relative(f_desc);
 	f.push_back(f_desc);
 }
 
@@ -374,6 +1219,34 @@ WavefrontObj::MeshData WavefrontObj::data()
 	return ret;
 }
 
+const WavefrontObj::FaceRuns &WavefrontObj::objects() const
+{
+	return object_runs;
+}
+
+const WavefrontObj::FaceRuns &WavefrontObj::groups() const
+{
+	return group_runs;
+}
+
+const WavefrontObj::FaceRuns &WavefrontObj::materials() const
+{
+	return material_runs;
+}
+
+const std::vector<std::string> &WavefrontObj::material_libraries() const
+{
+	return material_libs;
+}
+
+WavefrontObj::Bounds WavefrontObj::bounds() const
+{
+	Bounds b;
+	std::copy(bounds_min, bounds_min + 3, b.min);
+	std::copy(bounds_max, bounds_max + 3, b.max);
+	return b;
+}
+
 WavefrontObj::face_vertex_desc WavefrontObj::parse_face_arg(std::string &arg)
 {
 	face_vertex_desc desc;
@@ -405,3 +1278,60 @@ WavefrontObj::face_vertex_desc WavefrontObj::parse_face_arg(std::string &arg)
 
 	return desc;
 }
+
+void WavefrontObj::process_object_name(std::string_view args)
+{
+	object_name.assign(decode_name(args));
+	object_runs.begin(f.size(), object_runs.intern(object_name));
+}
+
+void WavefrontObj::process_vertex_coord(std::string_view args)
+{
+	vec4f vec;
+	if (decode_vec4(args, vec))
+		add_vertex(vec);
+}
+
+void WavefrontObj::process_vertex_normal_coord(std::string_view args)
+{
+	vec3f vec;
+	if (decode_vec3(args, vec))
+		norm.push_back(vec);
+}
+
+void WavefrontObj::process_uv_coord(std::string_view args)
+{
+	vec3f vec;
+	if (decode_vec3(args, vec))
+		uv.push_back(vec);
+}
+
+void WavefrontObj::process_face(std::string_view args)
+{
+	face_desc f_desc = decode_face(args);
+
+	resolve_relative(f_desc);
+	f.push_back(f_desc);
+}
+
+void WavefrontObj::process_group(std::string_view args)
+{
+	group_runs.begin(f.size(), group_runs.intern(decode_rest(args)));
+}
+
+void WavefrontObj::process_material(std::string_view args)
+{
+	material_runs.begin(f.size(), material_runs.intern(decode_name(args)));
+}
+
+void WavefrontObj::process_material_library(std::string_view args)
+{
+	for_each_token(args, [this](std::string_view filename) {
+		material_libs.emplace_back(filename);
+	});
+}
+
+WavefrontObj::face_vertex_desc WavefrontObj::parse_face_arg(std::string_view arg)
+{
+	return ObjScan::scan_face_corner(arg.data(), arg.data() + arg.size());
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "WavefrontObj.h"
+
+// Helpers shared by the WavefrontObj tests; floats are compared bit for
+// bit.
+
+inline void write_file(const std::string &filename, const std::string &contents) {
+	std::ofstream ofs(filename, std::ios_base::binary);
+	ofs << contents;
+}
+
+inline bool same_bits(float a, float b) {
+	return std::memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+inline bool same_corner(const WavefrontObj::face_vertex_desc &a, const WavefrontObj::face_vertex_desc &b) {
+	return a.have.v == b.have.v && a.have.uv == b.have.uv && a.have.n == b.have.n
+		&& a.vertex == b.vertex && a.uv == b.uv && a.normal == b.normal;
+}
+
+// Vertices, normals, uvs and faces.
+inline bool same_data(WavefrontObj &lhs, WavefrontObj &rhs) {
+	WavefrontObj::MeshData a = lhs.data();
+	WavefrontObj::MeshData b = rhs.data();
+
+	if (a.vert.size() != b.vert.size() || a.norm.size() != b.norm.size()
+		|| a.uv.size() != b.uv.size() || a.f.size() != b.f.size())
+		return false;
+
+	for (size_t i = 0; i < a.vert.size(); ++i) {
+		if (!same_bits(a.vert[i].x, b.vert[i].x) || !same_bits(a.vert[i].y, b.vert[i].y)
+			|| !same_bits(a.vert[i].z, b.vert[i].z) || !same_bits(a.vert[i].w, b.vert[i].w))
+			return false;
+	}
+
+	for (size_t i = 0; i < a.norm.size(); ++i) {
+		if (!same_bits(a.norm[i].x, b.norm[i].x) || !same_bits(a.norm[i].y, b.norm[i].y)
+			|| !same_bits(a.norm[i].z, b.norm[i].z))
+			return false;
+	}
+
+	for (size_t i = 0; i < a.uv.size(); ++i) {
+		if (!same_bits(a.uv[i].x, b.uv[i].x) || !same_bits(a.uv[i].y, b.uv[i].y)
+			|| !same_bits(a.uv[i].z, b.uv[i].z))
+			return false;
+	}
+
+	for (size_t i = 0; i < a.f.size(); ++i) {
+		if (!same_corner(a.f[i].p1, b.f[i].p1) || !same_corner(a.f[i].p2, b.f[i].p2)
+			|| !same_corner(a.f[i].p3, b.f[i].p3))
+			return false;
+	}
+
+	return true;
+}
+
+// Runs as (first_face, name) pairs, for comparing with expectations.
+inline std::vector<std::pair<size_t, std::string>> named_runs(const WavefrontObj::FaceRuns &runs) {
+	std::vector<std::pair<size_t, std::string>> out;
+	for (const WavefrontObj::face_run &run : runs.runs)
+		out.push_back({ run.first_face, runs.names[run.name] });
+	return out;
+}
+
+inline bool same_runs(const WavefrontObj::FaceRuns &a, const WavefrontObj::FaceRuns &b) {
+	return named_runs(a) == named_runs(b);
+}
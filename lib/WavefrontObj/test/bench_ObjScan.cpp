@@ -0,0 +1,129 @@
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ObjScan.h"
+#include "WavefrontObj.h"
+
+/*
+Compares the stream-based record parsing (WavefrontObj::parse_line() on a
+std::string) against the ObjScan path (parse_line() on a string_view), one
+record type at a time, and reports records per second for both.
+
+Usage: bench_ObjScan [records per type]
+*/
+
+typedef std::chrono::steady_clock bench_clock;
+
+static std::vector<std::string> make_records(const char *type, size_t count) {
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> coord(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::uniform_int_distribution<size_t> index(1, 1000000);
+
+	std::vector<std::string> records;
+	records.reserve(count);
+
+	char buf[256];
+	std::string t(type);
+
+	for (size_t i = 0; i < count; ++i) {
+		if (t == "v") {
+			snprintf(buf, sizeof(buf), "v %f %f %f", coord(rng), coord(rng), coord(rng));
+		}
+		else if (t == "vt") {
+			snprintf(buf, sizeof(buf), "vt %f %f", unit(rng), unit(rng));
+		}
+		else if (t == "vn") {
+			snprintf(buf, sizeof(buf), "vn %f %f %f", unit(rng), unit(rng), unit(rng));
+		}
+		else {
+			size_t a = index(rng), b = index(rng), c = index(rng);
+			snprintf(buf, sizeof(buf), "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu",
+				a, a, a, b, b, b, c, c, c);
+		}
+
+		records.push_back(buf);
+	}
+
+	return records;
+}
+
+static double seconds_since(bench_clock::time_point start) {
+	return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+static void bench_records(const char *type, size_t count) {
+	std::vector<std::string> records = make_records(type, count);
+
+	WavefrontObj stream;
+	bench_clock::time_point start = bench_clock::now();
+	for (const std::string &r : records) {
+		std::string line(r);
+		stream.parse_line(line);
+	}
+	double stream_time = seconds_since(start);
+
+	WavefrontObj scan;
+	start = bench_clock::now();
+	for (const std::string &r : records) {
+		scan.parse_line(std::string_view(r));
+	}
+	double scan_time = seconds_since(start);
+
+	printf("%-3s stream: %12.0f rec/s   scan: %12.0f rec/s   speedup: %5.1fx\n",
+		type, count / stream_time, count / scan_time, stream_time / scan_time);
+}
+
+static void bench_floats(size_t count) {
+	std::vector<std::string> values;
+	values.reserve(count);
+
+	std::mt19937 rng(99);
+	std::uniform_real_distribution<float> coord(-1000.0f, 1000.0f);
+	char buf[64];
+
+	for (size_t i = 0; i < count; ++i) {
+		snprintf(buf, sizeof(buf), "%.6f", coord(rng));
+		values.push_back(buf);
+	}
+
+	float sink = 0.0f;
+
+	bench_clock::time_point start = bench_clock::now();
+	for (const std::string &s : values) {
+		std::istringstream ss(s);
+		float v;
+		ss >> v;
+		sink += v;
+	}
+	double stream_time = seconds_since(start);
+
+	start = bench_clock::now();
+	for (const std::string &s : values) {
+		const char *p = s.data();
+		float v = 0.0f;
+		ObjScan::scan_float(p, p + s.size(), v);
+		sink += v;
+	}
+	double scan_time = seconds_since(start);
+
+	printf("float stream: %10.0f val/s   scan: %12.0f val/s   speedup: %5.1fx   (%g)\n",
+		count / stream_time, count / scan_time, stream_time / scan_time, sink);
+}
+
+int main(int argc, char **argv)
+{
+	size_t count = argc > 1 ? std::stoul(argv[1]) : 1000000;
+
+	for (const char *type : { "v", "vt", "vn", "f" }) {
+		bench_records(type, count);
+	}
+
+	bench_floats(count);
+	return 0;
+}
@@ -0,0 +1,462 @@
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ObjWriter.h"
+#include "WavefrontObj.h"
+#include "Mesh.h"
+
+/*
+Load-time benchmark for WavefrontObj and for the Mesh stages that follow it.
+
+Generates synthetic .obj files, either height field grids or random triangle
+soups, with every combination of uv and normal data, and times each loading
+stage on them:
+
+	parse_stream    WavefrontObj(file, PARSE_STREAM)
+	parse_mapped    WavefrontObj(file, PARSE_MAPPED)
+	parse_parallel  WavefrontObj(file, PARSE_PARALLEL)
+	visit           WavefrontObj::stream() with a visitor that stores nothing
+	mesh            Mesh(obj)
+	unpack          Mesh::unpack_to_triangles()
+	write_stream    the parsed data written back with std::ofstream <<
+	write           ObjWriter::write(), one thread
+	write_parallel  ObjWriter::write(), one thread per core
+
+Each stage prints one JSON object per line on stdout, so runs can be diffed
+and compared by a script; progress goes to stderr. mb_per_s is always
+relative to the size of the .obj file, so the stages can be compared with
+each other. Allocations are counted through the global operator new.
+
+Usage: bench_WavefrontObj [options] [faces...]
+	--shape grid|soup      only this shape (default both)
+	--attrs v|vt|vn|vtvn   only this corner format (default all four)
+	--no-stream-parse      skip parse_stream, which is slow on big files
+	--dir path             where to write the generated files (default .)
+	--keep                 keep the generated files
+
+faces defaults to 1000 10000 100000 1000000; 50000000 needs about 3 GB of
+disk and, for the Mesh stages, several GB of memory.
+*/
+
+static std::atomic<size_t> allocation_count(0);
+static std::atomic<size_t> allocation_bytes(0);
+
+// The replacements below are a matched set over malloc() and free(), but
+// once a delete is inlined GCC only sees free() called on the result of
+// operator new and warns.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void *operator new(size_t size) {
+	allocation_count.fetch_add(1, std::memory_order_relaxed);
+	allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+
+	if (void *p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+	std::free(p);
+}
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+typedef std::chrono::steady_clock bench_clock;
+
+static double seconds_since(bench_clock::time_point start) {
+	return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+#ifdef __linux__
+static long status_kib(const char *field) {
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	size_t length = std::strlen(field);
+	while (std::getline(status, line)) {
+		if (line.compare(0, length, field) == 0)
+			return std::stol(line.substr(length));
+	}
+	return -1;
+}
+
+static void reset_peak_rss() {
+	std::ofstream("/proc/self/clear_refs") << "5";
+}
+#else
+static long status_kib(const char *) {
+	return -1;
+}
+
+static void reset_peak_rss() {
+}
+#endif
+
+enum Shape { GRID, SOUP };
+
+struct Attrs {
+	const char *name;
+	bool uv, normal;
+};
+
+static const Attrs all_attrs[] = {
+	{ "v", false, false },
+	{ "vt", true, false },
+	{ "vn", false, true },
+	{ "vtvn", true, true }
+};
+
+// Buffered writer for the generator; formatting dominates at 50M faces,
+// so integers go through to_chars.
+class GeneratorWriter {
+	std::ofstream out;
+	std::string buffer;
+
+public:
+	explicit GeneratorWriter(const std::string &filename)
+		: out(filename, std::ios_base::binary)
+	{
+		buffer.reserve(1 << 20);
+	}
+
+	~GeneratorWriter() {
+		flush();
+	}
+
+	bool is_open() const {
+		return out.is_open();
+	}
+
+	void flush() {
+		out.write(buffer.data(), buffer.size());
+		buffer.clear();
+	}
+
+	void text(const char *s) {
+		buffer += s;
+	}
+
+	void number(size_t value) {
+		char digits[24];
+		char *end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+		buffer.append(digits, end);
+	}
+
+	void floats(const char *directive, const float *values, int count) {
+		char line[96];
+		int length;
+		if (count == 2)
+			length = snprintf(line, sizeof(line), "%s %.5f %.5f\n", directive, values[0], values[1]);
+		else
+			length = snprintf(line, sizeof(line), "%s %.5f %.5f %.5f\n", directive, values[0], values[1], values[2]);
+		buffer.append(line, length);
+	}
+
+	// "f a b c" in the corner format of attrs. Every stream uses the
+	// vertex index, since each vertex has its own uv and normal.
+	void face(const Attrs &attrs, size_t a, size_t b, size_t c) {
+		text("f");
+		for (size_t i : { a, b, c }) {
+			text(" ");
+			number(i);
+			if (attrs.uv || attrs.normal) {
+				text("/");
+				if (attrs.uv)
+					number(i);
+				if (attrs.normal) {
+					text("/");
+					number(i);
+				}
+			}
+		}
+		text("\n");
+
+		if (buffer.size() > (1 << 20) - 128)
+			flush();
+	}
+
+	void vertex(const Attrs &attrs, const float p[3], const float uv[2], const float n[3]) {
+		floats("v", p, 3);
+		if (attrs.uv)
+			floats("vt", uv, 2);
+		if (attrs.normal)
+			floats("vn", n, 3);
+
+		if (buffer.size() > (1 << 20) - 256)
+			flush();
+	}
+};
+
+// Grid: a height field with two triangles per cell, cut off after
+// face_count faces. Soup: face_count triangles over face_count / 2 random
+// vertices, which defeats any locality in the index streams.
+static bool write_obj(const std::string &filename, Shape shape, const Attrs &attrs, size_t face_count) {
+	GeneratorWriter obj(filename);
+	if (!obj.is_open()) {
+		std::cerr << "Failed to open \"" << filename << "\" for writing\n";
+		return false;
+	}
+
+	obj.text("o Bench\n");
+
+	if (shape == GRID) {
+		size_t n = (size_t)std::ceil(std::sqrt(face_count / 2.0)) + 1;
+
+		for (size_t y = 0; y < n; ++y) {
+			for (size_t x = 0; x < n; ++x) {
+				float h = 0.25f * std::sin(x * 0.1f) * std::cos(y * 0.1f);
+				const float p[3] = { (float)x, (float)y, h };
+				const float uv[2] = { x / (float)(n - 1), y / (float)(n - 1) };
+				const float normal[3] = { 0.0f, 0.0f, 1.0f };
+				obj.vertex(attrs, p, uv, normal);
+			}
+		}
+
+		size_t written = 0;
+		for (size_t y = 0; y + 1 < n && written < face_count; ++y) {
+			for (size_t x = 0; x + 1 < n && written < face_count; ++x) {
+				size_t a = y * n + x + 1, b = a + 1, c = a + n, d = c + 1;
+				obj.face(attrs, a, b, d);
+				if (++written < face_count) {
+					obj.face(attrs, a, d, c);
+					++written;
+				}
+			}
+		}
+	}
+	else {
+		std::mt19937_64 rng(face_count);
+		std::uniform_real_distribution<float> coord(-100.0f, 100.0f);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+		size_t vertex_count = std::max<size_t>(3, face_count / 2);
+		for (size_t i = 0; i < vertex_count; ++i) {
+			const float p[3] = { coord(rng), coord(rng), coord(rng) };
+			const float uv[2] = { unit(rng), unit(rng) };
+			const float normal[3] = { unit(rng), unit(rng), unit(rng) };
+			obj.vertex(attrs, p, uv, normal);
+		}
+
+		std::uniform_int_distribution<size_t> index(1, vertex_count);
+		for (size_t i = 0; i < face_count; ++i)
+			obj.face(attrs, index(rng), index(rng), index(rng));
+	}
+
+	return true;
+}
+
+// Counts records without keeping them.
+struct CountingVisitor : WavefrontObj::Visitor {
+	size_t faces = 0;
+
+	void on_face(const WavefrontObj::face_desc &) override { faces++; }
+};
+
+struct Measure {
+	bench_clock::time_point start;
+	size_t allocations, bytes;
+	long rss_before;
+
+	Measure() {
+		reset_peak_rss();
+		rss_before = status_kib("VmRSS:");
+		allocations = allocation_count.load();
+		bytes = allocation_bytes.load();
+		start = bench_clock::now();
+	}
+};
+
+static void report(const Measure &m, const char *stage, Shape shape, const Attrs &attrs,
+	size_t faces, size_t file_bytes) {
+	double seconds = seconds_since(m.start);
+	size_t allocations = allocation_count.load() - m.allocations;
+	size_t bytes = allocation_bytes.load() - m.bytes;
+	long peak = status_kib("VmHWM:");
+
+	printf("{\"shape\":\"%s\",\"attrs\":\"%s\",\"faces\":%zu,\"file_bytes\":%zu,\"stage\":\"%s\","
+		"\"seconds\":%.6f,\"mb_per_s\":%.2f,\"faces_per_s\":%.0f,"
+		"\"peak_rss_kib\":%ld,\"rss_growth_kib\":%ld,\"allocations\":%zu,\"allocated_bytes\":%zu}\n",
+		shape == GRID ? "grid" : "soup", attrs.name, faces, file_bytes, stage,
+		seconds, file_bytes / 1e6 / seconds, faces / seconds,
+		peak, peak >= 0 && m.rss_before >= 0 ? peak - m.rss_before : -1, allocations, bytes);
+	fflush(stdout);
+}
+
+// The obvious way to write the data back out, for comparison with
+// ObjWriter. max_digits10 digits are needed for it to read back exactly.
+static void write_with_stream(const std::string &filename, WavefrontObj &obj) {
+	std::ofstream ofs(filename, std::ios_base::binary);
+	ofs.precision(9);
+
+	WavefrontObj::MeshData data = obj.data();
+	for (const WavefrontObj::vec4f &v : data.vert)
+		ofs << "v " << v.x << " " << v.y << " " << v.z << "\n";
+	for (const WavefrontObj::vec3f &t : data.uv)
+		ofs << "vt " << t.x << " " << t.y << "\n";
+	for (const WavefrontObj::vec3f &n : data.norm)
+		ofs << "vn " << n.x << " " << n.y << " " << n.z << "\n";
+
+	for (size_t i = 0; i < data.f.size(); ++i) {
+		WavefrontObj::face_desc face = data.f[i];
+		ofs << "f";
+		for (const WavefrontObj::face_vertex_desc *c : { &face.p1, &face.p2, &face.p3 }) {
+			ofs << " " << c->vertex;
+			if (c->have.uv || c->have.n)
+				ofs << "/";
+			if (c->have.uv)
+				ofs << c->uv;
+			if (c->have.n)
+				ofs << "/" << c->normal;
+		}
+		ofs << "\n";
+	}
+}
+
+static void bench_file(const std::string &filename, Shape shape, const Attrs &attrs, size_t faces,
+	size_t file_bytes, bool stream_parse) {
+	if (stream_parse) {
+		Measure m;
+		WavefrontObj obj(filename, WavefrontObj::PARSE_STREAM);
+		report(m, "parse_stream", shape, attrs, obj.data().f.size(), file_bytes);
+	}
+
+	{
+		Measure m;
+		WavefrontObj obj(filename, WavefrontObj::PARSE_MAPPED);
+		report(m, "parse_mapped", shape, attrs, obj.data().f.size(), file_bytes);
+	}
+
+	{
+		Measure m;
+		CountingVisitor visitor;
+		WavefrontObj::stream(filename, visitor);
+		report(m, "visit", shape, attrs, visitor.faces, file_bytes);
+	}
+
+	Measure parse;
+	WavefrontObj obj(filename, WavefrontObj::PARSE_PARALLEL);
+	report(parse, "parse_parallel", shape, attrs, obj.data().f.size(), file_bytes);
+
+	Measure construct;
+	Mesh mesh(obj);
+	report(construct, "mesh", shape, attrs, faces, file_bytes);
+
+	Measure unpack;
+	Mesh::Unpacked unpacked = mesh.unpack_to_triangles();
+	report(unpack, "unpack", shape, attrs, unpacked.vertex.size() / 3, file_bytes);
+
+	std::string written = filename + ".written.obj";
+	{
+		Measure m;
+		write_with_stream(written, obj);
+		report(m, "write_stream", shape, attrs, faces, file_bytes);
+	}
+	{
+		Measure m;
+		ObjWriter::write(written, obj, 1);
+		report(m, "write", shape, attrs, faces, file_bytes);
+	}
+	{
+		Measure m;
+		ObjWriter::write(written, obj, 0);
+		report(m, "write_parallel", shape, attrs, faces, file_bytes);
+	}
+	std::remove(written.c_str());
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<size_t> face_counts;
+	std::vector<Shape> shapes = { GRID, SOUP };
+	std::vector<Attrs> attrs(std::begin(all_attrs), std::end(all_attrs));
+	std::string dir = ".";
+	bool stream_parse = true;
+	bool keep = false;
+
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+
+		if (arg == "--shape" && i + 1 < argc) {
+			std::string shape = argv[++i];
+			shapes = { shape == "soup" ? SOUP : GRID };
+		}
+		else if (arg == "--attrs" && i + 1 < argc) {
+			std::string name = argv[++i];
+			attrs.clear();
+			for (const Attrs &a : all_attrs) {
+				if (name == a.name)
+					attrs.push_back(a);
+			}
+		}
+		else if (arg == "--no-stream-parse") {
+			stream_parse = false;
+		}
+		else if (arg == "--dir" && i + 1 < argc) {
+			dir = argv[++i];
+		}
+		else if (arg == "--keep") {
+			keep = true;
+		}
+		else {
+			face_counts.push_back((size_t)std::strtoull(arg.c_str(), nullptr, 10));
+		}
+	}
+
+	if (face_counts.empty())
+		face_counts = { 1000, 10000, 100000, 1000000 };
+
+	for (size_t faces : face_counts) {
+		for (Shape shape : shapes) {
+			for (const Attrs &a : attrs) {
+				std::string filename = dir + "/bench_" + (shape == GRID ? "grid" : "soup") + "_"
+					+ a.name + "_" + std::to_string(faces) + ".obj";
+
+				std::cerr << "Generating " << filename << "\n";
+				if (!write_obj(filename, shape, a, faces))
+					return 1;
+
+				std::ifstream size_check(filename, std::ios_base::binary | std::ios_base::ate);
+				size_t file_bytes = (size_t)size_check.tellg();
+				size_check.close();
+
+				bench_file(filename, shape, a, faces, file_bytes, stream_parse);
+
+				if (!keep)
+					std::remove(filename.c_str());
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,144 @@
+#include <iostream>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ObjWriter.h"
+#include "WavefrontObj.h"
+#include "TestCheck.h"
+#include "WavefrontObjTest.h"
+
+// Everything the parser keeps, compared bit for bit.
+static bool same_obj(WavefrontObj &lhs, WavefrontObj &rhs) {
+	return same_data(lhs, rhs) && same_runs(lhs.objects(), rhs.objects())
+		&& same_runs(lhs.groups(), rhs.groups()) && same_runs(lhs.materials(), rhs.materials())
+		&& lhs.material_libraries() == rhs.material_libraries();
+}
+
+static void reparse(const std::string &text, WavefrontObj &out) {
+	out.parse_mapped(text.data(), text.data() + text.size());
+}
+
+void test_round_trip_records() {
+	static const char *source =
+		"mtllib a.mtl b.mtl\n"
+		"v 1 2 3\n"
+		"v -1.5 2.25 3e-2 0.5\n"
+		"v 0.1 0.2 0.3\n"
+		"vt 0.25 0.75\n"
+		"vt 0.5 0.5 1.0\n"
+		"vn 0 0 1\n"
+		"o First\n"
+		"g left arm\n"
+		"usemtl Red\n"
+		"f 1 2 3\n"
+		"f 1/1 2/2 3/1\n"
+		"usemtl Blue\n"
+		"f 1//1 2//1 3//1\n"
+		"f -3/-2/-1 -2/-1/-1 -1/-1/-1\n"
+		"o Second\n"
+		"g\n"
+		"usemtl Trailing\n";
+
+	std::string text(source);
+	WavefrontObj original;
+	reparse(text, original);
+
+	std::string written;
+	ObjWriter::format(written, original);
+
+	WavefrontObj copy;
+	reparse(written, copy);
+	CHECK(same_obj(original, copy));
+	CHECK(copy.materials().runs.back().first_face == 4);
+
+	// Writing the copy again gives the same text.
+	std::string again;
+	ObjWriter::format(again, copy);
+	CHECK(again == written);
+}
+
+void test_round_trip_floats() {
+	// Awkward values first, then random bit patterns over the whole range.
+	std::vector<float> values = { 0.0f, -0.0f, 1.0f, -1.0f, 0.1f, 1.0f / 3.0f, FLT_MAX, -FLT_MAX,
+		FLT_MIN, FLT_TRUE_MIN, -FLT_TRUE_MIN, FLT_MIN * 0.5f, 16777216.0f, 16777217.0f, 1e-7f, 123456789.0f };
+
+	std::mt19937 rng(20240601);
+	while (values.size() < 300000) {
+		uint32_t bits = rng();
+		float f;
+		std::memcpy(&f, &bits, sizeof(f));
+		if (std::isfinite(f))
+			values.push_back(f);
+	}
+
+	WavefrontObj original;
+	WavefrontObj::MeshData data = original.data();
+	for (size_t i = 0; i + 4 <= values.size(); i += 4) {
+		data.vert.push_back(WavefrontObj::vec4f(&values[i], 4));
+		data.uv.push_back(WavefrontObj::vec3f(&values[i], 3));
+		data.norm.push_back(WavefrontObj::vec3f(&values[i + 1], 3));
+	}
+
+	for (size_t i = 0; i + 3 <= data.vert.size(); i += 3) {
+		WavefrontObj::face_desc face;
+		WavefrontObj::face_vertex_desc *corner[3] = { &face.p1, &face.p2, &face.p3 };
+		for (size_t c = 0; c < 3; ++c) {
+			corner[c]->have = { true, i % 2 == 0, true };
+			corner[c]->vertex = i + c + 1;
+			corner[c]->uv = corner[c]->have.uv ? i + c + 1 : 0;
+			corner[c]->normal = i + c + 1;
+		}
+		data.f.push_back(face);
+	}
+
+	std::string serial;
+	ObjWriter::format(serial, original, 1);
+	CHECK(serial.size() > 2 * ObjWriter::WRITE_BUFFER_SIZE);
+
+	WavefrontObj copy;
+	reparse(serial, copy);
+	CHECK(same_obj(original, copy));
+
+	// Blocks formatted side by side come out in the same order.
+	for (unsigned threads : { 2u, 3u, 0u }) {
+		std::string parallel;
+		ObjWriter::format(parallel, original, threads);
+		CHECK(parallel == serial);
+	}
+
+	char buf[ObjWriter::MAX_FLOAT_CHARS];
+	char *end = ObjWriter::format_float(buf, 0.1f);
+	CHECK(std::string(buf, end) == "0.1");
+	end = ObjWriter::format_float(buf, -0.0f);
+	CHECK(std::string(buf, end) == "-0");
+}
+
+void test_write_file() {
+	std::string text = "v 1 2 3\nv 4 5 6\nv 7 8 9\nf 1 2 3\n";
+	WavefrontObj original;
+	reparse(text, original);
+
+	CHECK(ObjWriter::write("written.obj", original, 0));
+	WavefrontObj copy("written.obj", WavefrontObj::PARSE_MAPPED);
+	CHECK(same_obj(original, copy));
+
+	CHECK(!ObjWriter::write("no/such/dir/written.obj", original));
+}
+
+int main()
+{
+	test_round_trip_records();
+	test_round_trip_floats();
+	test_write_file();
+
+	if (failures) {
+		std::cerr << failures << " check(s) failed\n";
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,80 @@
+#include <iostream>
+#include <string>
+
+#include "WavefrontMtl.h"
+#include "TestCheck.h"
+#include "WavefrontObjTest.h"
+
+void test_parse() {
+	static const char *mtl =
+		"# two materials\n"
+		"Kd 1 1 1\n"
+		"newmtl Red\n"
+		"Ka 0.1 0.1 0.1\n"
+		"Kd 1.0 0.0 0.0\r\n"
+		"Ks 0.5\n"
+		"Ns 96.0\n"
+		"d 0.25\n"
+		"illum 1\n"
+		"Pr 0.5\n"
+		"map_Kd -s 1 1 1 -o 0 0 0 red.tga\n"
+		"map_Bump -bm 0.5 red_normal.tga\n"
+		"\n"
+		"newmtl Glass Pane\n"
+		"Tr 0.75\n";
+
+	WavefrontMtl lib;
+	lib.parse(mtl, mtl + std::char_traits<char>::length(mtl));
+
+	CHECK(lib.size() == 2);
+	CHECK(lib.find("Missing") == WavefrontMtl::NOT_FOUND);
+
+	uint32_t red = lib.find("Red");
+	CHECK(red == 0);
+	if (red != WavefrontMtl::NOT_FOUND) {
+		const WavefrontMtl::Material &m = lib.material(red);
+		CHECK(m.ambient[0] == 0.1f);
+		CHECK(m.diffuse[0] == 1.0f && m.diffuse[1] == 0.0f && m.diffuse[2] == 0.0f);
+		CHECK(m.specular[0] == 0.5f && m.specular[1] == 0.5f && m.specular[2] == 0.5f);
+		CHECK(m.shininess == 96.0f);
+		CHECK(m.opacity == 0.25f);
+		CHECK(m.illum == 1);
+		CHECK(m.diffuse_map == "red.tga");
+		CHECK(m.bump_map == "red_normal.tga");
+	}
+
+	uint32_t glass = lib.find("Glass Pane");
+	CHECK(glass == 1);
+	if (glass != WavefrontMtl::NOT_FOUND) {
+		CHECK(lib.material(glass).opacity == 0.25f);
+		CHECK(lib.material(glass).diffuse[0] == 0.8f);
+		CHECK(lib.material(glass).diffuse_map.empty());
+	}
+}
+
+void test_load_libraries() {
+	write_file("first.mtl", "newmtl A\nKd 1 0 0\nnewmtl B\nKd 0 1 0\n");
+	write_file("second.mtl", "newmtl B\nKd 0 0 1\n");
+
+	// Paths are relative to the .obj file, which need not exist.
+	WavefrontMtl lib;
+	CHECK(lib.load_libraries({ "first.mtl", "missing.mtl", "second.mtl" }, "./model.obj") == 2);
+
+	CHECK(lib.size() == 2);
+	CHECK(lib.find("A") == 0);
+	CHECK(lib.find("B") == 1);
+	CHECK(lib.material(1).diffuse[2] == 1.0f && lib.material(1).diffuse[1] == 0.0f);
+}
+
+int main()
+{
+	test_parse();
+	test_load_libraries();
+
+	if (failures) {
+		std::cerr << failures << " check(s) failed\n";
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,567 @@
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ObjScan.h"
+#include "WavefrontObj.h"
+#include "TestCheck.h"
+#include "WavefrontObjTest.h"
+
+// Covers every corner form, optional w/z components, comments, CRLF line
+// endings and trailing whitespace.
+static const char *synthetic_obj =
+	"# synthetic test mesh\n"
+	"o First\n"
+	"v 1.0 2.0 3.0\n"
+	"v -1.5 +2.25 3e-2 0.5\n"
+	"v 0.1 0.2 0.3 \n"
+	"v 4 5 6 # trailing comment\n"
+	"v 7 8 9\r\n"
+	"vt 0.25 0.75\n"
+	"vt 0.5 0.5 1.0\n"
+	"vn 0 0 1\n"
+	"vn 0.577350 0.577350 0.577350\n"
+	"\n"
+	"   \t\n"
+	"f 1 2 3 \r\n"
+	"f 1/1 2/2 3/1\n"
+	"f 1//1 2//2 4//1\n"
+	"f 2/1/1 3/2/2 4/2/1\n"
+	"f 1/ 2/ 5/\n"
+	"o Second\n"
+	"f 5/2/2 4/1/1 3/2/1";
+
+void test_mapped_matches_stream_synthetic() {
+	write_file("synthetic.obj", synthetic_obj);
+
+	WavefrontObj stream("synthetic.obj", WavefrontObj::PARSE_STREAM);
+	WavefrontObj mapped("synthetic.obj", WavefrontObj::PARSE_MAPPED);
+
+	CHECK(stream.data().vert.size() == 5);
+	CHECK(stream.data().vert[2].w == 1.0f);
+	CHECK(stream.data().vert[4].w == 1.0f);
+	CHECK(stream.data().f.size() == 6);
+	CHECK(same_data(stream, mapped));
+}
+
+void test_mapped_matches_stream_res() {
+	static const char *files[] = { "coollogo.obj", "texturedplane.obj" };
+
+	for (const char *name : files) {
+		std::string path = std::string(RES_DIR) + name;
+
+		WavefrontObj stream(path, WavefrontObj::PARSE_STREAM);
+		WavefrontObj mapped(path, WavefrontObj::PARSE_MAPPED);
+
+		CHECK(stream.data().f.size() != 0);
+		CHECK(same_data(stream, mapped));
+	}
+}
+
+void test_mapped_long_line() {
+	// Longer than MAX_LINE_LENGTH; the mapped path must not truncate it.
+	std::string line = "v 1.";
+	line.append(300, '0');
+	line += " 2 3\n";
+	write_file("longline.obj", line);
+
+	WavefrontObj mapped("longline.obj", WavefrontObj::PARSE_MAPPED);
+	CHECK(mapped.data().vert.size() == 1);
+	CHECK(mapped.data().vert[0].z == 3.0f);
+}
+
+void test_mapped_empty_file() {
+	write_file("empty.obj", "");
+
+	WavefrontObj mapped("empty.obj", WavefrontObj::PARSE_MAPPED);
+	CHECK(mapped.data().vert.size() == 0);
+	CHECK(mapped.data().f.size() == 0);
+}
+
+// n x n grid with uv and normal per vertex, two triangles per cell. Every
+// fourth row of faces uses relative indices, so that chunk merges have
+// something to fix up.
+static std::string make_grid_obj(size_t n) {
+	std::string obj = "o Grid\n";
+
+	for (size_t y = 0; y < n; ++y) {
+		for (size_t x = 0; x < n; ++x) {
+			obj += "v " + std::to_string(x * 0.125f) + " " + std::to_string(y * 0.125f) + " 0.0\n";
+			obj += "vt " + std::to_string(x / (float)n) + " " + std::to_string(y / (float)n) + "\n";
+			obj += "vn 0 0 1\r\n";
+		}
+	}
+
+	for (size_t y = 0; y + 1 < n; ++y) {
+		for (size_t x = 0; x + 1 < n; ++x) {
+			size_t a = y * n + x + 1, b = a + 1, c = a + n, d = c + 1;
+			size_t count = n * n;
+
+			auto corner = [&](size_t i) {
+				if (y % 4 == 3) {
+					std::string rel = "-" + std::to_string(count + 1 - i);
+					return rel + "/" + rel + "/" + rel;
+				}
+				std::string abs = std::to_string(i);
+				return abs + "/" + abs + "/" + abs;
+			};
+
+			obj += "f " + corner(a) + " " + corner(b) + " " + corner(d) + "\n";
+			obj += "f " + corner(a) + " " + corner(d) + " " + corner(c) + "\n";
+		}
+
+		obj += "# row " + std::to_string(y) + "\n";
+	}
+
+	return obj;
+}
+
+void test_relative_indices() {
+	write_file("absolute.obj", "v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\nvn 0 0 1\nf 1/1/1 2/1/1 3/1/1\n");
+	write_file("relative.obj", "v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\nvn 0 0 1\nf -3/-1/-1 -2/-1/-1 -1/-1/-1\n");
+
+	WavefrontObj absolute("absolute.obj", WavefrontObj::PARSE_MAPPED);
+	WavefrontObj relative_stream("relative.obj", WavefrontObj::PARSE_STREAM);
+	WavefrontObj relative_mapped("relative.obj", WavefrontObj::PARSE_MAPPED);
+
+	CHECK(same_data(absolute, relative_stream));
+	CHECK(same_data(absolute, relative_mapped));
+}
+
+void test_parallel_matches_serial() {
+	std::string obj = make_grid_obj(200);
+
+	WavefrontObj serial;
+	serial.parse_mapped(obj.data(), obj.data() + obj.size());
+	CHECK(serial.data().f.size() == 2 * 199 * 199);
+
+	for (unsigned threads : { 1u, 2u, 3u, 7u, 16u }) {
+		WavefrontObj parallel;
+		parallel.parse_parallel(obj.data(), obj.data() + obj.size(), threads);
+		CHECK(same_data(serial, parallel));
+	}
+
+	// Without the trailing newline the last chunk ends mid-line.
+	obj.pop_back();
+	WavefrontObj serial_unterminated;
+	serial_unterminated.parse_mapped(obj.data(), obj.data() + obj.size());
+	WavefrontObj parallel_unterminated;
+	parallel_unterminated.parse_parallel(obj.data(), obj.data() + obj.size(), 5);
+	CHECK(same_data(serial_unterminated, parallel_unterminated));
+
+	write_file("grid.obj", obj);
+	WavefrontObj stream("grid.obj", WavefrontObj::PARSE_STREAM);
+	WavefrontObj parallel_file("grid.obj", WavefrontObj::PARSE_PARALLEL);
+	CHECK(same_data(stream, parallel_file));
+}
+
+static bool same_bounds(const WavefrontObj::Bounds &a, const WavefrontObj::Bounds &b) {
+	for (int i = 0; i < 3; ++i) {
+		if (!same_bits(a.min[i], b.min[i]) || !same_bits(a.max[i], b.max[i]))
+			return false;
+	}
+	return true;
+}
+
+// The box the parser gathered, worked out again from the stored vertices.
+static WavefrontObj::Bounds bounds_of(WavefrontObj &obj) {
+	WavefrontObj::Bounds b;
+	for (const WavefrontObj::vec4f &v : obj.data().vert)
+		b.add(v.x, v.y, v.z);
+	return b;
+}
+
+void test_bounds() {
+	WavefrontObj empty;
+	CHECK(empty.bounds().empty());
+
+	float center[3], radius;
+	empty.bounds().sphere(center, radius);
+	CHECK(radius == 0.0f);
+
+	std::string text(synthetic_obj);
+	WavefrontObj mapped;
+	mapped.parse_mapped(text.data(), text.data() + text.size());
+	WavefrontObj::Bounds b = mapped.bounds();
+	CHECK(!b.empty());
+	CHECK(b.min[0] == -1.5f && b.min[1] == 0.2f && b.min[2] == 3e-2f);
+	CHECK(b.max[0] == 7.0f && b.max[1] == 8.0f && b.max[2] == 9.0f);
+	CHECK(same_bounds(b, bounds_of(mapped)));
+
+	b.sphere(center, radius);
+	CHECK(center[0] == 2.75f && center[1] == (0.2f + 8.0f) * 0.5f && center[2] == (3e-2f + 9.0f) * 0.5f);
+	CHECK(std::fabs(radius - std::sqrt(4.25f * 4.25f + 3.9f * 3.9f + 4.485f * 4.485f)) < 1e-5f);
+
+	// Every parse mode gathers the same box.
+	write_file("synthetic.obj", text);
+	WavefrontObj stream("synthetic.obj", WavefrontObj::PARSE_STREAM);
+	CHECK(same_bounds(b, stream.bounds()));
+
+	std::string grid = make_grid_obj(200);
+	WavefrontObj serial;
+	serial.parse_mapped(grid.data(), grid.data() + grid.size());
+	CHECK(same_bounds(serial.bounds(), bounds_of(serial)));
+
+	for (unsigned threads : { 2u, 3u, 7u }) {
+		WavefrontObj parallel;
+		parallel.parse_parallel(grid.data(), grid.data() + grid.size(), threads);
+		CHECK(same_bounds(serial.bounds(), parallel.bounds()));
+	}
+}
+
+void test_face_indices() {
+	// Streams are only allocated once a face uses them; earlier faces read
+	// as having no index there.
+	std::string small = "v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\nf 1 2 3\nf 3/1 2/1 1/1\n";
+	WavefrontObj obj;
+	obj.parse_mapped(small.data(), small.data() + small.size());
+	const WavefrontObj::FaceIndices &f = obj.data().f;
+
+	CHECK(f.size() == 2);
+	CHECK(f.has(WavefrontObj::FaceIndices::VERTEX) && f.has(WavefrontObj::FaceIndices::UV));
+	CHECK(!f.has(WavefrontObj::FaceIndices::NORMAL) && f.normal.empty());
+	CHECK(f.vertex == std::vector<uint32_t>({ 1, 2, 3, 3, 2, 1 }));
+	CHECK(f.uv == std::vector<uint32_t>({ 0, 0, 0, 1, 1, 1 }));
+	CHECK(!f[0].p1.have.uv && f[1].p3.have.uv && f[1].p3.vertex == 1 && !f[1].p3.have.n);
+
+	// A stream that only a later chunk uses, and relative indices reaching
+	// back into earlier chunks.
+	std::string big;
+	for (size_t i = 0; i < 40000; ++i)
+		big += "v 0 0 0\nv 1 0 0\nv 0 1 0\nf -3 -2 -1\n";
+	big += "vn 0 0 1\n";
+	for (size_t i = 0; i < 40000; ++i)
+		big += "f -9000//-1 -6000//-1 -3000//-1\n";
+
+	WavefrontObj serial;
+	serial.parse_mapped(big.data(), big.data() + big.size());
+	CHECK(serial.data().f.has(WavefrontObj::FaceIndices::NORMAL));
+	CHECK(serial.data().f.vertex.back() == 120000 - 3000 + 1);
+
+	for (unsigned threads : { 2u, 5u }) {
+		WavefrontObj parallel;
+		parallel.parse_parallel(big.data(), big.data() + big.size(), threads);
+		CHECK(same_data(serial, parallel));
+		CHECK(parallel.data().f.mask == serial.data().f.mask);
+	}
+}
+
+void test_groups_and_materials() {
+	static const char *obj =
+		"mtllib a.mtl b.mtl\n"
+		"v 0 0 0\nv 1 0 0\nv 0 1 0\n"
+		"f 1 2 3\n"
+		"o Body\n"
+		"g left side\n"
+		"usemtl Red\n"
+		"s 1\n"
+		"f 1 2 3\nf 1 2 3\n"
+		"usemtl Blue\n"
+		"usemtl Red\n"
+		"f 1 2 3\n"
+		"g right\n"
+		"s off\n"
+		"l 1 2\n"
+		"usemtl Blue\n"
+		"f 1 2 3\n"
+		"usemtl Red\r\n"
+		"f 1 2 3\n";
+	write_file("groups.obj", obj);
+
+	WavefrontObj stream("groups.obj", WavefrontObj::PARSE_STREAM);
+	WavefrontObj mapped("groups.obj", WavefrontObj::PARSE_MAPPED);
+
+	CHECK(mapped.data().f.size() == 6);
+	CHECK(same_data(stream, mapped));
+
+	for (WavefrontObj *parsed : { &stream, &mapped }) {
+		CHECK(parsed->material_libraries() == std::vector<std::string>({ "a.mtl", "b.mtl" }));
+
+		// "usemtl Blue" with no faces after it does not start a run, and
+		// the "Red" after it continues the one before.
+		const WavefrontObj::FaceRuns &materials = parsed->materials();
+		CHECK(materials.names == std::vector<std::string>({ "Red", "Blue" }));
+		CHECK(materials.runs.size() == 3);
+		CHECK(same_runs(materials, mapped.materials()));
+		CHECK(materials.name_of(0) == WavefrontObj::NO_NAME);
+		CHECK(materials.name_of(3) == 0);
+		CHECK(materials.name_of(4) == 1);
+		CHECK(materials.name_of(5) == 0);
+
+		const WavefrontObj::FaceRuns &groups = parsed->groups();
+		CHECK(groups.names == std::vector<std::string>({ "left side", "right" }));
+		CHECK(groups.name_of(3) == 0 && groups.name_of(4) == 1);
+
+		CHECK(parsed->objects().runs.size() == 1 && parsed->objects().runs[0].first_face == 1);
+	}
+}
+
+// A material per row of faces, switched back and forth, with the same
+// names reaching every chunk in a different order.
+void test_parallel_material_runs() {
+	std::string obj = make_grid_obj(120);
+	std::string tagged;
+	size_t row = 0;
+
+	for (size_t pos = 0; pos < obj.size();) {
+		size_t eol = obj.find('\n', pos) + 1;
+		if (obj.compare(pos, 6, "# row ") == 0) {
+			tagged += "usemtl m" + std::to_string(row * 7 % 5) + "\n";
+			tagged += "g row" + std::to_string(row++) + "\n";
+		}
+		tagged.append(obj, pos, eol - pos);
+		pos = eol;
+	}
+
+	WavefrontObj serial;
+	serial.parse_mapped(tagged.data(), tagged.data() + tagged.size());
+	CHECK(serial.materials().names.size() == 5);
+	CHECK(serial.groups().runs.size() == 119);
+
+	for (unsigned threads : { 2u, 3u, 7u }) {
+		WavefrontObj parallel;
+		parallel.parse_parallel(tagged.data(), tagged.data() + tagged.size(), threads);
+		CHECK(same_data(serial, parallel));
+		CHECK(same_runs(serial.materials(), parallel.materials()));
+		CHECK(same_runs(serial.groups(), parallel.groups()));
+		CHECK(same_runs(serial.objects(), parallel.objects()));
+	}
+}
+
+void test_scan_float_exact() {
+	std::mt19937 rng(42);
+	char buf[64];
+	size_t mismatches = 0;
+
+	for (int i = 0; i < 100000; ++i) {
+		uint32_t bits = rng() & 0x7F7FFFFF;
+		float value;
+		std::memcpy(&value, &bits, sizeof(value));
+
+		// Shortest forms take the fast paths, 17 digits the Eisel-Lemire one.
+		for (int precision : { 6, 9, 17 }) {
+			snprintf(buf, sizeof(buf), "%.*g", precision, value);
+
+			const char *end = buf + std::strlen(buf);
+			const char *p = buf;
+			float scanned = 0.0f, expected = 0.0f;
+
+			bool ok = ObjScan::scan_float(p, end, scanned);
+			std::from_chars_result res = std::from_chars(buf, end, expected);
+
+			if (res.ec == std::errc::result_out_of_range)
+				continue;
+			if (!ok || p != res.ptr || !same_bits(scanned, expected))
+				mismatches++;
+		}
+	}
+
+	CHECK(mismatches == 0);
+
+	const char *halfway = "16777217"; // 2^24 + 1, ties to even
+	const char *p = halfway;
+	float value = 0.0f;
+	CHECK(ObjScan::scan_float(p, halfway + 8, value));
+	CHECK(value == 16777216.0f);
+}
+
+void test_scan_face_corner() {
+	auto scan = [](const char *token) {
+		return ObjScan::scan_face_corner(token, token + std::strlen(token));
+	};
+
+	WavefrontObj::face_vertex_desc d = scan("123456789");
+	CHECK(d.have.v && !d.have.uv && !d.have.n && d.vertex == 123456789);
+
+	d = scan("12/");
+	CHECK(d.have.v && d.have.uv && !d.have.n && d.vertex == 12 && d.uv == 0);
+
+	d = scan("7//9");
+	CHECK(d.have.v && !d.have.uv && d.have.n && d.vertex == 7 && d.normal == 9);
+
+	d = scan("1/22/333");
+	CHECK(d.have.v && d.have.uv && d.have.n && d.vertex == 1 && d.uv == 22 && d.normal == 333);
+
+	d = scan("-1/-2/-3");
+	CHECK(d.have.v && d.have.uv && d.have.n && d.vertex == SIZE_MAX && d.normal == SIZE_MAX - 2);
+}
+
+// Collects every record, to compare stream() against the in-memory parser.
+struct CollectingVisitor : WavefrontObj::Visitor {
+	WavefrontObj obj;
+	std::vector<WavefrontObj::vec4f> vert;
+	std::vector<WavefrontObj::vec3f> uv, norm;
+	std::vector<WavefrontObj::face_desc> f;
+	std::vector<std::string> objects, groups, materials, libraries;
+
+	void on_object(std::string_view name) override { objects.emplace_back(name); }
+	void on_group(std::string_view name) override { groups.emplace_back(name); }
+	void on_material(std::string_view name) override { materials.emplace_back(name); }
+	void on_material_library(std::string_view name) override { libraries.emplace_back(name); }
+	void on_vertex(const WavefrontObj::vec4f &v) override { vert.push_back(v); }
+	void on_uv(const WavefrontObj::vec3f &t) override { uv.push_back(t); }
+	void on_normal(const WavefrontObj::vec3f &n) override { norm.push_back(n); }
+	void on_face(const WavefrontObj::face_desc &face) override { f.push_back(face); }
+};
+
+void test_stream_matches_parse() {
+	std::string obj = make_grid_obj(60);
+	// One line longer than the read buffer below, to force it to grow.
+	obj += "# " + std::string(500, 'x') + "\no Tail\n";
+	obj += "mtllib tail.mtl\ng tail group\nusemtl Tail\ns 1\n";
+	write_file("stream.obj", obj);
+
+	WavefrontObj parsed("stream.obj", WavefrontObj::PARSE_MAPPED);
+	WavefrontObj::MeshData data = parsed.data();
+
+	for (size_t buffer_size : { (size_t)64, (size_t)4096, WavefrontObj::STREAM_BUFFER_SIZE }) {
+		CollectingVisitor visitor;
+		CHECK(WavefrontObj::stream("stream.obj", visitor, buffer_size));
+
+		CHECK(visitor.objects.size() == 2 && visitor.objects[1] == "Tail");
+		CHECK(visitor.groups == std::vector<std::string>({ "tail group" }));
+		CHECK(visitor.materials == std::vector<std::string>({ "Tail" }));
+		CHECK(visitor.libraries == std::vector<std::string>({ "tail.mtl" }));
+		CHECK(visitor.vert.size() == data.vert.size());
+		CHECK(visitor.uv.size() == data.uv.size());
+		CHECK(visitor.norm.size() == data.norm.size());
+		CHECK(visitor.f.size() == data.f.size());
+
+		bool same = visitor.f.size() == data.f.size();
+		for (size_t i = 0; same && i < visitor.f.size(); ++i) {
+			same = same_corner(visitor.f[i].p1, data.f[i].p1)
+				&& same_corner(visitor.f[i].p2, data.f[i].p2)
+				&& same_corner(visitor.f[i].p3, data.f[i].p3);
+		}
+		for (size_t i = 0; same && i < visitor.vert.size(); ++i) {
+			same = same_bits(visitor.vert[i].x, data.vert[i].x)
+				&& same_bits(visitor.vert[i].y, data.vert[i].y)
+				&& same_bits(visitor.vert[i].z, data.vert[i].z);
+		}
+		CHECK(same);
+	}
+}
+
+#ifdef __linux__
+// Peak resident set size in KiB since the last reset_peak_rss().
+static long peak_rss_kib() {
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line)) {
+		if (line.compare(0, 6, "VmHWM:") == 0)
+			return std::stol(line.substr(6));
+	}
+	return -1;
+}
+
+static void reset_peak_rss() {
+	std::ofstream("/proc/self/clear_refs") << "5";
+}
+#endif
+
+// Counts records and computes bounds, storing nothing per record.
+struct BoundsVisitor : WavefrontObj::Visitor {
+	size_t vertices = 0, faces = 0, bad_indices = 0;
+	float min_x = 1e30f, max_x = -1e30f;
+
+	void on_vertex(const WavefrontObj::vec4f &v) override {
+		vertices++;
+		min_x = std::min(min_x, v.x);
+		max_x = std::max(max_x, v.x);
+	}
+
+	void on_face(const WavefrontObj::face_desc &face) override {
+		faces++;
+		for (const WavefrontObj::face_vertex_desc *c : { &face.p1, &face.p2, &face.p3 }) {
+			if (c->vertex == 0 || c->vertex > vertices)
+				bad_indices++;
+		}
+	}
+};
+
+// Streams a synthetic file of size_mb MiB and checks the record counts. With
+// check_memory, peak memory must also stay flat; that is only asked of the
+// multi-GB run, --stream-mb 4096 (ctest -C Large).
+void test_stream_bounded_memory(size_t size_mb, bool check_memory) {
+	const char *filename = "stream_large.obj";
+
+	std::string block;
+	for (int i = 0; i < 1000; ++i) {
+		block += "v " + std::to_string(i * 0.001f) + " 1.000000 -2.500000\n";
+		block += "f -1 -2 -3\n";
+	}
+
+	size_t blocks = size_mb * 1024 * 1024 / block.size() + 1;
+	{
+		std::ofstream ofs(filename, std::ios_base::binary);
+		for (size_t i = 0; i < blocks; ++i)
+			ofs.write(block.data(), block.size());
+	}
+
+#ifdef __linux__
+	long rss_before = 0;
+	if (check_memory) {
+		reset_peak_rss();
+		rss_before = peak_rss_kib();
+	}
+#endif
+
+	BoundsVisitor visitor;
+	CHECK(WavefrontObj::stream(filename, visitor));
+
+	// The first two faces of the file reach back before the first vertex.
+	CHECK(visitor.vertices == blocks * 1000);
+	CHECK(visitor.faces == blocks * 1000);
+	CHECK(visitor.bad_indices == 3);
+	CHECK(visitor.min_x == 0.0f);
+
+#ifdef __linux__
+	if (check_memory) {
+		long growth_kib = peak_rss_kib() - rss_before;
+		std::cout << "stream(): " << blocks * block.size() / (1024 * 1024) << " MiB file, peak RSS grew by "
+			<< growth_kib << " KiB\n";
+		CHECK(growth_kib < 16 * 1024);
+	}
+#else
+	(void)check_memory;
+#endif
+
+	std::remove(filename);
+}
+
+int main(int argc, char **argv)
+{
+	if (argc == 3 && std::string(argv[1]) == "--stream-mb") {
+		test_stream_bounded_memory(std::stoul(argv[2]), true);
+		return failures ? 1 : 0;
+	}
+
+	test_mapped_matches_stream_synthetic();
+	test_mapped_matches_stream_res();
+	test_mapped_long_line();
+	test_mapped_empty_file();
+	test_relative_indices();
+	test_parallel_matches_serial();
+	test_bounds();
+	test_face_indices();
+	test_groups_and_materials();
+	test_parallel_material_runs();
+	test_scan_float_exact();
+	test_scan_face_corner();
+	test_stream_matches_parse();
+	test_stream_bounded_memory(4, false);
+
+	if (failures) {
+		std::cerr << failures << " check(s) failed\n";
+		return 1;
+	}
+
+	return 0;
+}
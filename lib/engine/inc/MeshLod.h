@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+Levels of detail of one mesh, stored as ranges of a shared index buffer,
+finest first. Each level records the largest geometric error of its
+simplification in mesh units; select() projects that error to pixels and
+returns the coarsest level that stays under the allowed pixel error.
+*/
+
+class MeshLod {
+public:
+	// Plain data so levels can be stored in a mesh cache.
+	struct Level {
+		uint32_t first_index;
+		uint32_t index_count;
+		float error;
+	};
+
+	MeshLod();
+	MeshLod(const Level *levels, size_t count);
+
+	void add(const Level &level);
+	void clear();
+
+	size_t size() const { return m_levels.size(); }
+	bool empty() const { return m_levels.empty(); }
+	const Level &level(size_t i) const { return m_levels[i]; }
+	const Level *levels() const { return m_levels.data(); }
+
+	// pixels_per_unit is how many pixels one mesh unit covers on screen at
+	// the mesh's position, see perspective_scale().
+	size_t select(float pixels_per_unit, float max_pixel_error = 1.0f) const;
+
+	// Pixels per unit at distance from a perspective camera with vertical
+	// field of view fov_y (radians) and a viewport viewport_height high.
+	static float perspective_scale(float distance, float fov_y, float viewport_height);
+
+private:
+	std::vector<Level> m_levels;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+A meshlet is a small run of triangles in a mesh's index buffer together
+with bounds that let whole runs be rejected on the CPU before any draw is
+issued:
+
+ - a bounding sphere and an AABB, tested against the view frustum, and
+ - a normal cone (apex, axis and cutoff) that covers every triangle's
+   facing. If the camera sits inside the cone's "back" region, every
+   triangle of the meshlet faces away from it.
+
+A cone_cutoff of 1 means the normals spread too far for the cone to ever
+reject anything.
+*/
+
+struct Meshlet {
+	uint32_t first_index;
+	uint32_t index_count;
+	uint32_t vertex_count;
+
+	float center[3];
+	float radius;
+
+	float aabb_min[3];
+	float aabb_max[3];
+
+	float cone_apex[3];
+	float cone_axis[3];
+	float cone_cutoff;
+};
+
+// Six planes (a, b, c, d), with a point p inside when a*x + b*y + c*z + d >= 0
+// for all of them.
+struct Frustum {
+	float planes[6][4];
+
+	// From a column-major clip-from-object matrix, as OpenGL stores it.
+	static Frustum from_matrix(const float m[16]);
+
+	bool intersects_sphere(const float center[3], float radius) const;
+	bool intersects_aabb(const float min[3], const float max[3]) const;
+};
+
+struct MeshletCull {
+	struct DrawRange {
+		uint32_t first_index;
+		uint32_t index_count;
+	};
+
+	static bool frustum_culled(const Meshlet &m, const Frustum &frustum);
+	static bool cone_culled(const Meshlet &m, const float camera_position[3]);
+
+	// Appends a draw range per run of consecutive visible meshlets to draws
+	// and returns how many meshlets survived. Cone culling is skipped when
+	// camera_position is null.
+	static size_t cull(const Meshlet *meshlets, size_t count, const Frustum &frustum,
+		const float *camera_position, std::vector<DrawRange> &draws);
+};
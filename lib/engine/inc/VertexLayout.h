@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <GL/glew.h>
+#include <GL/freeglut.h>
+
+#include "Program.h"
+
+/*
+Describes one interleaved vertex: which attributes it has, their component
+type and count, and where each one sits inside the stride. Attributes are
+laid out in the order they are added, each aligned to four bytes.
+
+bind() issues the matching glVertexAttribPointer() calls for the buffer
+currently bound to GL_ARRAY_BUFFER, so one VBO serves every attribute.
+
+Quantised attributes come with a Dequantize block that the vertex shader
+applies: position = vertex_offset + vertex * vertex_scale, the same for uv,
+and normals are unpacked from octahedral form when normal_octahedral is set.
+*/
+
+class VertexLayout {
+public:
+	enum Attribute {
+		POSITION = 0,
+		NORMAL,
+		UV,
+		TANGENT,
+		ATTRIBUTE_COUNT
+	};
+
+	// Plain data so a layout can be stored next to the vertices it
+	// describes. size == 0 means the attribute is absent.
+	struct Element {
+		uint32_t size;
+		uint32_t type;
+		uint32_t normalized;
+		uint32_t offset;
+	};
+
+	// Plain data as well; the identity transform for float attributes.
+	struct Dequantize {
+		float position_offset[3];
+		float position_scale[3];
+		float uv_offset[2];
+		float uv_scale[2];
+		uint32_t normal_octahedral;
+
+		Dequantize();
+
+		// Sets the matching uniforms of program, which must be in use.
+		void set_uniforms(const Program &program) const;
+	};
+
+	VertexLayout();
+	VertexLayout(const Element *elements, size_t count, uint32_t stride);
+
+	void add(Attribute attribute, uint32_t size, GLenum type = GL_FLOAT, bool normalized = false);
+
+	bool has(Attribute attribute) const { return m_elements[attribute].size != 0; }
+	const Element &element(Attribute attribute) const { return m_elements[attribute]; }
+	const Element *elements() const { return m_elements; }
+	uint32_t stride() const { return m_stride; }
+
+	// Enables and points every attribute the program uses at the bound
+	// GL_ARRAY_BUFFER. Attributes the program does not use are skipped.
+	void bind(const Program &program) const;
+
+	// Name of the shader input for each attribute.
+	static const char *attribute_name(Attribute attribute);
+	static uint32_t type_size(GLenum type);
+
+private:
+	Element m_elements[ATTRIBUTE_COUNT];
+	uint32_t m_stride;
+};
@@ -0,0 +1,44 @@
+#include <cmath>
+
+#include "MeshLod.h"
+
+MeshLod::MeshLod()
+{
+}
+
+MeshLod::MeshLod(const Level *levels, size_t count) :
+	m_levels(levels, levels + count)
+{
+}
+
+void MeshLod::add(const Level &level)
+{
+	m_levels.push_back(level);
+}
+
+void MeshLod::clear()
+{
+	m_levels.clear();
+}
+
+size_t MeshLod::select(float pixels_per_unit, float max_pixel_error) const
+{
+	size_t chosen = 0;
+
+	for (size_t i = 1; i < m_levels.size(); ++i) {
+		if (m_levels[i].error * pixels_per_unit > max_pixel_error)
+			break;
+
+		chosen = i;
+	}
+
+	return chosen;
+}
+
+float MeshLod::perspective_scale(float distance, float fov_y, float viewport_height)
+{
+	if (distance <= 0.0f)
+		return INFINITY;
+
+	return viewport_height / (2.0f * distance * std::tan(fov_y * 0.5f));
+}
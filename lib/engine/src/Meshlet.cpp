@@ -0,0 +1,102 @@
+#include <cmath>
+
+#include "Meshlet.h"
+
+Frustum Frustum::from_matrix(const float m[16])
+{
+	// Gribb and Hartmann: each plane is the last row of the matrix plus or
+	// minus one of the others. Element (row, col) is m[col * 4 + row].
+	auto row = [&](int r, int c) { return m[c * 4 + r]; };
+
+	Frustum f;
+	for (int p = 0; p < 6; ++p) {
+		int r = p / 2;
+		float sign = (p % 2 == 0) ? 1.0f : -1.0f;
+
+		float plane[4];
+		for (int c = 0; c < 4; ++c)
+			plane[c] = row(3, c) + sign * row(r, c);
+
+		float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+		for (int c = 0; c < 4; ++c)
+			f.planes[p][c] = length > 0.0f ? plane[c] / length : plane[c];
+	}
+
+	return f;
+}
+
+bool Frustum::intersects_sphere(const float center[3], float radius) const
+{
+	for (int p = 0; p < 6; ++p) {
+		const float *pl = planes[p];
+		if (pl[0] * center[0] + pl[1] * center[1] + pl[2] * center[2] + pl[3] < -radius)
+			return false;
+	}
+
+	return true;
+}
+
+bool Frustum::intersects_aabb(const float min[3], const float max[3]) const
+{
+	for (int p = 0; p < 6; ++p) {
+		const float *pl = planes[p];
+
+		// The corner furthest along the plane normal.
+		float x = pl[0] >= 0.0f ? max[0] : min[0];
+		float y = pl[1] >= 0.0f ? max[1] : min[1];
+		float z = pl[2] >= 0.0f ? max[2] : min[2];
+
+		if (pl[0] * x + pl[1] * y + pl[2] * z + pl[3] < 0.0f)
+			return false;
+	}
+
+	return true;
+}
+
+bool MeshletCull::frustum_culled(const Meshlet &m, const Frustum &frustum)
+{
+	return !frustum.intersects_sphere(m.center, m.radius)
+		|| !frustum.intersects_aabb(m.aabb_min, m.aabb_max);
+}
+
+bool MeshletCull::cone_culled(const Meshlet &m, const float camera_position[3])
+{
+	if (m.cone_cutoff >= 1.0f)
+		return false;
+
+	float d[3] = {
+		m.cone_apex[0] - camera_position[0],
+		m.cone_apex[1] - camera_position[1],
+		m.cone_apex[2] - camera_position[2]
+	};
+	float length = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+	if (length == 0.0f)
+		return false;
+
+	float dot = (d[0] * m.cone_axis[0] + d[1] * m.cone_axis[1] + d[2] * m.cone_axis[2]) / length;
+	return dot >= m.cone_cutoff;
+}
+
+size_t MeshletCull::cull(const Meshlet *meshlets, size_t count, const Frustum &frustum,
+	const float *camera_position, std::vector<DrawRange> &draws)
+{
+	size_t visible = 0;
+
+	for (size_t i = 0; i < count; ++i) {
+		const Meshlet &m = meshlets[i];
+
+		if (frustum_culled(m, frustum))
+			continue;
+		if (camera_position && cone_culled(m, camera_position))
+			continue;
+
+		++visible;
+
+		if (!draws.empty() && draws.back().first_index + draws.back().index_count == m.first_index)
+			draws.back().index_count += m.index_count;
+		else
+			draws.push_back({ m.first_index, m.index_count });
+	}
+
+	return visible;
+}
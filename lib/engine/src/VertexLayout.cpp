@@ -0,0 +1,115 @@
+#include <iostream>
+
+#include "VertexLayout.h"
+
+VertexLayout::VertexLayout() :
+	m_elements(),
+	m_stride(0)
+{
+}
+
+VertexLayout::VertexLayout(const Element *elements, size_t count, uint32_t stride) :
+	m_elements(),
+	m_stride(stride)
+{
+	assert(count <= ATTRIBUTE_COUNT);
+
+	for (size_t i = 0; i < count; ++i) {
+		m_elements[i] = elements[i];
+	}
+}
+
+VertexLayout::Dequantize::Dequantize() :
+	position_offset{ 0.0f, 0.0f, 0.0f },
+	position_scale{ 1.0f, 1.0f, 1.0f },
+	uv_offset{ 0.0f, 0.0f },
+	uv_scale{ 1.0f, 1.0f },
+	normal_octahedral(0)
+{
+}
+
+void VertexLayout::Dequantize::set_uniforms(const Program &program) const
+{
+	GLint location;
+
+	if ((location = glGetUniformLocation(program.id(), "vertex_offset")) >= 0)
+		glUniform3fv(location, 1, position_offset);
+	if ((location = glGetUniformLocation(program.id(), "vertex_scale")) >= 0)
+		glUniform3fv(location, 1, position_scale);
+	if ((location = glGetUniformLocation(program.id(), "uv_offset")) >= 0)
+		glUniform2fv(location, 1, uv_offset);
+	if ((location = glGetUniformLocation(program.id(), "uv_scale")) >= 0)
+		glUniform2fv(location, 1, uv_scale);
+	if ((location = glGetUniformLocation(program.id(), "normal_octahedral")) >= 0)
+		glUniform1i(location, normal_octahedral ? 1 : 0);
+}
+
+void VertexLayout::add(Attribute attribute, uint32_t size, GLenum type, bool normalized)
+{
+	assert(attribute < ATTRIBUTE_COUNT);
+	assert(size >= 1 && size <= 4);
+	assert(!has(attribute));
+
+	Element &e = m_elements[attribute];
+	e.size = size;
+	e.type = type;
+	e.normalized = normalized ? GL_TRUE : GL_FALSE;
+	e.offset = m_stride;
+
+	m_stride += (size * type_size(type) + 3) & ~3u;
+}
+
+void VertexLayout::bind(const Program &program) const
+{
+	for (int a = 0; a < ATTRIBUTE_COUNT; ++a) {
+		const Element &e = m_elements[a];
+		if (e.size == 0)
+			continue;
+
+		GLint location = glGetAttribLocation(program.id(), attribute_name((Attribute)a));
+		if (location < 0)
+			continue;
+
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, e.size, e.type, (GLboolean)e.normalized, m_stride,
+			(const void *)(uintptr_t)e.offset);
+	}
+}
+
+const char *VertexLayout::attribute_name(Attribute attribute)
+{
+	switch (attribute) {
+	case POSITION:
+		return "vertex";
+	case NORMAL:
+		return "normal";
+	case UV:
+		return "uv";
+	case TANGENT:
+		return "tangent";
+	default:
+		return "";
+	}
+}
+
+uint32_t VertexLayout::type_size(GLenum type)
+{
+	switch (type) {
+	case GL_BYTE:
+	case GL_UNSIGNED_BYTE:
+		return 1;
+	case GL_SHORT:
+	case GL_UNSIGNED_SHORT:
+	case GL_HALF_FLOAT:
+		return 2;
+	case GL_INT:
+	case GL_UNSIGNED_INT:
+	case GL_FLOAT:
+	case GL_INT_2_10_10_10_REV:
+	case GL_UNSIGNED_INT_2_10_10_10_REV:
+		return 4;
+	default:
+		std::cerr << "VertexLayout: unknown component type " << type << "\n";
+		return 0;
+	}
+}
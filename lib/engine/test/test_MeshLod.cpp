@@ -0,0 +1,48 @@
+#include <cmath>
+#include <iostream>
+
+#include "MeshLod.h"
+#include "TestCheck.h"
+
+static void test_select() {
+	MeshLod lod;
+	lod.add({ 0, 3000, 0.0f });
+	lod.add({ 3000, 1500, 0.01f });
+	lod.add({ 4500, 750, 0.04f });
+
+	// Close up every simplified level is visibly wrong.
+	CHECK(lod.select(1000.0f) == 0);
+	// 0.01 * 100 = 1 pixel is still acceptable, 0.04 * 100 is not.
+	CHECK(lod.select(100.0f) == 1);
+	CHECK(lod.select(10.0f) == 2);
+	CHECK(lod.select(10.0f, 0.05f) == 0);
+}
+
+static void test_single_level() {
+	MeshLod lod;
+	lod.add({ 0, 300, 0.0f });
+	CHECK(lod.select(1e6f) == 0);
+	CHECK(lod.select(0.0f) == 0);
+}
+
+static void test_perspective_scale() {
+	// A 90 degree field of view shows 2 * distance units across the
+	// viewport height.
+	float scale = MeshLod::perspective_scale(10.0f, 3.14159265f / 2.0f, 800.0f);
+	CHECK(std::fabs(scale - 40.0f) < 1e-3f);
+}
+
+int main() {
+	std::cout << "Launching test_MeshLod...\n";
+
+	test_select();
+	test_single_level();
+	test_perspective_scale();
+
+	if (failures) {
+		std::cerr << failures << " check(s) failed\n";
+		return 1;
+	}
+
+	return 0;
+}
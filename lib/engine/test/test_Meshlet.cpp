@@ -0,0 +1,102 @@
+#include <iostream>
+
+#include "Meshlet.h"
+#include "TestCheck.h"
+
+static const float identity[16] = {
+	1.0f, 0.0f, 0.0f, 0.0f,
+	0.0f, 1.0f, 0.0f, 0.0f,
+	0.0f, 0.0f, 1.0f, 0.0f,
+	0.0f, 0.0f, 0.0f, 1.0f
+};
+
+static Meshlet make_meshlet(uint32_t first, float x, float y, float z, float r) {
+	Meshlet m = {};
+	m.first_index = first;
+	m.index_count = 3;
+	m.center[0] = x; m.center[1] = y; m.center[2] = z;
+	m.radius = r;
+	m.aabb_min[0] = x - r; m.aabb_min[1] = y - r; m.aabb_min[2] = z - r;
+	m.aabb_max[0] = x + r; m.aabb_max[1] = y + r; m.aabb_max[2] = z + r;
+	m.cone_apex[0] = x; m.cone_apex[1] = y; m.cone_apex[2] = z;
+	m.cone_cutoff = 1.0f;
+	return m;
+}
+
+static void test_frustum() {
+	Frustum f = Frustum::from_matrix(identity);
+
+	const float inside[3] = { 0.0f, 0.0f, 0.0f };
+	const float outside[3] = { 3.0f, 0.0f, 0.0f };
+	const float straddling[3] = { 1.5f, 0.0f, 0.0f };
+
+	CHECK(f.intersects_sphere(inside, 0.1f));
+	CHECK(!f.intersects_sphere(outside, 1.0f));
+	CHECK(f.intersects_sphere(straddling, 1.0f));
+
+	const float lo[3] = { 1.2f, -0.5f, -0.5f };
+	const float hi[3] = { 2.0f, 0.5f, 0.5f };
+	CHECK(!f.intersects_aabb(lo, hi));
+}
+
+static void test_translated_frustum() {
+	// Column-major translation by +5 in x moves the visible box to x in [-6, -4].
+	float m[16];
+	for (int i = 0; i < 16; ++i)
+		m[i] = identity[i];
+	m[12] = 5.0f;
+
+	Frustum f = Frustum::from_matrix(m);
+	const float moved[3] = { -5.0f, 0.0f, 0.0f };
+	const float origin[3] = { 0.0f, 0.0f, 0.0f };
+	CHECK(f.intersects_sphere(moved, 0.1f));
+	CHECK(!f.intersects_sphere(origin, 0.1f));
+}
+
+static void test_cone() {
+	Meshlet m = make_meshlet(0, 0.0f, 0.0f, 0.0f, 1.0f);
+	m.cone_axis[2] = 1.0f;
+	m.cone_cutoff = 0.5f;
+
+	// Every triangle faces +z, so from -z only their backs are visible.
+	const float behind[3] = { 0.0f, 0.0f, -10.0f };
+	const float in_front[3] = { 0.0f, 0.0f, 10.0f };
+	CHECK(MeshletCull::cone_culled(m, behind));
+	CHECK(!MeshletCull::cone_culled(m, in_front));
+
+	m.cone_cutoff = 1.0f;
+	CHECK(!MeshletCull::cone_culled(m, behind));
+}
+
+static void test_cull_merges_ranges() {
+	Meshlet meshlets[4] = {
+		make_meshlet(0, 0.0f, 0.0f, 0.0f, 0.1f),
+		make_meshlet(3, 0.5f, 0.0f, 0.0f, 0.1f),
+		make_meshlet(6, 9.0f, 0.0f, 0.0f, 0.1f),
+		make_meshlet(9, -0.5f, 0.0f, 0.0f, 0.1f),
+	};
+
+	std::vector<MeshletCull::DrawRange> draws;
+	size_t visible = MeshletCull::cull(meshlets, 4, Frustum::from_matrix(identity), nullptr, draws);
+
+	CHECK(visible == 3);
+	CHECK(draws.size() == 2);
+	CHECK(draws[0].first_index == 0 && draws[0].index_count == 6);
+	CHECK(draws[1].first_index == 9 && draws[1].index_count == 3);
+}
+
+int main() {
+	std::cout << "Launching test_Meshlet...\n";
+
+	test_frustum();
+	test_translated_frustum();
+	test_cone();
+	test_cull_merges_ranges();
+
+	if (failures) {
+		std::cerr << failures << " check(s) failed\n";
+		return 1;
+	}
+
+	return 0;
+}
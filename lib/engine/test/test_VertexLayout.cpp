@@ -0,0 +1,60 @@
+#include <iostream>
+
+#include "VertexLayout.h"
+#include "TestCheck.h"
+
+static void test_float_layout() {
+	VertexLayout layout;
+	layout.add(VertexLayout::POSITION, 3);
+	layout.add(VertexLayout::NORMAL, 3);
+	layout.add(VertexLayout::UV, 2);
+
+	CHECK(layout.stride() == 32);
+	CHECK(layout.element(VertexLayout::POSITION).offset == 0);
+	CHECK(layout.element(VertexLayout::NORMAL).offset == 12);
+	CHECK(layout.element(VertexLayout::UV).offset == 24);
+	CHECK(!layout.has(VertexLayout::TANGENT));
+}
+
+static void test_packed_layout_alignment() {
+	// Each attribute starts on a four byte boundary.
+	VertexLayout layout;
+	layout.add(VertexLayout::POSITION, 3, GL_SHORT, true);
+	layout.add(VertexLayout::UV, 2, GL_UNSIGNED_SHORT, true);
+	layout.add(VertexLayout::NORMAL, 1, GL_INT_2_10_10_10_REV);
+
+	CHECK(layout.element(VertexLayout::POSITION).offset == 0);
+	CHECK(layout.element(VertexLayout::UV).offset == 8);
+	CHECK(layout.element(VertexLayout::NORMAL).offset == 12);
+	CHECK(layout.stride() == 16);
+	CHECK(layout.element(VertexLayout::POSITION).normalized == GL_TRUE);
+}
+
+static void test_copy_from_elements() {
+	VertexLayout a;
+	a.add(VertexLayout::POSITION, 3);
+	a.add(VertexLayout::UV, 2);
+
+	VertexLayout b(a.elements(), VertexLayout::ATTRIBUTE_COUNT, a.stride());
+	CHECK(b.stride() == a.stride());
+	for (int i = 0; i < VertexLayout::ATTRIBUTE_COUNT; ++i) {
+		const VertexLayout::Element &ea = a.element((VertexLayout::Attribute)i);
+		const VertexLayout::Element &eb = b.element((VertexLayout::Attribute)i);
+		CHECK(ea.size == eb.size && ea.type == eb.type && ea.offset == eb.offset);
+	}
+}
+
+int main() {
+	std::cout << "Launching test_VertexLayout...\n";
+
+	test_float_layout();
+	test_packed_layout_alignment();
+	test_copy_from_elements();
+
+	if (failures) {
+		std::cerr << failures << " check(s) failed\n";
+		return 1;
+	}
+
+	return 0;
+}